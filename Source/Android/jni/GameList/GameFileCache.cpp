@@ -61,13 +61,16 @@ JNIEXPORT void JNICALL Java_org_dolphinemu_dolphinemu_model_GameFileCache_finali
 JNIEXPORT jobjectArray JNICALL
 Java_org_dolphinemu_dolphinemu_model_GameFileCache_getAllGames(JNIEnv* env, jobject obj)
 {
-  const UICommon::GameFileCache* ptr = GetPointer(env, obj);
+  // ForEach drops games that can't be read from the cache file, so GetSize can't be used here
+  std::vector<std::shared_ptr<const UICommon::GameFile>> games;
+  GetPointer(env, obj)->ForEach(
+      [&games](const auto& game_file) { games.push_back(game_file); });
+
   const jobjectArray array =
-      env->NewObjectArray(static_cast<jsize>(ptr->GetSize()), IDCache::GetGameFileClass(), nullptr);
+      env->NewObjectArray(static_cast<jsize>(games.size()), IDCache::GetGameFileClass(), nullptr);
   jsize i = 0;
-  GetPointer(env, obj)->ForEach([env, array, &i](const auto& game_file) {
+  for (const auto& game_file : games)
     env->SetObjectArrayElement(array, i++, GameFileToJava(env, game_file));
-  });
   return array;
 }
 
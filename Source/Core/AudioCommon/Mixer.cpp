@@ -4,6 +4,7 @@
 
 #include "AudioCommon/Mixer.h"
 
+#include <array>
 #include <cmath>
 #include <cstring>
 
@@ -15,6 +16,16 @@
 #include "Common/Swap.h"
 #include "Core/ConfigManager.h"
 
+#if defined(_M_X86)
+#include <emmintrin.h>
+#elif defined(_M_ARM_64)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 Mixer::Mixer(unsigned int BackendSampleRate)
     : m_sampleRate(BackendSampleRate), m_stretcher(BackendSampleRate)
 {
@@ -33,12 +44,298 @@ void Mixer::DoState(PointerWrap& p)
   m_wiimote_speaker_mixer.DoState(p);
 }
 
+#if defined(_M_X86)
+
+// Interpolating uses 32-bit multiplications that wrap around like the scalar code does. SSE2 only
+// has 32-bit multiplications with 64-bit results, so use two of those.
+static __m128i MultiplyLow32(__m128i a, __m128i b)
+{
+  const __m128i even = _mm_mul_epu32(a, b);
+  const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Byteswaps 4 sample pairs from the FIFO and puts the right channel first, like the output.
+static __m128i LoadSamplePairs(const u32* pairs)
+{
+  const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs));
+  const __m128i swapped = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(swapped, _MM_SHUFFLE(2, 3, 0, 1)),
+                             _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static __m128i ExtendLow(__m128i x)
+{
+  return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+static __m128i ExtendHigh(__m128i x)
+{
+  return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+}
+
+static __m128i InterpolateAndScale(__m128i current, __m128i next, __m128i fracs, __m128i volumes)
+{
+  const __m128i delta = MultiplyLow32(_mm_sub_epi32(next, current), fracs);
+  const __m128i sample = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(current, 16), delta), 16);
+  return _mm_srai_epi32(MultiplyLow32(sample, volumes), 8);
+}
+
+// Mixes 4 sample pairs the same way as the scalar loop in MixLinear does.
+static void MixLinearPairs(short* samples, const u32* current, const u32* next, const u32* fracs,
+                           s32 lvolume, s32 rvolume)
+{
+  const __m128i current_pairs = LoadSamplePairs(current);
+  const __m128i next_pairs = LoadSamplePairs(next);
+  const __m128i frac_values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fracs));
+  const __m128i volumes = _mm_setr_epi32(rvolume, lvolume, rvolume, lvolume);
+  const __m128i output = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+
+  const __m128i low =
+      _mm_add_epi32(InterpolateAndScale(ExtendLow(current_pairs), ExtendLow(next_pairs),
+                                        _mm_unpacklo_epi32(frac_values, frac_values), volumes),
+                    ExtendLow(output));
+  const __m128i high =
+      _mm_add_epi32(InterpolateAndScale(ExtendHigh(current_pairs), ExtendHigh(next_pairs),
+                                        _mm_unpackhi_epi32(frac_values, frac_values), volumes),
+                    ExtendHigh(output));
+
+  // Saturating to 16 bits and raising -32768 to -32767 is the same as clamping to +-32767.
+  const __m128i result = _mm_max_epi16(_mm_packs_epi32(low, high), _mm_set1_epi16(-32767));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(samples), result);
+}
+
+#elif defined(_M_ARM_64)
+
+// Byteswaps 4 sample pairs from the FIFO and puts the right channel first, like the output.
+static int16x8_t LoadSamplePairs(const u32* pairs)
+{
+  const uint8x16_t swapped = vrev16q_u8(vld1q_u8(reinterpret_cast<const u8*>(pairs)));
+  return vrev32q_s16(vreinterpretq_s16_u8(swapped));
+}
+
+static int32x4_t InterpolateAndScale(int32x4_t current, int32x4_t next, int32x4_t fracs,
+                                     int32x4_t volumes)
+{
+  const int32x4_t delta = vmulq_s32(vsubq_s32(next, current), fracs);
+  const int32x4_t sample = vshrq_n_s32(vaddq_s32(vshlq_n_s32(current, 16), delta), 16);
+  return vshrq_n_s32(vmulq_s32(sample, volumes), 8);
+}
+
+// Mixes 4 sample pairs the same way as the scalar loop in MixLinear does.
+static void MixLinearPairs(short* samples, const u32* current, const u32* next, const u32* fracs,
+                           s32 lvolume, s32 rvolume)
+{
+  const int16x8_t current_pairs = LoadSamplePairs(current);
+  const int16x8_t next_pairs = LoadSamplePairs(next);
+  const int32x4_t frac_values = vreinterpretq_s32_u32(vld1q_u32(fracs));
+  const s32 volume_values[4] = {rvolume, lvolume, rvolume, lvolume};
+  const int32x4_t volumes = vld1q_s32(volume_values);
+  const int16x8_t output = vld1q_s16(samples);
+
+  const int32x4_t low = vaddw_s16(
+      InterpolateAndScale(vmovl_s16(vget_low_s16(current_pairs)),
+                          vmovl_s16(vget_low_s16(next_pairs)),
+                          vzip1q_s32(frac_values, frac_values), volumes),
+      vget_low_s16(output));
+  const int32x4_t high = vaddw_s16(
+      InterpolateAndScale(vmovl_s16(vget_high_s16(current_pairs)),
+                          vmovl_s16(vget_high_s16(next_pairs)),
+                          vzip2q_s32(frac_values, frac_values), volumes),
+      vget_high_s16(output));
+
+  // Saturating to 16 bits and raising -32768 to -32767 is the same as clamping to +-32767.
+  const int16x8_t result = vcombine_s16(vqmovn_s32(low), vqmovn_s32(high));
+  vst1q_s16(samples, vmaxq_s16(result, vdupq_n_s16(-32767)));
+}
+
+#endif
+
+// The high quality resampler uses windowed sinc filters over this many input samples, for
+// POLYPHASE_PHASES positions between two input samples.
+constexpr u32 POLYPHASE_TAPS = 8;
+constexpr u32 POLYPHASE_PHASES = 256;
+
+// Windowed sinc filters for every POLYPHASE_PHASES-th of the distance between two input samples,
+// in 2.14 fixed point. The filter for a position uses the samples from POLYPHASE_TAPS / 2 - 1
+// before the current one to POLYPHASE_TAPS / 2 after it.
+static const std::array<std::array<s16, POLYPHASE_TAPS>, POLYPHASE_PHASES>&
+GetPolyphaseFilters()
+{
+  static const auto filters = [] {
+    constexpr int HALF_TAPS = POLYPHASE_TAPS / 2;
+    // Slightly below the input's Nyquist frequency, since the filters are short
+    constexpr double CUTOFF = 0.9;
+
+    std::array<std::array<s16, POLYPHASE_TAPS>, POLYPHASE_PHASES> result;
+    for (u32 phase = 0; phase < POLYPHASE_PHASES; ++phase)
+    {
+      const double frac = static_cast<double>(phase) / POLYPHASE_PHASES;
+      std::array<double, POLYPHASE_TAPS> taps;
+      double sum = 0.0;
+      for (int i = 0; i < static_cast<int>(POLYPHASE_TAPS); ++i)
+      {
+        const double x = i - (HALF_TAPS - 1) - frac;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * CUTOFF * x) / (M_PI * CUTOFF * x);
+        // Blackman window
+        const double window =
+            0.42 + 0.5 * std::cos(M_PI * x / HALF_TAPS) + 0.08 * std::cos(2 * M_PI * x / HALF_TAPS);
+        taps[i] = sinc * window;
+        sum += taps[i];
+      }
+
+      // Normalize to a gain of exactly 1, putting the rounding error on the biggest tap
+      int int_sum = 0;
+      for (u32 i = 0; i < POLYPHASE_TAPS; ++i)
+      {
+        result[phase][i] = static_cast<s16>(std::lround(taps[i] / sum * (1 << 14)));
+        int_sum += result[phase][i];
+      }
+      const int biggest = frac < 0.5 ? HALF_TAPS - 1 : HALF_TAPS;
+      result[phase][biggest] += static_cast<s16>((1 << 14) - int_sum);
+    }
+    return result;
+  }();
+  return filters;
+}
+
+static bool UseHighQualityResampling()
+{
+  return SConfig::GetInstance().m_audio_hq_resampling;
+}
+
+unsigned int Mixer::MixerFifo::MixLinear(short* samples, unsigned int num_samples,
+                                         u32* index_read, u32 index_write, u32 ratio,
+                                         s32 lvolume, s32 rvolume)
+{
+  u32 indexR = *index_read;
+  const u32 indexW = index_write;
+  unsigned int currentSample = 0;
+
+#if defined(_M_X86) || defined(_M_ARM_64)
+  // Gather 4 sample pairs and the positions between them, and interpolate them all at once.
+  while (currentSample + 8 <= num_samples * 2)
+  {
+    u32 current[4], next[4], fracs[4];
+    u32 index = indexR;
+    u32 frac = m_frac;
+    int i = 0;
+    for (; i < 4 && ((indexW - index) & INDEX_MASK) > 2; ++i)
+    {
+      std::memcpy(&current[i], &m_buffer[index & INDEX_MASK], sizeof(u32));
+      std::memcpy(&next[i], &m_buffer[(index + 2) & INDEX_MASK], sizeof(u32));
+      fracs[i] = frac;
+
+      frac += ratio;
+      index += 2 * (u16)(frac >> 16);
+      frac &= 0xffff;
+    }
+    if (i < 4)
+      break;
+
+    MixLinearPairs(&samples[currentSample], current, next, fracs, lvolume, rvolume);
+    currentSample += 8;
+    indexR = index;
+    m_frac = frac;
+  }
+#endif
+
+  for (; currentSample < num_samples * 2 && ((indexW - indexR) & INDEX_MASK) > 2;
+       currentSample += 2)
+  {
+    u32 indexR2 = indexR + 2;  // next sample
+
+    s16 l1 = Common::swap16(m_buffer[indexR & INDEX_MASK]);   // current
+    s16 l2 = Common::swap16(m_buffer[indexR2 & INDEX_MASK]);  // next
+    int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
+    sampleL = (sampleL * lvolume) >> 8;
+    sampleL += samples[currentSample + 1];
+    samples[currentSample + 1] = MathUtil::Clamp(sampleL, -32767, 32767);
+
+    s16 r1 = Common::swap16(m_buffer[(indexR + 1) & INDEX_MASK]);   // current
+    s16 r2 = Common::swap16(m_buffer[(indexR2 + 1) & INDEX_MASK]);  // next
+    int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
+    sampleR = (sampleR * rvolume) >> 8;
+    sampleR += samples[currentSample];
+    samples[currentSample] = MathUtil::Clamp(sampleR, -32767, 32767);
+
+    m_frac += ratio;
+    indexR += 2 * (u16)(m_frac >> 16);
+    m_frac &= 0xffff;
+  }
+
+  *index_read = indexR;
+  return currentSample / 2;
+}
+
+unsigned int Mixer::MixerFifo::MixPolyphase(short* samples, unsigned int num_samples,
+                                            u32* index_read, u32 index_write, u32 ratio,
+                                            s32 lvolume, s32 rvolume)
+{
+  static_assert(std::tuple_size<decltype(m_history)>::value == POLYPHASE_TAPS * 2,
+                "The history must hold the sample pairs for a whole filter");
+
+  const auto& filters = GetPolyphaseFilters();
+  u32 indexR = *index_read;
+  unsigned int currentSample = 0;
+
+  // The sample pairs before indexR have been consumed, so PushSamples may already have
+  // overwritten them in m_buffer. They are taken from the history instead.
+  const auto get_sample = [&](s32 pair, u32 channel) -> s16 {
+    if (pair < 0)
+      return m_history[(POLYPHASE_TAPS + pair) * 2 + channel];
+    return Common::swap16(m_buffer[(indexR + pair * 2 + channel) & INDEX_MASK]);
+  };
+
+  for (; currentSample < num_samples * 2 &&
+         ((index_write - indexR) & INDEX_MASK) > POLYPHASE_TAPS;
+       currentSample += 2)
+  {
+    const std::array<s16, POLYPHASE_TAPS>& filter =
+        filters[m_frac * POLYPHASE_PHASES / 0x10000];
+    s32 sum_l = 0;
+    s32 sum_r = 0;
+    for (u32 i = 0; i < POLYPHASE_TAPS; ++i)
+    {
+      const s32 pair = static_cast<s32>(i) - static_cast<s32>(POLYPHASE_TAPS / 2 - 1);
+      sum_l += filter[i] * get_sample(pair, 0);
+      sum_r += filter[i] * get_sample(pair, 1);
+    }
+
+    const int sampleL = ((sum_l >> 14) * lvolume >> 8) + samples[currentSample + 1];
+    samples[currentSample + 1] = MathUtil::Clamp(sampleL, -32767, 32767);
+    const int sampleR = ((sum_r >> 14) * rvolume >> 8) + samples[currentSample];
+    samples[currentSample] = MathUtil::Clamp(sampleR, -32767, 32767);
+
+    m_frac += ratio;
+    const s32 step = static_cast<u16>(m_frac >> 16);
+    m_frac &= 0xffff;
+
+    if (step == 0)
+      continue;
+
+    // Nothing at or after indexR has been consumed yet, so all pairs up to the new indexR can
+    // still be read from m_buffer.
+    std::array<short, POLYPHASE_TAPS * 2> history;
+    for (s32 i = 0; i < static_cast<s32>(POLYPHASE_TAPS); ++i)
+    {
+      const s32 pair = step - static_cast<s32>(POLYPHASE_TAPS) + i;
+      history[i * 2] = get_sample(pair, 0);
+      history[i * 2 + 1] = get_sample(pair, 1);
+    }
+    m_history = history;
+    indexR += 2 * step;
+  }
+
+  *index_read = indexR;
+  return currentSample / 2;
+}
+
 // Executed from sound stream thread
 unsigned int Mixer::MixerFifo::Mix(short* samples, unsigned int numSamples,
                                    bool consider_framelimit)
 {
-  unsigned int currentSample = 0;
-
   // Cache access in non-volatile variable
   // This is the only function changing the read value, so it's safe to
   // cache it locally although it's written here.
@@ -77,32 +374,12 @@ unsigned int Mixer::MixerFifo::Mix(short* samples, unsigned int numSamples,
   s32 lvolume = m_LVolume.load();
   s32 rvolume = m_RVolume.load();
 
-  // TODO: consider a higher-quality resampling algorithm.
-  for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2)
-  {
-    u32 indexR2 = indexR + 2;  // next sample
-
-    s16 l1 = Common::swap16(m_buffer[indexR & INDEX_MASK]);   // current
-    s16 l2 = Common::swap16(m_buffer[indexR2 & INDEX_MASK]);  // next
-    int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
-    sampleL = (sampleL * lvolume) >> 8;
-    sampleL += samples[currentSample + 1];
-    samples[currentSample + 1] = MathUtil::Clamp(sampleL, -32767, 32767);
-
-    s16 r1 = Common::swap16(m_buffer[(indexR + 1) & INDEX_MASK]);   // current
-    s16 r2 = Common::swap16(m_buffer[(indexR2 + 1) & INDEX_MASK]);  // next
-    int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
-    sampleR = (sampleR * rvolume) >> 8;
-    sampleR += samples[currentSample];
-    samples[currentSample] = MathUtil::Clamp(sampleR, -32767, 32767);
-
-    m_frac += ratio;
-    indexR += 2 * (u16)(m_frac >> 16);
-    m_frac &= 0xffff;
-  }
-
   // Actual number of samples written to the buffer without padding.
-  unsigned int actual_sample_count = currentSample / 2;
+  const unsigned int actual_sample_count =
+      UseHighQualityResampling() ?
+          MixPolyphase(samples, numSamples, &indexR, indexW, ratio, lvolume, rvolume) :
+          MixLinear(samples, numSamples, &indexR, indexW, ratio, lvolume, rvolume);
+  unsigned int currentSample = actual_sample_count * 2;
 
   // Padding
   short s[2];
@@ -367,7 +644,9 @@ void Mixer::MixerFifo::SetVolume(unsigned int lvolume, unsigned int rvolume)
 unsigned int Mixer::MixerFifo::AvailableSamples() const
 {
   unsigned int samples_in_fifo = ((m_indexW.load() - m_indexR.load()) & INDEX_MASK) / 2;
-  if (samples_in_fifo <= 1)
-    return 0;  // Mixer::MixerFifo::Mix always keeps one sample in the buffer.
-  return (samples_in_fifo - 1) * m_mixer->m_sampleRate / m_input_sample_rate;
+  // Mixer::MixerFifo::Mix always keeps the samples that it interpolates towards in the buffer.
+  const unsigned int lookahead = UseHighQualityResampling() ? POLYPHASE_TAPS / 2 : 1;
+  if (samples_in_fifo <= lookahead)
+    return 0;
+  return (samples_in_fifo - lookahead) * m_mixer->m_sampleRate / m_input_sample_rate;
 }
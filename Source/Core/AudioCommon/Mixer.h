@@ -67,6 +67,13 @@ private:
     unsigned int AvailableSamples() const;
 
   private:
+    // Both advance *index_read and return the number of sample pairs that were mixed into
+    // samples, which is less than num_samples if the FIFO runs out of samples.
+    unsigned int MixLinear(short* samples, unsigned int num_samples, u32* index_read,
+                           u32 index_write, u32 ratio, s32 lvolume, s32 rvolume);
+    unsigned int MixPolyphase(short* samples, unsigned int num_samples, u32* index_read,
+                              u32 index_write, u32 ratio, s32 lvolume, s32 rvolume);
+
     Mixer* m_mixer;
     unsigned m_input_sample_rate;
     std::array<short, MAX_SAMPLES * 2> m_buffer{};
@@ -77,6 +84,8 @@ private:
     std::atomic<s32> m_RVolume{256};
     float m_numLeftI = 0.0f;
     u32 m_frac = 0;
+    // The last sample pairs that the high quality resampler consumed, in native byte order
+    std::array<short, 8 * 2> m_history{};
   };
 
   MixerFifo m_dma_mixer{this, 32000};
@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <cstring>
 #include <deque>
+#include <functional>
 #include <list>
 #include <map>
 #include <set>
@@ -55,6 +56,15 @@ public:
   PointerWrap(u8** ptr_, Mode mode_) : ptr(ptr_), mode(mode_) {}
   void SetMode(Mode mode_) { mode = mode_; }
   Mode GetMode() const { return mode; }
+  // In write mode, the callback is called with the current position after every marker. Everything
+  // before that position has been written and can be consumed while the rest is being written.
+  void SetMarkerCallback(std::function<void(const u8*)> callback)
+  {
+    m_marker_callback = std::move(callback);
+  }
+  // In read mode, nothing at or past end is read. Instead, the mode is switched to measure mode
+  // like when a marker doesn't match, so callers have to check the mode afterwards.
+  void SetReadLimit(const u8* end) { m_read_limit = end; }
   template <typename K, class V>
   void Do(std::map<K, V>& x)
   {
@@ -64,6 +74,8 @@ public:
     switch (mode)
     {
     case MODE_READ:
+      if (!CheckReadCount(count))
+        break;
       for (x.clear(); count != 0; --count)
       {
         std::pair<K, V> pair;
@@ -94,6 +106,8 @@ public:
     switch (mode)
     {
     case MODE_READ:
+      if (!CheckReadCount(count))
+        break;
       for (x.clear(); count != 0; --count)
       {
         V value;
@@ -235,6 +249,9 @@ public:
                   prevName.c_str(), cookie, cookie, arbitraryNumber, arbitraryNumber);
       mode = PointerWrap::MODE_MEASURE;
     }
+
+    if (mode == PointerWrap::MODE_WRITE && m_marker_callback)
+      m_marker_callback(*ptr);
   }
 
   template <typename T, typename Functor>
@@ -242,6 +259,8 @@ public:
   {
     u32 size = static_cast<u32>(container.size());
     Do(size);
+    if (!CheckReadCount(size))
+      size = static_cast<u32>(container.size());
     container.resize(size);
 
     for (auto& elem : container)
@@ -249,6 +268,23 @@ public:
   }
 
 private:
+  std::function<void(const u8*)> m_marker_callback;
+  const u8* m_read_limit = nullptr;
+
+  // Every element takes at least one byte, so a count that is larger than what is left before the
+  // read limit can only come from corrupted data. Checking it keeps such counts from being used
+  // to allocate containers.
+  bool CheckReadCount(u32 count)
+  {
+    if (mode != MODE_READ || !m_read_limit ||
+        count <= static_cast<size_t>(m_read_limit - *ptr))
+    {
+      return true;
+    }
+    mode = MODE_MEASURE;
+    return false;
+  }
+
   template <typename T>
   void DoContainer(T& x)
   {
@@ -260,6 +296,11 @@ private:
     switch (mode)
     {
     case MODE_READ:
+      if (m_read_limit && size > static_cast<size_t>(m_read_limit - *ptr))
+      {
+        mode = MODE_MEASURE;
+        break;
+      }
       memcpy(data, *ptr, size);
       break;
 
@@ -3,8 +3,22 @@
 // Refer to the license.txt file included.
 
 #include <mbedtls/aes.h>
+#include <memory>
 
+#include "Common/CPUDetect.h"
 #include "Common/Crypto/AES.h"
+#include "Common/Intrinsics.h"
+
+#ifdef _M_ARM_64
+#include <arm_neon.h>
+#ifdef __ARM_FEATURE_CRYPTO
+#define FUNCTION_TARGET_CRYPTO
+#elif defined(__clang__)
+#define FUNCTION_TARGET_CRYPTO [[gnu::target("crypto")]]
+#else
+#define FUNCTION_TARGET_CRYPTO [[gnu::target("+crypto")]]
+#endif
+#endif
 
 namespace Common
 {
@@ -35,5 +49,177 @@ std::vector<u8> Encrypt(const u8* key, u8* iv, const u8* src, size_t size)
 {
   return DecryptEncrypt(key, iv, src, size, Mode::Encrypt);
 }
+
+constexpr int NUM_ROUNDS = 10;
+// CBC decryption has no dependency between blocks, so this many blocks are kept in flight at
+// once to hide the latency of the AES instructions.
+constexpr size_t PARALLEL_BLOCKS = 8;
+
+class ContextGeneric final : public Context
+{
+public:
+  explicit ContextGeneric(const u8* key)
+  {
+    mbedtls_aes_init(&m_ctx);
+    mbedtls_aes_setkey_dec(&m_ctx, key, 128);
+  }
+  ~ContextGeneric() { mbedtls_aes_free(&m_ctx); }
+
+  void DecryptCBC(u8* iv, const u8* src, u8* dst, size_t size) const override
+  {
+    mbedtls_aes_crypt_cbc(&m_ctx, MBEDTLS_AES_DECRYPT, size, iv, src, dst);
+  }
+
+private:
+  mutable mbedtls_aes_context m_ctx;
+};
+
+#if defined(_M_X86)
+FUNCTION_TARGET_AES
+static void DecryptCBCAESNI(const __m128i* keys, u8* iv, const u8* src, u8* dst, size_t size)
+{
+  const __m128i* in_ptr = reinterpret_cast<const __m128i*>(src);
+  __m128i* out_ptr = reinterpret_cast<__m128i*>(dst);
+  const size_t num_blocks = size / 16;
+  __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+
+  size_t i = 0;
+  for (; i + PARALLEL_BLOCKS <= num_blocks; i += PARALLEL_BLOCKS)
+  {
+    __m128i in[PARALLEL_BLOCKS];
+    __m128i state[PARALLEL_BLOCKS];
+    for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+    {
+      in[j] = _mm_loadu_si128(in_ptr + i + j);
+      state[j] = _mm_xor_si128(in[j], keys[0]);
+    }
+    for (int round = 1; round < NUM_ROUNDS; round++)
+    {
+      for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+        state[j] = _mm_aesdec_si128(state[j], keys[round]);
+    }
+    for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+    {
+      state[j] = _mm_aesdeclast_si128(state[j], keys[NUM_ROUNDS]);
+      _mm_storeu_si128(out_ptr + i + j, _mm_xor_si128(state[j], j == 0 ? prev : in[j - 1]));
+    }
+    prev = in[PARALLEL_BLOCKS - 1];
+  }
+
+  for (; i < num_blocks; i++)
+  {
+    const __m128i in = _mm_loadu_si128(in_ptr + i);
+    __m128i state = _mm_xor_si128(in, keys[0]);
+    for (int round = 1; round < NUM_ROUNDS; round++)
+      state = _mm_aesdec_si128(state, keys[round]);
+    state = _mm_aesdeclast_si128(state, keys[NUM_ROUNDS]);
+    _mm_storeu_si128(out_ptr + i, _mm_xor_si128(state, prev));
+    prev = in;
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), prev);
+}
+
+class ContextAESNI final : public Context
+{
+public:
+  // mbedtls stores the decryption key schedule in the layout AESDEC expects.
+  explicit ContextAESNI(const mbedtls_aes_context& ctx)
+  {
+    for (int i = 0; i <= NUM_ROUNDS; i++)
+      m_keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctx.rk) + i);
+  }
+
+  void DecryptCBC(u8* iv, const u8* src, u8* dst, size_t size) const override
+  {
+    DecryptCBCAESNI(m_keys, iv, src, dst, size);
+  }
+
+private:
+  __m128i m_keys[NUM_ROUNDS + 1];
+};
+#elif defined(_M_ARM_64)
+FUNCTION_TARGET_CRYPTO
+static void DecryptCBCNEON(const uint8x16_t* keys, u8* iv, const u8* src, u8* dst, size_t size)
+{
+  const size_t num_blocks = size / 16;
+  uint8x16_t prev = vld1q_u8(iv);
+
+  // AESD adds the round key before the inverse S-box rather than after it, so the last round
+  // key is applied with a plain XOR.
+  size_t i = 0;
+  for (; i + PARALLEL_BLOCKS <= num_blocks; i += PARALLEL_BLOCKS)
+  {
+    uint8x16_t in[PARALLEL_BLOCKS];
+    uint8x16_t state[PARALLEL_BLOCKS];
+    for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+      state[j] = in[j] = vld1q_u8(src + (i + j) * 16);
+    for (int round = 0; round < NUM_ROUNDS - 1; round++)
+    {
+      for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+        state[j] = vaesimcq_u8(vaesdq_u8(state[j], keys[round]));
+    }
+    for (size_t j = 0; j < PARALLEL_BLOCKS; j++)
+    {
+      state[j] = veorq_u8(vaesdq_u8(state[j], keys[NUM_ROUNDS - 1]), keys[NUM_ROUNDS]);
+      vst1q_u8(dst + (i + j) * 16, veorq_u8(state[j], j == 0 ? prev : in[j - 1]));
+    }
+    prev = in[PARALLEL_BLOCKS - 1];
+  }
+
+  for (; i < num_blocks; i++)
+  {
+    const uint8x16_t in = vld1q_u8(src + i * 16);
+    uint8x16_t state = in;
+    for (int round = 0; round < NUM_ROUNDS - 1; round++)
+      state = vaesimcq_u8(vaesdq_u8(state, keys[round]));
+    state = veorq_u8(vaesdq_u8(state, keys[NUM_ROUNDS - 1]), keys[NUM_ROUNDS]);
+    vst1q_u8(dst + i * 16, veorq_u8(state, prev));
+    prev = in;
+  }
+
+  vst1q_u8(iv, prev);
+}
+
+class ContextNEON final : public Context
+{
+public:
+  // mbedtls stores the decryption key schedule in the layout AESD/AESIMC expect.
+  explicit ContextNEON(const mbedtls_aes_context& ctx)
+  {
+    for (int i = 0; i <= NUM_ROUNDS; i++)
+      m_keys[i] = vld1q_u8(reinterpret_cast<const u8*>(ctx.rk) + i * 16);
+  }
+
+  void DecryptCBC(u8* iv, const u8* src, u8* dst, size_t size) const override
+  {
+    DecryptCBCNEON(m_keys, iv, src, dst, size);
+  }
+
+private:
+  uint8x16_t m_keys[NUM_ROUNDS + 1];
+};
+#endif
+
+std::unique_ptr<Context> CreateDecryptionContext(const u8* key)
+{
+#if defined(_M_X86) || defined(_M_ARM_64)
+  if (cpu_info.bAES)
+  {
+    mbedtls_aes_context ctx;
+    mbedtls_aes_init(&ctx);
+    mbedtls_aes_setkey_dec(&ctx, key, 128);
+#if defined(_M_X86)
+    std::unique_ptr<Context> context = std::make_unique<ContextAESNI>(ctx);
+#else
+    std::unique_ptr<Context> context = std::make_unique<ContextNEON>(ctx);
+#endif
+    mbedtls_aes_free(&ctx);
+    return context;
+  }
+#endif
+
+  return std::make_unique<ContextGeneric>(key);
+}
 }  // namespace AES
 }  // namespace Common
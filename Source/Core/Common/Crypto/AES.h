@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 #include <vector>
 
 #include "Common/CommonTypes.h"
@@ -23,5 +24,19 @@ std::vector<u8> DecryptEncrypt(const u8* key, u8* iv, const u8* src, size_t size
 // Convenience functions
 std::vector<u8> Decrypt(const u8* key, u8* iv, const u8* src, size_t size);
 std::vector<u8> Encrypt(const u8* key, u8* iv, const u8* src, size_t size);
+
+// An AES-128 decryption key that can be used many times. Uses AES-NI or the ARMv8 crypto
+// extensions when the CPU has them, and mbedtls otherwise.
+class Context
+{
+public:
+  virtual ~Context() = default;
+
+  // CBC-decrypts size bytes (a multiple of 16). Like mbedtls_aes_crypt_cbc, iv is updated so that
+  // the next call continues the chain. src and dst may point to the same buffer.
+  virtual void DecryptCBC(u8* iv, const u8* src, u8* dst, size_t size) const = 0;
+};
+
+std::unique_ptr<Context> CreateDecryptionContext(const u8* key);
 }  // namespace AES
 }  // namespace Common
@@ -0,0 +1,101 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Common/MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include "Common/StringUtil.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Common/CommonTypes.h"
+
+namespace File
+{
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+  Close();
+
+#ifdef _WIN32
+  const HANDLE file = CreateFile(UTF8ToTStr(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size;
+  // Empty files can't be mapped
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 ||
+      static_cast<u64>(file_size.QuadPart) > static_cast<u64>(SIZE_MAX))
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  // The view keeps the file mapping and the file open, so the handles can be closed right away
+  const HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+    return false;
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!data)
+    return false;
+  const u64 size = file_size.QuadPart;
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat file_stat;
+  // Empty files can't be mapped
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0 ||
+      static_cast<u64>(file_stat.st_size) > static_cast<u64>(SIZE_MAX))
+  {
+    close(fd);
+    return false;
+  }
+
+  // The mapping stays valid after the file descriptor is closed
+  void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  const u64 size = file_stat.st_size;
+#endif
+
+  m_data = static_cast<const u8*>(data);
+  m_size = static_cast<size_t>(size);
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (!m_data)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(m_data);
+#else
+  munmap(const_cast<u8*>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
+}  // namespace File
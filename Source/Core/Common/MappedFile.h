@@ -0,0 +1,38 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "Common/CommonTypes.h"
+
+namespace File
+{
+// A read-only view of a whole file. Pages are only read from disk when they are accessed, and the
+// OS can drop them again under memory pressure since they never become dirty.
+// The file must not be truncated or overwritten while it is mapped.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path);
+  void Close();
+
+  bool IsOpen() const { return m_data != nullptr; }
+  const u8* GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+private:
+  const u8* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+}  // namespace File
@@ -0,0 +1,91 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Common/ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "Common/Thread.h"
+
+namespace Common
+{
+ThreadPool::ThreadPool(unsigned int num_threads, const std::string& name)
+{
+  if (num_threads == 0)
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (unsigned int i = 1; i < num_threads; i++)
+    m_threads.emplace_back(&ThreadPool::WorkerLoop, this, name);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_shutdown = true;
+  }
+  m_wakeup.notify_all();
+
+  for (std::thread& thread : m_threads)
+    thread.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& function)
+{
+  if (m_threads.empty() || count <= 1)
+  {
+    for (size_t i = 0; i < count; i++)
+      function(i);
+    return;
+  }
+
+  std::lock_guard<std::mutex> job_lk(m_job_lock);
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_function = &function;
+    m_count = count;
+    m_next_item = 0;
+    m_busy_workers = m_threads.size();
+    m_generation++;
+  }
+  m_wakeup.notify_all();
+
+  RunItems();
+
+  std::unique_lock<std::mutex> lk(m_lock);
+  m_done.wait(lk, [this] { return m_busy_workers == 0; });
+  m_function = nullptr;
+}
+
+void ThreadPool::WorkerLoop(std::string name)
+{
+  SetCurrentThreadName(name.c_str());
+
+  u64 generation = 0;
+  std::unique_lock<std::mutex> lk(m_lock);
+  while (true)
+  {
+    m_wakeup.wait(lk, [&] { return m_shutdown || m_generation != generation; });
+    if (m_shutdown)
+      return;
+    generation = m_generation;
+
+    lk.unlock();
+    RunItems();
+    lk.lock();
+
+    if (--m_busy_workers == 0)
+      m_done.notify_one();
+  }
+}
+
+void ThreadPool::RunItems()
+{
+  size_t i;
+  while ((i = m_next_item.fetch_add(1)) < m_count)
+    (*m_function)(i);
+}
+
+}  // namespace Common
@@ -0,0 +1,59 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// A fixed set of worker threads for splitting up loops over independent items.
+
+namespace Common
+{
+class ThreadPool final
+{
+public:
+  // num_threads counts the calling thread, which takes part in the work as well.
+  // 0 uses one thread per hardware thread.
+  explicit ThreadPool(unsigned int num_threads = 0, const std::string& name = "Worker thread");
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t GetThreadCount() const { return m_threads.size() + 1; }
+
+  // Calls function(i) for every i in [0, count) and returns once all calls have finished.
+  // The calls are spread over the pool in no particular order. Calls from multiple threads are
+  // serialized; calling ParallelFor from inside function is not allowed.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+
+private:
+  void WorkerLoop(std::string name);
+  void RunItems();
+
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_job_lock;
+  std::mutex m_lock;
+  std::condition_variable m_wakeup;
+  std::condition_variable m_done;
+  u64 m_generation = 0;
+  size_t m_busy_workers = 0;
+  bool m_shutdown = false;
+
+  const std::function<void(size_t)>* m_function = nullptr;
+  size_t m_count = 0;
+  std::atomic<size_t> m_next_item{0};
+};
+
+}  // namespace Common
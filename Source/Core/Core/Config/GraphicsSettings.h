@@ -47,6 +47,7 @@ extern const ConfigInfo<std::string> GFX_DUMP_CODEC;
 extern const ConfigInfo<std::string> GFX_DUMP_ENCODER;
 extern const ConfigInfo<std::string> GFX_DUMP_PATH;
 extern const ConfigInfo<int> GFX_BITRATE_KBPS;
+extern const ConfigInfo<int> GFX_DUMP_ENCODER_THREADS;
 extern const ConfigInfo<bool> GFX_INTERNAL_RESOLUTION_FRAME_DUMPS;
 extern const ConfigInfo<bool> GFX_ENABLE_GPU_TEXTURE_DECODING;
 extern const ConfigInfo<bool> GFX_ENABLE_PIXEL_LIGHTING;
@@ -75,6 +76,7 @@ extern const ConfigInfo<bool> GFX_SW_DUMP_TEV_STAGES;
 extern const ConfigInfo<bool> GFX_SW_DUMP_TEV_TEX_FETCHES;
 extern const ConfigInfo<int> GFX_SW_DRAW_START;
 extern const ConfigInfo<int> GFX_SW_DRAW_END;
+extern const ConfigInfo<int> GFX_SW_RASTERIZER_THREADS;
 
 extern const ConfigInfo<bool> GFX_PREFER_GLES;
 
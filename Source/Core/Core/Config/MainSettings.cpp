@@ -20,6 +20,11 @@ const ConfigInfo<bool> MAIN_LOAD_IPL_DUMP{{System::Main, "Core", "LoadIPLDump"},
 const ConfigInfo<PowerPC::CPUCore> MAIN_CPU_CORE{{System::Main, "Core", "CPUCore"},
                                                  PowerPC::DefaultCPUCore()};
 const ConfigInfo<bool> MAIN_JIT_FOLLOW_BRANCH{{System::Main, "Core", "JITFollowBranch"}, true};
+const ConfigInfo<bool> MAIN_JIT_ANALYSIS_CACHE{{System::Main, "Core", "JITAnalysisCache"}, false};
+const ConfigInfo<bool> MAIN_JIT_ASYNC_COMPILE{{System::Main, "Core", "JITAsyncCompile"}, false};
+const ConfigInfo<bool> MAIN_JIT_TIERED_COMPILE{{System::Main, "Core", "JITTieredCompile"}, false};
+const ConfigInfo<bool> MAIN_JIT_SAMPLING_PROFILER{{System::Main, "Core", "JITSamplingProfiler"},
+                                                  false};
 const ConfigInfo<bool> MAIN_FASTMEM{{System::Main, "Core", "Fastmem"}, true};
 const ConfigInfo<bool> MAIN_DSP_HLE{{System::Main, "Core", "DSPHLE"}, true};
 const ConfigInfo<int> MAIN_TIMING_VARIANCE{{System::Main, "Core", "TimingVariance"}, 40};
@@ -34,6 +39,8 @@ const ConfigInfo<int> MAIN_AUDIO_LATENCY{{System::Main, "Core", "AudioLatency"},
 const ConfigInfo<bool> MAIN_AUDIO_STRETCH{{System::Main, "Core", "AudioStretch"}, false};
 const ConfigInfo<int> MAIN_AUDIO_STRETCH_LATENCY{{System::Main, "Core", "AudioStretchMaxLatency"},
                                                  80};
+const ConfigInfo<bool> MAIN_AUDIO_HQ_RESAMPLING{{System::Main, "Core", "AudioHQResampling"},
+                                                false};
 const ConfigInfo<std::string> MAIN_MEMCARD_A_PATH{{System::Main, "Core", "MemcardAPath"}, ""};
 const ConfigInfo<std::string> MAIN_MEMCARD_B_PATH{{System::Main, "Core", "MemcardBPath"}, ""};
 const ConfigInfo<std::string> MAIN_AGP_CART_A_PATH{{System::Main, "Core", "AgpCartAPath"}, ""};
@@ -87,6 +94,13 @@ const ConfigInfo<int> MAIN_SYNC_GPU_MIN_DISTANCE{{System::Main, "Core", "SyncGpu
                                                  -200000};
 const ConfigInfo<float> MAIN_SYNC_GPU_OVERCLOCK{{System::Main, "Core", "SyncGpuOverclock"}, 1.0f};
 const ConfigInfo<bool> MAIN_FAST_DISC_SPEED{{System::Main, "Core", "FastDiscSpeed"}, false};
+const ConfigInfo<bool> MAIN_DVD_READ_AHEAD{{System::Main, "Core", "DVDReadAhead"}, true};
+const ConfigInfo<bool> MAIN_REWIND_ENABLE{{System::Main, "Core", "RewindEnable"}, false};
+// In fields
+const ConfigInfo<int> MAIN_REWIND_INTERVAL{{System::Main, "Core", "RewindInterval"}, 30};
+// In MiB
+const ConfigInfo<int> MAIN_REWIND_MEMORY_BUDGET{{System::Main, "Core", "RewindMemoryBudget"},
+                                                512};
 const ConfigInfo<bool> MAIN_LOW_DCBZ_HACK{{System::Main, "Core", "LowDCBZHack"}, false};
 const ConfigInfo<bool> MAIN_FPRF{{System::Main, "Core", "FPRF"}, false};
 const ConfigInfo<bool> MAIN_ACCURATE_NANS{{System::Main, "Core", "AccurateNaNs"}, false};
@@ -21,6 +21,10 @@ extern const ConfigInfo<bool> MAIN_SKIP_IPL;
 extern const ConfigInfo<bool> MAIN_LOAD_IPL_DUMP;
 extern const ConfigInfo<PowerPC::CPUCore> MAIN_CPU_CORE;
 extern const ConfigInfo<bool> MAIN_JIT_FOLLOW_BRANCH;
+extern const ConfigInfo<bool> MAIN_JIT_ANALYSIS_CACHE;
+extern const ConfigInfo<bool> MAIN_JIT_ASYNC_COMPILE;
+extern const ConfigInfo<bool> MAIN_JIT_TIERED_COMPILE;
+extern const ConfigInfo<bool> MAIN_JIT_SAMPLING_PROFILER;
 extern const ConfigInfo<bool> MAIN_FASTMEM;
 // Should really be in the DSP section, but we're kind of stuck with bad decisions made in the past.
 extern const ConfigInfo<bool> MAIN_DSP_HLE;
@@ -35,6 +39,7 @@ extern const ConfigInfo<bool> MAIN_DPL2_DECODER;
 extern const ConfigInfo<int> MAIN_AUDIO_LATENCY;
 extern const ConfigInfo<bool> MAIN_AUDIO_STRETCH;
 extern const ConfigInfo<int> MAIN_AUDIO_STRETCH_LATENCY;
+extern const ConfigInfo<bool> MAIN_AUDIO_HQ_RESAMPLING;
 extern const ConfigInfo<std::string> MAIN_MEMCARD_A_PATH;
 extern const ConfigInfo<std::string> MAIN_MEMCARD_B_PATH;
 extern const ConfigInfo<std::string> MAIN_AGP_CART_A_PATH;
@@ -63,6 +68,10 @@ extern const ConfigInfo<int> MAIN_SYNC_GPU_MAX_DISTANCE;
 extern const ConfigInfo<int> MAIN_SYNC_GPU_MIN_DISTANCE;
 extern const ConfigInfo<float> MAIN_SYNC_GPU_OVERCLOCK;
 extern const ConfigInfo<bool> MAIN_FAST_DISC_SPEED;
+extern const ConfigInfo<bool> MAIN_DVD_READ_AHEAD;
+extern const ConfigInfo<bool> MAIN_REWIND_ENABLE;
+extern const ConfigInfo<int> MAIN_REWIND_INTERVAL;
+extern const ConfigInfo<int> MAIN_REWIND_MEMORY_BUDGET;
 extern const ConfigInfo<bool> MAIN_LOW_DCBZ_HACK;
 extern const ConfigInfo<bool> MAIN_FPRF;
 extern const ConfigInfo<bool> MAIN_ACCURATE_NANS;
@@ -57,6 +57,7 @@ bool IsSettingSaveable(const Config::ConfigLocation& config_location)
       Config::GFX_DUMP_ENCODER.location,
       Config::GFX_DUMP_PATH.location,
       Config::GFX_BITRATE_KBPS.location,
+      Config::GFX_DUMP_ENCODER_THREADS.location,
       Config::GFX_INTERNAL_RESOLUTION_FRAME_DUMPS.location,
       Config::GFX_ENABLE_GPU_TEXTURE_DECODING.location,
       Config::GFX_ENABLE_PIXEL_LIGHTING.location,
@@ -85,6 +86,7 @@ bool IsSettingSaveable(const Config::ConfigLocation& config_location)
       Config::GFX_SW_DUMP_TEV_TEX_FETCHES.location,
       Config::GFX_SW_DRAW_START.location,
       Config::GFX_SW_DRAW_END.location,
+      Config::GFX_SW_RASTERIZER_THREADS.location,
 
       // Graphics.Enhancements
 
@@ -117,6 +117,7 @@ struct SConfig
   int iLatency = 20;
   bool m_audio_stretch = false;
   int m_audio_stretch_max_latency = 80;
+  bool m_audio_hq_resampling = false;
 
   bool bRunCompareServer = false;
   bool bRunCompareClient = false;
@@ -33,6 +33,7 @@
 
 #include "Core/Analytics.h"
 #include "Core/BootManager.h"
+#include "Core/Config/MainSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/CoreTiming.h"
 #include "Core/DSPEmulator.h"
@@ -60,6 +61,7 @@
 #include "Core/PatchEngine.h"
 #include "Core/PowerPC/JitInterface.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/SamplingProfiler.h"
 #include "Core/State.h"
 #include "Core/WiiRoot.h"
 
@@ -297,6 +299,7 @@ static void CPUSetInitialExecutionState()
 static void CpuThread(const std::optional<std::string>& savestate_path, bool delete_savestate)
 {
   DeclareAsCPUThread();
+  Profiler::RegisterSampledThread();
 
   const SConfig& _CoreParameter = SConfig::GetInstance();
   if (_CoreParameter.bCPUThread)
@@ -324,6 +327,9 @@ static void CpuThread(const std::optional<std::string>& savestate_path, bool del
   s_is_started = true;
   CPUSetInitialExecutionState();
 
+  if (Config::Get(Config::MAIN_JIT_SAMPLING_PROFILER))
+    JitInterface::SetSamplingState(JitInterface::ProfilingState::Enabled);
+
 #ifdef USE_GDBSTUB
 #ifndef _WIN32
   if (!_CoreParameter.gdb_socket.empty())
@@ -346,6 +352,14 @@ static void CpuThread(const std::optional<std::string>& savestate_path, bool del
 
   s_is_started = false;
 
+  if (Profiler::IsSampling())
+  {
+    JitInterface::SetSamplingState(JitInterface::ProfilingState::Disabled);
+    JitInterface::WriteSamplingResults(File::GetUserPath(D_DUMP_IDX) + _CoreParameter.GetGameID() +
+                                       "_samples");
+  }
+  Profiler::UnregisterSampledThread();
+
   if (_CoreParameter.bFastmem)
     EMM::UninstallExceptionHandler();
 }
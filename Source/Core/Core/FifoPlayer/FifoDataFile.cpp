@@ -5,20 +5,48 @@
 #include "Core/FifoPlayer/FifoDataFile.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include <zlib.h>
+
 #include "Common/File.h"
+#include "Common/Logging/Log.h"
+#include "Common/Thread.h"
+#include "Common/ThreadPool.h"
+#include "Core/FifoPlayer/FifoAnalyzer.h"
+#include "Core/FifoPlayer/FifoPlaybackAnalyzer.h"
 
 enum
 {
   FILE_ID = 0x0d01f1f0,
-  VERSION_NUMBER = 4,
-  MIN_LOADER_VERSION = 1,
+  VERSION_NUMBER = 5,
+  MIN_LOADER_VERSION = 5,
+};
+
+// Since version 5, the FIFO data and the memory updates of every frame are stored as two
+// separately compressed chunks, so that single frames can be read quickly.
+enum : u8
+{
+  COMPRESSION_ZLIB = 1,
 };
 
+constexpr int COMPRESSION_LEVEL = 6;
+
+// The sizes of chunks come from the file, so they are checked before anything is allocated for
+// them. This is far more than a frame can write, even if it rewrote all of MEM1 and MEM2.
+constexpr u32 MAX_CHUNK_SIZE = 0x10000000;
+
 #pragma pack(push, 1)
 
 struct FileHeader
@@ -39,10 +67,16 @@ struct FileHeader
   u32 flags;
   u64 texMemOffset;
   u32 texMemSize;
-  u8 reserved[40];
+  u8 compression;  // Added in version 5
+  // Added in version 5, but zero in files that were saved without the playback analysis
+  u64 analysisOffset;
+  u32 analysisStoredSize;
+  u32 analysisSize;
+  u8 reserved[23];
 };
 static_assert(sizeof(FileHeader) == 128, "FileHeader should be 128 bytes");
 
+// Frame list entry before version 5
 struct FileFrameInfo
 {
   u64 fifoDataOffset;
@@ -55,6 +89,24 @@ struct FileFrameInfo
 };
 static_assert(sizeof(FileFrameInfo) == 64, "FileFrameInfo should be 64 bytes");
 
+// Frame list entry since version 5. A chunk whose stored size is its uncompressed size is stored
+// without compression. The memory updates chunk is laid out like the memory updates before
+// version 5, with data offsets relative to the start of the chunk.
+struct FileCompressedFrameInfo
+{
+  u64 fifoDataOffset;
+  u32 fifoDataStoredSize;
+  u32 fifoDataSize;
+  u32 fifoStart;
+  u32 fifoEnd;
+  u64 memoryUpdatesOffset;
+  u32 memoryUpdatesStoredSize;
+  u32 memoryUpdatesSize;
+  u32 numMemoryUpdates;
+  u8 reserved[20];
+};
+static_assert(sizeof(FileCompressedFrameInfo) == 64, "FileCompressedFrameInfo should be 64 bytes");
+
 struct FileMemoryUpdate
 {
   u32 fifoPosition;
@@ -68,6 +120,363 @@ static_assert(sizeof(FileMemoryUpdate) == 24, "FileMemoryUpdate should be 24 byt
 
 #pragma pack(pop)
 
+// The playback analysis is stored as the object count of every frame, each followed by the start
+// and end of every object.
+static std::vector<u8> SerializeAnalysis(const std::vector<AnalyzedFrameInfo>& analysis)
+{
+  std::vector<u8> chunk;
+  const auto append = [&chunk](u32 value) {
+    const u8* const bytes = reinterpret_cast<const u8*>(&value);
+    chunk.insert(chunk.end(), bytes, bytes + sizeof(value));
+  };
+
+  for (const AnalyzedFrameInfo& frame : analysis)
+  {
+    const size_t numObjects = std::min(frame.objectStarts.size(), frame.objectEnds.size());
+    append(static_cast<u32>(numObjects));
+    for (size_t i = 0; i < numObjects; ++i)
+    {
+      append(frame.objectStarts[i]);
+      append(frame.objectEnds[i]);
+    }
+  }
+
+  return chunk;
+}
+
+// Objects have to be inside the FIFO data of their frame, since playback writes them from there.
+static bool DeserializeAnalysis(const std::vector<u8>& chunk,
+                                const std::vector<FileCompressedFrameInfo>& frames,
+                                std::vector<AnalyzedFrameInfo>& analysis)
+{
+  size_t position = 0;
+  const auto read = [&](u32* value) {
+    if (chunk.size() - position < sizeof(*value))
+      return false;
+    std::memcpy(value, &chunk[position], sizeof(*value));
+    position += sizeof(*value);
+    return true;
+  };
+
+  analysis.resize(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    u32 numObjects;
+    if (!read(&numObjects) || numObjects > (chunk.size() - position) / (2 * sizeof(u32)))
+      return false;
+
+    AnalyzedFrameInfo& frame = analysis[i];
+    frame.objectStarts.resize(numObjects);
+    frame.objectEnds.resize(numObjects);
+    for (u32 j = 0; j < numObjects; ++j)
+    {
+      if (!read(&frame.objectStarts[j]) || !read(&frame.objectEnds[j]) ||
+          frame.objectStarts[j] > frame.objectEnds[j] ||
+          frame.objectEnds[j] > frames[i].fifoDataSize)
+      {
+        return false;
+      }
+    }
+  }
+
+  return position == chunk.size();
+}
+
+static bool IsValidChunk(u64 offset, u32 storedSize, u32 size, u64 fileSize)
+{
+  return size <= MAX_CHUNK_SIZE && storedSize <= size && offset <= fileSize &&
+         storedSize <= fileSize - offset;
+}
+
+// A chunk whose stored size is its uncompressed size is read directly into the destination.
+static bool ReadChunk(File::IOFile& file, u64 fileSize, u64 offset, u32 storedSize, u32 size,
+                      std::vector<u8>& data)
+{
+  if (!IsValidChunk(offset, storedSize, size, fileSize))
+  {
+    ERROR_LOG(VIDEO, "FIFO log chunk at 0x%" PRIx64 " has an invalid size", offset);
+    return false;
+  }
+
+  const bool isStored = storedSize == size;
+  std::vector<u8> compressed(isStored ? 0 : storedSize);
+  data.resize(size);
+
+  if (!file.Seek(offset, SEEK_SET) ||
+      !file.ReadBytes(isStored ? data.data() : compressed.data(), storedSize))
+  {
+    file.Clear();
+    ERROR_LOG(VIDEO, "Failed to read the FIFO log chunk at 0x%" PRIx64, offset);
+    return false;
+  }
+
+  if (isStored)
+    return true;
+
+  uLongf decompressedSize = size;
+  if (uncompress(data.data(), &decompressedSize, compressed.data(),
+                 static_cast<uLong>(compressed.size())) != Z_OK ||
+      decompressedSize != size)
+  {
+    ERROR_LOG(VIDEO, "Failed to decompress the FIFO log chunk at 0x%" PRIx64, offset);
+    return false;
+  }
+
+  return true;
+}
+
+// Returns the data unchanged if compressing it doesn't make it smaller.
+static std::vector<u8> CompressChunk(std::vector<u8> data)
+{
+  uLongf compressed_size = compressBound(static_cast<uLong>(data.size()));
+  std::vector<u8> compressed(compressed_size);
+  if (compress2(compressed.data(), &compressed_size, data.data(), static_cast<uLong>(data.size()),
+                COMPRESSION_LEVEL) != Z_OK ||
+      compressed_size >= data.size())
+  {
+    return data;
+  }
+
+  compressed.resize(compressed_size);
+  return compressed;
+}
+
+static std::vector<u8> SerializeMemoryUpdates(const std::vector<MemoryUpdate>& memUpdates)
+{
+  const size_t headersSize = memUpdates.size() * sizeof(FileMemoryUpdate);
+  size_t size = headersSize;
+  for (const MemoryUpdate& update : memUpdates)
+    size += update.data.size();
+
+  std::vector<u8> chunk(size);
+  u64 dataOffset = headersSize;
+  for (size_t i = 0; i < memUpdates.size(); ++i)
+  {
+    const MemoryUpdate& srcUpdate = memUpdates[i];
+
+    FileMemoryUpdate dstUpdate = {};
+    dstUpdate.address = srcUpdate.address;
+    dstUpdate.dataOffset = dataOffset;
+    dstUpdate.dataSize = static_cast<u32>(srcUpdate.data.size());
+    dstUpdate.fifoPosition = srcUpdate.fifoPosition;
+    dstUpdate.type = srcUpdate.type;
+
+    std::memcpy(&chunk[i * sizeof(FileMemoryUpdate)], &dstUpdate, sizeof(FileMemoryUpdate));
+    std::copy(srcUpdate.data.begin(), srcUpdate.data.end(), chunk.begin() + dataOffset);
+    dataOffset += srcUpdate.data.size();
+  }
+
+  return chunk;
+}
+
+static bool DeserializeMemoryUpdates(const std::vector<u8>& chunk, u32 numUpdates,
+                                     std::vector<MemoryUpdate>& memUpdates)
+{
+  if (chunk.size() / sizeof(FileMemoryUpdate) < numUpdates)
+    return false;
+
+  memUpdates.resize(numUpdates);
+  for (u32 i = 0; i < numUpdates; ++i)
+  {
+    FileMemoryUpdate srcUpdate;
+    std::memcpy(&srcUpdate, &chunk[i * sizeof(FileMemoryUpdate)], sizeof(FileMemoryUpdate));
+    if (srcUpdate.dataOffset > chunk.size() ||
+        srcUpdate.dataSize > chunk.size() - srcUpdate.dataOffset)
+    {
+      return false;
+    }
+
+    MemoryUpdate& dstUpdate = memUpdates[i];
+    dstUpdate.address = srcUpdate.address;
+    dstUpdate.fifoPosition = srcUpdate.fifoPosition;
+    dstUpdate.data.assign(chunk.begin() + srcUpdate.dataOffset,
+                          chunk.begin() + srcUpdate.dataOffset + srcUpdate.dataSize);
+    dstUpdate.type = static_cast<MemoryUpdate::Type>(srcUpdate.type);
+  }
+
+  return true;
+}
+
+// Reads the frames of a loaded file when they are requested. Whenever a frame is requested, the
+// next one is read ahead of time on a separate thread, so that playing back a compressed file
+// doesn't have to wait for frames to be decompressed.
+class FifoDataFile::FrameReader final
+{
+public:
+  FrameReader(File::IOFile file, bool compressed, std::vector<FileCompressedFrameInfo> frames)
+      : m_file(std::move(file)), m_file_size(m_file.GetSize()), m_compressed(compressed),
+        m_frames(std::move(frames))
+  {
+    m_prefetch_thread = std::thread(&FrameReader::PrefetchThread, this);
+  }
+
+  ~FrameReader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_shutdown = true;
+    }
+    m_prefetch_wakeup.notify_one();
+    m_prefetch_thread.join();
+  }
+
+  u32 GetFrameCount() const { return static_cast<u32>(m_frames.size()); }
+
+  std::shared_ptr<const FifoFrameInfo> GetFrame(u32 frame)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+
+      // Don't read the frame twice if it is being prefetched
+      m_prefetch_done.wait(lock, [&] { return m_prefetching_frame != frame; });
+
+      if (frame + 1 < GetFrameCount())
+      {
+        m_prefetch_request = frame + 1;
+        m_prefetch_wakeup.notify_one();
+      }
+
+      if (std::shared_ptr<const FifoFrameInfo> cached = FindCachedFrame(frame))
+        return cached;
+    }
+
+    std::shared_ptr<const FifoFrameInfo> result = ReadFrame(frame);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    AddCachedFrame(frame, result);
+    return result;
+  }
+
+  std::optional<std::vector<u8>> GetFifoData(u32 frame)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (std::shared_ptr<const FifoFrameInfo> cached = FindCachedFrame(frame))
+        return cached->fifoData;
+    }
+
+    std::vector<u8> fifoData;
+    if (!ReadFifoData(frame, fifoData))
+    {
+      ERROR_LOG(VIDEO, "Failed to read frame %u of the FIFO log", frame);
+      return std::nullopt;
+    }
+    return fifoData;
+  }
+
+private:
+  static constexpr size_t MAX_CACHED_FRAMES = 4;
+
+  void PrefetchThread()
+  {
+    Common::SetCurrentThreadName("FIFO log prefetch thread");
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true)
+    {
+      m_prefetch_wakeup.wait(lock, [&] { return m_shutdown || m_prefetch_request; });
+      if (m_shutdown)
+        return;
+
+      const u32 frame = *m_prefetch_request;
+      m_prefetch_request.reset();
+      if (FindCachedFrame(frame))
+        continue;
+
+      m_prefetching_frame = frame;
+      lock.unlock();
+      std::shared_ptr<const FifoFrameInfo> result = ReadFrame(frame);
+      lock.lock();
+
+      AddCachedFrame(frame, std::move(result));
+      m_prefetching_frame.reset();
+      m_prefetch_done.notify_all();
+    }
+  }
+
+  std::shared_ptr<const FifoFrameInfo> ReadFrame(u32 frame)
+  {
+    const FileCompressedFrameInfo& srcFrame = m_frames[frame];
+
+    auto dstFrame = std::make_shared<FifoFrameInfo>();
+    dstFrame->fifoStart = srcFrame.fifoStart;
+    dstFrame->fifoEnd = srcFrame.fifoEnd;
+    if (!ReadFifoData(frame, dstFrame->fifoData) ||
+        !ReadMemoryUpdates(frame, dstFrame->memoryUpdates))
+    {
+      ERROR_LOG(VIDEO, "Failed to read frame %u of the FIFO log", frame);
+      return nullptr;
+    }
+
+    return dstFrame;
+  }
+
+  bool ReadFifoData(u32 frame, std::vector<u8>& fifoData)
+  {
+    const FileCompressedFrameInfo& srcFrame = m_frames[frame];
+    return ReadChunk(srcFrame.fifoDataOffset, srcFrame.fifoDataStoredSize, srcFrame.fifoDataSize,
+                     fifoData);
+  }
+
+  bool ReadMemoryUpdates(u32 frame, std::vector<MemoryUpdate>& memUpdates)
+  {
+    const FileCompressedFrameInfo& srcFrame = m_frames[frame];
+
+    if (!m_compressed)
+    {
+      std::lock_guard<std::mutex> lock(m_file_lock);
+      const bool good = FifoDataFile::ReadMemoryUpdates(
+          srcFrame.memoryUpdatesOffset, srcFrame.numMemoryUpdates, memUpdates, m_file);
+      m_file.Clear();
+      return good;
+    }
+
+    std::vector<u8> chunk;
+    return ReadChunk(srcFrame.memoryUpdatesOffset, srcFrame.memoryUpdatesStoredSize,
+                     srcFrame.memoryUpdatesSize, chunk) &&
+           DeserializeMemoryUpdates(chunk, srcFrame.numMemoryUpdates, memUpdates);
+  }
+
+  bool ReadChunk(u64 offset, u32 storedSize, u32 size, std::vector<u8>& data)
+  {
+    std::lock_guard<std::mutex> lock(m_file_lock);
+    return ::ReadChunk(m_file, m_file_size, offset, storedSize, size, data);
+  }
+
+  std::shared_ptr<const FifoFrameInfo> FindCachedFrame(u32 frame) const
+  {
+    const auto it = std::find_if(m_cache.begin(), m_cache.end(),
+                                 [frame](const auto& entry) { return entry.first == frame; });
+    return it != m_cache.end() ? it->second : nullptr;
+  }
+
+  void AddCachedFrame(u32 frame, std::shared_ptr<const FifoFrameInfo> data)
+  {
+    // Frames that couldn't be read are tried again the next time they are requested
+    if (!data || FindCachedFrame(frame))
+      return;
+
+    if (m_cache.size() == MAX_CACHED_FRAMES)
+      m_cache.pop_front();
+    m_cache.emplace_back(frame, std::move(data));
+  }
+
+  File::IOFile m_file;
+  std::mutex m_file_lock;
+  const u64 m_file_size;
+  const bool m_compressed;
+  const std::vector<FileCompressedFrameInfo> m_frames;
+
+  std::mutex m_lock;
+  std::deque<std::pair<u32, std::shared_ptr<const FifoFrameInfo>>> m_cache;
+  std::condition_variable m_prefetch_wakeup;
+  std::condition_variable m_prefetch_done;
+  std::optional<u32> m_prefetch_request;
+  std::optional<u32> m_prefetching_frame;
+  bool m_shutdown = false;
+  std::thread m_prefetch_thread;
+};
+
 FifoDataFile::FifoDataFile() = default;
 
 FifoDataFile::~FifoDataFile() = default;
@@ -94,7 +503,31 @@ bool FifoDataFile::GetIsWii() const
 
 void FifoDataFile::AddFrame(const FifoFrameInfo& frameInfo)
 {
-  m_Frames.push_back(frameInfo);
+  m_Frames.push_back(std::make_shared<FifoFrameInfo>(frameInfo));
+}
+
+u32 FifoDataFile::GetFrameCount() const
+{
+  if (m_frame_reader)
+    return m_frame_reader->GetFrameCount();
+
+  return static_cast<u32>(m_Frames.size());
+}
+
+std::shared_ptr<const FifoFrameInfo> FifoDataFile::GetFrame(u32 frame) const
+{
+  if (m_frame_reader)
+    return m_frame_reader->GetFrame(frame);
+
+  return m_Frames[frame];
+}
+
+std::optional<std::vector<u8>> FifoDataFile::GetFrameFifoData(u32 frame) const
+{
+  if (m_frame_reader)
+    return m_frame_reader->GetFifoData(frame);
+
+  return m_Frames[frame]->fifoData;
 }
 
 bool FifoDataFile::Save(const std::string& filename)
@@ -103,12 +536,23 @@ bool FifoDataFile::Save(const std::string& filename)
   if (!file.Open(filename, "wb"))
     return false;
 
+  const u32 frameCount = GetFrameCount();
+
+  // Storing the playback analysis means that opening the file doesn't require reading every frame
+  std::vector<AnalyzedFrameInfo> analysis = m_analysis;
+  if (analysis.size() != frameCount)
+  {
+    FifoAnalyzer::Init();
+    if (!FifoPlaybackAnalyzer::AnalyzeFrames(this, analysis))
+      return false;
+  }
+
   // Add space for header
   PadFile(sizeof(FileHeader), file);
 
   // Add space for frame list
   u64 frameListOffset = file.Tell();
-  PadFile(m_Frames.size() * sizeof(FileFrameInfo), file);
+  PadFile(frameCount * sizeof(FileCompressedFrameInfo), file);
 
   u64 bpMemOffset = file.Tell();
   file.WriteArray(m_BPMem, BP_MEM_SIZE);
@@ -125,8 +569,67 @@ bool FifoDataFile::Save(const std::string& filename)
   u64 texMemOffset = file.Tell();
   file.WriteArray(m_TexMem, TEX_MEM_SIZE);
 
+  // Write frames, compressing a batch of them at a time on all cores
+  struct CompressedFrame
+  {
+    std::vector<u8> fifoData;
+    std::vector<u8> memoryUpdates;
+  };
+
+  Common::ThreadPool pool(0, "FIFO log compression thread");
+  const u32 batchSize = static_cast<u32>(pool.GetThreadCount()) * 2;
+  std::vector<CompressedFrame> batch(batchSize);
+  std::vector<FileCompressedFrameInfo> frameList(frameCount);
+  std::atomic<bool> readFailed{false};
+
+  for (u32 firstFrame = 0; firstFrame < frameCount; firstFrame += batchSize)
+  {
+    const u32 batchFrames = std::min(batchSize, frameCount - firstFrame);
+    pool.ParallelFor(batchFrames, [&](size_t i) {
+      const u32 frame = firstFrame + static_cast<u32>(i);
+      const std::shared_ptr<const FifoFrameInfo> srcFrame = GetFrame(frame);
+      if (!srcFrame)
+      {
+        readFailed = true;
+        return;
+      }
+      std::vector<u8> memoryUpdates = SerializeMemoryUpdates(srcFrame->memoryUpdates);
+
+      FileCompressedFrameInfo& dstFrame = frameList[frame];
+      dstFrame.fifoDataSize = static_cast<u32>(srcFrame->fifoData.size());
+      dstFrame.fifoStart = srcFrame->fifoStart;
+      dstFrame.fifoEnd = srcFrame->fifoEnd;
+      dstFrame.memoryUpdatesSize = static_cast<u32>(memoryUpdates.size());
+      dstFrame.numMemoryUpdates = static_cast<u32>(srcFrame->memoryUpdates.size());
+
+      batch[i].fifoData = CompressChunk(srcFrame->fifoData);
+      batch[i].memoryUpdates = CompressChunk(std::move(memoryUpdates));
+    });
+    if (readFailed)
+      return false;
+
+    for (u32 i = 0; i < batchFrames; ++i)
+    {
+      FileCompressedFrameInfo& dstFrame = frameList[firstFrame + i];
+
+      dstFrame.fifoDataOffset = file.Tell();
+      dstFrame.fifoDataStoredSize = static_cast<u32>(batch[i].fifoData.size());
+      file.WriteBytes(batch[i].fifoData.data(), batch[i].fifoData.size());
+
+      dstFrame.memoryUpdatesOffset = file.Tell();
+      dstFrame.memoryUpdatesStoredSize = static_cast<u32>(batch[i].memoryUpdates.size());
+      file.WriteBytes(batch[i].memoryUpdates.data(), batch[i].memoryUpdates.size());
+    }
+  }
+
+  std::vector<u8> analysisChunk = SerializeAnalysis(analysis);
+  const u64 analysisOffset = file.Tell();
+  const u32 analysisSize = static_cast<u32>(analysisChunk.size());
+  analysisChunk = CompressChunk(std::move(analysisChunk));
+  file.WriteBytes(analysisChunk.data(), analysisChunk.size());
+
   // Write header
-  FileHeader header;
+  FileHeader header = {};
   header.fileId = FILE_ID;
   header.file_version = VERSION_NUMBER;
   header.min_loader_version = MIN_LOADER_VERSION;
@@ -147,40 +650,23 @@ bool FifoDataFile::Save(const std::string& filename)
   header.texMemSize = TEX_MEM_SIZE;
 
   header.frameListOffset = frameListOffset;
-  header.frameCount = (u32)m_Frames.size();
+  header.frameCount = frameCount;
 
   header.flags = m_Flags;
+  header.compression = COMPRESSION_ZLIB;
+
+  header.analysisOffset = analysisOffset;
+  header.analysisStoredSize = static_cast<u32>(analysisChunk.size());
+  header.analysisSize = analysisSize;
 
   file.Seek(0, SEEK_SET);
   file.WriteBytes(&header, sizeof(FileHeader));
 
   // Write frames list
-  for (unsigned int i = 0; i < m_Frames.size(); ++i)
-  {
-    const FifoFrameInfo& srcFrame = m_Frames[i];
+  file.Seek(frameListOffset, SEEK_SET);
+  file.WriteArray(frameList.data(), frameList.size());
 
-    // Write FIFO data
-    file.Seek(0, SEEK_END);
-    u64 dataOffset = file.Tell();
-    file.WriteBytes(srcFrame.fifoData.data(), srcFrame.fifoData.size());
-
-    u64 memoryUpdatesOffset = WriteMemoryUpdates(srcFrame.memoryUpdates, file);
-
-    FileFrameInfo dstFrame;
-    dstFrame.fifoDataSize = static_cast<u32>(srcFrame.fifoData.size());
-    dstFrame.fifoDataOffset = dataOffset;
-    dstFrame.fifoStart = srcFrame.fifoStart;
-    dstFrame.fifoEnd = srcFrame.fifoEnd;
-    dstFrame.memoryUpdatesOffset = memoryUpdatesOffset;
-    dstFrame.numMemoryUpdates = static_cast<u32>(srcFrame.memoryUpdates.size());
-
-    // Write frame info
-    u64 frameOffset = frameListOffset + (i * sizeof(FileFrameInfo));
-    file.Seek(frameOffset, SEEK_SET);
-    file.WriteBytes(&dstFrame, sizeof(FileFrameInfo));
-  }
-
-  if (!file.Close())
+  if (!file.IsGood() || !file.Close())
     return false;
 
   return true;
@@ -238,33 +724,105 @@ std::unique_ptr<FifoDataFile> FifoDataFile::Load(const std::string& filename, bo
     file.ReadArray(dataFile->m_TexMem, size);
   }
 
-  // Read frames
-  for (u32 i = 0; i < header.frameCount; ++i)
+  // Compressed frames were added in version 5.
+  const bool compressed = dataFile->m_Version >= 5;
+  if (compressed && header.compression != COMPRESSION_ZLIB)
   {
-    u64 frameOffset = header.frameListOffset + (i * sizeof(FileFrameInfo));
-    file.Seek(frameOffset, SEEK_SET);
-    FileFrameInfo srcFrame;
-    file.ReadBytes(&srcFrame, sizeof(FileFrameInfo));
+    file.Close();
+    return nullptr;
+  }
 
-    FifoFrameInfo dstFrame;
-    dstFrame.fifoData.resize(srcFrame.fifoDataSize);
-    dstFrame.fifoStart = srcFrame.fifoStart;
-    dstFrame.fifoEnd = srcFrame.fifoEnd;
+  // Read the frame list. The frames themselves are read on demand.
+  const u64 fileSize = file.GetSize();
+  const u64 frameInfoSize = compressed ? sizeof(FileCompressedFrameInfo) : sizeof(FileFrameInfo);
+  if (header.frameListOffset > fileSize ||
+      header.frameCount > (fileSize - header.frameListOffset) / frameInfoSize)
+  {
+    file.Close();
+    return nullptr;
+  }
 
-    file.Seek(srcFrame.fifoDataOffset, SEEK_SET);
-    file.ReadBytes(dstFrame.fifoData.data(), srcFrame.fifoDataSize);
+  std::vector<FileCompressedFrameInfo> frames(header.frameCount);
+  file.Seek(header.frameListOffset, SEEK_SET);
+  if (compressed)
+  {
+    file.ReadArray(frames.data(), frames.size());
+  }
+  else
+  {
+    for (FileCompressedFrameInfo& dstFrame : frames)
+    {
+      FileFrameInfo srcFrame;
+      file.ReadBytes(&srcFrame, sizeof(FileFrameInfo));
+
+      dstFrame = {};
+      dstFrame.fifoDataOffset = srcFrame.fifoDataOffset;
+      dstFrame.fifoDataStoredSize = srcFrame.fifoDataSize;
+      dstFrame.fifoDataSize = srcFrame.fifoDataSize;
+      dstFrame.fifoStart = srcFrame.fifoStart;
+      dstFrame.fifoEnd = srcFrame.fifoEnd;
+      dstFrame.memoryUpdatesOffset = srcFrame.memoryUpdatesOffset;
+      dstFrame.numMemoryUpdates = srcFrame.numMemoryUpdates;
+    }
+  }
 
-    ReadMemoryUpdates(srcFrame.memoryUpdatesOffset, srcFrame.numMemoryUpdates,
-                      dstFrame.memoryUpdates, file);
+  if (!file.IsGood())
+  {
+    file.Close();
+    return nullptr;
+  }
 
-    dataFile->AddFrame(dstFrame);
+  // Reject sizes that reading the frames would fail on or allocate far too much for, instead of
+  // finding out during playback
+  for (u32 i = 0; i < header.frameCount; ++i)
+  {
+    const FileCompressedFrameInfo& frame = frames[i];
+    const bool memoryUpdatesValid =
+        compressed ? IsValidChunk(frame.memoryUpdatesOffset, frame.memoryUpdatesStoredSize,
+                                  frame.memoryUpdatesSize, fileSize) :
+                     frame.memoryUpdatesOffset <= fileSize &&
+                         frame.numMemoryUpdates <=
+                             (fileSize - frame.memoryUpdatesOffset) / sizeof(FileMemoryUpdate);
+    if (!IsValidChunk(frame.fifoDataOffset, frame.fifoDataStoredSize, frame.fifoDataSize,
+                      fileSize) ||
+        !memoryUpdatesValid)
+    {
+      ERROR_LOG(VIDEO, "Frame %u of the FIFO log \"%s\" has an invalid size", i, filename.c_str());
+      file.Close();
+      return nullptr;
+    }
   }
 
-  file.Close();
+  if (compressed && header.analysisOffset != 0)
+  {
+    std::vector<u8> analysisChunk;
+    if (!ReadChunk(file, fileSize, header.analysisOffset, header.analysisStoredSize,
+                   header.analysisSize, analysisChunk) ||
+        !DeserializeAnalysis(analysisChunk, frames, dataFile->m_analysis))
+    {
+      ERROR_LOG(VIDEO, "The playback analysis of the FIFO log \"%s\" is corrupted",
+                filename.c_str());
+      file.Close();
+      return nullptr;
+    }
+  }
+
+  dataFile->m_frame_reader =
+      std::make_unique<FrameReader>(std::move(file), compressed, std::move(frames));
 
   return dataFile;
 }
 
+bool FifoDataFile::Convert(const std::string& input_filename, const std::string& output_filename)
+{
+  // The input file is read while the output file is being written
+  if (input_filename == output_filename)
+    return false;
+
+  const std::unique_ptr<FifoDataFile> file = Load(input_filename, false);
+  return file && file->Save(output_filename);
+}
+
 void FifoDataFile::PadFile(size_t numBytes, File::IOFile& file)
 {
   for (size_t i = 0; i < numBytes; ++i)
@@ -284,40 +842,10 @@ bool FifoDataFile::GetFlag(u32 flag) const
   return !!(m_Flags & flag);
 }
 
-u64 FifoDataFile::WriteMemoryUpdates(const std::vector<MemoryUpdate>& memUpdates,
-                                     File::IOFile& file)
-{
-  // Add space for memory update list
-  u64 updateListOffset = file.Tell();
-  PadFile(memUpdates.size() * sizeof(FileMemoryUpdate), file);
-
-  for (unsigned int i = 0; i < memUpdates.size(); ++i)
-  {
-    const MemoryUpdate& srcUpdate = memUpdates[i];
-
-    // Write memory
-    file.Seek(0, SEEK_END);
-    u64 dataOffset = file.Tell();
-    file.WriteBytes(srcUpdate.data.data(), srcUpdate.data.size());
-
-    FileMemoryUpdate dstUpdate;
-    dstUpdate.address = srcUpdate.address;
-    dstUpdate.dataOffset = dataOffset;
-    dstUpdate.dataSize = static_cast<u32>(srcUpdate.data.size());
-    dstUpdate.fifoPosition = srcUpdate.fifoPosition;
-    dstUpdate.type = srcUpdate.type;
-
-    u64 updateOffset = updateListOffset + (i * sizeof(FileMemoryUpdate));
-    file.Seek(updateOffset, SEEK_SET);
-    file.WriteBytes(&dstUpdate, sizeof(FileMemoryUpdate));
-  }
-
-  return updateListOffset;
-}
-
-void FifoDataFile::ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
+bool FifoDataFile::ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
                                      std::vector<MemoryUpdate>& memUpdates, File::IOFile& file)
 {
+  const u64 fileSize = file.GetSize();
   memUpdates.resize(numUpdates);
 
   for (u32 i = 0; i < numUpdates; ++i)
@@ -327,6 +855,12 @@ void FifoDataFile::ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
     FileMemoryUpdate srcUpdate;
     file.ReadBytes(&srcUpdate, sizeof(FileMemoryUpdate));
 
+    if (!file.IsGood() ||
+        !IsValidChunk(srcUpdate.dataOffset, srcUpdate.dataSize, srcUpdate.dataSize, fileSize))
+    {
+      return false;
+    }
+
     MemoryUpdate& dstUpdate = memUpdates[i];
     dstUpdate.address = srcUpdate.address;
     dstUpdate.fifoPosition = srcUpdate.fifoPosition;
@@ -336,4 +870,6 @@ void FifoDataFile::ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
     file.Seek(srcUpdate.dataOffset, SEEK_SET);
     file.ReadBytes(dstUpdate.data.data(), srcUpdate.dataSize);
   }
+
+  return file.IsGood();
 }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -43,6 +44,13 @@ struct FifoFrameInfo
   std::vector<MemoryUpdate> memoryUpdates;
 };
 
+// Where the objects of a frame start and end in its FIFO data
+struct AnalyzedFrameInfo
+{
+  std::vector<u32> objectStarts;
+  std::vector<u32> objectEnds;
+};
+
 class FifoDataFile
 {
 public:
@@ -70,13 +78,29 @@ public:
   u32* GetXFRegs() { return m_XFRegs; }
   u8* GetTexMem() { return m_TexMem; }
   void AddFrame(const FifoFrameInfo& frameInfo);
-  const FifoFrameInfo& GetFrame(u32 frame) const { return m_Frames[frame]; }
-  u32 GetFrameCount() const { return static_cast<u32>(m_Frames.size()); }
+  u32 GetFrameCount() const;
+
+  // Frames of loaded files are read from the file when they are requested, so the returned frame
+  // has to be kept alive for as long as it is used. Returns nullptr if the frame couldn't be read.
+  // Safe to call from any thread.
+  std::shared_ptr<const FifoFrameInfo> GetFrame(u32 frame) const;
+  // Only reads the FIFO data of a frame, which is cheaper than reading all of its memory updates.
+  std::optional<std::vector<u8>> GetFrameFifoData(u32 frame) const;
+
+  // The playback analysis that was saved with the file, so that opening a file doesn't require
+  // reading all of its frames. Empty for files that were saved without it.
+  const std::vector<AnalyzedFrameInfo>& GetStoredAnalysis() const { return m_analysis; }
+
+  // Always saves in the latest version of the format, which compresses every frame separately.
   bool Save(const std::string& filename);
 
   static std::unique_ptr<FifoDataFile> Load(const std::string& filename, bool flagsOnly);
+  // Rewrites a FIFO log of any version in the latest version of the format, one frame at a time.
+  static bool Convert(const std::string& input_filename, const std::string& output_filename);
 
 private:
+  class FrameReader;
+
   enum
   {
     FLAG_IS_WII = 1
@@ -87,8 +111,7 @@ private:
   void SetFlag(u32 flag, bool set);
   bool GetFlag(u32 flag) const;
 
-  u64 WriteMemoryUpdates(const std::vector<MemoryUpdate>& memUpdates, File::IOFile& file);
-  static void ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
+  static bool ReadMemoryUpdates(u64 fileOffset, u32 numUpdates,
                                 std::vector<MemoryUpdate>& memUpdates, File::IOFile& file);
 
   u32 m_BPMem[BP_MEM_SIZE];
@@ -100,5 +123,9 @@ private:
   u32 m_Flags = 0;
   u32 m_Version = 0;
 
-  std::vector<FifoFrameInfo> m_Frames;
+  // Frames added while recording
+  std::vector<std::shared_ptr<const FifoFrameInfo>> m_Frames;
+  // Frames of a loaded file, in which case m_Frames is empty
+  std::unique_ptr<FrameReader> m_frame_reader;
+  std::vector<AnalyzedFrameInfo> m_analysis;
 };
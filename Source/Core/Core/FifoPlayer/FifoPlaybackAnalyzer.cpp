@@ -4,6 +4,7 @@
 
 #include "Core/FifoPlayer/FifoPlaybackAnalyzer.h"
 
+#include <optional>
 #include <vector>
 
 #include "Common/CommonTypes.h"
@@ -21,7 +22,7 @@ struct CmdData
   const u8* ptr;
 };
 
-void FifoPlaybackAnalyzer::AnalyzeFrames(FifoDataFile* file,
+bool FifoPlaybackAnalyzer::AnalyzeFrames(FifoDataFile* file,
                                          std::vector<AnalyzedFrameInfo>& frameInfo)
 {
   u32* cpMem = file->GetCPMem();
@@ -40,37 +41,31 @@ void FifoPlaybackAnalyzer::AnalyzeFrames(FifoDataFile* file,
 
   for (u32 frameIdx = 0; frameIdx < file->GetFrameCount(); ++frameIdx)
   {
-    const FifoFrameInfo& frame = file->GetFrame(frameIdx);
+    const std::optional<std::vector<u8>> frameFifoData = file->GetFrameFifoData(frameIdx);
+    if (!frameFifoData)
+      return false;
+    const std::vector<u8>& fifoData = *frameFifoData;
     AnalyzedFrameInfo& analyzed = frameInfo[frameIdx];
 
     s_DrawingObject = false;
 
     u32 cmdStart = 0;
-    u32 nextMemUpdate = 0;
 
 #if LOG_FIFO_CMDS
     // Debugging
     std::vector<CmdData> prevCmds;
 #endif
 
-    while (cmdStart < frame.fifoData.size())
+    while (cmdStart < fifoData.size())
     {
-      // Add memory updates that have occurred before this point in the frame
-      while (nextMemUpdate < frame.memoryUpdates.size() &&
-             frame.memoryUpdates[nextMemUpdate].fifoPosition <= cmdStart)
-      {
-        analyzed.memoryUpdates.push_back(frame.memoryUpdates[nextMemUpdate]);
-        ++nextMemUpdate;
-      }
-
       bool wasDrawing = s_DrawingObject;
 
-      u32 cmdSize = FifoAnalyzer::AnalyzeCommand(&frame.fifoData[cmdStart], DECODE_PLAYBACK);
+      u32 cmdSize = FifoAnalyzer::AnalyzeCommand(&fifoData[cmdStart], DECODE_PLAYBACK);
 
 #if LOG_FIFO_CMDS
       CmdData cmdData;
       cmdData.offset = cmdStart;
-      cmdData.ptr = &frame.fifoData[cmdStart];
+      cmdData.ptr = &fifoData[cmdStart];
       cmdData.size = cmdSize;
       prevCmds.push_back(cmdData);
 #endif
@@ -82,7 +77,7 @@ void FifoPlaybackAnalyzer::AnalyzeFrames(FifoDataFile* file,
         analyzed.objectStarts.clear();
         analyzed.objectEnds.clear();
 
-        return;
+        return true;
       }
 
       if (wasDrawing != s_DrawingObject)
@@ -96,7 +91,11 @@ void FifoPlaybackAnalyzer::AnalyzeFrames(FifoDataFile* file,
       cmdStart += cmdSize;
     }
 
+    // The last command can claim to be longer than what is left, but playback must not go past
+    // the end of the FIFO data
     if (analyzed.objectEnds.size() < analyzed.objectStarts.size())
-      analyzed.objectEnds.push_back(cmdStart);
+      analyzed.objectEnds.push_back(static_cast<u32>(fifoData.size()));
   }
+
+  return true;
 }
@@ -9,14 +9,8 @@
 
 #include "Core/FifoPlayer/FifoDataFile.h"
 
-struct AnalyzedFrameInfo
-{
-  std::vector<u32> objectStarts;
-  std::vector<u32> objectEnds;
-  std::vector<MemoryUpdate> memoryUpdates;
-};
-
 namespace FifoPlaybackAnalyzer
 {
-void AnalyzeFrames(FifoDataFile* file, std::vector<AnalyzedFrameInfo>& frameInfo);
+// Reads the FIFO data of every frame. Returns false if a frame couldn't be read.
+bool AnalyzeFrames(FifoDataFile* file, std::vector<AnalyzedFrameInfo>& frameInfo);
 }  // namespace FifoPlaybackAnalyzer
@@ -5,6 +5,7 @@
 #include "Core/FifoPlayer/FifoPlayer.h"
 
 #include <algorithm>
+#include <memory>
 #include <mutex>
 
 #include "Common/Assert.h"
@@ -49,10 +50,18 @@ bool FifoPlayer::Open(const std::string& filename)
 
   if (m_File)
   {
+    // Only files without a stored analysis have to be read completely when they are opened
+    m_FrameInfo = m_File->GetStoredAnalysis();
     FifoAnalyzer::Init();
-    FifoPlaybackAnalyzer::AnalyzeFrames(m_File.get(), m_FrameInfo);
-
-    m_FrameRangeEnd = m_File->GetFrameCount();
+    if (m_FrameInfo.size() != m_File->GetFrameCount() &&
+        !FifoPlaybackAnalyzer::AnalyzeFrames(m_File.get(), m_FrameInfo))
+    {
+      m_File.reset();
+    }
+    else
+    {
+      m_FrameRangeEnd = m_File->GetFrameCount();
+    }
   }
 
   if (m_FileLoadedCb)
@@ -155,7 +164,13 @@ CPU::State FifoPlayer::AdvanceFrame()
   if (m_EarlyMemoryUpdates && m_CurrentFrame == m_FrameRangeStart)
     WriteAllMemoryUpdates();
 
-  WriteFrame(m_File->GetFrame(m_CurrentFrame), m_FrameInfo[m_CurrentFrame]);
+  const std::shared_ptr<const FifoFrameInfo> frame = m_File->GetFrame(m_CurrentFrame);
+  if (!frame)
+  {
+    PanicAlertT("Failed to read frame %u of the FIFO log.", m_CurrentFrame);
+    return CPU::State::PowerDown;
+  }
+  WriteFrame(*frame, m_FrameInfo[m_CurrentFrame]);
 
   ++m_CurrentFrame;
   return CPU::State::Running;
@@ -257,7 +272,7 @@ void FifoPlayer::WriteFrame(const FifoFrameInfo& frame, const AnalyzedFrameInfo&
     // Write fifo data skipping objects before the draw range
     while (objectNum < drawStart)
     {
-      WriteFramePart(position, info.objectStarts[objectNum], memoryUpdate, frame, info);
+      WriteFramePart(position, info.objectStarts[objectNum], memoryUpdate, frame);
 
       position = info.objectEnds[objectNum];
       ++objectNum;
@@ -267,7 +282,7 @@ void FifoPlayer::WriteFrame(const FifoFrameInfo& frame, const AnalyzedFrameInfo&
     if (objectNum < numObjects && drawStart <= drawEnd)
     {
       objectNum = drawEnd;
-      WriteFramePart(position, info.objectEnds[objectNum], memoryUpdate, frame, info);
+      WriteFramePart(position, info.objectEnds[objectNum], memoryUpdate, frame);
       position = info.objectEnds[objectNum];
       ++objectNum;
     }
@@ -275,7 +290,7 @@ void FifoPlayer::WriteFrame(const FifoFrameInfo& frame, const AnalyzedFrameInfo&
     // Write fifo data skipping objects after the draw range
     while (objectNum < numObjects)
     {
-      WriteFramePart(position, info.objectStarts[objectNum], memoryUpdate, frame, info);
+      WriteFramePart(position, info.objectStarts[objectNum], memoryUpdate, frame);
 
       position = info.objectEnds[objectNum];
       ++objectNum;
@@ -283,7 +298,7 @@ void FifoPlayer::WriteFrame(const FifoFrameInfo& frame, const AnalyzedFrameInfo&
   }
 
   // Write data after the last object
-  WriteFramePart(position, static_cast<u32>(frame.fifoData.size()), memoryUpdate, frame, info);
+  WriteFramePart(position, static_cast<u32>(frame.fifoData.size()), memoryUpdate, frame);
 
   FlushWGP();
 
@@ -296,13 +311,13 @@ void FifoPlayer::WriteFrame(const FifoFrameInfo& frame, const AnalyzedFrameInfo&
 }
 
 void FifoPlayer::WriteFramePart(u32 dataStart, u32 dataEnd, u32& nextMemUpdate,
-                                const FifoFrameInfo& frame, const AnalyzedFrameInfo& info)
+                                const FifoFrameInfo& frame)
 {
   const u8* const data = frame.fifoData.data();
 
   while (nextMemUpdate < frame.memoryUpdates.size() && dataStart < dataEnd)
   {
-    const MemoryUpdate& memUpdate = info.memoryUpdates[nextMemUpdate];
+    const MemoryUpdate& memUpdate = frame.memoryUpdates[nextMemUpdate];
 
     if (memUpdate.fifoPosition < dataEnd)
     {
@@ -333,8 +348,10 @@ void FifoPlayer::WriteAllMemoryUpdates()
 
   for (u32 frameNum = 0; frameNum < m_File->GetFrameCount(); ++frameNum)
   {
-    const FifoFrameInfo& frame = m_File->GetFrame(frameNum);
-    for (auto& update : frame.memoryUpdates)
+    const std::shared_ptr<const FifoFrameInfo> frame = m_File->GetFrame(frameNum);
+    if (!frame)
+      continue;
+    for (auto& update : frame->memoryUpdates)
     {
       WriteMemory(update);
     }
@@ -389,16 +406,19 @@ void FifoPlayer::SetupFifo()
   WriteCP(CommandProcessor::CTRL_REGISTER, 0);   // disable read, BP, interrupts
   WriteCP(CommandProcessor::CLEAR_REGISTER, 7);  // clear overflow, underflow, metrics
 
-  const FifoFrameInfo& frame = m_File->GetFrame(m_CurrentFrame);
+  // If the frame can't be read, AdvanceFrame stops playback before anything gets written
+  const std::shared_ptr<const FifoFrameInfo> frame = m_File->GetFrame(m_CurrentFrame);
+  if (!frame)
+    return;
 
   // Set fifo bounds
-  WriteCP(CommandProcessor::FIFO_BASE_LO, frame.fifoStart);
-  WriteCP(CommandProcessor::FIFO_BASE_HI, frame.fifoStart >> 16);
-  WriteCP(CommandProcessor::FIFO_END_LO, frame.fifoEnd);
-  WriteCP(CommandProcessor::FIFO_END_HI, frame.fifoEnd >> 16);
+  WriteCP(CommandProcessor::FIFO_BASE_LO, frame->fifoStart);
+  WriteCP(CommandProcessor::FIFO_BASE_HI, frame->fifoStart >> 16);
+  WriteCP(CommandProcessor::FIFO_END_LO, frame->fifoEnd);
+  WriteCP(CommandProcessor::FIFO_END_HI, frame->fifoEnd >> 16);
 
   // Set watermarks, high at 75%, low at 0%
-  u32 hi_watermark = (frame.fifoEnd - frame.fifoStart) * 3 / 4;
+  u32 hi_watermark = (frame->fifoEnd - frame->fifoStart) * 3 / 4;
   WriteCP(CommandProcessor::FIFO_HI_WATERMARK_LO, hi_watermark);
   WriteCP(CommandProcessor::FIFO_HI_WATERMARK_HI, hi_watermark >> 16);
   WriteCP(CommandProcessor::FIFO_LO_WATERMARK_LO, 0);
@@ -407,19 +427,19 @@ void FifoPlayer::SetupFifo()
   // Set R/W pointers to fifo start
   WriteCP(CommandProcessor::FIFO_RW_DISTANCE_LO, 0);
   WriteCP(CommandProcessor::FIFO_RW_DISTANCE_HI, 0);
-  WriteCP(CommandProcessor::FIFO_WRITE_POINTER_LO, frame.fifoStart);
-  WriteCP(CommandProcessor::FIFO_WRITE_POINTER_HI, frame.fifoStart >> 16);
-  WriteCP(CommandProcessor::FIFO_READ_POINTER_LO, frame.fifoStart);
-  WriteCP(CommandProcessor::FIFO_READ_POINTER_HI, frame.fifoStart >> 16);
+  WriteCP(CommandProcessor::FIFO_WRITE_POINTER_LO, frame->fifoStart);
+  WriteCP(CommandProcessor::FIFO_WRITE_POINTER_HI, frame->fifoStart >> 16);
+  WriteCP(CommandProcessor::FIFO_READ_POINTER_LO, frame->fifoStart);
+  WriteCP(CommandProcessor::FIFO_READ_POINTER_HI, frame->fifoStart >> 16);
 
   // Set fifo bounds
-  WritePI(ProcessorInterface::PI_FIFO_BASE, frame.fifoStart);
-  WritePI(ProcessorInterface::PI_FIFO_END, frame.fifoEnd);
+  WritePI(ProcessorInterface::PI_FIFO_BASE, frame->fifoStart);
+  WritePI(ProcessorInterface::PI_FIFO_END, frame->fifoEnd);
 
   // Set write pointer
-  WritePI(ProcessorInterface::PI_FIFO_WPTR, frame.fifoStart);
+  WritePI(ProcessorInterface::PI_FIFO_WPTR, frame->fifoStart);
   FlushWGP();
-  WritePI(ProcessorInterface::PI_FIFO_WPTR, frame.fifoStart);
+  WritePI(ProcessorInterface::PI_FIFO_WPTR, frame->fifoStart);
 
   WriteCP(CommandProcessor::CTRL_REGISTER, 17);  // enable read & GP link
 }
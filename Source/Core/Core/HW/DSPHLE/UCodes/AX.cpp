@@ -4,6 +4,10 @@
 
 #include "Core/HW/DSPHLE/UCodes/AX.h"
 
+#include <algorithm>
+#include <memory>
+#include <thread>
+
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
 #include "Common/File.h"
@@ -11,6 +15,7 @@
 #include "Common/Logging/Log.h"
 #include "Common/MathUtil.h"
 #include "Common/Swap.h"
+#include "Common/ThreadPool.h"
 #include "Core/HW/DSP.h"
 #include "Core/HW/DSPHLE/DSPHLE.h"
 #include "Core/HW/DSPHLE/MailHandler.h"
@@ -23,7 +28,14 @@ namespace DSP
 {
 namespace HLE
 {
-AXUCode::AXUCode(DSPHLE* dsphle, u32 crc) : UCodeInterface(dsphle, crc), m_cmdlist_size(0)
+// Voices are cheap to mix, so a few threads are enough for even the busiest frames.
+constexpr unsigned int MAX_VOICE_THREADS = 4;
+
+AXUCode::AXUCode(DSPHLE* dsphle, u32 crc)
+    : UCodeInterface(dsphle, crc), m_cmdlist_size(0),
+      m_thread_pool(std::make_unique<Common::ThreadPool>(
+          std::min(std::max(std::thread::hardware_concurrency(), 1u), MAX_VOICE_THREADS),
+          "AX voice thread"))
 {
   INFO_LOG(DSPHLE, "Instantiating AXUCode: crc=%08x", crc);
 }
@@ -427,34 +439,30 @@ void AXUCode::ProcessPBList(u32 pb_addr)
   // 32KHz to 48KHz, but AX always process at 32KHz.
   const u32 spms = 32;
 
-  AXPB pb;
-
-  while (pb_addr)
-  {
-    AXBuffers buffers = {{m_samples_left, m_samples_right, m_samples_surround, m_samples_auxA_left,
-                          m_samples_auxA_right, m_samples_auxA_surround, m_samples_auxB_left,
-                          m_samples_auxB_right, m_samples_auxB_surround}};
-
-    ReadPB(pb_addr, pb, m_crc);
-
-    u32 updates_addr = HILO_TO_32(pb.updates.data);
-    u16* updates = (u16*)HLEMemory_Get_Pointer(updates_addr);
-
-    for (int curr_ms = 0; curr_ms < 5; ++curr_ms)
-    {
-      ApplyUpdatesForMs(curr_ms, (u16*)&pb, pb.updates.num_updates, updates);
-
-      ProcessVoice(pb, buffers, spms, ConvertMixerControl(pb.mixer_control),
-                   m_coeffs_available ? m_coeffs : nullptr);
-
-      // Forward the buffers
-      for (size_t i = 0; i < ArraySize(buffers.ptrs); ++i)
-        buffers.ptrs[i] += spms;
-    }
-
-    WritePB(pb_addr, pb, m_crc);
-    pb_addr = HILO_TO_32(pb.next_pb);
-  }
+  const AXBuffers buffers = {{m_samples_left, m_samples_right, m_samples_surround,
+                              m_samples_auxA_left, m_samples_auxA_right, m_samples_auxA_surround,
+                              m_samples_auxB_left, m_samples_auxB_right, m_samples_auxB_surround}};
+
+  ProcessVoices(pb_addr, m_crc, buffers, m_thread_pool.get(),
+                [this](AXPB& pb, const AXBuffers* output) {
+                  u32 updates_addr = HILO_TO_32(pb.updates.data);
+                  u16* updates = (u16*)HLEMemory_Get_Pointer(updates_addr);
+
+                  AXBuffers voice_buffers = output ? *output : AXBuffers{};
+                  for (int curr_ms = 0; curr_ms < 5; ++curr_ms)
+                  {
+                    ApplyUpdatesForMs(curr_ms, (u16*)&pb, pb.updates.num_updates, updates);
+                    if (!output)
+                      continue;
+
+                    ProcessVoice(pb, voice_buffers, spms, ConvertMixerControl(pb.mixer_control),
+                                 m_coeffs_available ? m_coeffs : nullptr);
+
+                    // Forward the buffers
+                    for (size_t i = 0; i < ArraySize(voice_buffers.ptrs); ++i)
+                      voice_buffers.ptrs[i] += spms;
+                  }
+                });
 }
 
 void AXUCode::MixAUXSamples(int aux_id, u32 write_addr, u32 read_addr)
@@ -12,9 +12,16 @@
 
 #pragma once
 
+#include <memory>
+
 #include "Common/CommonTypes.h"
 #include "Core/HW/DSPHLE/UCodes/UCodes.h"
 
+namespace Common
+{
+class ThreadPool;
+}
+
 namespace DSP
 {
 namespace HLE
@@ -99,6 +106,9 @@ protected:
   bool m_coeffs_available;
   s16 m_coeffs[0x800];
 
+  // Runs the voices of heavy frames in parallel.
+  std::unique_ptr<Common::ThreadPool> m_thread_pool;
+
   void LoadResamplingCoefficients();
 
   // Copy a command list from memory to our temp buffer
@@ -0,0 +1,202 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/HW/DSPHLE/UCodes/AXMixing.h"
+
+#include "Common/CommonTypes.h"
+#include "Common/MathUtil.h"
+
+#if defined(_M_X86)
+#include <emmintrin.h>
+#elif defined(_M_ARM_64)
+#include <arm_neon.h>
+#endif
+
+namespace DSP
+{
+namespace HLE
+{
+#if defined(_M_X86) || defined(_M_ARM_64)
+#define AX_MIXING_SIMD
+
+// The vector helpers below process 8 samples at a time.
+constexpr u32 VECTOR_SIZE = 8;
+#endif
+
+#if defined(_M_X86)
+
+static __m128i LoadSamples(const s16* samples)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+}
+
+static void StoreSamples(s16* samples, __m128i vector)
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(samples), vector);
+}
+
+static s16 LastSample(__m128i vector)
+{
+  return static_cast<s16>(_mm_extract_epi16(vector, 7));
+}
+
+// Volumes for the next 8 samples of a ramp starting at volume
+static __m128i MakeVolumes(u16 volume, u16 volume_delta)
+{
+  const __m128i steps = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm_add_epi16(_mm_set1_epi16(volume),
+                       _mm_mullo_epi16(_mm_set1_epi16(volume_delta), steps));
+}
+
+static __m128i AdvanceVolumes(__m128i volumes, u16 volume_delta)
+{
+  return _mm_add_epi16(volumes, _mm_set1_epi16(static_cast<u16>(volume_delta * VECTOR_SIZE)));
+}
+
+// (sample * volume) >> 15, clamped to [-32767, 32767]
+static __m128i MultiplyVolume(__m128i samples, __m128i volumes)
+{
+  // The volume is unsigned, but _mm_mulhi_epi16 is a signed multiplication. For volumes >= 0x8000
+  // that is off by sample << 16, which is added back to the high half.
+  const __m128i low = _mm_mullo_epi16(samples, volumes);
+  const __m128i high = _mm_add_epi16(_mm_mulhi_epi16(samples, volumes),
+                                     _mm_and_si128(samples, _mm_srai_epi16(volumes, 15)));
+  const __m128i products_low = _mm_srai_epi32(_mm_unpacklo_epi16(low, high), 15);
+  const __m128i products_high = _mm_srai_epi32(_mm_unpackhi_epi16(low, high), 15);
+  return _mm_max_epi16(_mm_packs_epi32(products_low, products_high), _mm_set1_epi16(-32767));
+}
+
+static void AddToOutput(int* out, __m128i samples)
+{
+  const __m128i sign = _mm_srai_epi16(samples, 15);
+  __m128i* const out_low = reinterpret_cast<__m128i*>(out);
+  __m128i* const out_high = reinterpret_cast<__m128i*>(out + 4);
+  _mm_storeu_si128(out_low,
+                   _mm_add_epi32(_mm_loadu_si128(out_low), _mm_unpacklo_epi16(samples, sign)));
+  _mm_storeu_si128(out_high,
+                   _mm_add_epi32(_mm_loadu_si128(out_high), _mm_unpackhi_epi16(samples, sign)));
+}
+
+#elif defined(_M_ARM_64)
+
+static int16x8_t LoadSamples(const s16* samples)
+{
+  return vld1q_s16(samples);
+}
+
+static void StoreSamples(s16* samples, int16x8_t vector)
+{
+  vst1q_s16(samples, vector);
+}
+
+static s16 LastSample(int16x8_t vector)
+{
+  return vgetq_lane_s16(vector, 7);
+}
+
+// Volumes for the next 8 samples of a ramp starting at volume
+static uint16x8_t MakeVolumes(u16 volume, u16 volume_delta)
+{
+  static const u16 steps[VECTOR_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7};
+  return vmlaq_n_u16(vdupq_n_u16(volume), vld1q_u16(steps), volume_delta);
+}
+
+static uint16x8_t AdvanceVolumes(uint16x8_t volumes, u16 volume_delta)
+{
+  return vaddq_u16(volumes, vdupq_n_u16(static_cast<u16>(volume_delta * VECTOR_SIZE)));
+}
+
+// (sample * volume) >> 15, clamped to [-32767, 32767]
+static int16x8_t MultiplyVolume(int16x8_t samples, uint16x8_t volumes)
+{
+  const int32x4_t products_low =
+      vmulq_s32(vmovl_s16(vget_low_s16(samples)),
+                vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(volumes))));
+  const int32x4_t products_high =
+      vmulq_s32(vmovl_s16(vget_high_s16(samples)),
+                vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(volumes))));
+  const int16x8_t clamped = vcombine_s16(vqmovn_s32(vshrq_n_s32(products_low, 15)),
+                                         vqmovn_s32(vshrq_n_s32(products_high, 15)));
+  return vmaxq_s16(clamped, vdupq_n_s16(-32767));
+}
+
+static void AddToOutput(int* out, int16x8_t samples)
+{
+  vst1q_s32(out, vaddw_s16(vld1q_s32(out), vget_low_s16(samples)));
+  vst1q_s32(out + 4, vaddw_s16(vld1q_s32(out + 4), vget_high_s16(samples)));
+}
+
+#endif
+
+void ApplyVolume(s16* samples, u32 count, u16* volume, s16 volume_delta)
+{
+  u32 i = 0;
+  u16 cur_volume = *volume;
+
+#ifdef AX_MIXING_SIMD
+  if (count >= VECTOR_SIZE)
+  {
+    auto volumes = MakeVolumes(cur_volume, volume_delta);
+    for (; i + VECTOR_SIZE <= count; i += VECTOR_SIZE)
+    {
+      StoreSamples(samples + i, MultiplyVolume(LoadSamples(samples + i), volumes));
+      volumes = AdvanceVolumes(volumes, volume_delta);
+    }
+    cur_volume += static_cast<u16>(volume_delta * i);
+  }
+#endif
+
+  for (; i < count; ++i)
+  {
+    samples[i] = MathUtil::Clamp(((s32)samples[i] * cur_volume) >> 15, -32767, 32767);
+    cur_volume += volume_delta;
+  }
+
+  *volume = cur_volume;
+}
+
+void MixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ramp)
+{
+  u16& volume = pvol[0];
+  u16 volume_delta = pvol[1];
+
+  // If volume ramping is disabled, set volume_delta to 0. That way, the
+  // mixing loop can avoid testing if volume ramping is enabled at each step,
+  // and just add volume_delta.
+  if (!ramp)
+    volume_delta = 0;
+
+  u32 i = 0;
+
+#ifdef AX_MIXING_SIMD
+  if (count >= VECTOR_SIZE)
+  {
+    auto volumes = MakeVolumes(volume, volume_delta);
+    for (; i + VECTOR_SIZE <= count; i += VECTOR_SIZE)
+    {
+      const auto samples = MultiplyVolume(LoadSamples(input + i), volumes);
+      AddToOutput(out + i, samples);
+      volumes = AdvanceVolumes(volumes, volume_delta);
+      if (i + VECTOR_SIZE == count)
+        *dpop = LastSample(samples);
+    }
+    volume += static_cast<u16>(volume_delta * i);
+  }
+#endif
+
+  for (; i < count; ++i)
+  {
+    s64 sample = input[i];
+    sample *= volume;
+    sample >>= 15;
+    sample = MathUtil::Clamp((s32)sample, -32767, 32767);  // -32768 ?
+
+    out[i] += (s16)sample;
+    volume += volume_delta;
+
+    *dpop = (s16)sample;
+  }
+}
+}  // namespace HLE
+}  // namespace DSP
@@ -0,0 +1,25 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Per-sample loops of the AX voice processing that are shared by AX GC and AX Wii. These run for
+// every voice and every mix bus, so they are vectorized with SSE2 on x86-64 and NEON on AArch64,
+// with a plain C++ fallback elsewhere. All of them give the same results as the scalar code.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+namespace DSP
+{
+namespace HLE
+{
+// Multiplies the samples by a volume that changes by volume_delta after every sample, and clamps
+// them to [-32767, 32767]. *volume is updated to the volume after the last sample.
+void ApplyVolume(s16* samples, u32 count, u16* volume, s16 volume_delta);
+
+// Adds samples to an output buffer, with optional volume ramping. pvol points to the volume and
+// the volume delta, and dpop receives the last sample that was added.
+void MixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ramp);
+}  // namespace HLE
+}  // namespace DSP
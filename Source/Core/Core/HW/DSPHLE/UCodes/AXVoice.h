@@ -12,14 +12,17 @@
 #error AXVoice.h included without specifying version
 #endif
 
-#include <functional>
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include "Common/CommonFuncs.h"
 #include "Common/CommonTypes.h"
-#include "Common/MathUtil.h"
+#include "Common/ThreadPool.h"
 #include "Core/DSP/DSPAccelerator.h"
 #include "Core/HW/DSP.h"
 #include "Core/HW/DSPHLE/UCodes/AX.h"
+#include "Core/HW/DSPHLE/UCodes/AXMixing.h"
 #include "Core/HW/DSPHLE/UCodes/AXStructs.h"
 #include "Core/HW/Memmap.h"
 
@@ -82,6 +85,17 @@ union AXBuffers
 #endif
 };
 
+// Number of samples that a frame mixes into each of the AXBuffers.
+u32 GetBufferSize(size_t index)
+{
+#ifdef AX_GC
+  return 32 * 5;
+#else
+  // The Wii Remote buffers come last.
+  return index < 12 ? 32 * 3 : 6 * 3;
+#endif
+}
+
 // Determines if this version of the UCode has a PBLowPassFilter in its AXPB layout.
 bool HasLpf(u32 crc)
 {
@@ -163,9 +177,10 @@ void DumpPB(const PB_TYPE& pb)
 }
 #endif
 
-// Simulated accelerator state.
-static PB_TYPE* acc_pb;
-static bool acc_end_reached;
+// Simulated accelerator state. Voices may be processed on multiple threads, so every thread
+// has its own.
+static thread_local PB_TYPE* acc_pb;
+static thread_local bool acc_end_reached;
 
 class HLEAccelerator final : public Accelerator
 {
@@ -212,7 +227,8 @@ protected:
   void WriteMemory(u32 address, u8 value) override { WriteARAM(value, address); }
 };
 
-static std::unique_ptr<Accelerator> s_accelerator = std::make_unique<HLEAccelerator>();
+static thread_local std::unique_ptr<Accelerator> s_accelerator =
+    std::make_unique<HLEAccelerator>();
 
 // Sets up the simulated accelerator.
 void AcceleratorSetup(PB_TYPE* pb)
@@ -260,7 +276,8 @@ u16 AcceleratorGetSample()
 // We start getting samples not from sample 0, but 0.<curr_pos_frac>. This
 // avoids discontinuities in the audio stream, especially with very low ratios
 // which interpolate a lot of values between two "real" samples.
-u32 ResampleAudio(std::function<s16(u32)> input_callback, s16* output, u32 count, s16* last_samples,
+template <typename InputCallback>
+u32 ResampleAudio(InputCallback input_callback, s16* output, u32 count, s16* last_samples,
                   u32 curr_pos, u32 ratio, int srctype, const s16* coeffs)
 {
   int read_samples_count = 0;
@@ -396,32 +413,6 @@ void GetInputSamples(PB_TYPE& pb, s16* samples, u16 count, const s16* coeffs)
   pb.adpcm.pred_scale = s_accelerator->GetPredScale();
 }
 
-// Add samples to an output buffer, with optional volume ramping.
-void MixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ramp)
-{
-  u16& volume = pvol[0];
-  u16 volume_delta = pvol[1];
-
-  // If volume ramping is disabled, set volume_delta to 0. That way, the
-  // mixing loop can avoid testing if volume ramping is enabled at each step,
-  // and just add volume_delta.
-  if (!ramp)
-    volume_delta = 0;
-
-  for (u32 i = 0; i < count; ++i)
-  {
-    s64 sample = input[i];
-    sample *= volume;
-    sample >>= 15;
-    sample = MathUtil::Clamp((s32)sample, -32767, 32767);  // -32768 ?
-
-    out[i] += (s16)sample;
-    volume += volume_delta;
-
-    *dpop = (s16)sample;
-  }
-}
-
 // Execute a low pass filter on the samples using one history value. Returns
 // the new history value.
 s16 LowPassFilter(s16* samples, u32 count, s16 yn1, u16 a0, u16 b0)
@@ -445,12 +436,7 @@ void ProcessVoice(PB_TYPE& pb, const AXBuffers& buffers, u16 count, AXMixControl
   GetInputSamples(pb, samples, count, coeffs);
 
   // Apply a global volume ramp using the volume envelope parameters.
-  for (u32 i = 0; i < count; ++i)
-  {
-    samples[i] = MathUtil::Clamp(((s32)samples[i] * pb.vol_env.cur_volume) >> 15, -32767,
-                                 32767);  // -32768 ?
-    pb.vol_env.cur_volume += pb.vol_env.cur_volume_delta;
-  }
+  ApplyVolume(samples, count, &pb.vol_env.cur_volume, pb.vol_env.cur_volume_delta);
 
   // Optionally, execute a low pass filter
   // TODO: LPF code is currently broken, causing Super Monkey Ball sound
@@ -565,6 +551,106 @@ void ProcessVoice(PB_TYPE& pb, const AXBuffers& buffers, u16 count, AXMixControl
 #endif
 }
 
+// Processes the voices of a PB list and writes the PBs back. process_pb applies the updates of
+// the whole frame to a PB and, if buffers isn't null, mixes the voice into them.
+//
+// With enough running voices, they are processed on the thread pool. Every thread mixes into its
+// own set of buffers, which are added to the output buffers at the end. Mixing only adds integers,
+// so this gives exactly the same result as processing the voices one after the other.
+//
+// Each PB only says where the next one is after its updates have been applied, so the list is
+// walked first with the updates applied to copies of the PBs. If any PBs overlap, writing one back
+// changes what is read for the next one, and the voices are processed serially instead.
+template <typename ProcessPB>
+void ProcessVoices(u32 pb_addr, u32 crc, const AXBuffers& buffers,
+                   Common::ThreadPool* thread_pool, ProcessPB process_pb)
+{
+  // Waking up the worker threads isn't worth it for a few voices.
+  constexpr size_t MIN_PARALLEL_VOICES = 16;
+  // AX has at most 64 (GC) or 96 (Wii) voices. Anything longer is most likely a loop.
+  constexpr size_t MAX_PARALLEL_VOICES = 0x100;
+
+  struct Voice
+  {
+    u32 addr;
+    PB_TYPE pb;
+  };
+  // Only used from the CPU thread; kept around to avoid allocating them for every frame.
+  static std::vector<Voice> s_voices;
+  static std::vector<u32> s_addresses;
+  static std::vector<int> s_thread_samples;
+
+  if (thread_pool->GetThreadCount() > 1)
+  {
+    s_voices.clear();
+    size_t num_running = 0;
+    u32 addr = pb_addr;
+    while (addr && s_voices.size() < MAX_PARALLEL_VOICES)
+    {
+      s_voices.emplace_back();
+      Voice& voice = s_voices.back();
+      voice.addr = addr;
+      ReadPB(addr, voice.pb, crc);
+      if (voice.pb.running)
+        num_running++;
+
+      PB_TYPE updated_pb = voice.pb;
+      process_pb(updated_pb, nullptr);
+      addr = HILO_TO_32(updated_pb.next_pb);
+    }
+
+    s_addresses.clear();
+    for (const Voice& voice : s_voices)
+      s_addresses.push_back(voice.addr);
+    std::sort(s_addresses.begin(), s_addresses.end());
+    const bool overlap =
+        std::adjacent_find(s_addresses.begin(), s_addresses.end(), [](u32 a, u32 b) {
+          return b - a < sizeof(PB_TYPE);
+        }) != s_addresses.end();
+
+    if (!addr && !overlap && num_running >= MIN_PARALLEL_VOICES)
+    {
+      const size_t num_buffers = ArraySize(buffers.ptrs);
+      const size_t buffer_size = GetBufferSize(0);
+      const size_t num_threads = std::min(s_voices.size(), thread_pool->GetThreadCount());
+      s_thread_samples.assign(num_threads * num_buffers * buffer_size, 0);
+
+      thread_pool->ParallelFor(num_threads, [&](size_t thread) {
+        AXBuffers thread_buffers;
+        for (size_t i = 0; i < num_buffers; ++i)
+          thread_buffers.ptrs[i] = &s_thread_samples[(thread * num_buffers + i) * buffer_size];
+
+        // Interleaving the voices spreads the running ones evenly over the threads.
+        for (size_t i = thread; i < s_voices.size(); i += num_threads)
+          process_pb(s_voices[i].pb, &thread_buffers);
+      });
+
+      for (size_t thread = 0; thread < num_threads; ++thread)
+      {
+        for (size_t i = 0; i < num_buffers; ++i)
+        {
+          const int* samples = &s_thread_samples[(thread * num_buffers + i) * buffer_size];
+          for (u32 j = 0; j < GetBufferSize(i); ++j)
+            buffers.ptrs[i][j] += samples[j];
+        }
+      }
+
+      for (const Voice& voice : s_voices)
+        WritePB(voice.addr, voice.pb, crc);
+      return;
+    }
+  }
+
+  PB_TYPE pb;
+  while (pb_addr)
+  {
+    ReadPB(pb_addr, pb, crc);
+    process_pb(pb, &buffers);
+    WritePB(pb_addr, pb, crc);
+    pb_addr = HILO_TO_32(pb.next_pb);
+  }
+}
+
 }  // namespace
 }  // namespace HLE
 }  // namespace DSP
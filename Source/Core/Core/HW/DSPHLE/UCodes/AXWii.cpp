@@ -439,46 +439,44 @@ void AXWiiUCode::ReinjectUpdatesFields(AXPBWii& pb, u16* num_updates, u32 update
 
 void AXWiiUCode::ProcessPBList(u32 pb_addr)
 {
-  AXPBWii pb;
-
-  while (pb_addr)
-  {
-    AXBuffers buffers = {{m_samples_left,      m_samples_right,      m_samples_surround,
-                          m_samples_auxA_left, m_samples_auxA_right, m_samples_auxA_surround,
-                          m_samples_auxB_left, m_samples_auxB_right, m_samples_auxB_surround,
-                          m_samples_auxC_left, m_samples_auxC_right, m_samples_auxC_surround,
-                          m_samples_wm0,       m_samples_aux0,       m_samples_wm1,
-                          m_samples_aux1,      m_samples_wm2,        m_samples_aux2,
-                          m_samples_wm3,       m_samples_aux3}};
-
-    ReadPB(pb_addr, pb, m_crc);
-
-    u16 num_updates[3];
-    u16 updates[1024];
-    u32 updates_addr;
-    if (ExtractUpdatesFields(pb, num_updates, updates, &updates_addr))
-    {
-      for (int curr_ms = 0; curr_ms < 3; ++curr_ms)
-      {
-        ApplyUpdatesForMs(curr_ms, (u16*)&pb, num_updates, updates);
-        ProcessVoice(pb, buffers, 32, ConvertMixerControl(HILO_TO_32(pb.mixer_control)),
-                     m_coeffs_available ? m_coeffs : nullptr);
-
-        // Forward the buffers
-        for (size_t i = 0; i < ArraySize(buffers.ptrs); ++i)
-          buffers.ptrs[i] += 32;
-      }
-      ReinjectUpdatesFields(pb, num_updates, updates_addr);
-    }
-    else
-    {
-      ProcessVoice(pb, buffers, 96, ConvertMixerControl(HILO_TO_32(pb.mixer_control)),
-                   m_coeffs_available ? m_coeffs : nullptr);
-    }
-
-    WritePB(pb_addr, pb, m_crc);
-    pb_addr = HILO_TO_32(pb.next_pb);
-  }
+  const AXBuffers buffers = {{m_samples_left,      m_samples_right,      m_samples_surround,
+                              m_samples_auxA_left, m_samples_auxA_right, m_samples_auxA_surround,
+                              m_samples_auxB_left, m_samples_auxB_right, m_samples_auxB_surround,
+                              m_samples_auxC_left, m_samples_auxC_right, m_samples_auxC_surround,
+                              m_samples_wm0,       m_samples_aux0,       m_samples_wm1,
+                              m_samples_aux1,      m_samples_wm2,        m_samples_aux2,
+                              m_samples_wm3,       m_samples_aux3}};
+
+  ProcessVoices(
+      pb_addr, m_crc, buffers, m_thread_pool.get(), [this](AXPBWii& pb, const AXBuffers* output) {
+        u16 num_updates[3];
+        u16 updates[1024];
+        u32 updates_addr;
+        if (ExtractUpdatesFields(pb, num_updates, updates, &updates_addr))
+        {
+          AXBuffers voice_buffers = output ? *output : AXBuffers{};
+          for (int curr_ms = 0; curr_ms < 3; ++curr_ms)
+          {
+            ApplyUpdatesForMs(curr_ms, (u16*)&pb, num_updates, updates);
+            if (!output)
+              continue;
+
+            ProcessVoice(pb, voice_buffers, 32,
+                         ConvertMixerControl(HILO_TO_32(pb.mixer_control)),
+                         m_coeffs_available ? m_coeffs : nullptr);
+
+            // Forward the buffers
+            for (size_t i = 0; i < ArraySize(voice_buffers.ptrs); ++i)
+              voice_buffers.ptrs[i] += 32;
+          }
+          ReinjectUpdatesFields(pb, num_updates, updates_addr);
+        }
+        else if (output)
+        {
+          ProcessVoice(pb, *output, 96, ConvertMixerControl(HILO_TO_32(pb.mixer_control)),
+                       m_coeffs_available ? m_coeffs : nullptr);
+        }
+      });
 }
 
 void AXWiiUCode::MixAUXSamples(int aux_id, u32 write_addr, u32 read_addr, u16 volume)
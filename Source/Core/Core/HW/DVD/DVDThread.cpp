@@ -4,6 +4,7 @@
 
 #include "Core/HW/DVD/DVDThread.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <map>
 #include <memory>
@@ -23,17 +24,20 @@
 #include "Common/Thread.h"
 #include "Common/Timer.h"
 
+#include "Core/Config/MainSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/HW/DVD/DVDInterface.h"
 #include "Core/HW/DVD/FileMonitor.h"
+#include "Core/HW/DVD/ReadAheadCache.h"
 #include "Core/HW/Memmap.h"
 #include "Core/HW/SystemTimers.h"
 #include "Core/IOS/ES/Formats.h"
 
 #include "DiscIO/Enums.h"
 #include "DiscIO/Volume.h"
+#include "DiscIO/VolumeWii.h"
 
 namespace DVDThread
 {
@@ -88,6 +92,16 @@ static Common::SPSCQueue<ReadResult, false> s_result_queue;
 static std::map<u64, ReadResult> s_result_map;
 
 static std::unique_ptr<DiscIO::Volume> s_disc;
+// The amount of data that can be read from each partition of s_disc, by partition offset
+static std::map<u64, u64> s_partition_data_sizes;
+
+// Only used by the DVD thread while it is running
+static ReadAheadCache s_read_ahead_cache;
+static bool s_read_ahead_enabled;
+
+// Only used by the CPU thread. Counts the reads that FinishRead had to wait for.
+static u64 s_stalled_reads;
+static u64 s_stall_time_us;
 
 void Start()
 {
@@ -102,6 +116,11 @@ void Start()
   // much, because this will never get exposed to the emulated game.
   s_next_id = 0;
 
+  s_read_ahead_enabled = Config::Get(Config::MAIN_DVD_READ_AHEAD);
+  s_read_ahead_cache.ResetStats();
+  s_stalled_reads = 0;
+  s_stall_time_us = 0;
+
   StartDVDThread();
 }
 
@@ -116,6 +135,21 @@ void Stop()
 {
   StopDVDThread();
   s_disc.reset();
+  s_partition_data_sizes.clear();
+  s_read_ahead_cache.Clear();
+
+  const ReadAheadCache::Stats& stats = s_read_ahead_cache.GetStats();
+  if (stats.bytes_read != 0)
+  {
+    NOTICE_LOG(DVDINTERFACE,
+               "DVD reads: %" PRIu64 ", cache hits: %" PRIu64 " (%.1f%% of bytes), "
+               "prefetched: %" PRIu64 " KiB (%" PRIu64 " KiB unused), "
+               "time reading uncached data: %" PRIu64 " ms, "
+               "stalls: %" PRIu64 " (%" PRIu64 " ms)",
+               stats.reads, stats.hits, 100.0 * stats.bytes_hit / stats.bytes_read,
+               stats.bytes_prefetched / 1024, stats.bytes_wasted / 1024,
+               stats.miss_time_us / 1000, s_stalled_reads, s_stall_time_us / 1000);
+  }
 }
 
 static void StopDVDThread()
@@ -162,6 +196,7 @@ void DoState(PointerWrap& p)
       PanicAlertT("An inserted disc was expected but not found.");
     else
       s_disc.reset();
+    s_read_ahead_cache.Clear();
   }
 
   // TODO: Savestates can be smaller if the buffers of results aren't saved,
@@ -179,6 +214,26 @@ void SetDisc(std::unique_ptr<DiscIO::Volume> disc)
 {
   WaitUntilIdle();
   s_disc = std::move(disc);
+  s_read_ahead_cache.Clear();
+
+  // Read-ahead needs the data sizes for every request, so they are only read from the partition
+  // headers once.
+  s_partition_data_sizes.clear();
+  if (!s_disc)
+    return;
+  const u64 disc_size = s_disc->GetSize();
+  for (const DiscIO::Partition& partition : s_disc->GetPartitions())
+  {
+    // The data size in the partition header includes the hashes.
+    const std::optional<u64> size =
+        s_disc->ReadSwappedAndShifted(partition.offset + 0x2bc, DiscIO::PARTITION_NONE);
+    if (size)
+    {
+      s_partition_data_sizes[partition.offset] =
+          std::min(disc_size, *size / DiscIO::VolumeWii::BLOCK_TOTAL_SIZE *
+                                  DiscIO::VolumeWii::BLOCK_DATA_SIZE);
+    }
+  }
 }
 
 bool HasDisc()
@@ -280,6 +335,13 @@ static void StartReadInternal(bool copy_to_ram, u32 output_address, u64 dvd_offs
   request.time_started_ticks = CoreTiming::GetTicks();
   request.realtime_started_us = Common::Timer::GetTimeUs();
 
+  // This can be used as an access trace for DVDReadAheadTest.
+  INFO_LOG(DVDINTERFACE,
+           "DVD read: time %" PRIu64 " us, partition %016" PRIx64 ", offset %016" PRIx64
+           ", length %08x",
+           request.time_started_ticks / (SystemTimers::GetTicksPerSecond() / 1000000),
+           partition.offset, dvd_offset, length);
+
   s_request_queue.Push(std::move(request));
   s_request_queue_expanded.Set();
 
@@ -307,16 +369,27 @@ static void FinishRead(u64 id, s64 cycles_late)
   }
   else
   {
+    const u64 wait_start_us = Common::Timer::GetTimeUs();
+    bool stalled = false;
     while (true)
     {
       while (!s_result_queue.Pop(result))
+      {
+        stalled = true;
         s_result_queue_expanded.Wait();
+      }
 
       if (result.first.id == id)
         break;
       else
         s_result_map.emplace(result.first.id, std::move(result));
     }
+
+    if (stalled)
+    {
+      s_stalled_reads++;
+      s_stall_time_us += Common::Timer::GetTimeUs() - wait_start_us;
+    }
   }
   // We have now obtained the right ReadResult.
 
@@ -348,6 +421,18 @@ static void FinishRead(u64 id, s64 cycles_late)
                                        buffer);
 }
 
+static bool ReadDisc(u64 offset, u32 length, u8* buffer, const DiscIO::Partition& partition)
+{
+  return s_disc->Read(offset, length, buffer, partition);
+}
+
+// The amount of data that can be read from a partition, so that read-ahead stops there.
+static u64 GetDataSize(const DiscIO::Partition& partition)
+{
+  const auto it = s_partition_data_sizes.find(partition.offset);
+  return it != s_partition_data_sizes.end() ? it->second : s_disc->GetSize();
+}
+
 static void DVDThread()
 {
   Common::SetCurrentThreadName("DVD thread");
@@ -365,7 +450,13 @@ static void DVDThread()
       FileMonitor::Log(*s_disc, request.partition, request.dvd_offset);
 
       std::vector<u8> buffer(request.length);
-      if (!s_disc->Read(request.dvd_offset, request.length, buffer.data(), request.partition))
+      const bool success =
+          s_read_ahead_enabled ?
+              s_read_ahead_cache.Read(request.dvd_offset, request.length, buffer.data(),
+                                      request.partition, GetDataSize(request.partition),
+                                      ReadDisc) :
+              ReadDisc(request.dvd_offset, request.length, buffer.data(), request.partition);
+      if (!success)
         buffer.resize(0);
 
       request.realtime_done_us = Common::Timer::GetTimeUs();
@@ -376,6 +467,13 @@ static void DVDThread()
       if (s_dvd_thread_exiting.IsSet())
         return;
     }
+
+    // Prefetch one chunk at a time until a new request comes in. Since this only happens after
+    // requests, the thread stays idle after WaitUntilIdle has restarted it.
+    while (s_read_ahead_enabled && s_request_queue.Empty() && !s_dvd_thread_exiting.IsSet() &&
+           s_read_ahead_cache.Prefetch(ReadDisc))
+    {
+    }
   }
 }
 }
@@ -0,0 +1,188 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/HW/DVD/ReadAheadCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "Common/Timer.h"
+#include "DiscIO/Volume.h"
+
+namespace DVDThread
+{
+ReadAheadCache::ReadAheadCache(size_t max_chunks) : m_max_chunks(max_chunks)
+{
+}
+
+bool ReadAheadCache::Read(u64 offset, u32 length, u8* buffer, const DiscIO::Partition& partition,
+                          u64 data_size, const ReadFunction& read)
+{
+  const u64 end = offset + length;
+  u64 bytes_hit = 0;
+
+  u64 position = offset;
+  while (position < end)
+  {
+    const u64 chunk_index = position / CHUNK_SIZE;
+    const u64 chunk_end = std::min(end, (chunk_index + 1) * CHUNK_SIZE);
+
+    const auto it = m_chunks.find({partition.offset, chunk_index});
+    // The last chunk of a partition is only partially filled.
+    if (it != m_chunks.end() && chunk_end - chunk_index * CHUNK_SIZE <= it->second.data.size())
+    {
+      Chunk& chunk = it->second;
+      std::memcpy(buffer + (position - offset), &chunk.data[position - chunk_index * CHUNK_SIZE],
+                  chunk_end - position);
+      chunk.last_used = ++m_clock;
+      chunk.was_read = true;
+      // Streams rarely go back, so once a chunk has been read to its end, it's the first to go.
+      chunk.consumed = chunk_end == chunk_index * CHUNK_SIZE + chunk.data.size();
+      bytes_hit += chunk_end - position;
+      position = chunk_end;
+      continue;
+    }
+
+    // Read everything up to the next cached chunk at once. The data doesn't go into the cache,
+    // since the emulated software rarely reads the same data twice in a row.
+    u64 miss_end = chunk_end;
+    while (miss_end < end && !m_chunks.count({partition.offset, miss_end / CHUNK_SIZE}))
+      miss_end = std::min(end, miss_end + CHUNK_SIZE);
+
+    const u64 start_time = Common::Timer::GetTimeUs();
+    const bool success = read(position, static_cast<u32>(miss_end - position),
+                              buffer + (position - offset), partition);
+    m_stats.miss_time_us += Common::Timer::GetTimeUs() - start_time;
+    if (!success)
+      return false;
+
+    position = miss_end;
+  }
+
+  m_stats.reads++;
+  if (bytes_hit == length)
+    m_stats.hits++;
+  m_stats.bytes_read += length;
+  m_stats.bytes_hit += bytes_hit;
+
+  RecordAccess(partition.offset, offset, length, data_size);
+  return true;
+}
+
+void ReadAheadCache::RecordAccess(u64 partition, u64 offset, u32 length, u64 data_size)
+{
+  const u64 end = offset + length;
+
+  // A read continues a stream if it starts inside the previous read of the stream or a little
+  // after it, so that small skips (padding between files, for instance) don't break streams.
+  for (Stream& stream : m_streams)
+  {
+    if (stream.active && stream.partition == partition && offset >= stream.start_offset &&
+        offset <= stream.next_offset + CHUNK_SIZE)
+    {
+      stream.start_offset = offset;
+      stream.next_offset = std::max(stream.next_offset, end);
+      stream.sequential_reads++;
+      stream.last_used = ++m_clock;
+      return;
+    }
+  }
+
+  Stream& stream = *std::min_element(
+      m_streams.begin(), m_streams.end(),
+      [](const Stream& a, const Stream& b) { return a.last_used < b.last_used; });
+  stream = {};
+  stream.active = true;
+  stream.partition = partition;
+  stream.start_offset = offset;
+  stream.next_offset = end;
+  stream.end_offset = data_size;
+  stream.last_used = ++m_clock;
+}
+
+bool ReadAheadCache::FindChunkToPrefetch(const Stream& stream, u64* chunk_index) const
+{
+  // A single read isn't a stream yet. After that, the distance doubles with each read.
+  if (!stream.active || stream.sequential_reads == 0)
+    return false;
+
+  const u32 read_ahead_chunks =
+      std::min<u32>(MAX_READ_AHEAD_CHUNKS, 1U << std::min<u32>(stream.sequential_reads, 31));
+  const u64 first = stream.next_offset / CHUNK_SIZE;
+  const u64 end_chunk = (stream.end_offset + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  const u64 last = std::min(end_chunk, first + read_ahead_chunks);
+  for (u64 i = first; i < last; i++)
+  {
+    if (!m_chunks.count({stream.partition, i}))
+    {
+      *chunk_index = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ReadAheadCache::Prefetch(const ReadFunction& read)
+{
+  // The most recently used stream is the one most likely to be waited on next.
+  Stream* best_stream = nullptr;
+  u64 best_chunk = 0;
+  for (Stream& stream : m_streams)
+  {
+    u64 chunk_index;
+    if (FindChunkToPrefetch(stream, &chunk_index) &&
+        (!best_stream || stream.last_used > best_stream->last_used))
+    {
+      best_stream = &stream;
+      best_chunk = chunk_index;
+    }
+  }
+
+  if (!best_stream)
+    return false;
+
+  const u64 offset = best_chunk * CHUNK_SIZE;
+  std::vector<u8> data(std::min<u64>(CHUNK_SIZE, best_stream->end_offset - offset));
+  const DiscIO::Partition partition(best_stream->partition);
+  if (!read(offset, static_cast<u32>(data.size()), data.data(), partition))
+  {
+    best_stream->end_offset = offset;
+    return true;
+  }
+
+  m_stats.bytes_prefetched += data.size();
+  InsertChunk({best_stream->partition, best_chunk}, std::move(data));
+  return true;
+}
+
+void ReadAheadCache::InsertChunk(const ChunkKey& key, std::vector<u8> data)
+{
+  if (m_chunks.size() >= m_max_chunks)
+  {
+    const auto lru =
+        std::min_element(m_chunks.begin(), m_chunks.end(), [](const auto& a, const auto& b) {
+          if (a.second.consumed != b.second.consumed)
+            return a.second.consumed;
+          return a.second.last_used < b.second.last_used;
+        });
+    if (!lru->second.was_read)
+      m_stats.bytes_wasted += lru->second.data.size();
+    m_chunks.erase(lru);
+  }
+
+  Chunk& chunk = m_chunks[key];
+  chunk.data = std::move(data);
+  chunk.last_used = ++m_clock;
+  chunk.was_read = false;
+  chunk.consumed = false;
+}
+
+void ReadAheadCache::Clear()
+{
+  m_chunks.clear();
+  m_streams = {};
+}
+}  // namespace DVDThread
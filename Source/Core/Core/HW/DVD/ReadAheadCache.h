@@ -0,0 +1,106 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace DiscIO
+{
+struct Partition;
+}
+
+namespace DVDThread
+{
+// Serves reads of the disc and predicts which parts of it will be read next, so that the DVD
+// thread can read them while it would otherwise be idle. Reads that follow on from earlier reads
+// are tracked as streams (games commonly interleave a few of them, for instance streamed audio
+// and level data), and the further a stream has gone, the further ahead of it gets read.
+//
+// Not thread-safe. Only the DVD thread may use it while the thread is running.
+class ReadAheadCache
+{
+public:
+  using ReadFunction =
+      std::function<bool(u64 offset, u32 length, u8* buffer, const DiscIO::Partition& partition)>;
+
+  struct Stats
+  {
+    u64 reads = 0;
+    // Reads that were served entirely from the cache
+    u64 hits = 0;
+    u64 bytes_read = 0;
+    u64 bytes_hit = 0;
+    u64 bytes_prefetched = 0;
+    // Prefetched data that was evicted without ever being read
+    u64 bytes_wasted = 0;
+    // Time that reads spent waiting for the disc because their data wasn't cached
+    u64 miss_time_us = 0;
+  };
+
+  static constexpr u32 CHUNK_SIZE = 0x20000;
+  static constexpr u32 MAX_READ_AHEAD_CHUNKS = 32;
+  static constexpr size_t DEFAULT_MAX_CHUNKS = 128;
+
+  explicit ReadAheadCache(size_t max_chunks = DEFAULT_MAX_CHUNKS);
+
+  // Reads data that the emulated software has asked for, and records the access. data_size is
+  // the size of the partition's data (or of the disc), which prefetching doesn't go past.
+  bool Read(u64 offset, u32 length, u8* buffer, const DiscIO::Partition& partition, u64 data_size,
+            const ReadFunction& read);
+
+  // Reads one chunk ahead of a stream into the cache, so that callers can check for new requests
+  // in between. Returns false if there was nothing to prefetch.
+  bool Prefetch(const ReadFunction& read);
+
+  // Must be called when the disc changes.
+  void Clear();
+
+  const Stats& GetStats() const { return m_stats; }
+  void ResetStats() { m_stats = {}; }
+
+private:
+  // Partition offset and chunk index
+  using ChunkKey = std::pair<u64, u64>;
+
+  struct Chunk
+  {
+    std::vector<u8> data;
+    u64 last_used = 0;
+    bool was_read = false;
+    bool consumed = false;
+  };
+
+  struct Stream
+  {
+    bool active = false;
+    u64 partition = 0;
+    u64 start_offset = 0;
+    u64 next_offset = 0;
+    u32 sequential_reads = 0;
+    // Nothing from here on gets prefetched (the end of the partition, or of what could be read)
+    u64 end_offset = 0;
+    u64 last_used = 0;
+  };
+
+  static constexpr size_t MAX_STREAMS = 4;
+
+  void RecordAccess(u64 partition, u64 offset, u32 length, u64 data_size);
+  // Returns the first chunk ahead of the stream that should be prefetched, if any.
+  bool FindChunkToPrefetch(const Stream& stream, u64* chunk_index) const;
+  void InsertChunk(const ChunkKey& key, std::vector<u8> data);
+
+  size_t m_max_chunks;
+  std::map<ChunkKey, Chunk> m_chunks;
+  std::array<Stream, MAX_STREAMS> m_streams;
+  u64 m_clock = 0;
+  Stats m_stats;
+};
+}  // namespace DVDThread
@@ -23,6 +23,7 @@
 #include "Core/HW/VideoInterface.h"
 #include "Core/HW/WII_IPC.h"
 #include "Core/IOS/IOS.h"
+#include "Core/Rewind.h"
 #include "Core/State.h"
 #include "Core/WiiRoot.h"
 
@@ -34,6 +35,7 @@ void Init()
   SystemTimers::PreInit();
 
   State::Init();
+  Rewind::Init();
 
   // Init the whole Hardware
   AudioInterface::Init();
@@ -73,6 +75,7 @@ void Shutdown()
   SerialInterface::Shutdown();
   AudioInterface::Shutdown();
 
+  Rewind::Shutdown();
   State::Shutdown();
   CoreTiming::Shutdown();
 }
@@ -10,10 +10,14 @@
 #include "Core/HW/Memmap.h"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <memory>
+#include <random>
+#include <vector>
 
 #include "Common/ChunkFile.h"
+#include "Common/CommonFuncs.h"
 #include "Common/CommonTypes.h"
 #include "Common/Logging/Log.h"
 #include "Common/MemArena.h"
@@ -164,6 +168,11 @@ static PhysicalMemoryRegion physical_regions[] = {
 
 static std::vector<LogicalMemoryView> logical_mapped_entries;
 
+// The contents of physical_regions when the delta base was saved or loaded
+static std::array<std::vector<u8>, ArraySize(physical_regions)> s_delta_base;
+static u64 s_delta_base_id = 0;
+static StateType s_state_type_to_save = StateType::Full;
+
 void Init()
 {
   bool wii = SConfig::GetInstance().bWii;
@@ -263,8 +272,107 @@ void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table)
   }
 }
 
+static void MakeDeltaBase(u64 id)
+{
+  for (size_t i = 0; i < ArraySize(physical_regions); i++)
+  {
+    const u8* const region = *physical_regions[i].out_pointer;
+    if (region)
+      s_delta_base[i].assign(region, region + physical_regions[i].size);
+    else
+      s_delta_base[i].clear();
+  }
+  s_delta_base_id = id;
+}
+
+static void ClearDeltaBase()
+{
+  for (std::vector<u8>& region : s_delta_base)
+  {
+    region.clear();
+    region.shrink_to_fit();
+  }
+  s_delta_base_id = 0;
+}
+
+static void DoRegionDeltaState(PointerWrap& p, size_t index)
+{
+  u8* const region = *physical_regions[index].out_pointer;
+  const u32 size = physical_regions[index].size;
+  const std::vector<u8>& base = s_delta_base[index];
+  if (!region)
+    return;
+
+  std::vector<u32> pages;
+  if (p.GetMode() == PointerWrap::MODE_WRITE || p.GetMode() == PointerWrap::MODE_MEASURE)
+  {
+    for (u32 offset = 0; offset < size; offset += DELTA_PAGE_SIZE)
+    {
+      if (std::memcmp(region + offset, &base[offset], DELTA_PAGE_SIZE) != 0)
+        pages.push_back(offset / DELTA_PAGE_SIZE);
+    }
+  }
+  p.Do(pages);
+
+  if (p.GetMode() == PointerWrap::MODE_READ)
+  {
+    if (std::any_of(pages.begin(), pages.end(),
+                    [size](u32 page) { return page >= size / DELTA_PAGE_SIZE; }))
+    {
+      ERROR_LOG(MEMMAP, "Invalid page in delta state");
+      p.SetMode(PointerWrap::MODE_MEASURE);
+      return;
+    }
+    std::memcpy(region, base.data(), size);
+  }
+
+  for (u32 page : pages)
+    p.DoArray(region + page * DELTA_PAGE_SIZE, DELTA_PAGE_SIZE);
+}
+
+static void DoDeltaState(PointerWrap& p)
+{
+  for (size_t i = 0; i < ArraySize(physical_regions); i++)
+  {
+    DoRegionDeltaState(p, i);
+    if (physical_regions[i].out_pointer == &m_pL1Cache)
+      p.DoMarker("Memory RAM");
+    else if (physical_regions[i].out_pointer == &m_pFakeVMEM)
+      p.DoMarker("Memory FakeVMEM");
+  }
+  p.DoMarker("Memory EXRAM");
+}
+
 void DoState(PointerWrap& p)
 {
+  StateType type = s_state_type_to_save;
+  if (type == StateType::Delta && s_delta_base_id == 0)
+    type = StateType::Full;
+  u64 delta_base_id = type == StateType::Full ? 0 : s_delta_base_id;
+  if (type == StateType::DeltaBase && p.GetMode() == PointerWrap::MODE_WRITE)
+  {
+    // Random, so that deltas can't be mixed up with bases from other sessions
+    std::random_device rd;
+    do
+      delta_base_id = static_cast<u64>(rd()) << 32 | rd();
+    while (delta_base_id == 0);
+  }
+  p.Do(type);
+  p.Do(delta_base_id);
+
+  if (type == StateType::Delta)
+  {
+    if (p.GetMode() == PointerWrap::MODE_READ &&
+        (delta_base_id == 0 || delta_base_id != s_delta_base_id))
+    {
+      ERROR_LOG(MEMMAP, "The base of this delta state isn't loaded");
+      p.SetMode(PointerWrap::MODE_MEASURE);
+      return;
+    }
+    DoDeltaState(p);
+    return;
+  }
+
   bool wii = SConfig::GetInstance().bWii;
   p.DoArray(m_pRAM, RAM_SIZE);
   p.DoArray(m_pL1Cache, L1_CACHE_SIZE);
@@ -275,6 +383,21 @@ void DoState(PointerWrap& p)
   if (wii)
     p.DoArray(m_pEXRAM, EXRAM_SIZE);
   p.DoMarker("Memory EXRAM");
+
+  const bool saved = p.GetMode() == PointerWrap::MODE_WRITE;
+  const bool loaded = p.GetMode() == PointerWrap::MODE_READ;
+  if (type == StateType::DeltaBase && (saved || loaded) && delta_base_id != s_delta_base_id)
+    MakeDeltaBase(delta_base_id);
+}
+
+void SetStateTypeToSave(StateType type)
+{
+  s_state_type_to_save = type;
+}
+
+u64 GetDeltaBaseID()
+{
+  return s_delta_base_id;
 }
 
 void Shutdown()
@@ -297,6 +420,7 @@ void Shutdown()
     g_arena.ReleaseView(entry.mapped_pointer, entry.mapped_size);
   }
   logical_mapped_entries.clear();
+  ClearDeltaBase();
   g_arena.ReleaseSHMSegment();
   physical_base = nullptr;
   logical_base = nullptr;
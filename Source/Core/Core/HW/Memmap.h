@@ -64,6 +64,22 @@ void Init();
 void Shutdown();
 void DoState(PointerWrap& p);
 
+// Delta states only contain the pages of memory that differ from a delta base state. Memory keeps
+// a copy of itself from when the base was saved (or loaded) to compare against, and delta states
+// can only be loaded while that copy is still around.
+enum class StateType : u8
+{
+  Full,
+  DeltaBase,
+  Delta,
+};
+constexpr u32 DELTA_PAGE_SIZE = 0x1000;
+
+// What DoState saves. Saving a delta state without a delta base saves a full state instead.
+void SetStateTypeToSave(StateType type);
+// Identifies the current delta base, or 0 if there is none.
+u64 GetDeltaBaseID();
+
 void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table);
 
 void Clear();
@@ -204,7 +204,7 @@ void CachedInterpreter::Jit(u32 address)
     ClearCache();
   }
 
-  const u32 nextPC = analyzer.Analyze(PC, &code_block, &m_code_buffer, m_code_buffer.size());
+  const u32 nextPC = AnalyzeBlock(PC, m_code_buffer.size());
   if (code_block.m_memory_exception)
   {
     // Address of instruction could not be translated
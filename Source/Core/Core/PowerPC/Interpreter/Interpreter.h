@@ -17,6 +17,8 @@ public:
   void Shutdown() override;
   void SingleStep() override;
   int SingleStepInner();
+  // Executes instructions up to the end of the current block and returns their cycle count.
+  int SingleStepBlock();
 
   void Run() override;
   void ClearCache() override;
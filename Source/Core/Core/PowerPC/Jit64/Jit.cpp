@@ -4,6 +4,7 @@
 
 #include "Core/PowerPC/Jit64/Jit.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
 
@@ -18,7 +19,9 @@
 #include "Common/MemoryUtil.h"
 #include "Common/PerformanceCounter.h"
 #include "Common/StringUtil.h"
+#include "Common/Thread.h"
 #include "Common/x64ABI.h"
+#include "Core/Config/MainSettings.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
 #include "Core/HLE/HLE.h"
@@ -26,6 +29,7 @@
 #include "Core/HW/GPFifo.h"
 #include "Core/HW/ProcessorInterface.h"
 #include "Core/PatchEngine.h"
+#include "Core/PowerPC/Interpreter/Interpreter.h"
 #include "Core/PowerPC/Jit64/JitAsm.h"
 #include "Core/PowerPC/Jit64/JitRegCache.h"
 #include "Core/PowerPC/Jit64Common/FarCodeCache.h"
@@ -261,10 +265,25 @@ void Jit64::Init()
   code_block.m_gpa = &js.gpa;
   code_block.m_fpa = &js.fpa;
   EnableOptimization();
+
+  m_tiered_compile =
+      Config::Get(Config::MAIN_JIT_TIERED_COMPILE) && !SConfig::GetInstance().bEnableDebugging;
+
+  m_compile_time_dbat_table_valid = false;
+  m_async_compile = Config::Get(Config::MAIN_JIT_ASYNC_COMPILE);
+  if (m_async_compile)
+  {
+    m_async_quit.Clear();
+    m_async_thread = std::thread(&Jit64::AsyncCompileThread, this);
+  }
 }
 
 void Jit64::ClearCache()
 {
+  // A block compiled in the background lives in the code space we are about to throw away.
+  WaitForAsyncCompile();
+  m_async_discarded = true;
+
   blocks.Clear();
   trampolines.ClearCodeSpace();
   m_far_code.ClearCodeSpace();
@@ -276,6 +295,13 @@ void Jit64::ClearCache()
 
 void Jit64::Shutdown()
 {
+  if (m_async_thread.joinable())
+  {
+    m_async_quit.Set();
+    m_async_request.Set();
+    m_async_thread.join();
+  }
+
   FreeStack();
   FreeCodeSpace();
 
@@ -626,10 +652,13 @@ void Jit64::Jit(u32 em_address)
     }
   }
 
+  if (m_tiered_compile)
+    SetCompileTier(js.hotBlockAddresses.find(em_address) != js.hotBlockAddresses.end());
+
   // Analyze the block, collect all instructions it is made of (including inlining,
   // if that is enabled), reorder instructions for optimal performance, and join joinable
   // instructions.
-  const u32 nextPC = analyzer.Analyze(em_address, &code_block, &m_code_buffer, block_size);
+  const u32 nextPC = AnalyzeBlock(em_address, block_size);
 
   if (code_block.m_memory_exception)
   {
@@ -641,11 +670,172 @@ void Jit64::Jit(u32 em_address)
     return;
   }
 
+  CaptureGuestState();
+
+  // The free list of run counters is only touched on the CPU thread.
+  u32* run_counter = nullptr;
+  if (m_tiered_compile &&
+      !analyzer.HasOption(PPCAnalyst::PPCAnalyzer::OPTION_AGGRESSIVE_BRANCH_FOLLOW))
+  {
+    run_counter = blocks.AllocateRunCounter(HOT_BLOCK_THRESHOLD);
+  }
+
+  if (CanCompileAsync())
+  {
+    CompileAsync(em_address, nextPC, run_counter);
+    return;
+  }
+
   JitBlock* b = blocks.AllocateBlock(em_address);
+  b->run_counter = run_counter;
   DoJit(em_address, b, nextPC);
   blocks.FinalizeBlock(*b, jo.enableBlocklink, code_block.m_physical_addresses);
 }
 
+void Jit64::CaptureGuestState()
+{
+  std::copy_n(PowerPC::ppcState.gpr, m_compile_time_gprs.size(), m_compile_time_gprs.begin());
+  for (size_t i = 0; i < m_compile_time_gqrs.size(); i++)
+    m_compile_time_gqrs[i] = GQR(i);
+
+  js.msr.Hex = MSR.Hex;
+
+  std::array<u32, NUM_BAT_SPRS> bats;
+  std::copy_n(&PowerPC::ppcState.spr[SPR_IBAT0U], 16, bats.begin());
+  std::copy_n(&PowerPC::ppcState.spr[SPR_IBAT4U], 16, bats.begin() + 16);
+  bats[32] = PowerPC::ppcState.spr[SPR_HID4];
+  if (!m_compile_time_dbat_table_valid || bats != m_compile_time_bats)
+  {
+    m_compile_time_bats = bats;
+    m_compile_time_dbat_table = PowerPC::dbat_table;
+    m_compile_time_dbat_table_valid = true;
+  }
+  js.dbatTable = &m_compile_time_dbat_table;
+
+  // HLE hooks come from the symbol database.
+  m_compile_time_hooks.clear();
+  for (u32 i = 0; i < code_block.m_num_instructions; i++)
+  {
+    const u32 address = m_code_buffer[i].address;
+    HLE::ReplaceFunctionIfPossible(address, [&](u32 function, HLE::HookType type) {
+      m_compile_time_hooks.push_back({address, function, type});
+      return true;
+    });
+  }
+}
+
+bool Jit64::GuestStateChanged() const
+{
+  if (((MSR.Hex ^ js.msr.Hex) & JitBaseBlockCache::JIT_CACHE_MSR_MASK) != 0)
+    return true;
+
+  const u32* const spr = PowerPC::ppcState.spr;
+  return !std::equal(&spr[SPR_IBAT0U], &spr[SPR_IBAT0U] + 16, m_compile_time_bats.begin()) ||
+         !std::equal(&spr[SPR_IBAT4U], &spr[SPR_IBAT4U] + 16, m_compile_time_bats.begin() + 16) ||
+         spr[SPR_HID4] != m_compile_time_bats[32];
+}
+
+bool Jit64::CanCompileAsync() const
+{
+  // Block profiling embeds pointers to the final JitBlock into the code, and the debugger
+  // expects breakpoints and stepping to behave exactly, so both stay synchronous.
+  return m_async_compile && !jo.profile_blocks && !SConfig::GetInstance().bEnableDebugging &&
+         !SConfig::GetInstance().bJITNoBlockCache && PowerPC::ppcState.downcount > 0;
+}
+
+void Jit64::CompileAsync(u32 em_address, u32 nextPC, u32* run_counter)
+{
+  m_async_block = JitBlock{};
+  m_async_block.effectiveAddress = em_address;
+  m_async_block.msrBits = MSR.Hex & JitBaseBlockCache::JIT_CACHE_MSR_MASK;
+  m_async_block.run_counter = run_counter;
+  m_async_physical_address = PowerPC::JitCache_TranslateAddress(em_address).address;
+  m_async_next_pc = nextPC;
+  m_async_discarded = false;
+  m_async_done.Clear();
+  m_async_pending = true;
+  m_async_request.Set();
+
+  // Keep the guest running on the interpreter instead of stalling on the emitter.
+  while (!m_async_done.IsSet() && PowerPC::ppcState.downcount > 0)
+  {
+    PowerPC::ppcState.downcount -= Interpreter::getInstance()->SingleStepBlock();
+
+    // The block is only good if the guest state it was compiled for never changed under it.
+    if (GuestStateChanged())
+      m_async_discarded = true;
+  }
+
+  WaitForAsyncCompile();
+  PublishAsyncBlock();
+}
+
+void Jit64::WaitForAsyncCompile()
+{
+  if (!m_async_pending)
+    return;
+
+  m_async_done_event.Wait();
+  m_async_pending = false;
+  m_async_ready = true;
+}
+
+void Jit64::PublishAsyncBlock()
+{
+  if (!m_async_ready)
+    return;
+  m_async_ready = false;
+
+  const u32 em_address = m_async_block.effectiveAddress;
+  if (m_async_discarded || GuestStateChanged() ||
+      PowerPC::JitCache_TranslateAddress(em_address).address != m_async_physical_address)
+  {
+    if (m_async_block.run_counter)
+      blocks.FreeRunCounter(m_async_block.run_counter);
+    return;
+  }
+
+  JitBlock* b = blocks.AllocateBlock(em_address);
+  b->checkedEntry = m_async_block.checkedEntry;
+  b->normalEntry = m_async_block.normalEntry;
+  b->codeSize = m_async_block.codeSize;
+  b->originalSize = m_async_block.originalSize;
+  b->linkData = std::move(m_async_block.linkData);
+  b->run_counter = m_async_block.run_counter;
+  blocks.FinalizeBlock(*b, jo.enableBlocklink, code_block.m_physical_addresses);
+}
+
+void Jit64::InvalidatePendingCompile(u32 address, u32 length)
+{
+  if (!m_async_pending && !m_async_ready)
+    return;
+
+  // Invalidation also touches the js address sets, which the compiler thread may be reading.
+  WaitForAsyncCompile();
+
+  const auto translated = PowerPC::JitCache_TranslateAddress(address);
+  const auto& addresses = code_block.m_physical_addresses;
+  const auto it = addresses.lower_bound(translated.address);
+  if (!translated.valid || (it != addresses.end() && *it < u64{translated.address} + length))
+    m_async_discarded = true;
+}
+
+void Jit64::AsyncCompileThread()
+{
+  Common::SetCurrentThreadName("JIT compiler");
+
+  while (true)
+  {
+    m_async_request.Wait();
+    if (m_async_quit.IsSet())
+      return;
+
+    DoJit(m_async_block.effectiveAddress, &m_async_block, m_async_next_pc);
+    m_async_done.Set();
+    m_async_done_event.Set();
+  }
+}
+
 u8* Jit64::DoJit(u32 em_address, JitBlock* b, u32 nextPC)
 {
   js.firstFPInstructionFound = false;
@@ -658,7 +848,10 @@ u8* Jit64::DoJit(u32 em_address, JitBlock* b, u32 nextPC)
   js.numFloatingPointInst = 0;
 
   // TODO: Test if this or AlignCode16 make a difference from GetCodePtr
-  u8* const start = AlignCode4();
+  // Hot blocks are the targets of most block links, so their entry is aligned for the instruction
+  // fetch. That isn't worth the padding for every block.
+  const bool hot = analyzer.HasOption(PPCAnalyst::PPCAnalyzer::OPTION_AGGRESSIVE_BRANCH_FOLLOW);
+  u8* const start = hot ? AlignCode16() : AlignCode4();
   b->checkedEntry = start;
 
   // Downcount flag check. The last block decremented downcounter, and the flag should still be
@@ -689,6 +882,9 @@ u8* Jit64::DoJit(u32 em_address, JitBlock* b, u32 nextPC)
     ADD(64, MDisp(ABI_PARAM1, offset), Imm8(1));
     ABI_CallFunction(QueryPerformanceCounter);
   }
+  if (b->run_counter)
+    WriteHotBlockCheck(b);
+
 #if defined(_DEBUG) || defined(DEBUGFAST) || defined(NAN_CHECK)
   // should help logged stack-traces become more accurate
   MOV(32, PPCSTATE(pc), Imm32(js.blockStart));
@@ -729,7 +925,7 @@ u8* Jit64::DoJit(u32 em_address, JitBlock* b, u32 nextPC)
       // the start of the block in case our guess turns out wrong.
       for (int gqr : gqr_static)
       {
-        u32 value = GQR(gqr);
+        u32 value = m_compile_time_gqrs[gqr];
         js.constantGqr[gqr] = value;
         CMP_or_TEST(32, PPCSTATE(spr[SPR_GQR0 + gqr]), Imm32(value));
         J_CC(CC_NZ, target);
@@ -996,6 +1192,34 @@ void Jit64::EnableOptimization()
   analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_FOLLOW);
 }
 
+void Jit64::SetCompileTier(bool hot)
+{
+  if (hot)
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_AGGRESSIVE_BRANCH_FOLLOW);
+  else
+    analyzer.ClearOption(PPCAnalyst::PPCAnalyzer::OPTION_AGGRESSIVE_BRANCH_FOLLOW);
+}
+
+void Jit64::WriteHotBlockCheck(JitBlock* b)
+{
+  // Blocks compiled by the compiler thread are copied when they are published, so the
+  // counter can't live in the JitBlock itself. It is allocated on the CPU thread before the
+  // compile and handed over to the published block.
+  SwitchToFarCode();
+  const u8* target = GetCodePtr();
+  MOV(32, PPCSTATE(pc), Imm32(js.blockStart));
+  ABI_PushRegistersAndAdjustStack({}, 0);
+  ABI_CallFunctionC(JitInterface::CompileExceptionCheck,
+                    static_cast<u32>(JitInterface::ExceptionType::HotBlock));
+  ABI_PopRegistersAndAdjustStack({}, 0);
+  JMP(asm_routines.dispatcher_no_check, true);
+  SwitchToNearCode();
+
+  MOV(64, R(RSCRATCH), ImmPtr(b->run_counter));
+  SUB(32, MatR(RSCRATCH), Imm8(1));
+  J_CC(CC_Z, target);
+}
+
 void Jit64::IntializeSpeculativeConstants()
 {
   // If the block depends on an input register which looks like a gather pipe or MMIO related
@@ -1007,9 +1231,10 @@ void Jit64::IntializeSpeculativeConstants()
   const u8* target = nullptr;
   for (auto i : code_block.m_gpr_inputs)
   {
-    u32 compileTimeValue = PowerPC::ppcState.gpr[i];
-    if (PowerPC::IsOptimizableGatherPipeWrite(compileTimeValue) ||
-        PowerPC::IsOptimizableGatherPipeWrite(compileTimeValue - 0x8000) ||
+    u32 compileTimeValue = m_compile_time_gprs[i];
+    if (PowerPC::IsOptimizableGatherPipeWrite(compileTimeValue, *js.dbatTable, js.msr.DR) ||
+        PowerPC::IsOptimizableGatherPipeWrite(compileTimeValue - 0x8000, *js.dbatTable,
+                                              js.msr.DR) ||
         compileTimeValue == 0xCC000000)
     {
       if (!target)
@@ -1033,15 +1258,19 @@ void Jit64::IntializeSpeculativeConstants()
 
 bool Jit64::HandleFunctionHooking(u32 address)
 {
-  return HLE::ReplaceFunctionIfPossible(address, [&](u32 function, HLE::HookType type) {
-    HLEFunction(function);
+  const auto hook =
+      std::find_if(m_compile_time_hooks.begin(), m_compile_time_hooks.end(),
+                   [address](const FunctionHook& entry) { return entry.address == address; });
+  if (hook == m_compile_time_hooks.end())
+    return false;
 
-    if (type != HLE::HookType::Replace)
-      return false;
+  HLEFunction(hook->function);
 
-    MOV(32, R(RSCRATCH), PPCSTATE(npc));
-    js.downcountAmount += js.st.numCycles;
-    WriteExitDestInRSCRATCH();
-    return true;
-  });
+  if (hook->type != HLE::HookType::Replace)
+    return false;
+
+  MOV(32, R(RSCRATCH), PPCSTATE(npc));
+  js.downcountAmount += js.st.numCycles;
+  WriteExitDestInRSCRATCH();
+  return true;
 }
@@ -18,9 +18,16 @@
 // ----------
 #pragma once
 
+#include <array>
+#include <thread>
+#include <vector>
+
 #include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/Flag.h"
 #include "Common/x64ABI.h"
 #include "Common/x64Emitter.h"
+#include "Core/HLE/HLE.h"
 #include "Core/PowerPC/Jit64/FPURegCache.h"
 #include "Core/PowerPC/Jit64/GPRRegCache.h"
 #include "Core/PowerPC/Jit64/JitAsm.h"
@@ -53,6 +60,7 @@ public:
 
   void Jit(u32 em_address) override;
   u8* DoJit(u32 em_address, JitBlock* b, u32 nextPC);
+  void InvalidatePendingCompile(u32 address, u32 length) override;
 
   BitSet32 CallerSavedRegistersInUse() const;
   BitSet8 ComputeStaticGQRs(const PPCAnalyst::CodeBlock&) const;
@@ -241,6 +249,27 @@ private:
   void AllocStack();
   void FreeStack();
 
+  // Tiered compilation. Blocks are first compiled with the regular analyzer options and count
+  // their executions. Once a block has run HOT_BLOCK_THRESHOLD times, it is invalidated and
+  // recompiled as a hot block: with aggressive branch following and a 16-byte aligned entry.
+  // Block linking then relinks its callers to the new code.
+  static constexpr u32 HOT_BLOCK_THRESHOLD = 1000;
+  void SetCompileTier(bool hot);
+  void WriteHotBlockCheck(JitBlock* b);
+
+  // Background compilation. The CPU thread analyzes the block, hands the emission off to the
+  // compiler thread and keeps running the guest with the interpreter until the block is ready.
+  // At most one block is in flight, and only for the duration of a single Jit() call, so the
+  // compiler thread never emits code while JIT code is running.
+  void CaptureGuestState();
+  // Whether the MSR translation bits or the BATs differ from the ones the block was compiled for.
+  bool GuestStateChanged() const;
+  bool CanCompileAsync() const;
+  void CompileAsync(u32 em_address, u32 nextPC, u32* run_counter);
+  void WaitForAsyncCompile();
+  void PublishAsyncBlock();
+  void AsyncCompileThread();
+
   GPRRegCache gpr{*this};
   FPURegCache fpr{*this};
 
@@ -249,4 +278,39 @@ private:
   bool m_enable_blr_optimization;
   bool m_cleanup_after_stackfault;
   u8* m_stack;
+
+  bool m_tiered_compile = false;
+
+  // Guest state the block is specialized for, captured on the CPU thread when the compile is
+  // requested (see also JitState::msr).
+  struct FunctionHook
+  {
+    u32 address;
+    u32 function;
+    HLE::HookType type;
+  };
+  static constexpr std::size_t NUM_BAT_SPRS = 33;
+  std::array<u32, 32> m_compile_time_gprs{};
+  std::array<u32, 8> m_compile_time_gqrs{};
+  std::vector<FunctionHook> m_compile_time_hooks;
+  // The BAT SPRs and HID4 which the copy of the data BAT table was built from. The table is only
+  // copied again when they change.
+  std::array<u32, NUM_BAT_SPRS> m_compile_time_bats{};
+  PowerPC::BatTable m_compile_time_dbat_table{};
+  bool m_compile_time_dbat_table_valid = false;
+
+  bool m_async_compile = false;
+  std::thread m_async_thread;
+  Common::Event m_async_request;
+  Common::Event m_async_done_event;
+  Common::Flag m_async_done;
+  Common::Flag m_async_quit;
+  JitBlock m_async_block;
+  u32 m_async_physical_address = 0;
+  u32 m_async_next_pc = 0;
+  // Submitted to the compiler thread and not waited for yet.
+  bool m_async_pending = false;
+  // Compiled and waiting to be published.
+  bool m_async_ready = false;
+  bool m_async_discarded = false;
 };
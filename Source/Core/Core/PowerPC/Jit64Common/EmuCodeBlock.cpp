@@ -367,7 +367,7 @@ void EmuCodeBlock::SafeLoadToReg(X64Reg reg_value, const Gen::OpArg& opAddress,
   }
 
   FixupBranch exit;
-  const bool dr_set = (flags & SAFE_LOADSTORE_DR_ON) || MSR.DR;
+  const bool dr_set = (flags & SAFE_LOADSTORE_DR_ON) || g_jit->js.msr.DR;
   const bool fast_check_address = !slowmem && dr_set;
   if (fast_check_address)
   {
@@ -432,14 +432,15 @@ void EmuCodeBlock::SafeLoadToRegImmediate(X64Reg reg_value, u32 address, int acc
                                           BitSet32 registersInUse, bool signExtend)
 {
   // If the address is known to be RAM, just load it directly.
-  if (PowerPC::IsOptimizableRAMAddress(address))
+  if (PowerPC::IsOptimizableRAMAddress(address, *g_jit->js.dbatTable, g_jit->js.msr.DR))
   {
     UnsafeLoadToReg(reg_value, Imm32(address), accessSize, 0, signExtend);
     return;
   }
 
   // If the address maps to an MMIO register, inline MMIO read code.
-  u32 mmioAddress = PowerPC::IsOptimizableMMIOAccess(address, accessSize);
+  u32 mmioAddress =
+      PowerPC::IsOptimizableMMIOAccess(address, accessSize, *g_jit->js.dbatTable, g_jit->js.msr.DR);
   if (accessSize != 64 && mmioAddress)
   {
     MMIOLoadToReg(Memory::mmio_mapping.get(), reg_value, registersInUse, mmioAddress, accessSize,
@@ -534,7 +535,7 @@ void EmuCodeBlock::SafeWriteRegToReg(OpArg reg_value, X64Reg reg_addr, int acces
   }
 
   FixupBranch exit;
-  const bool dr_set = (flags & SAFE_LOADSTORE_DR_ON) || MSR.DR;
+  const bool dr_set = (flags & SAFE_LOADSTORE_DR_ON) || g_jit->js.msr.DR;
   const bool fast_check_address = !slowmem && dr_set;
   if (fast_check_address)
   {
@@ -617,7 +618,8 @@ bool EmuCodeBlock::WriteToConstAddress(int accessSize, OpArg arg, u32 address,
 
   // If we already know the address through constant folding, we can do some
   // fun tricks...
-  if (g_jit->jo.optimizeGatherPipe && PowerPC::IsOptimizableGatherPipeWrite(address))
+  if (g_jit->jo.optimizeGatherPipe &&
+      PowerPC::IsOptimizableGatherPipeWrite(address, *g_jit->js.dbatTable, g_jit->js.msr.DR))
   {
     X64Reg arg_reg = RSCRATCH;
 
@@ -637,7 +639,7 @@ bool EmuCodeBlock::WriteToConstAddress(int accessSize, OpArg arg, u32 address,
     g_jit->js.fifoBytesSinceCheck += accessSize >> 3;
     return false;
   }
-  else if (PowerPC::IsOptimizableRAMAddress(address))
+  else if (PowerPC::IsOptimizableRAMAddress(address, *g_jit->js.dbatTable, g_jit->js.msr.DR))
   {
     WriteToConstRamAddress(accessSize, arg, address);
     return false;
@@ -19,6 +19,7 @@
 #include "Core/HW/Memmap.h"
 #include "Core/MachineContext.h"
 #include "Core/PowerPC/PPCAnalyst.h"
+#include "Core/PowerPC/PowerPC.h"
 
 // This generates some fairly heavy trampolines, but it doesn't really hurt.
 // Only instructions that access I/O will get these, and there won't be that
@@ -71,6 +72,8 @@ bool Jitx86Base::BackPatch(u32 emAddress, SContext* ctx)
   js.generatingTrampoline = true;
   js.trampolineExceptionHandler = exceptionHandler;
   js.compilerPC = info.pc;
+  js.msr.Hex = MSR.Hex;
+  js.dbatTable = &PowerPC::dbat_table;
 
   // Generate the trampoline.
   const u8* trampoline = trampolines.GenerateTrampoline(info);
@@ -4,7 +4,11 @@
 
 #include "Core/PowerPC/JitCommon/JitBase.h"
 
+#include <string>
+
 #include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "Core/Config/MainSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/HW/CPU.h"
 #include "Core/PowerPC/PPCAnalyst.h"
@@ -26,7 +30,45 @@ JitBase::JitBase() : m_code_buffer(code_buffer_size)
 {
 }
 
-JitBase::~JitBase() = default;
+JitBase::~JitBase()
+{
+  m_analysis_cache.Close();
+}
+
+u32 JitBase::AnalyzeBlock(u32 em_address, std::size_t block_size)
+{
+  // The analysis depends on the breakpoints while debugging.
+  if (SConfig::GetInstance().bEnableDebugging)
+    return analyzer.Analyze(em_address, &code_block, &m_code_buffer, block_size);
+
+  // This isn't done in the constructor, since JITs can be created without a config (in tests).
+  // The running game can also change without the JIT being recreated, e.g. when a Wii title
+  // launches another one.
+  const std::string& game_id = SConfig::GetInstance().GetGameID();
+  if (!m_analysis_cache_checked || game_id != m_analysis_cache_game_id)
+  {
+    m_analysis_cache_checked = true;
+    m_analysis_cache_game_id = game_id;
+    m_analysis_cache.Close();
+    if (Config::Get(Config::MAIN_JIT_ANALYSIS_CACHE))
+      m_analysis_cache.Open(File::GetUserPath(D_CACHE_IDX) + game_id + ".ppcanalysis");
+  }
+
+  if (!m_analysis_cache.IsOpen())
+    return analyzer.Analyze(em_address, &code_block, &m_code_buffer, block_size);
+
+  u32 next_pc;
+  if (m_analysis_cache.Lookup(em_address, analyzer.GetOptions(), block_size, &code_block,
+                              &m_code_buffer, &next_pc))
+  {
+    return next_pc;
+  }
+
+  next_pc = analyzer.Analyze(em_address, &code_block, &m_code_buffer, block_size);
+  m_analysis_cache.Store(em_address, analyzer.GetOptions(), block_size, code_block,
+                         m_code_buffer, next_pc);
+  return next_pc;
+}
 
 bool JitBase::CanMergeNextInstructions(int count) const
 {
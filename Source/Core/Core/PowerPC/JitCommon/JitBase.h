@@ -6,6 +6,7 @@
 
 #include <cstddef>
 #include <map>
+#include <string>
 #include <unordered_set>
 
 #include "Common/CommonTypes.h"
@@ -13,8 +14,11 @@
 #include "Core/ConfigManager.h"
 #include "Core/MachineContext.h"
 #include "Core/PowerPC/CPUCoreBase.h"
+#include "Core/PowerPC/Gekko.h"
 #include "Core/PowerPC/JitCommon/JitAsmCommon.h"
 #include "Core/PowerPC/JitCommon/JitCache.h"
+#include "Core/PowerPC/MMU.h"
+#include "Core/PowerPC/PPCAnalysisCache.h"
 #include "Core/PowerPC/PPCAnalyst.h"
 
 //#define JIT_LOG_GENERATED_CODE  // Enables logging of generated code
@@ -59,6 +63,10 @@ protected:
   {
     u32 compilerPC;
     u32 blockStart;
+    // The MSR and data BAT table that the code is generated for. Blocks can be emitted on another
+    // thread than the CPU thread, so these are captured on the CPU thread instead of read live.
+    UReg_MSR msr{};
+    const PowerPC::BatTable* dbatTable = &PowerPC::dbat_table;
     int instructionNumber;
     int instructionsLeft;
     int downcountAmount;
@@ -100,11 +108,19 @@ protected:
     std::unordered_set<u32> fifoWriteAddresses;
     std::unordered_set<u32> pairedQuantizeAddresses;
     std::unordered_set<u32> noSpeculativeConstantsAddresses;
+    std::unordered_set<u32> hotBlockAddresses;
   };
 
   PPCAnalyst::CodeBlock code_block;
   PPCAnalyst::CodeBuffer m_code_buffer;
   PPCAnalyst::PPCAnalyzer analyzer;
+  PPCAnalyst::AnalysisCache m_analysis_cache;
+  bool m_analysis_cache_checked = false;
+  std::string m_analysis_cache_game_id;
+
+  // Analyzes the block at em_address into code_block and m_code_buffer, reusing the results
+  // from the analysis cache if possible. Returns the address following the block.
+  u32 AnalyzeBlock(u32 em_address, std::size_t block_size);
 
   bool CanMergeNextInstructions(int count) const;
 
@@ -119,6 +135,10 @@ public:
 
   virtual void Jit(u32 em_address) = 0;
 
+  // Called before guest code in [address, address + length) is invalidated. JITs which compile
+  // blocks in the background must make sure that no stale block for it gets published afterwards.
+  virtual void InvalidatePendingCompile(u32 address, u32 length) {}
+
   virtual const CommonAsmRoutinesBase* GetAsmRoutines() = 0;
 
   virtual bool HandleFault(uintptr_t access_address, SContext* ctx) = 0;
@@ -11,20 +11,25 @@
 
 #include <algorithm>
 #include <array>
+#include <cinttypes>
 #include <cstring>
 #include <functional>
-#include <map>
+#include <memory>
 #include <set>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "Common/CommonTypes.h"
 #include "Common/JitRegister.h"
+#include "Common/Logging/Log.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/PowerPC/JitCommon/JitBase.h"
 #include "Core/PowerPC/MMU.h"
 #include "Core/PowerPC/PPCSymbolDB.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/SamplingProfiler.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -34,8 +39,108 @@ using namespace Gen;
 
 bool JitBlock::OverlapsPhysicalRange(u32 address, u32 length) const
 {
-  return physical_addresses.lower_bound(address) !=
-         physical_addresses.lower_bound(address + length);
+  const auto iter =
+      std::lower_bound(physical_addresses.begin(), physical_addresses.end(), address);
+  return iter != physical_addresses.end() && *iter < static_cast<u64>(address) + length;
+}
+
+namespace
+{
+constexpr u32 BLOCK_INDEX_INITIAL_SIZE_LOG2 = 12;
+}
+
+JitBlockIndex::JitBlockIndex()
+{
+  Clear();
+}
+
+JitBlock* JitBlockIndex::Find(u32 physical_address) const
+{
+  return m_slots[SlotFor(physical_address)].head;
+}
+
+void JitBlockIndex::Insert(JitBlock* block)
+{
+  Slot& slot = m_slots[SlotFor(block->physicalAddress)];
+  if (!slot.head)
+  {
+    slot.key = block->physicalAddress;
+    m_used_slots++;
+  }
+  block->next_in_bucket = slot.head;
+  slot.head = block;
+  m_num_blocks++;
+
+  // Keep the load factor below 1/2 so probe sequences stay short.
+  if (m_used_slots * 2 > m_slots.size())
+    Grow();
+}
+
+void JitBlockIndex::Erase(JitBlock* block)
+{
+  size_t hole = SlotFor(block->physicalAddress);
+  JitBlock** link = &m_slots[hole].head;
+  while (*link && *link != block)
+    link = &(*link)->next_in_bucket;
+  if (!*link)
+    return;
+
+  *link = block->next_in_bucket;
+  block->next_in_bucket = nullptr;
+  m_num_blocks--;
+
+  if (m_slots[hole].head)
+    return;
+  m_used_slots--;
+
+  // Backward-shift deletion: move later entries of the probe sequence into the hole,
+  // so that lookups never need tombstones.
+  const size_t mask = m_slots.size() - 1;
+  for (size_t i = (hole + 1) & mask; m_slots[i].head; i = (i + 1) & mask)
+  {
+    const size_t ideal = Hash(m_slots[i].key);
+    if (((i - ideal) & mask) >= ((i - hole) & mask))
+    {
+      m_slots[hole] = m_slots[i];
+      m_slots[i].head = nullptr;
+      hole = i;
+    }
+  }
+}
+
+void JitBlockIndex::Clear()
+{
+  m_slots.assign(size_t{1} << BLOCK_INDEX_INITIAL_SIZE_LOG2, Slot{0, nullptr});
+  m_shift = 32 - BLOCK_INDEX_INITIAL_SIZE_LOG2;
+  m_used_slots = 0;
+  m_num_blocks = 0;
+}
+
+size_t JitBlockIndex::Hash(u32 key) const
+{
+  // Fibonacci hashing, using the upper bits of the product as the slot index.
+  return static_cast<u32>(key * 0x9E3779B9u) >> m_shift;
+}
+
+size_t JitBlockIndex::SlotFor(u32 key) const
+{
+  const size_t mask = m_slots.size() - 1;
+  size_t i = Hash(key);
+  while (m_slots[i].head && m_slots[i].key != key)
+    i = (i + 1) & mask;
+  return i;
+}
+
+void JitBlockIndex::Grow()
+{
+  std::vector<Slot> old_slots = std::move(m_slots);
+  m_slots.assign(old_slots.size() * 2, Slot{0, nullptr});
+  m_shift--;
+  for (const Slot& slot : old_slots)
+  {
+    if (slot.head)
+      m_slots[SlotFor(slot.key)] = slot;
+  }
 }
 
 JitBaseBlockCache::JitBaseBlockCache(JitBase& jit) : m_jit{jit}
@@ -53,6 +158,14 @@ void JitBaseBlockCache::Init()
 
 void JitBaseBlockCache::Shutdown()
 {
+  const JitInvalidationStats& stats = m_invalidation_stats;
+  INFO_LOG(DYNA_REC,
+           "ICache invalidations: %" PRIu64 " (page hits: %" PRIu64 ", cacheline hits: %" PRIu64
+           ", misses: %" PRIu64 ", blocks destroyed: %" PRIu64 ")",
+           stats.invalidations, stats.page_hits, stats.cacheline_hits, stats.misses,
+           stats.blocks_destroyed);
+  m_invalidation_stats = {};
+
   JitRegister::Shutdown();
 }
 
@@ -63,13 +176,16 @@ void JitBaseBlockCache::Clear()
 #if defined(_DEBUG) || defined(DEBUGFAST)
   Core::DisplayMessage("Clearing code cache.", 3000);
 #endif
+  // The code space is about to be reused.
+  Profiler::ClearCode();
+
   m_jit.js.fifoWriteAddresses.clear();
   m_jit.js.pairedQuantizeAddresses.clear();
-  for (auto& e : block_map)
-  {
-    DestroyBlock(e.second);
-  }
-  block_map.clear();
+  block_map.ForEach([this](JitBlock& block) {
+    DestroyBlock(block);
+    FreeBlock(&block);
+  });
+  block_map.Clear();
   links_to.clear();
   block_range_map.clear();
 
@@ -91,19 +207,19 @@ JitBlock** JitBaseBlockCache::GetFastBlockMap()
 
 void JitBaseBlockCache::RunOnBlocks(std::function<void(const JitBlock&)> f)
 {
-  for (const auto& e : block_map)
-    f(e.second);
+  block_map.ForEach(f);
 }
 
 JitBlock* JitBaseBlockCache::AllocateBlock(u32 em_address)
 {
   u32 physicalAddress = PowerPC::JitCache_TranslateAddress(em_address).address;
-  JitBlock& b = block_map.emplace(physicalAddress, JitBlock())->second;
+  JitBlock& b = *NewBlock();
   b.effectiveAddress = em_address;
   b.physicalAddress = physicalAddress;
   b.msrBits = MSR.Hex & JIT_CACHE_MSR_MASK;
   b.linkData.clear();
   b.fast_block_map_index = 0;
+  block_map.Insert(&b);
   return &b;
 }
 
@@ -114,25 +230,35 @@ void JitBaseBlockCache::FinalizeBlock(JitBlock& block, bool block_link,
   fast_block_map[index] = &block;
   block.fast_block_map_index = index;
 
-  block.physical_addresses = physical_addresses;
+  block.physical_addresses.assign(physical_addresses.begin(), physical_addresses.end());
 
-  u32 range_mask = ~(BLOCK_RANGE_MAP_ELEMENTS - 1);
-  for (u32 addr : physical_addresses)
+  // The addresses are sorted, so all addresses of one page are adjacent.
+  for (size_t i = 0; i < block.physical_addresses.size(); i++)
   {
+    const u32 addr = block.physical_addresses[i];
+    const u32 prev_addr = i == 0 ? ~addr : block.physical_addresses[i - 1];
     valid_block.Set(addr / 32);
-    block_range_map[addr & range_mask].insert(&block);
+    if ((prev_addr >> CODE_PAGE_SHIFT) != (addr >> CODE_PAGE_SHIFT))
+      block_range_map[addr >> CODE_PAGE_SHIFT].push_back(&block);
   }
 
+  // This can be used as a trace for the JitBlockCache.ReplayTrace benchmark.
+  INFO_LOG(DYNA_REC, "JIT block: %08x, %zu instructions", block.physicalAddress,
+           block.physical_addresses.size());
+
   if (block_link)
   {
     for (const auto& e : block.linkData)
     {
-      links_to.emplace(e.exitAddress, &block);
+      INFO_LOG(DYNA_REC, "JIT link: %08x", e.exitAddress);
+      links_to[e.exitAddress].push_back(&block);
     }
 
     LinkBlock(block);
   }
 
+  Profiler::RegisterCode(block.checkedEntry, block.codeSize, block.effectiveAddress);
+
   Common::Symbol* symbol = nullptr;
   if (JitRegister::IsEnabled() &&
       (symbol = g_symbolDB.GetSymbolFromAddr(block.effectiveAddress)) != nullptr)
@@ -160,12 +286,10 @@ JitBlock* JitBaseBlockCache::GetBlockFromStartAddress(u32 addr, u32 msr)
     translated_addr = translated.address;
   }
 
-  auto iter = block_map.equal_range(translated_addr);
-  for (; iter.first != iter.second; iter.first++)
+  for (JitBlock* b = block_map.Find(translated_addr); b; b = b->next_in_bucket)
   {
-    JitBlock& b = iter.first->second;
-    if (b.effectiveAddress == addr && b.msrBits == (msr & JIT_CACHE_MSR_MASK))
-      return &b;
+    if (b->effectiveAddress == addr && b->msrBits == (msr & JIT_CACHE_MSR_MASK))
+      return b;
   }
 
   return nullptr;
@@ -184,6 +308,26 @@ const u8* JitBaseBlockCache::Dispatch()
   return block->normalEntry;
 }
 
+static void EraseAddressRange(std::unordered_set<u32>& addresses, u32 address, u32 length)
+{
+  // DMA transfers invalidate large ranges, while the sets usually only hold a few addresses.
+  if (addresses.size() < length / 4)
+  {
+    for (auto iter = addresses.begin(); iter != addresses.end();)
+    {
+      if (*iter - address < length)
+        iter = addresses.erase(iter);
+      else
+        ++iter;
+    }
+  }
+  else
+  {
+    for (u32 i = address; i < address + length; i += 4)
+      addresses.erase(i);
+  }
+}
+
 void JitBaseBlockCache::InvalidateICache(u32 address, u32 length, bool forced)
 {
   auto translated = PowerPC::JitCache_TranslateAddress(address);
@@ -191,82 +335,98 @@ void JitBaseBlockCache::InvalidateICache(u32 address, u32 length, bool forced)
     return;
   u32 pAddr = translated.address;
 
+  // If the code was actually modified, we need to clear the relevant entries from the
+  // FIFO write address cache, so we don't end up with FIFO checks in places they shouldn't
+  // be (this can clobber flags, and thus break any optimization that relies on flags
+  // being in the right place between instructions). This has to happen even if no block is
+  // currently compiled there, as the addresses outlive the blocks they were found in.
+  if (!forced)
+  {
+    EraseAddressRange(m_jit.js.fifoWriteAddresses, address, length);
+    EraseAddressRange(m_jit.js.pairedQuantizeAddresses, address, length);
+    EraseAddressRange(m_jit.js.hotBlockAddresses, address, length);
+  }
+
+  INFO_LOG(DYNA_REC, "JIT invalidate: %08x, length %u", pAddr, length);
+  m_invalidation_stats.invalidations++;
+  if (!IsCodeInPhysicalRange(pAddr, length))
+  {
+    m_invalidation_stats.page_hits++;
+    return;
+  }
+
   // Optimize the common case of length == 32 which is used by Interpreter::dcb*
   bool destroy_block = true;
   if (length == 32)
   {
     if (!valid_block.Test(pAddr / 32))
+    {
       destroy_block = false;
+      m_invalidation_stats.cacheline_hits++;
+    }
     else
+    {
       valid_block.Clear(pAddr / 32);
+    }
   }
 
   if (destroy_block)
   {
+    m_invalidation_stats.misses++;
+
     // destroy JIT blocks
     ErasePhysicalRange(pAddr, length);
-
-    // If the code was actually modified, we need to clear the relevant entries from the
-    // FIFO write address cache, so we don't end up with FIFO checks in places they shouldn't
-    // be (this can clobber flags, and thus break any optimization that relies on flags
-    // being in the right place between instructions).
-    if (!forced)
-    {
-      for (u32 i = address; i < address + length; i += 4)
-      {
-        m_jit.js.fifoWriteAddresses.erase(i);
-        m_jit.js.pairedQuantizeAddresses.erase(i);
-      }
-    }
   }
 }
 
 void JitBaseBlockCache::ErasePhysicalRange(u32 address, u32 length)
 {
-  // Iterate over all macro blocks which overlap the given range.
-  u32 range_mask = ~(BLOCK_RANGE_MAP_ELEMENTS - 1);
-  auto start = block_range_map.lower_bound(address & range_mask);
-  auto end = block_range_map.lower_bound(address + length);
-  while (start != end)
-  {
-    // Iterate over all blocks in the macro block.
-    auto iter = start->second.begin();
-    while (iter != start->second.end())
+  if (length == 0)
+    return;
+
+  const u32 first_page = address >> CODE_PAGE_SHIFT;
+  const u64 end_page = ((static_cast<u64>(address) + length - 1) >> CODE_PAGE_SHIFT) + 1;
+
+  erase_blocks.clear();
+  const auto collect_overlapping = [&](const std::vector<JitBlock*>& blocks) {
+    for (JitBlock* block : blocks)
     {
-      JitBlock* block = *iter;
       if (block->OverlapsPhysicalRange(address, length))
-      {
-        // If the block overlaps, also remove all other occupied slots in the other macro blocks.
-        // This will leak empty macro blocks, but they may be reused or cleared later on.
-        for (u32 addr : block->physical_addresses)
-          if ((addr & range_mask) != start->first)
-            block_range_map[addr & range_mask].erase(block);
-
-        // And remove the block.
-        DestroyBlock(*block);
-        auto block_map_iter = block_map.equal_range(block->physicalAddress);
-        while (block_map_iter.first != block_map_iter.second)
-        {
-          if (&block_map_iter.first->second == block)
-          {
-            block_map.erase(block_map_iter.first);
-            break;
-          }
-          block_map_iter.first++;
-        }
-        iter = start->second.erase(iter);
-      }
-      else
-      {
-        iter++;
-      }
+        erase_blocks.push_back(block);
     }
+  };
 
-    // If the macro block is empty, drop it.
-    if (start->second.empty())
-      start = block_range_map.erase(start);
-    else
-      start++;
+  // Collect the blocks of all pages which overlap the given range. For huge ranges, walking the
+  // pages with code is cheaper than probing every possible one.
+  if (end_page - first_page > block_range_map.size())
+  {
+    for (const auto& e : block_range_map)
+    {
+      if (e.first >= first_page && e.first < end_page)
+        collect_overlapping(e.second);
+    }
+  }
+  else
+  {
+    for (u64 page = first_page; page < end_page; page++)
+    {
+      const auto iter = block_range_map.find(static_cast<u32>(page));
+      if (iter != block_range_map.end())
+        collect_overlapping(iter->second);
+    }
+  }
+
+  // Blocks spanning several pages may have been collected more than once.
+  std::sort(erase_blocks.begin(), erase_blocks.end());
+  erase_blocks.erase(std::unique(erase_blocks.begin(), erase_blocks.end()), erase_blocks.end());
+
+  m_invalidation_stats.blocks_destroyed += erase_blocks.size();
+  for (JitBlock* block : erase_blocks)
+  {
+    RemoveFromRangeMap(block);
+    DestroyBlock(*block);
+    block_map.Erase(block);
+    FreeBlock(block);
   }
 }
 
@@ -304,13 +464,14 @@ void JitBaseBlockCache::LinkBlockExits(JitBlock& block)
 void JitBaseBlockCache::LinkBlock(JitBlock& block)
 {
   LinkBlockExits(block);
-  auto ppp = links_to.equal_range(block.effectiveAddress);
+  const auto iter = links_to.find(block.effectiveAddress);
+  if (iter == links_to.end())
+    return;
 
-  for (auto iter = ppp.first; iter != ppp.second; ++iter)
+  for (JitBlock* b2 : iter->second)
   {
-    JitBlock& b2 = *iter->second;
-    if (block.msrBits == b2.msrBits)
-      LinkBlockExits(b2);
+    if (block.msrBits == b2->msrBits)
+      LinkBlockExits(*b2);
   }
 }
 
@@ -323,14 +484,16 @@ void JitBaseBlockCache::UnlinkBlock(const JitBlock& block)
   }
 
   // Unlink all exits of other blocks which points to this block
-  auto ppp = links_to.equal_range(block.effectiveAddress);
-  for (auto iter = ppp.first; iter != ppp.second; ++iter)
+  const auto iter = links_to.find(block.effectiveAddress);
+  if (iter == links_to.end())
+    return;
+
+  for (JitBlock* sourceBlock : iter->second)
   {
-    JitBlock& sourceBlock = *iter->second;
-    if (sourceBlock.msrBits != block.msrBits)
+    if (sourceBlock->msrBits != block.msrBits)
       continue;
 
-    for (auto& e : sourceBlock.linkData)
+    for (auto& e : sourceBlock->linkData)
     {
       if (e.exitAddress == block.effectiveAddress)
       {
@@ -351,14 +514,14 @@ void JitBaseBlockCache::DestroyBlock(JitBlock& block)
   // Delete linking addresses
   for (const auto& e : block.linkData)
   {
-    auto it = links_to.equal_range(e.exitAddress);
-    while (it.first != it.second)
-    {
-      if (it.first->second == &block)
-        it.first = links_to.erase(it.first);
-      else
-        it.first++;
-    }
+    const auto iter = links_to.find(e.exitAddress);
+    if (iter == links_to.end())
+      continue;
+
+    std::vector<JitBlock*>& sources = iter->second;
+    sources.erase(std::remove(sources.begin(), sources.end(), &block), sources.end());
+    if (sources.empty())
+      links_to.erase(iter);
   }
 
   // Raise an signal if we are going to call this block again
@@ -384,6 +547,99 @@ JitBlock* JitBaseBlockCache::MoveBlockIntoFastCache(u32 addr, u32 msr)
   return block;
 }
 
+JitBlock* JitBaseBlockCache::NewBlock()
+{
+  if (free_blocks.empty())
+  {
+    block_slabs.push_back(std::make_unique<JitBlock[]>(BLOCK_SLAB_SIZE));
+    JitBlock* slab = block_slabs.back().get();
+    for (size_t i = BLOCK_SLAB_SIZE; i > 0; i--)
+      free_blocks.push_back(&slab[i - 1]);
+  }
+
+  JitBlock* block = free_blocks.back();
+  free_blocks.pop_back();
+  return block;
+}
+
+void JitBaseBlockCache::FreeBlock(JitBlock* block)
+{
+  if (block->run_counter)
+    FreeRunCounter(block->run_counter);
+
+  // The block has already been unlinked and removed from all maps, so nothing of it may survive
+  // into the block which reuses the slot.
+  *block = JitBlock{};
+  free_blocks.push_back(block);
+}
+
+u32* JitBaseBlockCache::AllocateRunCounter(u32 initial_value)
+{
+  if (free_run_counters.empty())
+  {
+    run_counter_slabs.push_back(std::make_unique<u32[]>(RUN_COUNTER_SLAB_SIZE));
+    u32* slab = run_counter_slabs.back().get();
+    for (size_t i = RUN_COUNTER_SLAB_SIZE; i > 0; i--)
+      free_run_counters.push_back(&slab[i - 1]);
+  }
+
+  u32* counter = free_run_counters.back();
+  free_run_counters.pop_back();
+  *counter = initial_value;
+  return counter;
+}
+
+void JitBaseBlockCache::FreeRunCounter(u32* counter)
+{
+  free_run_counters.push_back(counter);
+}
+
+void JitBaseBlockCache::RemoveFromRangeMap(JitBlock* block)
+{
+  for (size_t i = 0; i < block->physical_addresses.size(); i++)
+  {
+    const u32 addr = block->physical_addresses[i];
+    const u32 prev_addr = i == 0 ? ~addr : block->physical_addresses[i - 1];
+    if ((prev_addr >> CODE_PAGE_SHIFT) == (addr >> CODE_PAGE_SHIFT))
+      continue;
+
+    const auto iter = block_range_map.find(addr >> CODE_PAGE_SHIFT);
+    if (iter == block_range_map.end())
+      continue;
+
+    std::vector<JitBlock*>& blocks = iter->second;
+    const auto block_iter = std::find(blocks.begin(), blocks.end(), block);
+    if (block_iter != blocks.end())
+    {
+      *block_iter = blocks.back();
+      blocks.pop_back();
+    }
+    if (blocks.empty())
+      block_range_map.erase(iter);
+  }
+}
+
+bool JitBaseBlockCache::IsCodeInPhysicalRange(u32 address, u32 length) const
+{
+  if (block_range_map.empty() || length == 0)
+    return false;
+
+  const u32 first_page = address >> CODE_PAGE_SHIFT;
+  const u64 end_page = (static_cast<u64>(address) + length - 1) >> CODE_PAGE_SHIFT;
+
+  // Don't bother checking every page of huge ranges, those are rare.
+  constexpr u32 MAX_PAGES_TO_CHECK = 64;
+  if (end_page - first_page >= MAX_PAGES_TO_CHECK)
+    return true;
+
+  for (u64 page = first_page; page <= end_page; page++)
+  {
+    if (block_range_map.count(static_cast<u32>(page)) != 0)
+      return true;
+  }
+  return false;
+}
+
 size_t JitBaseBlockCache::FastLookupIndexForAddress(u32 address)
 {
   return (address >> 2) & FAST_BLOCK_MAP_MASK;
@@ -8,9 +8,9 @@
 #include <bitset>
 #include <cstring>
 #include <functional>
-#include <map>
 #include <memory>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "Common/CommonTypes.h"
@@ -61,8 +61,8 @@ struct JitBlock
   };
   std::vector<LinkData> linkData;
 
-  // This set stores all physical addresses of all occupied instructions.
-  std::set<u32> physical_addresses;
+  // This sorted array stores all physical addresses of all occupied instructions.
+  std::vector<u32> physical_addresses;
 
   // Block profiling data, structure is inlined in Jit.cpp
   struct ProfileData
@@ -74,9 +74,15 @@ struct JitBlock
     u64 ticStop;
   } profile_data = {};
 
+  // Execution counter for JITs which recompile blocks once they get hot, see AllocateRunCounter.
+  u32* run_counter = nullptr;
+
   // This tracks the position if this block within the fast block cache.
   // We allow each block to have only one map entry.
   size_t fast_block_map_index;
+
+  // The next block with the same physical start address, see JitBlockIndex.
+  JitBlock* next_in_bucket;
 };
 
 typedef void (*CompiledCode)();
@@ -111,6 +117,66 @@ public:
   bool Test(u32 bit) { return (m_valid_block[bit / 32] & (1u << (bit % 32))) != 0; }
 };
 
+// Open-addressed hash table which maps the physical start address of a block to
+// all blocks starting there. Blocks which share a start address (e.g. because
+// they were compiled with different MSR bits) are chained via next_in_bucket.
+class JitBlockIndex final
+{
+public:
+  JitBlockIndex();
+
+  JitBlock* Find(u32 physical_address) const;
+  void Insert(JitBlock* block);
+  void Erase(JitBlock* block);
+  void Clear();
+  size_t Size() const { return m_num_blocks; }
+
+  template <typename F>
+  void ForEach(F f) const
+  {
+    for (const Slot& slot : m_slots)
+    {
+      // f may free the block, which resets its link to the next one.
+      for (JitBlock* block = slot.head; block;)
+      {
+        JitBlock* next = block->next_in_bucket;
+        f(*block);
+        block = next;
+      }
+    }
+  }
+
+private:
+  struct Slot
+  {
+    u32 key;
+    // nullptr marks an empty slot.
+    JitBlock* head;
+  };
+
+  size_t Hash(u32 key) const;
+  size_t SlotFor(u32 key) const;
+  void Grow();
+
+  std::vector<Slot> m_slots;
+  size_t m_used_slots = 0;
+  size_t m_num_blocks = 0;
+  u32 m_shift;
+};
+
+// Counters describing how icache invalidations were handled by the block cache.
+struct JitInvalidationStats
+{
+  u64 invalidations;
+  // Rejected because no compiled code overlaps any page in the range.
+  u64 page_hits;
+  // Rejected because no compiled code overlaps the invalidated cacheline.
+  u64 cacheline_hits;
+  // The block maps had to be searched for overlapping blocks.
+  u64 misses;
+  u64 blocks_destroyed;
+};
+
 class JitBaseBlockCache
 {
 public:
@@ -150,8 +216,15 @@ public:
   void InvalidateICache(u32 address, u32 length, bool forced);
   void ErasePhysicalRange(u32 address, u32 length);
 
+  // Counters have a stable address, so that compiled code can refer to them. A counter which is
+  // stored in JitBlock::run_counter is freed together with the block.
+  u32* AllocateRunCounter(u32 initial_value);
+  void FreeRunCounter(u32* counter);
+
   u32* GetBlockBitSet() const;
 
+  const JitInvalidationStats& GetInvalidationStats() const { return m_invalidation_stats; }
+
 protected:
   JitBase& m_jit;
 
@@ -166,22 +239,42 @@ private:
 
   JitBlock* MoveBlockIntoFastCache(u32 em_address, u32 msr);
 
+  JitBlock* NewBlock();
+  void FreeBlock(JitBlock* block);
+  void RemoveFromRangeMap(JitBlock* block);
+  bool IsCodeInPhysicalRange(u32 address, u32 length) const;
+
   // Fast but risky block lookup based on fast_block_map.
   size_t FastLookupIndexForAddress(u32 address);
 
   // links_to hold all exit points of all valid blocks in a reverse way.
   // It is used to query all blocks which links to an address.
-  std::multimap<u32, JitBlock*> links_to;  // destination_PC -> number
+  std::unordered_map<u32, std::vector<JitBlock*>> links_to;  // destination_PC -> blocks
+
+  // Blocks are allocated in fixed-size slabs so that their addresses stay stable
+  // (they are referenced from emitted code) and freed blocks get reused.
+  static constexpr size_t BLOCK_SLAB_SIZE = 0x1000;
+  std::vector<std::unique_ptr<JitBlock[]>> block_slabs;
+  std::vector<JitBlock*> free_blocks;
 
-  // Map indexed by the physical address of the entry point.
+  static constexpr size_t RUN_COUNTER_SLAB_SIZE = 0x1000;
+  std::vector<std::unique_ptr<u32[]>> run_counter_slabs;
+  std::vector<u32*> free_run_counters;
+
+  // Index of all valid blocks by the physical address of the entry point.
   // This is used to query the block based on the current PC in a slow way.
-  std::multimap<u32, JitBlock> block_map;  // start_addr -> block
+  JitBlockIndex block_map;  // start_addr -> blocks
+
+  // The blocks which have code in each 4 KiB page of the physical address space, indexed by page
+  // number. It is used for invalidation of memory regions, and pages without an entry are rejected
+  // right away.
+  static constexpr u32 CODE_PAGE_SHIFT = 12;
+  std::unordered_map<u32, std::vector<JitBlock*>> block_range_map;  // page -> blocks
+
+  JitInvalidationStats m_invalidation_stats{};
 
-  // Range of overlapping code indexed by a masked physical address.
-  // This is used for invalidation of memory regions. The range is grouped
-  // in macro blocks of each 0x100 bytes.
-  static constexpr u32 BLOCK_RANGE_MAP_ELEMENTS = 0x100;
-  std::map<u32, std::set<JitBlock*>> block_range_map;
+  // Scratch space for ErasePhysicalRange, kept around to avoid allocations.
+  std::vector<JitBlock*> erase_blocks;
 
   // This bitsets shows which cachelines overlap with any blocks.
   // It is used to provide a fast way to query if no icache invalidation is needed.
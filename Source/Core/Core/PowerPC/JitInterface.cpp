@@ -29,6 +29,7 @@
 #include "Core/PowerPC/PPCSymbolDB.h"
 #include "Core/PowerPC/PowerPC.h"
 #include "Core/PowerPC/Profiler.h"
+#include "Core/PowerPC/SamplingProfiler.h"
 
 #if _M_X86
 #include "Core/PowerPC/Jit64/Jit.h"
@@ -144,6 +145,60 @@ void GetProfileResults(Profiler::ProfileStats* prof_stats)
     Core::SetState(Core::State::Running);
 }
 
+void GetInvalidationStats(JitInvalidationStats* stats)
+{
+  if (!g_jit)
+  {
+    *stats = {};
+    return;
+  }
+
+  *stats = g_jit->GetBlockCache()->GetInvalidationStats();
+}
+
+void SetSamplingState(ProfilingState state)
+{
+  if (state != ProfilingState::Enabled)
+  {
+    Profiler::StopSampling();
+    return;
+  }
+
+  if (!g_jit)
+    return;
+
+  // The blocks which already exist are registered, so the CPU thread mustn't be running code.
+  const Core::State old_state = Core::GetState();
+  const bool pause = !Core::IsCPUThread() && old_state == Core::State::Running;
+  if (pause)
+    Core::SetState(Core::State::Paused);
+
+  Profiler::StartSampling(*g_jit->GetBlockCache());
+
+  if (pause)
+    Core::SetState(Core::State::Running);
+}
+
+void WriteSamplingResults(const std::string& prefix)
+{
+  if (!g_jit)
+    return;
+
+  // The block cache may only be looked at while the CPU thread isn't running code.
+  const Core::State old_state = Core::GetState();
+  const bool pause = !Core::IsCPUThread() && old_state == Core::State::Running;
+  if (pause)
+    Core::SetState(Core::State::Paused);
+
+  Profiler::ResolveSamples();
+  Profiler::WriteSampleResults(prefix + ".txt");
+  Profiler::WriteFoldedStacks(prefix + ".folded");
+  Profiler::WritePerfMap(*g_jit->GetBlockCache(), prefix + ".map");
+
+  if (pause)
+    Core::SetState(Core::State::Running);
+}
+
 int GetHostCode(u32* address, const u8** code, u32* code_size)
 {
   if (!g_jit)
@@ -212,13 +267,19 @@ void ClearCache()
 void ClearSafe()
 {
   if (g_jit)
+  {
+    g_jit->InvalidatePendingCompile(0, 0xffffffff);
     g_jit->GetBlockCache()->Clear();
+  }
 }
 
 void InvalidateICache(u32 address, u32 size, bool forced)
 {
   if (g_jit)
+  {
+    g_jit->InvalidatePendingCompile(address, size);
     g_jit->GetBlockCache()->InvalidateICache(address, size, forced);
+  }
 }
 
 void CompileExceptionCheck(ExceptionType type)
@@ -239,6 +300,9 @@ void CompileExceptionCheck(ExceptionType type)
   case ExceptionType::SpeculativeConstants:
     exception_addresses = &g_jit->js.noSpeculativeConstantsAddresses;
     break;
+  case ExceptionType::HotBlock:
+    exception_addresses = &g_jit->js.hotBlockAddresses;
+    break;
   }
 
   if (PC != 0 && (exception_addresses->find(PC)) == (exception_addresses->end()))
@@ -250,6 +314,11 @@ void CompileExceptionCheck(ExceptionType type)
       if (optype != OpType::Store && optype != OpType::StoreFP && optype != OpType::StorePS)
         return;
     }
+
+    // A block compiled in the background may be reading the address sets, and a block at PC
+    // has to be recompiled with the exception check anyway. Looking up addresses concurrently
+    // is fine, but the sets must not change before the compile has finished.
+    g_jit->InvalidatePendingCompile(PC, 4);
     exception_addresses->insert(PC);
 
     // Invalidate the JIT block so that it gets recompiled with the external exception check
@@ -11,6 +11,7 @@
 
 class CPUCoreBase;
 class PointerWrap;
+struct JitInvalidationStats;
 
 namespace PowerPC
 {
@@ -28,7 +29,8 @@ enum class ExceptionType
 {
   FIFOWrite,
   PairedQuantize,
-  SpeculativeConstants
+  SpeculativeConstants,
+  HotBlock
 };
 
 void DoState(PointerWrap& p);
@@ -46,6 +48,11 @@ enum class ProfilingState
 void SetProfilingState(ProfilingState state);
 void WriteProfileResults(const std::string& filename);
 void GetProfileResults(Profiler::ProfileStats* prof_stats);
+void GetInvalidationStats(JitInvalidationStats* stats);
+void SetSamplingState(ProfilingState state);
+// Writes <prefix>.txt with the samples per guest function, <prefix>.folded for flamegraph.pl
+// and <prefix>.map with the host code of all blocks in the format of perf's /tmp/perf-PID.map.
+void WriteSamplingResults(const std::string& prefix);
 int GetHostCode(u32* address, const u8** code, u32* code_size);
 
 // Memory Utilities
@@ -640,18 +640,23 @@ std::string HostGetString(u32 address, size_t size)
 }
 
 bool IsOptimizableRAMAddress(const u32 address)
+{
+  return IsOptimizableRAMAddress(address, dbat_table, MSR.DR);
+}
+
+bool IsOptimizableRAMAddress(const u32 address, const BatTable& bat_table, bool dr)
 {
   if (PowerPC::memchecks.HasAny())
     return false;
 
-  if (!MSR.DR)
+  if (!dr)
     return false;
 
   // TODO: This API needs to take an access size
   //
   // We store whether an access can be optimized to an unchecked access
   // in dbat_table.
-  u32 bat_result = dbat_table[address >> BAT_INDEX_SHIFT];
+  u32 bat_result = bat_table[address >> BAT_INDEX_SHIFT];
   return (bat_result & BAT_PHYSICAL_BIT) != 0;
 }
 
@@ -790,17 +795,22 @@ void ClearCacheLine(u32 address)
 }
 
 u32 IsOptimizableMMIOAccess(u32 address, u32 access_size)
+{
+  return IsOptimizableMMIOAccess(address, access_size, dbat_table, MSR.DR);
+}
+
+u32 IsOptimizableMMIOAccess(u32 address, u32 access_size, const BatTable& bat_table, bool dr)
 {
   if (PowerPC::memchecks.HasAny())
     return 0;
 
-  if (!MSR.DR)
+  if (!dr)
     return 0;
 
   // Translate address
   // If we also optimize for TLB mappings, we'd have to clear the
   // JitCache on each TLB invalidation.
-  if (!TranslateBatAddess(dbat_table, &address))
+  if (!TranslateBatAddess(bat_table, &address))
     return 0;
 
   // Check whether the address is an aligned address of an MMIO register.
@@ -812,17 +822,22 @@ u32 IsOptimizableMMIOAccess(u32 address, u32 access_size)
 }
 
 bool IsOptimizableGatherPipeWrite(u32 address)
+{
+  return IsOptimizableGatherPipeWrite(address, dbat_table, MSR.DR);
+}
+
+bool IsOptimizableGatherPipeWrite(u32 address, const BatTable& bat_table, bool dr)
 {
   if (PowerPC::memchecks.HasAny())
     return false;
 
-  if (!MSR.DR)
+  if (!dr)
     return false;
 
   // Translate address, only check BAT mapping.
   // If we also optimize for TLB mappings, we'd have to clear the
   // JitCache on each TLB invalidation.
-  if (!TranslateBatAddess(dbat_table, &address))
+  if (!TranslateBatAddess(bat_table, &address))
     return false;
 
   // Check whether the translated address equals the address in WPAR.
@@ -118,4 +118,9 @@ inline bool TranslateBatAddess(const BatTable& bat_table, u32* address)
   *address = (bat_result & BAT_RESULT_MASK) | (*address & (BAT_PAGE_SIZE - 1));
   return true;
 }
+
+// The same as above, for a data BAT table and MSR.DR which were captured earlier.
+bool IsOptimizableRAMAddress(u32 address, const BatTable& bat_table, bool dr);
+u32 IsOptimizableMMIOAccess(u32 address, u32 access_size, const BatTable& bat_table, bool dr);
+bool IsOptimizableGatherPipeWrite(u32 address, const BatTable& bat_table, bool dr);
 }  // namespace PowerPC
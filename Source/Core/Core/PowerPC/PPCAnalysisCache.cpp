@@ -0,0 +1,353 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/PowerPC/PPCAnalysisCache.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <tuple>
+
+#include "Common/ChunkFile.h"
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Core/ConfigManager.h"
+#include "Core/PowerPC/MMU.h"
+#include "Core/PowerPC/PPCTables.h"
+
+namespace PPCAnalyst
+{
+namespace
+{
+// Increment this every time the format of the entries or the analysis itself changes.
+constexpr u32 ANALYSIS_CACHE_VERSION = 2;
+
+// Cached blocks are kept in memory so that lookups don't need any disk accesses, but a long
+// session shouldn't be able to grow this without bounds.
+constexpr std::size_t MAX_ENTRIES = 0x8000;
+
+// The file is only appended to, so entries which were evicted or couldn't be used pile up in it.
+// It gets rewritten on open once there are more of those than entries in use, and at least this
+// many.
+constexpr u32 MIN_UNUSED_ENTRIES_TO_COMPACT = 0x1000;
+
+class NullReader final : public LinearDiskCacheReader<AnalysisCacheKey, u8>
+{
+public:
+  void Read(const AnalysisCacheKey& key, const u8* value, u32 value_size) override {}
+};
+
+// The fields are serialized one by one, as the structures contain pointers and padding.
+void DoBlockStats(PointerWrap& p, BlockStats& stats)
+{
+  p.Do(stats.isFirstBlockOfFunction);
+  p.Do(stats.isLastBlockOfFunction);
+  p.Do(stats.numCycles);
+}
+
+void DoBlockRegStats(PointerWrap& p, BlockRegStats& stats)
+{
+  p.DoArray(stats.firstRead);
+  p.DoArray(stats.firstWrite);
+  p.DoArray(stats.lastRead);
+  p.DoArray(stats.lastWrite);
+  p.DoArray(stats.numReads);
+  p.DoArray(stats.numWrites);
+  p.Do(stats.any);
+  p.Do(stats.anyTimer);
+}
+
+// Layout of a cache entry: the version and the number of instructions, followed by the rest
+// of the block and num_instructions CodeOps.
+void DoBlock(PointerWrap& p, u32& version, u32& next_pc, CodeBlock& block)
+{
+  p.Do(version);
+  p.Do(block.m_num_instructions);
+  p.Do(next_pc);
+  p.Do(block.m_gpr_inputs.m_val);
+  p.Do(block.m_gqr_used.m_val);
+  p.Do(block.m_gqr_modified.m_val);
+  p.Do(block.m_broken);
+  DoBlockStats(p, *block.m_stats);
+  DoBlockRegStats(p, *block.m_gpa);
+  DoBlockRegStats(p, *block.m_fpa);
+}
+
+// The opinfo pointer isn't meaningful across sessions; it is restored on lookup.
+void DoCodeOp(PointerWrap& p, CodeOp& op)
+{
+  p.Do(op.inst.hex);
+  p.Do(op.address);
+  p.Do(op.branchTo);
+  p.Do(op.branchToIndex);
+  p.Do(op.regsOut.m_val);
+  p.Do(op.regsIn.m_val);
+  p.Do(op.fregsIn.m_val);
+  p.Do(op.fregOut);
+  p.Do(op.isBranchTarget);
+  p.Do(op.wantsCR0);
+  p.Do(op.wantsCR1);
+  p.Do(op.wantsFPRF);
+  p.Do(op.wantsCA);
+  p.Do(op.wantsCAInFlags);
+  p.Do(op.outputCR0);
+  p.Do(op.outputCR1);
+  p.Do(op.outputFPRF);
+  p.Do(op.outputCA);
+  p.Do(op.canEndBlock);
+  p.Do(op.skipLRStack);
+  p.Do(op.skip);
+  p.Do(op.fprInUse.m_val);
+  p.Do(op.gprInUse.m_val);
+  p.Do(op.gprInReg.m_val);
+  p.Do(op.fprInXmm.m_val);
+  p.Do(op.fprIsSingle.m_val);
+  p.Do(op.fprIsDuplicated.m_val);
+  p.Do(op.fprIsStoreSafe.m_val);
+}
+
+template <typename F>
+std::size_t MeasureSize(F f)
+{
+  u8* ptr = nullptr;
+  PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+  f(p);
+  return reinterpret_cast<std::size_t>(ptr);
+}
+
+std::size_t GetBlockSize()
+{
+  static const std::size_t size = MeasureSize([](PointerWrap& p) {
+    BlockStats stats;
+    BlockRegStats gpa, fpa;
+    CodeBlock block;
+    block.m_stats = &stats;
+    block.m_gpa = &gpa;
+    block.m_fpa = &fpa;
+    u32 version, next_pc;
+    DoBlock(p, version, next_pc, block);
+  });
+  return size;
+}
+
+std::size_t GetCodeOpSize()
+{
+  static const std::size_t size = MeasureSize([](PointerWrap& p) {
+    CodeOp op;
+    DoCodeOp(p, op);
+  });
+  return size;
+}
+
+// 64-bit FNV-1a
+u64 HashCode(const CodeBuffer& buffer, u32 num_instructions)
+{
+  u64 hash = 0xcbf29ce484222325;
+  for (u32 i = 0; i < num_instructions; i++)
+  {
+    for (u32 shift = 0; shift < 32; shift += 8)
+    {
+      hash ^= (buffer[i].inst.hex >> shift) & 0xff;
+      hash *= 0x100000001b3;
+    }
+  }
+  return hash;
+}
+
+AnalysisCacheKey MakeKey(u32 address, u32 options, std::size_t block_size, u64 code_hash)
+{
+  return {address, options, static_cast<u32>(block_size),
+          SConfig::GetInstance().bJITFollowBranch ? 1u : 0u, code_hash};
+}
+
+bool HasSameBlock(const AnalysisCacheKey& a, const AnalysisCacheKey& b)
+{
+  return std::tie(a.address, a.options, a.block_size, a.follow_branch) ==
+         std::tie(b.address, b.options, b.block_size, b.follow_branch);
+}
+
+// Fills in the block and buffer from an entry. Fails if any of the instructions that the entry
+// was created from is different now.
+bool LoadEntry(std::vector<u8>& data, CodeBlock* block, CodeBuffer* buffer, u32* next_pc)
+{
+  u8* ptr = data.data();
+  PointerWrap p(&ptr, PointerWrap::MODE_READ);
+  u32 version;
+  DoBlock(p, version, *next_pc, *block);
+
+  CodeOp* const code = buffer->data();
+  block->m_physical_addresses.clear();
+  for (u32 i = 0; i < block->m_num_instructions; i++)
+  {
+    DoCodeOp(p, code[i]);
+    const auto result = PowerPC::TryReadInstruction(code[i].address);
+    if (!result.valid || result.hex != code[i].inst.hex)
+      return false;
+    code[i].opinfo = PPCTables::GetOpInfo(code[i].inst);
+    block->m_physical_addresses.insert(result.physical_address);
+  }
+  return true;
+}
+}  // Anonymous namespace
+
+bool AnalysisCacheKey::operator<(const AnalysisCacheKey& other) const
+{
+  return std::tie(address, options, block_size, follow_branch, code_hash) <
+         std::tie(other.address, other.options, other.block_size, other.follow_branch,
+                  other.code_hash);
+}
+
+void AnalysisCache::Open(const std::string& filename)
+{
+  m_entries.clear();
+  m_hits = 0;
+  m_misses = 0;
+  m_filename = filename;
+  m_file_entries = m_disk_cache.OpenAndRead(filename, *this);
+  m_is_open = true;
+  INFO_LOG(DYNA_REC, "Loaded %zu PPC analysis cache entries from %s (%u in the file)",
+           m_entries.size(), filename.c_str(), m_file_entries);
+
+  const u32 unused_entries = m_file_entries - static_cast<u32>(m_entries.size());
+  if (unused_entries >= MIN_UNUSED_ENTRIES_TO_COMPACT && unused_entries > m_entries.size())
+    Compact();
+}
+
+void AnalysisCache::Compact()
+{
+  m_disk_cache.Close();
+
+  const std::string temp_filename = m_filename + ".tmp";
+  File::Delete(temp_filename);
+  NullReader null_reader;
+  {
+    LinearDiskCache<AnalysisCacheKey, u8> temp_cache;
+    temp_cache.OpenAndRead(temp_filename, null_reader);
+    for (const auto& entry : m_entries)
+    {
+      temp_cache.Append(entry.first, entry.second.data.data(),
+                        static_cast<u32>(entry.second.data.size()));
+    }
+    temp_cache.Close();
+  }
+
+  if (!File::Rename(temp_filename, m_filename))
+    ERROR_LOG(DYNA_REC, "Failed to rewrite the PPC analysis cache %s", m_filename.c_str());
+  m_file_entries = m_disk_cache.OpenAndRead(m_filename, null_reader);
+  INFO_LOG(DYNA_REC, "Rewrote %s with %u entries", m_filename.c_str(), m_file_entries);
+}
+
+void AnalysisCache::Close()
+{
+  if (!m_is_open)
+    return;
+
+  INFO_LOG(DYNA_REC, "PPC analysis cache: %" PRIu64 " hits, %" PRIu64 " misses", m_hits,
+           m_misses);
+  m_disk_cache.Sync();
+  m_disk_cache.Close();
+  m_entries.clear();
+  m_is_open = false;
+}
+
+void AnalysisCache::Read(const AnalysisCacheKey& key, const u8* value, u32 value_size)
+{
+  // The version and the number of instructions are the first two fields.
+  if (value_size < GetBlockSize())
+    return;
+
+  u32 version, num_instructions;
+  std::memcpy(&version, value, sizeof(version));
+  std::memcpy(&num_instructions, value + sizeof(version), sizeof(num_instructions));
+  if (version != ANALYSIS_CACHE_VERSION || num_instructions > key.block_size ||
+      value_size != GetBlockSize() + num_instructions * GetCodeOpSize())
+  {
+    return;
+  }
+
+  Insert(key).assign(value, value + value_size);
+}
+
+std::vector<u8>& AnalysisCache::Insert(const AnalysisCacheKey& key)
+{
+  if (m_entries.size() >= MAX_ENTRIES && m_entries.find(key) == m_entries.end())
+    EvictEntries();
+
+  Entry& entry = m_entries[key];
+  entry.last_use = ++m_use_counter;
+  return entry.data;
+}
+
+void AnalysisCache::EvictEntries()
+{
+  // Throw away the least recently used quarter at once, so that this doesn't happen on every
+  // insertion once the cache is full.
+  std::vector<std::map<AnalysisCacheKey, Entry>::iterator> entries;
+  entries.reserve(m_entries.size());
+  for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+    entries.push_back(iter);
+
+  const auto evicted_end = entries.begin() + entries.size() / 4;
+  std::nth_element(entries.begin(), evicted_end, entries.end(), [](const auto& a, const auto& b) {
+    return a->second.last_use < b->second.last_use;
+  });
+  for (auto iter = entries.begin(); iter != evicted_end; ++iter)
+    m_entries.erase(*iter);
+}
+
+bool AnalysisCache::Lookup(u32 address, u32 options, std::size_t block_size, CodeBlock* block,
+                           CodeBuffer* buffer, u32* next_pc)
+{
+  // Code at the same address can have several entries, which are adjacent in the map.
+  const AnalysisCacheKey first_key = MakeKey(address, options, block_size, 0);
+  for (auto iter = m_entries.lower_bound(first_key);
+       iter != m_entries.end() && HasSameBlock(iter->first, first_key); ++iter)
+  {
+    if (!LoadEntry(iter->second.data, block, buffer, next_pc))
+      continue;
+
+    block->m_address = address;
+    block->m_memory_exception = false;
+    iter->second.last_use = ++m_use_counter;
+
+    m_hits++;
+    return true;
+  }
+
+  m_misses++;
+  return false;
+}
+
+void AnalysisCache::Store(u32 address, u32 options, std::size_t block_size,
+                          const CodeBlock& block, const CodeBuffer& buffer, u32 next_pc)
+{
+  // Blocks which couldn't be read at all don't have anything worth caching.
+  if (block.m_memory_exception)
+    return;
+
+  // PointerWrap takes non-const references, even when writing.
+  CodeBlock& source_block = const_cast<CodeBlock&>(block);
+  CodeBuffer& source_buffer = const_cast<CodeBuffer&>(buffer);
+  u32 version = ANALYSIS_CACHE_VERSION;
+
+  const AnalysisCacheKey key =
+      MakeKey(address, options, block_size, HashCode(buffer, block.m_num_instructions));
+  // Entries with the same key have the same contents, so they only need to be written once.
+  const bool is_new = m_entries.find(key) == m_entries.end();
+  std::vector<u8>& value = Insert(key);
+  value.resize(GetBlockSize() + block.m_num_instructions * GetCodeOpSize());
+  u8* ptr = value.data();
+  PointerWrap p(&ptr, PointerWrap::MODE_WRITE);
+  DoBlock(p, version, next_pc, source_block);
+  for (u32 i = 0; i < block.m_num_instructions; i++)
+    DoCodeOp(p, source_buffer[i]);
+
+  if (is_new)
+  {
+    m_disk_cache.Append(key, value.data(), static_cast<u32>(value.size()));
+    m_file_entries++;
+  }
+}
+}  // namespace PPCAnalyst
@@ -0,0 +1,81 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/LinearDiskCache.h"
+#include "Core/PowerPC/PPCAnalyst.h"
+
+namespace PPCAnalyst
+{
+struct AnalysisCacheKey
+{
+  u32 address;
+  u32 options;
+  u32 block_size;
+  u32 follow_branch;
+  // Hash of the instruction words which were read by the analysis, in the order of the CodeOps
+  u64 code_hash;
+
+  bool operator<(const AnalysisCacheKey& other) const;
+};
+
+// Keeps the results of PPCAnalyzer::Analyze around across sessions, so that blocks which were
+// analyzed before don't need to be analyzed again when they are compiled.
+//
+// The results of the analysis only depend on the analyzer options and on the instructions that
+// were read, so entries are keyed by a hash of those instructions. Different code at the same
+// address (e.g. from overlays) gets separate entries, and a lookup picks the entry whose
+// instructions all match the ones in memory. Only the most recently used entries are kept in
+// memory, and the file is rewritten when it contains too many entries that aren't.
+class AnalysisCache final : private LinearDiskCacheReader<AnalysisCacheKey, u8>
+{
+public:
+  void Open(const std::string& filename);
+  void Close();
+  bool IsOpen() const { return m_is_open; }
+
+  // On success, fills in the block and buffer as if Analyze had been called and returns true.
+  // On failure, the contents of the block and buffer are unspecified.
+  bool Lookup(u32 address, u32 options, std::size_t block_size, CodeBlock* block,
+              CodeBuffer* buffer, u32* next_pc);
+  void Store(u32 address, u32 options, std::size_t block_size, const CodeBlock& block,
+             const CodeBuffer& buffer, u32 next_pc);
+
+  u64 GetHits() const { return m_hits; }
+  u64 GetMisses() const { return m_misses; }
+  // The number of entries in the file, including ones which are no longer used
+  u32 GetFileEntries() const { return m_file_entries; }
+
+private:
+  struct Entry
+  {
+    std::vector<u8> data;
+    u64 last_use;
+  };
+
+  void Read(const AnalysisCacheKey& key, const u8* value, u32 value_size) override;
+
+  // Returns the data of the entry for the key, which is created if necessary.
+  std::vector<u8>& Insert(const AnalysisCacheKey& key);
+  void EvictEntries();
+  // Rewrites the file with only the entries that are kept in memory.
+  void Compact();
+
+  std::map<AnalysisCacheKey, Entry> m_entries;
+  u64 m_use_counter = 0;
+  LinearDiskCache<AnalysisCacheKey, u8> m_disk_cache;
+  std::string m_filename;
+  u32 m_file_entries = 0;
+  bool m_is_open = false;
+  u64 m_hits = 0;
+  u64 m_misses = 0;
+};
+}  // namespace PPCAnalyst
@@ -39,6 +39,8 @@ namespace PPCAnalyst
 {
 // 0 does not perform block merging
 constexpr u32 BRANCH_FOLLOWING_THRESHOLD = 2;
+// Used with OPTION_AGGRESSIVE_BRANCH_FOLLOW
+constexpr u32 HOT_BRANCH_FOLLOWING_THRESHOLD = 8;
 
 constexpr u32 INVALID_BRANCH_TARGET = 0xFFFFFFFF;
 
@@ -673,6 +675,9 @@ u32 PPCAnalyzer::Analyze(u32 address, CodeBlock* block, CodeBuffer* buffer, std:
   u32 num_inst = 0;
 
   const bool enable_follow = SConfig::GetInstance().bJITFollowBranch;
+  const u32 follow_threshold = HasOption(OPTION_AGGRESSIVE_BRANCH_FOLLOW) ?
+                                   HOT_BRANCH_FOLLOWING_THRESHOLD :
+                                   BRANCH_FOLLOWING_THRESHOLD;
 
   for (std::size_t i = 0; i < block_size; ++i)
   {
@@ -709,7 +714,7 @@ u32 PPCAnalyzer::Analyze(u32 address, CodeBlock* block, CodeBuffer* buffer, std:
     //       If it is small, the performance will be down.
     //       If it is big, the size of generated code will be big and
     //       cache clearning will happen many times.
-    if (enable_follow && HasOption(OPTION_BRANCH_FOLLOW) && numFollows < BRANCH_FOLLOWING_THRESHOLD)
+    if (enable_follow && HasOption(OPTION_BRANCH_FOLLOW) && numFollows < follow_threshold)
     {
       if (inst.OPCD == 18 && block_size > 1)
       {
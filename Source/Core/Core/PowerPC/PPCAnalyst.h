@@ -194,12 +194,17 @@ public:
 
     // Reorder cror instructions next to their associated fcmp.
     OPTION_CROR_MERGE = (1 << 6),
+
+    // Follow more branches than usual when OPTION_BRANCH_FOLLOW is set.
+    // Meant for blocks which are known to be hot, where the larger code is worth it.
+    OPTION_AGGRESSIVE_BRANCH_FOLLOW = (1 << 7),
   };
 
   // Option setting/getting
   void SetOption(AnalystOption option) { m_options |= option; }
   void ClearOption(AnalystOption option) { m_options &= ~(option); }
   bool HasOption(AnalystOption option) const { return !!(m_options & option); }
+  u32 GetOptions() const { return m_options; }
   u32 Analyze(u32 address, CodeBlock* block, CodeBuffer* buffer, std::size_t block_size);
 
 private:
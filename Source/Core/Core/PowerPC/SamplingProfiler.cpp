@@ -0,0 +1,388 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/PowerPC/SamplingProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/Logging/Log.h"
+#include "Common/MsgHandler.h"
+#include "Core/MachineContext.h"
+#include "Core/PowerPC/JitCommon/JitCache.h"
+#include "Core/PowerPC/PPCSymbolDB.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Older glibc versions only have the internal name of this field.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+namespace Profiler
+{
+// Enough for a bit over 17 minutes at the default rate. The buffer is drained whenever results
+// are written; samples which don't fit are dropped.
+constexpr u32 SAMPLE_BUFFER_SIZE = 1 << 20;
+
+// Guest address of the block a sample hit, or OTHER_SAMPLE if it didn't hit any JIT block.
+constexpr u32 OTHER_SAMPLE = 0xFFFFFFFF;
+
+// Written by the signal handler on the sampled thread, read by ResolveSamples.
+static std::unique_ptr<u32[]> s_samples;
+static std::atomic<u32> s_samples_head{0};
+static std::atomic<u32> s_samples_tail{0};
+static std::atomic<u64> s_dropped_samples{0};
+static std::atomic<bool> s_sampling{false};
+
+// Samples which have been attributed already.
+static std::mutex s_results_mutex;
+static std::map<u32, u64> s_block_samples;
+static u64 s_other_samples = 0;
+
+// Host code ranges of all blocks compiled since sampling was started or the code space was last
+// cleared. The code space is filled linearly, so appending keeps them sorted by address, and
+// invalidated blocks stay in there as their code isn't overwritten before the next clear. Only
+// the CPU thread appends, and the signal handler runs on the CPU thread too, so the handler never
+// sees a partial update.
+constexpr u32 CODE_RANGE_BUFFER_SIZE = 1 << 18;
+
+struct CodeRange
+{
+  uintptr_t start;
+  u32 size;
+  u32 address;
+};
+
+static std::unique_ptr<CodeRange[]> s_code_ranges;
+static std::atomic<u32> s_num_code_ranges{0};
+
+void RegisterCode(const void* start, u32 size, u32 address)
+{
+  if (!s_sampling.load(std::memory_order_relaxed))
+    return;
+
+  const u32 count = s_num_code_ranges.load(std::memory_order_relaxed);
+  const uintptr_t start_address = reinterpret_cast<uintptr_t>(start);
+  const CodeRange* const last = count != 0 ? &s_code_ranges[count - 1] : nullptr;
+  // Code which doesn't fit or isn't in order is counted as "other".
+  if (count == CODE_RANGE_BUFFER_SIZE || (last && start_address < last->start + last->size))
+    return;
+
+  s_code_ranges[count] = {start_address, size, address};
+  s_num_code_ranges.store(count + 1, std::memory_order_release);
+}
+
+void ClearCode()
+{
+  s_num_code_ranges.store(0, std::memory_order_release);
+}
+
+// Replaces the code ranges with the ones of the blocks which are currently in the block cache.
+static void RegisterBlocks(JitBaseBlockCache& block_cache)
+{
+  if (!s_code_ranges)
+    s_code_ranges = std::make_unique<CodeRange[]>(CODE_RANGE_BUFFER_SIZE);
+
+  std::vector<CodeRange> ranges;
+  block_cache.RunOnBlocks([&ranges](const JitBlock& block) {
+    ranges.push_back(
+        {reinterpret_cast<uintptr_t>(block.checkedEntry), block.codeSize, block.effectiveAddress});
+  });
+  std::sort(ranges.begin(), ranges.end(),
+            [](const CodeRange& a, const CodeRange& b) { return a.start < b.start; });
+
+  const u32 count = static_cast<u32>(std::min<std::size_t>(ranges.size(), CODE_RANGE_BUFFER_SIZE));
+  std::copy_n(ranges.begin(), count, s_code_ranges.get());
+  s_num_code_ranges.store(count, std::memory_order_release);
+}
+
+static u32 FindCode(uintptr_t pc)
+{
+  const u32 count = s_num_code_ranges.load(std::memory_order_acquire);
+  const CodeRange* const begin = s_code_ranges.get();
+  const CodeRange* const end = begin + count;
+  const CodeRange* iter = std::upper_bound(
+      begin, end, pc, [](uintptr_t value, const CodeRange& r) { return value < r.start; });
+  if (iter == begin)
+    return OTHER_SAMPLE;
+  --iter;
+  return pc - iter->start < iter->size ? iter->address : OTHER_SAMPLE;
+}
+
+static void ResetResults()
+{
+  std::lock_guard<std::mutex> lk(s_results_mutex);
+  s_samples_tail.store(s_samples_head.load());
+  s_dropped_samples = 0;
+  s_block_samples.clear();
+  s_other_samples = 0;
+}
+
+#if defined(__linux__)
+static bool s_thread_registered = false;
+static pthread_t s_thread;
+static pid_t s_thread_id;
+static timer_t s_timer;
+static struct sigaction s_old_sigaction;
+
+static void SampleHandler(int sig, siginfo_t* info, void* raw_context)
+{
+  if (!s_sampling.load(std::memory_order_relaxed))
+    return;
+
+  const u32 head = s_samples_head.load(std::memory_order_relaxed);
+  if (head - s_samples_tail.load(std::memory_order_acquire) >= SAMPLE_BUFFER_SIZE)
+  {
+    s_dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // The block is looked up right away, since it may be invalidated before the samples are
+  // resolved.
+  SContext* ctx = &static_cast<ucontext_t*>(raw_context)->uc_mcontext;
+#if _M_X86_64
+  s_samples[head % SAMPLE_BUFFER_SIZE] = FindCode(static_cast<uintptr_t>(ctx->CTX_RIP));
+#elif _M_ARM_64
+  s_samples[head % SAMPLE_BUFFER_SIZE] = FindCode(static_cast<uintptr_t>(ctx->CTX_PC));
+#else
+  s_samples[head % SAMPLE_BUFFER_SIZE] = OTHER_SAMPLE;
+#endif
+  s_samples_head.store(head + 1, std::memory_order_release);
+}
+
+void RegisterSampledThread()
+{
+  s_thread = pthread_self();
+  s_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+  s_thread_registered = true;
+}
+
+void UnregisterSampledThread()
+{
+  StopSampling();
+  s_thread_registered = false;
+}
+
+bool StartSampling(JitBaseBlockCache& block_cache, u32 frequency)
+{
+  if (IsSampling() || !s_thread_registered || frequency == 0)
+    return false;
+
+  // Measure the CPU time of the sampled thread, so no samples are taken while it is idle.
+  clockid_t clock;
+  if (pthread_getcpuclockid(s_thread, &clock) != 0)
+    return false;
+
+  struct sigaction sa = {};
+  sa.sa_sigaction = &SampleHandler;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, &s_old_sigaction) != 0)
+  {
+    ERROR_LOG(POWERPC, "Sampling profiler: failed to install the SIGPROF handler");
+    return false;
+  }
+
+  struct sigevent event = {};
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPROF;
+  event.sigev_notify_thread_id = s_thread_id;
+  if (timer_create(clock, &event, &s_timer) != 0)
+  {
+    ERROR_LOG(POWERPC, "Sampling profiler: failed to create the timer");
+    sigaction(SIGPROF, &s_old_sigaction, nullptr);
+    return false;
+  }
+
+  if (!s_samples)
+    s_samples = std::make_unique<u32[]>(SAMPLE_BUFFER_SIZE);
+  ResetResults();
+  RegisterBlocks(block_cache);
+  s_sampling = true;
+
+  const u64 period_ns = 1000000000 / frequency;
+  struct itimerspec spec = {};
+  spec.it_interval.tv_sec = static_cast<time_t>(period_ns / 1000000000);
+  spec.it_interval.tv_nsec = static_cast<long>(period_ns % 1000000000);
+  spec.it_value = spec.it_interval;
+  timer_settime(s_timer, 0, &spec, nullptr);
+
+  INFO_LOG(POWERPC, "Sampling profiler started at %u Hz", frequency);
+  return true;
+}
+
+void StopSampling()
+{
+  if (!IsSampling())
+    return;
+
+  s_sampling = false;
+  timer_delete(s_timer);
+
+  // A signal from the timer may still be pending, and SIGPROF terminates the process by default.
+  // Ignoring the signal discards it before the previous handler is restored.
+  struct sigaction ignore = {};
+  ignore.sa_handler = SIG_IGN;
+  sigemptyset(&ignore.sa_mask);
+  sigaction(SIGPROF, &ignore, nullptr);
+  sigaction(SIGPROF, &s_old_sigaction, nullptr);
+  INFO_LOG(POWERPC, "Sampling profiler stopped");
+}
+#else
+void RegisterSampledThread()
+{
+}
+
+void UnregisterSampledThread()
+{
+}
+
+bool StartSampling(JitBaseBlockCache& block_cache, u32 frequency)
+{
+  WARN_LOG(POWERPC, "The sampling profiler is not supported on this platform");
+  return false;
+}
+
+void StopSampling()
+{
+}
+#endif
+
+bool IsSampling()
+{
+  return s_sampling;
+}
+
+void ResolveSamples()
+{
+  const u32 head = s_samples_head.load(std::memory_order_acquire);
+  u32 tail = s_samples_tail.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lk(s_results_mutex);
+  for (; tail != head; tail++)
+  {
+    const u32 address = s_samples[tail % SAMPLE_BUFFER_SIZE];
+    if (address != OTHER_SAMPLE)
+      s_block_samples[address]++;
+    else
+      s_other_samples++;
+  }
+  s_samples_tail.store(tail, std::memory_order_release);
+}
+
+static std::string GetFunctionName(u32 address, u32* function_address)
+{
+  const Common::Symbol* symbol = g_symbolDB.GetSymbolFromAddr(address);
+  if (!symbol)
+  {
+    *function_address = address;
+    return "[unknown]";
+  }
+  *function_address = symbol->address;
+  return symbol->name;
+}
+
+void GetSampleStats(SampleStats* stats)
+{
+  std::lock_guard<std::mutex> lk(s_results_mutex);
+
+  std::map<u32, FunctionSamples> functions;
+  stats->total_samples = s_other_samples;
+  for (const auto& entry : s_block_samples)
+  {
+    u32 function_address;
+    std::string name = GetFunctionName(entry.first, &function_address);
+    auto iter = functions.emplace(function_address,
+                                  FunctionSamples{std::move(name), function_address, 0});
+    iter.first->second.samples += entry.second;
+    stats->total_samples += entry.second;
+  }
+
+  stats->functions.clear();
+  for (auto& entry : functions)
+    stats->functions.push_back(std::move(entry.second));
+  std::sort(stats->functions.begin(), stats->functions.end(),
+            [](const FunctionSamples& a, const FunctionSamples& b) { return a.samples > b.samples; });
+
+  stats->other_samples = s_other_samples;
+  stats->dropped_samples = s_dropped_samples;
+}
+
+void WriteFoldedStacks(const std::string& filename)
+{
+  File::IOFile f(filename, "w");
+  if (!f)
+  {
+    PanicAlert("Failed to open %s", filename.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(s_results_mutex);
+  for (const auto& entry : s_block_samples)
+  {
+    u32 function_address;
+    const std::string name = GetFunctionName(entry.first, &function_address);
+    fprintf(f.GetHandle(), "%s;%08x %" PRIu64 "\n", name.c_str(), entry.first, entry.second);
+  }
+  if (s_other_samples)
+    fprintf(f.GetHandle(), "[other] %" PRIu64 "\n", s_other_samples);
+}
+
+void WriteSampleResults(const std::string& filename)
+{
+  SampleStats stats;
+  GetSampleStats(&stats);
+
+  File::IOFile f(filename, "w");
+  if (!f)
+  {
+    PanicAlert("Failed to open %s", filename.c_str());
+    return;
+  }
+
+  fprintf(f.GetHandle(), "samples\tpercent\taddress\tfunction\n");
+  const double total = stats.total_samples ? static_cast<double>(stats.total_samples) : 1.0;
+  for (const FunctionSamples& function : stats.functions)
+  {
+    fprintf(f.GetHandle(), "%" PRIu64 "\t%.2f\t%08x\t%s\n", function.samples,
+            100.0 * function.samples / total, function.address, function.name.c_str());
+  }
+  fprintf(f.GetHandle(), "%" PRIu64 "\t%.2f\t\t[other]\n", stats.other_samples,
+          100.0 * stats.other_samples / total);
+  fprintf(f.GetHandle(), "# %" PRIu64 " samples, %" PRIu64 " dropped\n", stats.total_samples,
+          stats.dropped_samples);
+}
+
+void WritePerfMap(JitBaseBlockCache& block_cache, const std::string& filename)
+{
+  File::IOFile f(filename, "w");
+  if (!f)
+  {
+    PanicAlert("Failed to open %s", filename.c_str());
+    return;
+  }
+
+  block_cache.RunOnBlocks([&f](const JitBlock& block) {
+    u32 function_address;
+    const std::string name = GetFunctionName(block.effectiveAddress, &function_address);
+    fprintf(f.GetHandle(), "%" PRIxPTR " %x JIT_PPC_%s_%08x\n",
+            reinterpret_cast<uintptr_t>(block.checkedEntry), block.codeSize, name.c_str(),
+            block.effectiveAddress);
+  });
+}
+}  // namespace Profiler
@@ -0,0 +1,65 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+class JitBaseBlockCache;
+
+// A statistical profiler for JIT code. While it is running, a timer interrupts the CPU thread
+// at a fixed rate of its CPU time and records the JIT block at the host program counter. The
+// samples are mapped to guest functions later, so taking a sample is only a binary search and a
+// few stores. Nothing happens while it is stopped.
+//
+// Only implemented on Linux. Samples which don't hit a JIT block (emulator code, the dispatcher
+// or far code) are counted as "other".
+namespace Profiler
+{
+struct FunctionSamples
+{
+  std::string name;
+  u32 address;
+  u64 samples;
+};
+
+struct SampleStats
+{
+  // Sorted by sample count, highest first.
+  std::vector<FunctionSamples> functions;
+  u64 total_samples;
+  u64 other_samples;
+  u64 dropped_samples;
+};
+
+// Must be called on the thread to be profiled (the CPU thread) before sampling is started.
+void RegisterSampledThread();
+void UnregisterSampledThread();
+
+// The blocks which are in the block cache at this point are registered, see RegisterCode. Has to
+// be called on the CPU thread or while it is paused.
+bool StartSampling(JitBaseBlockCache& block_cache, u32 frequency = 1000);
+void StopSampling();
+bool IsSampling();
+
+// Records the host code of a block, so that samples can be attributed to it even after the block
+// has been invalidated. Does nothing while sampling is stopped. Has to be called on the CPU thread
+// or while it is paused.
+void RegisterCode(const void* start, u32 size, u32 address);
+// Forgets all code, for when the code space is cleared.
+void ClearCode();
+
+// Moves the pending samples into the results.
+void ResolveSamples();
+
+void GetSampleStats(SampleStats* stats);
+// One line per guest function and block, in the folded stack format used by flamegraph.pl.
+void WriteFoldedStacks(const std::string& filename);
+void WriteSampleResults(const std::string& filename);
+// Writes the host code ranges of all live blocks in the format perf expects in /tmp/perf-PID.map.
+void WritePerfMap(JitBaseBlockCache& block_cache, const std::string& filename);
+}  // namespace Profiler
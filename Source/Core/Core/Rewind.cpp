@@ -0,0 +1,350 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/Rewind.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/Thread.h"
+#include "Common/ThreadPool.h"
+#include "Common/Timer.h"
+#include "Core/Config/MainSettings.h"
+#include "Core/Core.h"
+#include "Core/NetPlayClient.h"
+#include "Core/State.h"
+#include "Core/StateCompression.h"
+
+namespace Rewind
+{
+// out = a ^ b, with the smaller of the two padded with zeroes. out may be a or b.
+static void XorStates(const std::vector<u8>& a, const std::vector<u8>& b, std::vector<u8>* out,
+                      Common::ThreadPool* thread_pool)
+{
+  constexpr size_t CHUNK_SIZE = 0x100000;
+  const std::vector<u8>& larger = a.size() >= b.size() ? a : b;
+  const size_t common_size = std::min(a.size(), b.size());
+  if (&larger != out)
+  {
+    out->resize(larger.size());
+    std::copy(larger.begin() + common_size, larger.end(), out->begin() + common_size);
+  }
+
+  thread_pool->ParallelFor((common_size + CHUNK_SIZE - 1) / CHUNK_SIZE, [&](size_t chunk) {
+    size_t i = chunk * CHUNK_SIZE;
+    const size_t end = std::min(common_size, i + CHUNK_SIZE);
+    for (; i + sizeof(u64) <= end; i += sizeof(u64))
+    {
+      u64 x, y;
+      std::memcpy(&x, a.data() + i, sizeof(u64));
+      std::memcpy(&y, b.data() + i, sizeof(u64));
+      x ^= y;
+      std::memcpy(out->data() + i, &x, sizeof(u64));
+    }
+    for (; i < end; i++)
+      (*out)[i] = a[i] ^ b[i];
+  });
+}
+
+RewindBuffer::RewindBuffer(size_t memory_budget, Common::ThreadPool* thread_pool)
+    : m_memory_budget(memory_budget), m_thread_pool(thread_pool)
+{
+  m_thread = std::thread([this] { ThreadLoop(); });
+}
+
+RewindBuffer::~RewindBuffer()
+{
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_exit = true;
+  }
+  m_cvar.notify_all();
+  m_thread.join();
+}
+
+bool RewindBuffer::Push(std::vector<u8> state)
+{
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    if (m_has_pending_state)
+    {
+      if (m_spare_buffer.empty())
+        m_spare_buffer = std::move(state);
+      return false;
+    }
+
+    m_pending_state = std::move(state);
+    m_has_pending_state = true;
+  }
+  m_cvar.notify_all();
+  return true;
+}
+
+bool RewindBuffer::Pop(std::vector<u8>* state)
+{
+  Flush();
+
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (m_newest_state.empty())
+    return false;
+
+  *state = std::move(m_newest_state);
+  m_newest_state.clear();
+  if (m_older_states.empty())
+    return true;
+
+  // Undo the XOR that the older state is stored as
+  const OlderState& older = m_older_states.back();
+  std::vector<u8> older_state = std::move(m_spare_buffer);
+  m_spare_buffer.clear();
+  if (State::DecompressState(older.compressed_xor.data(), older.compressed_xor.size(),
+                             &older_state, m_thread_pool) &&
+      older_state.size() == std::max(older.size, state->size()))
+  {
+    XorStates(older_state, *state, &older_state, m_thread_pool);
+    older_state.resize(older.size);
+    m_newest_state = std::move(older_state);
+    m_older_states_size -= older.compressed_xor.size();
+    m_older_states.pop_back();
+  }
+  else
+  {
+    // Every older state depends on this one
+    m_older_states.clear();
+    m_older_states_size = 0;
+  }
+
+  return true;
+}
+
+void RewindBuffer::Flush()
+{
+  std::unique_lock<std::mutex> lk(m_lock);
+  m_cvar.wait(lk, [this] { return !m_has_pending_state; });
+}
+
+std::vector<u8> RewindBuffer::TakeSpareBuffer()
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  std::vector<u8> buffer = std::move(m_spare_buffer);
+  m_spare_buffer.clear();
+  return buffer;
+}
+
+void RewindBuffer::RecycleBuffer(std::vector<u8> buffer)
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (m_spare_buffer.empty())
+    m_spare_buffer = std::move(buffer);
+}
+
+size_t RewindBuffer::GetNumStates() const
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_older_states.size() + (m_newest_state.empty() ? 0 : 1);
+}
+
+size_t RewindBuffer::GetMemoryUsage() const
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_older_states_size + m_newest_state.size();
+}
+
+u64 RewindBuffer::GetAverageStoreTime() const
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  return m_num_stores ? m_total_store_time / m_num_stores : 0;
+}
+
+void RewindBuffer::ThreadLoop()
+{
+  Common::SetCurrentThreadName("Rewind thread");
+
+  std::unique_lock<std::mutex> lk(m_lock);
+  while (true)
+  {
+    m_cvar.wait(lk, [this] { return m_has_pending_state || m_exit; });
+    if (m_exit)
+      return;
+
+    std::vector<u8> state = std::move(m_pending_state);
+    m_pending_state.clear();
+    lk.unlock();
+    Store(std::move(state));
+    lk.lock();
+
+    m_has_pending_state = false;
+    m_cvar.notify_all();
+  }
+}
+
+void RewindBuffer::Store(std::vector<u8> state)
+{
+  const u64 start_time = Common::Timer::GetTimeUs();
+
+  // Nothing else modifies the stored states while a state is pending, since Pop flushes first.
+  // The getters may still look at them, so they are only modified with the lock held.
+  std::vector<u8> xor_buffer;
+  OlderState older;
+  const bool has_older = !m_newest_state.empty();
+  if (has_older)
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      xor_buffer = std::move(m_spare_buffer);
+      m_spare_buffer.clear();
+    }
+    XorStates(m_newest_state, state, &xor_buffer, m_thread_pool);
+
+    State::StateCompressor compressor(xor_buffer.data(), xor_buffer.size(),
+                                      State::GetDefaultStateCompression(), m_thread_pool);
+    compressor.SetWrittenSize(xor_buffer.size());
+    compressor.Compress();
+    older.compressed_xor = compressor.WriteToBuffer();
+    older.size = m_newest_state.size();
+  }
+
+  std::lock_guard<std::mutex> lk(m_lock);
+  if (has_older)
+  {
+    m_older_states_size += older.compressed_xor.size();
+    m_older_states.push_back(std::move(older));
+  }
+  if (has_older && m_spare_buffer.empty())
+    m_spare_buffer = std::move(xor_buffer);
+  m_newest_state = std::move(state);
+
+  while (!m_older_states.empty() &&
+         m_older_states_size + m_newest_state.size() > m_memory_budget)
+  {
+    m_older_states_size -= m_older_states.front().compressed_xor.size();
+    m_older_states.pop_front();
+  }
+
+  m_num_stores++;
+  m_total_store_time += Common::Timer::GetTimeUs() - start_time;
+}
+
+// Protects everything below except the values that the CPU thread uses
+static std::mutex s_lock;
+static std::unique_ptr<Common::ThreadPool> s_thread_pool;
+static std::unique_ptr<RewindBuffer> s_buffer;
+static u64 s_num_captures;
+static u64 s_total_capture_time;
+static u64 s_max_capture_time;
+static u64 s_dropped_states;
+
+static bool s_enabled = false;
+static u32 s_interval;
+static std::atomic<u32> s_frames_since_capture;
+static std::atomic<u64> s_num_frames;
+static std::atomic<bool> s_capture_queued;
+
+void Init()
+{
+  s_enabled = Config::Get(Config::MAIN_REWIND_ENABLE);
+  if (!s_enabled)
+    return;
+
+  s_interval = static_cast<u32>(std::max(1, Config::Get(Config::MAIN_REWIND_INTERVAL)));
+  s_frames_since_capture = 0;
+  s_num_frames = 0;
+  s_capture_queued = false;
+
+  const size_t memory_budget =
+      static_cast<size_t>(std::max(0, Config::Get(Config::MAIN_REWIND_MEMORY_BUDGET))) << 20;
+  std::lock_guard<std::mutex> lk(s_lock);
+  // A couple of threads keep up with a capture every few frames without competing too much with
+  // the CPU and GPU threads
+  s_thread_pool = std::make_unique<Common::ThreadPool>(2, "Rewind compression");
+  s_buffer = std::make_unique<RewindBuffer>(memory_budget, s_thread_pool.get());
+  s_num_captures = 0;
+  s_total_capture_time = 0;
+  s_max_capture_time = 0;
+  s_dropped_states = 0;
+}
+
+void Shutdown()
+{
+  s_enabled = false;
+
+  std::lock_guard<std::mutex> lk(s_lock);
+  s_buffer.reset();
+  s_thread_pool.reset();
+}
+
+// Runs on the host thread, since saving a state has to pause the emulation.
+static void Capture()
+{
+  std::lock_guard<std::mutex> lk(s_lock);
+  s_capture_queued = false;
+  if (!s_buffer || NetPlay::IsNetPlayRunning())
+    return;
+
+  std::vector<u8> state = s_buffer->TakeSpareBuffer();
+  const u64 start_time = Common::Timer::GetTimeUs();
+  State::SaveToBuffer(state);
+  const u64 capture_time = Common::Timer::GetTimeUs() - start_time;
+
+  s_num_captures++;
+  s_total_capture_time += capture_time;
+  s_max_capture_time = std::max(s_max_capture_time, capture_time);
+  if (!s_buffer->Push(std::move(state)))
+    s_dropped_states++;
+}
+
+void FrameUpdate()
+{
+  if (!s_enabled)
+    return;
+
+  s_num_frames++;
+  if (++s_frames_since_capture < s_interval || s_capture_queued)
+    return;
+
+  s_frames_since_capture = 0;
+  s_capture_queued = true;
+  Core::QueueHostJob(Capture);
+}
+
+bool StepBack()
+{
+  std::lock_guard<std::mutex> lk(s_lock);
+  if (!s_buffer)
+    return false;
+
+  std::vector<u8> state;
+  if (!s_buffer->Pop(&state))
+    return false;
+
+  State::LoadFromBuffer(state);
+  s_buffer->RecycleBuffer(std::move(state));
+  s_frames_since_capture = 0;
+  return true;
+}
+
+Stats GetStats()
+{
+  std::lock_guard<std::mutex> lk(s_lock);
+  Stats stats{};
+  if (!s_buffer)
+    return stats;
+
+  stats.num_states = s_buffer->GetNumStates();
+  stats.memory_usage = s_buffer->GetMemoryUsage();
+  stats.capture_time_per_frame = s_total_capture_time / std::max<u64>(1, s_num_frames);
+  stats.average_capture_time = s_total_capture_time / std::max<u64>(1, s_num_captures);
+  stats.max_capture_time = s_max_capture_time;
+  stats.average_store_time = s_buffer->GetAverageStoreTime();
+  stats.dropped_states = s_dropped_states;
+  return stats;
+}
+}  // namespace Rewind
@@ -0,0 +1,108 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace Common
+{
+class ThreadPool;
+}
+
+// Rewinding works by saving a state into memory every few frames. Only the newest state is kept
+// as it is. Every older state is stored as the XOR of itself and the state after it, compressed
+// on a background thread. Consecutive states are mostly the same, so that is mostly zeroes and
+// compresses very well.
+
+namespace Rewind
+{
+class RewindBuffer
+{
+public:
+  // The memory budget includes the newest state. The oldest states are thrown away to stay
+  // within it.
+  RewindBuffer(size_t memory_budget, Common::ThreadPool* thread_pool);
+  ~RewindBuffer();
+
+  // Adds a state as the newest one. Compressing the previous newest state happens on a background
+  // thread; if that is still busy with the previous call, the state is dropped and false is
+  // returned.
+  bool Push(std::vector<u8> state);
+  // Removes the newest state and returns it.
+  bool Pop(std::vector<u8>* state);
+  // Waits until the last pushed state has been stored.
+  void Flush();
+
+  // Saving states into a buffer that was used before avoids having to allocate and page in a new
+  // one every time, which is noticeable with states that are close to 100 MiB.
+  std::vector<u8> TakeSpareBuffer();
+  void RecycleBuffer(std::vector<u8> buffer);
+
+  size_t GetNumStates() const;
+  size_t GetMemoryUsage() const;
+  // Time spent on the background thread per state, in microseconds
+  u64 GetAverageStoreTime() const;
+
+private:
+  struct OlderState
+  {
+    std::vector<u8> compressed_xor;
+    size_t size;
+  };
+
+  void ThreadLoop();
+  void Store(std::vector<u8> state);
+
+  const size_t m_memory_budget;
+  Common::ThreadPool* const m_thread_pool;
+
+  mutable std::mutex m_lock;
+  std::condition_variable m_cvar;
+  std::vector<u8> m_pending_state;
+  bool m_has_pending_state = false;
+  bool m_exit = false;
+
+  std::vector<u8> m_newest_state;
+  std::deque<OlderState> m_older_states;
+  size_t m_older_states_size = 0;
+  std::vector<u8> m_spare_buffer;
+  u64 m_num_stores = 0;
+  u64 m_total_store_time = 0;
+
+  std::thread m_thread;
+};
+
+struct Stats
+{
+  size_t num_states;
+  size_t memory_usage;
+  // Times in microseconds. Capturing a state is what pauses the emulation.
+  u64 capture_time_per_frame;
+  u64 average_capture_time;
+  u64 max_capture_time;
+  u64 average_store_time;
+  // States that were skipped because the previous one was still being compressed
+  u64 dropped_states;
+};
+
+void Init();
+void Shutdown();
+
+// Called on the CPU thread for every field. Schedules a capture every MAIN_REWIND_INTERVAL fields.
+void FrameUpdate();
+
+// Loads the newest state that hasn't been loaded yet, which goes back one interval every time.
+// Returns false if there are no states left.
+bool StepBack();
+
+Stats GetStats();
+}  // namespace Rewind
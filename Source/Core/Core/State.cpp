@@ -6,6 +6,7 @@
 
 #include <lzo/lzo1x.h>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -21,6 +22,7 @@
 #include "Common/ScopeGuard.h"
 #include "Common/StringUtil.h"
 #include "Common/Thread.h"
+#include "Common/ThreadPool.h"
 #include "Common/Timer.h"
 #include "Common/Version.h"
 
@@ -29,11 +31,13 @@
 #include "Core/CoreTiming.h"
 #include "Core/GeckoCode.h"
 #include "Core/HW/HW.h"
+#include "Core/HW/Memmap.h"
 #include "Core/HW/Wiimote.h"
 #include "Core/Host.h"
 #include "Core/Movie.h"
 #include "Core/NetPlayClient.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/StateCompression.h"
 
 #include "VideoCommon/AVIDump.h"
 #include "VideoCommon/OnScreenDisplay.h"
@@ -51,13 +55,9 @@ static const u32 IN_LEN = 128 * 1024u;
 
 static const u32 OUT_LEN = IN_LEN + (IN_LEN / 16) + 64 + 3;
 
+// Only used for loading states from before StateCompressor
 static unsigned char __LZO_MMODEL out[OUT_LEN];
 
-#define HEAP_ALLOC(var, size)                                                                      \
-  lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
-
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
-
 static std::string g_last_filename;
 
 static AfterLoadCallbackFunc s_on_after_load_callback;
@@ -73,8 +73,11 @@ static Common::Event g_compressAndDumpStateSyncEvent;
 
 static std::thread g_save_thread;
 
+// Compresses and decompresses the chunks of states
+static std::unique_ptr<Common::ThreadPool> s_thread_pool;
+
 // Don't forget to increase this after doing changes on the savestate system
-static const u32 STATE_VERSION = 99;  // Last changed in PR 6020
+static const u32 STATE_VERSION = 100;  // Last changed for delta states
 
 // Maps savestate versions to Dolphin versions.
 // Versions after 42 don't need to be added to this list,
@@ -214,20 +217,85 @@ void LoadFromBuffer(std::vector<u8>& buffer)
   });
 }
 
-void SaveToBuffer(std::vector<u8>& buffer)
+static void SaveToBuffer(std::vector<u8>& buffer, Memory::StateType type)
 {
   Core::RunAsCPUThread([&] {
+    // Delta states start with the ID of their base, so that LoadDeltaFromBuffer can tell
+    // whether it has to load the base first without loading half of the delta state.
+    Memory::SetStateTypeToSave(type);
+    u64 delta_base_id = Memory::GetDeltaBaseID();
+    const auto do_state = [&](PointerWrap& p) {
+      if (type == Memory::StateType::Delta)
+        p.Do(delta_base_id);
+      DoState(p);
+    };
+
     u8* ptr = nullptr;
     PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
 
-    DoState(p);
+    do_state(p);
     const size_t buffer_size = reinterpret_cast<size_t>(ptr);
     buffer.resize(buffer_size);
 
     ptr = &buffer[0];
     p.SetMode(PointerWrap::MODE_WRITE);
+    do_state(p);
+
+    Memory::SetStateTypeToSave(Memory::StateType::Full);
+  });
+}
+
+void SaveToBuffer(std::vector<u8>& buffer)
+{
+  SaveToBuffer(buffer, Memory::StateType::Full);
+}
+
+void SaveDeltaBaseToBuffer(std::vector<u8>& buffer)
+{
+  SaveToBuffer(buffer, Memory::StateType::DeltaBase);
+}
+
+bool SaveDeltaToBuffer(std::vector<u8>& buffer)
+{
+  if (Memory::GetDeltaBaseID() == 0)
+    return false;
+
+  SaveToBuffer(buffer, Memory::StateType::Delta);
+  return true;
+}
+
+bool LoadDeltaFromBuffer(std::vector<u8>& base, std::vector<u8>& delta)
+{
+  if (NetPlay::IsNetPlayRunning())
+  {
+    OSD::AddMessage("Loading savestates is disabled in Netplay to prevent desyncs");
+    return false;
+  }
+
+  bool success = false;
+  Core::RunAsCPUThread([&] {
+    u8* ptr = delta.data();
+    PointerWrap p(&ptr, PointerWrap::MODE_READ);
+    u64 delta_base_id = 0;
+    p.Do(delta_base_id);
+
+    if (delta_base_id != Memory::GetDeltaBaseID())
+    {
+      u8* base_ptr = base.data();
+      PointerWrap base_p(&base_ptr, PointerWrap::MODE_READ);
+      DoState(base_p);
+      if (base_p.GetMode() != PointerWrap::MODE_READ ||
+          delta_base_id != Memory::GetDeltaBaseID())
+      {
+        Core::DisplayMessage("This delta savestate doesn't belong to the given base", 4000);
+        return;
+      }
+    }
+
     DoState(p);
+    success = p.GetMode() == PointerWrap::MODE_READ;
   });
+  return success;
 }
 
 // return state number not in map
@@ -281,6 +349,7 @@ struct CompressAndDumpState_args
 {
   std::vector<u8>* buffer_vector;
   std::mutex* buffer_mutex;
+  std::shared_ptr<StateCompressor> compressor;
   std::string filename;
   bool wait;
 };
@@ -302,13 +371,17 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
   if (!save_args.wait)
     on_exit.Exit();
 
-  const u8* const buffer_data = &(*(save_args.buffer_vector))[0];
   const size_t buffer_size = (save_args.buffer_vector)->size();
   std::string& filename = save_args.filename;
 
   // For easy debugging
   Common::SetCurrentThreadName("SaveState thread");
 
+  // This thread is started while the state is still being written,
+  // so the chunks of the state get compressed as they are finished.
+  if (!save_args.compressor->Compress())
+    return;
+
   // Moving to last overwritten save-state
   if (File::Exists(filename))
   {
@@ -338,44 +411,14 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
   // Setting up the header
   StateHeader header;
   strncpy(header.gameID, SConfig::GetInstance().GetGameID().c_str(), 6);
-  header.size = g_use_compression ? (u32)buffer_size : 0;
+  // A non-zero size means that the state is split into chunks, even if they aren't compressed
+  header.size = (u32)buffer_size;
   header.time = Common::Timer::GetDoubleTime();
 
-  f.WriteArray(&header, 1);
-
-  if (header.size != 0)  // non-zero header size means the state is compressed
+  if (!f.WriteArray(&header, 1) || !save_args.compressor->WriteToFile(&f))
   {
-    lzo_uint i = 0;
-    while (true)
-    {
-      lzo_uint32 cur_len = 0;
-      lzo_uint out_len = 0;
-
-      if ((i + IN_LEN) >= buffer_size)
-      {
-        cur_len = (lzo_uint32)(buffer_size - i);
-      }
-      else
-      {
-        cur_len = IN_LEN;
-      }
-
-      if (lzo1x_1_compress(buffer_data + i, cur_len, out, &out_len, wrkmem) != LZO_E_OK)
-        PanicAlertT("Internal LZO Error - compression failed");
-
-      // The size of the data to write is 'out_len'
-      f.WriteArray((lzo_uint32*)&out_len, 1);
-      f.WriteBytes(out, out_len);
-
-      if (cur_len != IN_LEN)
-        break;
-
-      i += cur_len;
-    }
-  }
-  else  // uncompressed
-  {
-    f.WriteBytes(buffer_data, buffer_size);
+    Core::DisplayMessage("Could not save state", 2000);
+    return;
   }
 
   Core::DisplayMessage(StringFromFormat("Saved State to %s", filename.c_str()), 2000);
@@ -391,27 +434,41 @@ void SaveAs(const std::string& filename, bool wait)
     DoState(p);
     const size_t buffer_size = reinterpret_cast<size_t>(ptr);
 
-    // Then actually do the write.
+    // The previous save must be done with the buffer before it can be reused.
+    Flush();
     {
       std::lock_guard<std::mutex> lk(g_cs_current_buffer);
       g_current_buffer.resize(buffer_size);
-      ptr = &g_current_buffer[0];
-      p.SetMode(PointerWrap::MODE_WRITE);
-      DoState(p);
     }
 
+    // Start the save thread before writing the state, so that compression overlaps with writing.
+    // The save thread holds g_cs_current_buffer, and only reads the parts of the buffer that the
+    // compressor has been told are finished.
+    CompressAndDumpState_args save_args;
+    save_args.buffer_vector = &g_current_buffer;
+    save_args.buffer_mutex = &g_cs_current_buffer;
+    save_args.compressor = std::make_shared<StateCompressor>(
+        g_current_buffer.data(), buffer_size,
+        g_use_compression ? GetDefaultStateCompression() : StateCompression::None,
+        s_thread_pool.get());
+    save_args.filename = filename;
+    save_args.wait = wait;
+    // The save thread may finish with the compressor while it is still being notified.
+    const std::shared_ptr<StateCompressor> compressor = save_args.compressor;
+    g_save_thread = std::thread(CompressAndDumpState, std::move(save_args));
+
+    // Then actually do the write.
+    u8* const buffer_start = g_current_buffer.data();
+    ptr = buffer_start;
+    p.SetMode(PointerWrap::MODE_WRITE);
+    p.SetMarkerCallback(
+        [&](const u8* position) { compressor->SetWrittenSize(position - buffer_start); });
+    DoState(p);
+
     if (p.GetMode() == PointerWrap::MODE_WRITE)
     {
       Core::DisplayMessage("Saving State...", 1000);
-
-      CompressAndDumpState_args save_args;
-      save_args.buffer_vector = &g_current_buffer;
-      save_args.buffer_mutex = &g_cs_current_buffer;
-      save_args.filename = filename;
-      save_args.wait = wait;
-
-      Flush();
-      g_save_thread = std::thread(CompressAndDumpState, save_args);
+      compressor->SetWrittenSize(buffer_size);
       g_compressAndDumpStateSyncEvent.Wait();
 
       g_last_filename = filename;
@@ -419,6 +476,8 @@ void SaveAs(const std::string& filename, bool wait)
     else
     {
       // someone aborted the save by changing the mode?
+      compressor->Abort();
+      g_compressAndDumpStateSyncEvent.Wait();
       Core::DisplayMessage("Unable to save: Internal DoState Error", 4000);
     }
   });
@@ -473,7 +532,25 @@ static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_
 
   std::vector<u8> buffer;
 
+  u32 magic = 0;
   if (header.size != 0)  // non-zero size means the state is compressed
+  {
+    // Older states don't have this magic, and are compressed with LZO as one stream
+    if (f.ReadArray(&magic, 1))
+      f.Seek(-static_cast<s64>(sizeof(magic)), SEEK_CUR);
+  }
+
+  if (magic == COMPRESSED_STATE_MAGIC)
+  {
+    Core::DisplayMessage("Decompressing State...", 500);
+
+    if (!ReadCompressedState(&f, &buffer, s_thread_pool.get()))
+    {
+      PanicAlertT("Could not decompress the savestate. It might be corrupted.");
+      return;
+    }
+  }
+  else if (header.size != 0)
   {
     Core::DisplayMessage("Decompressing State...", 500);
 
@@ -599,12 +676,16 @@ void Init()
 {
   if (lzo_init() != LZO_E_OK)
     PanicAlertT("Internal LZO Error - lzo_init() failed");
+
+  s_thread_pool = std::make_unique<Common::ThreadPool>(0, "Savestate compression");
 }
 
 void Shutdown()
 {
   Flush();
 
+  s_thread_pool.reset();
+
   // swapping with an empty vector, rather than clear()ing
   // this gives a better guarantee to free the allocated memory right NOW (as opposed to, actually,
   // never)
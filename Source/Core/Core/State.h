@@ -50,6 +50,15 @@ void LoadAs(const std::string& filename);
 void SaveToBuffer(std::vector<u8>& buffer);
 void LoadFromBuffer(std::vector<u8>& buffer);
 
+// Delta states only contain the pages of memory that changed since the last delta base state was
+// saved, which makes them much smaller. A delta state can be loaded on top of its base, and
+// loading a delta base state with LoadFromBuffer makes it the current base again.
+void SaveDeltaBaseToBuffer(std::vector<u8>& buffer);
+// Returns false if no delta base state has been saved or loaded.
+bool SaveDeltaToBuffer(std::vector<u8>& buffer);
+// Only loads the base if it isn't the current one already.
+bool LoadDeltaFromBuffer(std::vector<u8>& base, std::vector<u8>& delta);
+
 void LoadLastSaved(int i = 1);
 void SaveFirstSaved();
 void UndoSaveState();
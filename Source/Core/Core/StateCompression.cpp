@@ -0,0 +1,311 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/StateCompression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <lzo/lzo1x.h>
+#include <mutex>
+#include <vector>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/ThreadPool.h"
+
+namespace State
+{
+// Set in the size of chunks which didn't get smaller and are stored uncompressed
+constexpr u32 STORED_CHUNK_FLAG = 0x80000000;
+constexpr u32 MAX_CHUNK_SIZE = 0x4000000;
+
+#ifdef HAVE_ZSTD
+// Savestates are made often and thrown away often, so speed matters more than size
+constexpr int ZSTD_LEVEL = 1;
+#endif
+
+bool IsStateCompressionSupported(StateCompression compression)
+{
+  switch (compression)
+  {
+  case StateCompression::None:
+  case StateCompression::LZO:
+    return true;
+  case StateCompression::Zstd:
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+StateCompression GetDefaultStateCompression()
+{
+  return IsStateCompressionSupported(StateCompression::Zstd) ? StateCompression::Zstd :
+                                                                StateCompression::LZO;
+}
+
+StateCompressor::StateCompressor(const u8* state, size_t state_size, StateCompression compression,
+                                 Common::ThreadPool* thread_pool)
+    : m_state(state), m_state_size(state_size), m_compression(compression),
+      m_thread_pool(thread_pool)
+{
+}
+
+void StateCompressor::SetWrittenSize(size_t written_size)
+{
+  // Compress may return and the compressor be destroyed as soon as the lock is released, so
+  // the notification has to happen while it is still held.
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_written_size = written_size;
+  m_progress.notify_one();
+}
+
+void StateCompressor::Abort()
+{
+  std::lock_guard<std::mutex> lk(m_lock);
+  m_aborted = true;
+  m_progress.notify_one();
+}
+
+bool StateCompressor::Compress()
+{
+  const size_t num_chunks = (m_state_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  m_chunks.resize(num_chunks);
+  m_chunk_sizes.resize(num_chunks);
+
+  size_t next_chunk = 0;
+  while (next_chunk < num_chunks)
+  {
+    // Wait for more chunks to be written completely
+    size_t end_chunk;
+    {
+      std::unique_lock<std::mutex> lk(m_lock);
+      const auto written_chunks = [&] {
+        return m_written_size == m_state_size ? num_chunks : m_written_size / CHUNK_SIZE;
+      };
+      m_progress.wait(lk, [&] { return m_aborted || written_chunks() > next_chunk; });
+      if (m_aborted)
+        return false;
+      end_chunk = written_chunks();
+    }
+
+    const size_t first_chunk = next_chunk;
+    m_thread_pool->ParallelFor(end_chunk - first_chunk,
+                               [&](size_t i) { CompressChunk(first_chunk + i); });
+    next_chunk = end_chunk;
+  }
+
+  return true;
+}
+
+void StateCompressor::CompressChunk(size_t index)
+{
+  const u8* const in = m_state + index * CHUNK_SIZE;
+  const size_t in_size = std::min<size_t>(CHUNK_SIZE, m_state_size - index * CHUNK_SIZE);
+  std::vector<u8>& out = m_chunks[index];
+  size_t out_size = 0;
+
+  switch (m_compression)
+  {
+  case StateCompression::LZO:
+  {
+    out.resize(in_size + in_size / 16 + 64 + 3);
+    std::vector<u8> work_memory(LZO1X_1_MEM_COMPRESS);
+    lzo_uint lzo_out_size;
+    if (lzo1x_1_compress(in, static_cast<lzo_uint>(in_size), out.data(), &lzo_out_size,
+                         work_memory.data()) == LZO_E_OK)
+    {
+      out_size = lzo_out_size;
+    }
+    break;
+  }
+#ifdef HAVE_ZSTD
+  case StateCompression::Zstd:
+  {
+    out.resize(ZSTD_compressBound(in_size));
+    const size_t result = ZSTD_compress(out.data(), out.size(), in, in_size, ZSTD_LEVEL);
+    if (!ZSTD_isError(result))
+      out_size = result;
+    break;
+  }
+#endif
+  default:
+    break;
+  }
+
+  if (out_size == 0 || out_size >= in_size)
+  {
+    out.clear();
+    out.shrink_to_fit();
+    m_chunk_sizes[index] = static_cast<u32>(in_size) | STORED_CHUNK_FLAG;
+  }
+  else
+  {
+    out.resize(out_size);
+    m_chunk_sizes[index] = static_cast<u32>(out_size);
+  }
+}
+
+CompressedStateHeader StateCompressor::GetHeader() const
+{
+  CompressedStateHeader header;
+  header.magic = COMPRESSED_STATE_MAGIC;
+  header.compression = m_compression;
+  header.chunk_size = CHUNK_SIZE;
+  header.num_chunks = static_cast<u32>(m_chunks.size());
+  header.state_size = m_state_size;
+  return header;
+}
+
+const u8* StateCompressor::GetChunkData(size_t index) const
+{
+  const bool stored = (m_chunk_sizes[index] & STORED_CHUNK_FLAG) != 0;
+  return stored ? m_state + index * CHUNK_SIZE : m_chunks[index].data();
+}
+
+bool StateCompressor::WriteToFile(File::IOFile* file) const
+{
+  const CompressedStateHeader header = GetHeader();
+  if (!file->WriteArray(&header, 1) ||
+      !file->WriteArray(m_chunk_sizes.data(), m_chunk_sizes.size()))
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < m_chunks.size(); i++)
+  {
+    if (!file->WriteBytes(GetChunkData(i), m_chunk_sizes[i] & ~STORED_CHUNK_FLAG))
+      return false;
+  }
+
+  return true;
+}
+
+std::vector<u8> StateCompressor::WriteToBuffer() const
+{
+  size_t size = sizeof(CompressedStateHeader) + m_chunk_sizes.size() * sizeof(u32);
+  for (u32 chunk_size : m_chunk_sizes)
+    size += chunk_size & ~STORED_CHUNK_FLAG;
+
+  std::vector<u8> buffer(size);
+  const CompressedStateHeader header = GetHeader();
+  u8* out = buffer.data();
+  std::memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+  std::memcpy(out, m_chunk_sizes.data(), m_chunk_sizes.size() * sizeof(u32));
+  out += m_chunk_sizes.size() * sizeof(u32);
+  for (size_t i = 0; i < m_chunks.size(); i++)
+  {
+    const size_t chunk_size = m_chunk_sizes[i] & ~STORED_CHUNK_FLAG;
+    std::memcpy(out, GetChunkData(i), chunk_size);
+    out += chunk_size;
+  }
+
+  return buffer;
+}
+
+static bool DecompressChunk(StateCompression compression, const u8* in, size_t in_size, u8* out,
+                            size_t out_size)
+{
+  switch (compression)
+  {
+  case StateCompression::LZO:
+  {
+    lzo_uint new_size = static_cast<lzo_uint>(out_size);
+    return lzo1x_decompress_safe(in, static_cast<lzo_uint>(in_size), out, &new_size, nullptr) ==
+               LZO_E_OK &&
+           new_size == out_size;
+  }
+#ifdef HAVE_ZSTD
+  case StateCompression::Zstd:
+    return ZSTD_decompress(out, out_size, in, in_size) == out_size;
+#endif
+  default:
+    return false;
+  }
+}
+
+bool ReadCompressedState(File::IOFile* file, std::vector<u8>* state,
+                         Common::ThreadPool* thread_pool)
+{
+  // The compressed state is always the last thing in the file
+  std::vector<u8> data(file->GetSize() - file->Tell());
+  if (!file->ReadBytes(data.data(), data.size()))
+    return false;
+
+  return DecompressState(data.data(), data.size(), state, thread_pool);
+}
+
+bool DecompressState(const u8* data, size_t size, std::vector<u8>* state,
+                     Common::ThreadPool* thread_pool)
+{
+  CompressedStateHeader header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != COMPRESSED_STATE_MAGIC || !IsStateCompressionSupported(header.compression) ||
+      header.chunk_size == 0 || header.chunk_size > MAX_CHUNK_SIZE)
+  {
+    return false;
+  }
+
+  // Only the last chunk may be partial
+  const u64 max_state_size = u64(header.num_chunks) * header.chunk_size;
+  if (header.state_size > max_state_size || header.state_size + header.chunk_size <= max_state_size)
+    return false;
+
+  const u64 remaining_size = size - sizeof(header);
+  if (header.num_chunks > remaining_size / sizeof(u32))
+    return false;
+
+  std::vector<u32> chunk_sizes(header.num_chunks);
+  std::memcpy(chunk_sizes.data(), data + sizeof(header), chunk_sizes.size() * sizeof(u32));
+
+  std::vector<u64> chunk_offsets(header.num_chunks);
+  u64 compressed_size = 0;
+  for (size_t i = 0; i < chunk_sizes.size(); i++)
+  {
+    chunk_offsets[i] = compressed_size;
+    compressed_size += chunk_sizes[i] & ~STORED_CHUNK_FLAG;
+  }
+  if (compressed_size > remaining_size - chunk_sizes.size() * sizeof(u32))
+    return false;
+
+  const u8* const compressed = data + sizeof(header) + chunk_sizes.size() * sizeof(u32);
+  state->resize(header.state_size);
+  std::atomic<bool> success{true};
+  thread_pool->ParallelFor(chunk_sizes.size(), [&](size_t i) {
+    const u8* const in = compressed + chunk_offsets[i];
+    const size_t in_size = chunk_sizes[i] & ~STORED_CHUNK_FLAG;
+    u8* const out = state->data() + i * header.chunk_size;
+    const size_t out_size =
+        std::min<u64>(header.chunk_size, header.state_size - i * header.chunk_size);
+
+    if (chunk_sizes[i] & STORED_CHUNK_FLAG)
+    {
+      if (in_size == out_size)
+        std::memcpy(out, in, out_size);
+      else
+        success = false;
+    }
+    else if (!DecompressChunk(header.compression, in, in_size, out, out_size))
+    {
+      success = false;
+    }
+  });
+
+  return success;
+}
+
+}  // namespace State
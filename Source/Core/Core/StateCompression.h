@@ -0,0 +1,106 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace Common
+{
+class ThreadPool;
+}
+
+namespace File
+{
+class IOFile;
+}
+
+// Compressed savestates are split into chunks which are compressed independently of each other,
+// so that they can be compressed and decompressed in parallel. After the StateHeader, the file
+// contains a CompressedStateHeader, the compressed size of every chunk, and then the chunks.
+
+namespace State
+{
+// Old compressed states store the compressed size of their first LZO block in the same place,
+// which can never be this large.
+constexpr u32 COMPRESSED_STATE_MAGIC = 0x43545344;  // "DSTC"
+
+enum class StateCompression : u32
+{
+  None = 0,
+  LZO = 1,
+  Zstd = 2,
+};
+
+bool IsStateCompressionSupported(StateCompression compression);
+// zstd if Dolphin was built with it, otherwise LZO
+StateCompression GetDefaultStateCompression();
+
+struct CompressedStateHeader
+{
+  u32 magic;
+  StateCompression compression;
+  u32 chunk_size;
+  u32 num_chunks;
+  u64 state_size;
+};
+static_assert(sizeof(CompressedStateHeader) == 24, "CompressedStateHeader must not have padding");
+
+// Compresses a state while it is still being written. The thread that writes the state reports
+// its progress with SetWrittenSize, and Compress (running on another thread) compresses every
+// chunk that has been completely written on the thread pool.
+class StateCompressor
+{
+public:
+  static constexpr u32 CHUNK_SIZE = 0x100000;
+
+  StateCompressor(const u8* state, size_t state_size, StateCompression compression,
+                  Common::ThreadPool* thread_pool);
+
+  // Everything before written_size has been written and will not change anymore.
+  void SetWrittenSize(size_t written_size);
+  // Writing the state failed. Compress returns false as soon as possible.
+  void Abort();
+
+  // Returns once the whole state has been compressed, or false if it was aborted.
+  bool Compress();
+  // Writes everything after the StateHeader.
+  bool WriteToFile(File::IOFile* file) const;
+  // Same as WriteToFile, for states that are kept in memory.
+  std::vector<u8> WriteToBuffer() const;
+
+private:
+  CompressedStateHeader GetHeader() const;
+  const u8* GetChunkData(size_t index) const;
+  void CompressChunk(size_t index);
+
+  const u8* const m_state;
+  const size_t m_state_size;
+  const StateCompression m_compression;
+  Common::ThreadPool* const m_thread_pool;
+
+  std::mutex m_lock;
+  std::condition_variable m_progress;
+  size_t m_written_size = 0;
+  bool m_aborted = false;
+
+  // Chunks that didn't get smaller are left empty and written straight from the state
+  std::vector<std::vector<u8>> m_chunks;
+  std::vector<u32> m_chunk_sizes;
+};
+
+// Reads everything after the StateHeader of a file written by StateCompressor. The chunks are
+// decompressed on the thread pool.
+bool ReadCompressedState(File::IOFile* file, std::vector<u8>* state,
+                         Common::ThreadPool* thread_pool);
+// Same as ReadCompressedState, for states that are kept in memory.
+bool DecompressState(const u8* data, size_t size, std::vector<u8>* state,
+                     Common::ThreadPool* thread_pool);
+
+}  // namespace State
@@ -34,7 +34,16 @@ enum class BlobType
   GCZ,
   CISO,
   WBFS,
-  TGC
+  TGC,
+  DCZ
+};
+
+enum class DCZCompression : u32
+{
+  None = 0,
+  Zlib = 1,
+  LZMA = 2,
+  Zstd = 3,
 };
 
 class BlobReader
@@ -159,9 +168,16 @@ std::unique_ptr<BlobReader> CreateBlobReader(const std::string& filename);
 
 typedef bool (*CompressCB)(const std::string& text, float percent, void* arg);
 
+// num_threads == 0 compresses on all hardware threads.
 bool CompressFileToBlob(const std::string& infile_path, const std::string& outfile_path,
                         u32 sub_type = 0, int sector_size = 16384, CompressCB callback = nullptr,
-                        void* arg = nullptr);
+                        void* arg = nullptr, unsigned int num_threads = 0);
+// LZMA and zstd are only available when Dolphin is built with liblzma and libzstd.
+bool IsDCZCompressionSupported(DCZCompression compression);
+// Converts any readable disc image to DCZ. chunk_size must be a multiple of 2 MiB, at most 1 GiB.
+bool ConvertToDCZ(const std::string& infile_path, const std::string& outfile_path,
+                  DCZCompression compression, int compression_level, u32 chunk_size = 0x200000,
+                  CompressCB callback = nullptr, void* arg = nullptr, unsigned int num_threads = 0);
 bool DecompressBlobToFile(const std::string& infile_path, const std::string& outfile_path,
                           CompressCB callback = nullptr, void* arg = nullptr);
 
@@ -8,6 +8,8 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <cstring>
@@ -24,14 +26,26 @@
 #include "Common/Logging/Log.h"
 #include "Common/MsgHandler.h"
 #include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
 #include "DiscIO/Blob.h"
 #include "DiscIO/CompressedBlob.h"
 #include "DiscIO/DiscScrubber.h"
 
 namespace DiscIO
 {
+// Number of blocks each thread gets per batch when compressing.
+constexpr u32 GCZ_BLOCKS_PER_THREAD = 16;
+// Maximum number of neighbouring blocks decompressed together when reading.
+constexpr u32 GCZ_READ_AHEAD_BLOCKS = 4;
+
 bool IsGCZBlob(File::IOFile& file);
 
+static Common::ThreadPool& GetDecompressionPool()
+{
+  static Common::ThreadPool pool(0, "GCZ decompression");
+  return pool;
+}
+
 CompressedBlobReader::CompressedBlobReader(File::IOFile file, const std::string& filename)
     : m_file(std::move(file)), m_file_name(filename)
 {
@@ -56,6 +70,11 @@ CompressedBlobReader::CompressedBlobReader(File::IOFile file, const std::string&
   // I still add some safety margin.
   const u32 zlib_buffer_size = m_header.block_size + 64;
   m_zlib_buffer.resize(zlib_buffer_size);
+
+  // Decompressing a few neighbouring blocks on worker threads costs little more time than a
+  // single block, and sequential reads usually need them next.
+  SetChunkSize(static_cast<int>(
+      std::min<size_t>(GetDecompressionPool().GetThreadCount(), GCZ_READ_AHEAD_BLOCKS)));
 }
 
 std::unique_ptr<CompressedBlobReader> CompressedBlobReader::Create(File::IOFile file,
@@ -75,18 +94,32 @@ CompressedBlobReader::~CompressedBlobReader()
 // IMPORTANT: Calling this function invalidates all earlier pointers gotten from this function.
 u64 CompressedBlobReader::GetBlockCompressedSize(u64 block_num) const
 {
+  if (block_num >= m_header.num_blocks)
+  {
+    PanicAlert("GetBlockCompressedSize - illegal block number %i", (int)block_num);
+    return 0;
+  }
+
   u64 start = m_block_pointers[block_num];
   if (block_num < m_header.num_blocks - 1)
     return m_block_pointers[block_num + 1] - start;
-  else if (block_num == m_header.num_blocks - 1)
-    return m_header.compressed_data_size - start;
   else
-    PanicAlert("GetBlockCompressedSize - illegal block number %i", (int)block_num);
-  return 0;
+    return m_header.compressed_data_size - start;
+}
+
+bool CompressedBlobReader::Read(u64 offset, u64 size, u8* out_ptr)
+{
+  if (offset > m_header.data_size || size > m_header.data_size - offset)
+    return false;
+
+  return SectorReader::Read(offset, size, out_ptr);
 }
 
 bool CompressedBlobReader::GetBlock(u64 block_num, u8* out_ptr)
 {
+  if (block_num >= m_header.num_blocks)
+    return false;
+
   bool uncompressed = false;
   u32 comp_block_size = (u32)GetBlockCompressedSize(block_num);
   u64 offset = m_block_pointers[block_num] + m_data_offset;
@@ -111,8 +144,63 @@ bool CompressedBlobReader::GetBlock(u64 block_num, u8* out_ptr)
     return false;
   }
 
+  return DecompressBlock(block_num, m_zlib_buffer.data(), comp_block_size, uncompressed, out_ptr);
+}
+
+bool CompressedBlobReader::ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8* out_ptr)
+{
+  if (num_blocks == 0 || block_num >= m_header.num_blocks ||
+      num_blocks > m_header.num_blocks - block_num)
+  {
+    return false;
+  }
+
+  if (num_blocks == 1)
+    return GetBlock(block_num, out_ptr);
+
+  // Blocks are stored back to back, so neighbouring blocks can be fetched with a single read
+  // and then be decompressed in parallel.
+  const u64 last_block = block_num + num_blocks - 1;
+  const u64 start = (m_block_pointers[block_num] & ~(1ULL << 63)) + m_data_offset;
+  const u64 end = (m_block_pointers[last_block] & ~(1ULL << 63)) + m_data_offset +
+                  static_cast<u32>(GetBlockCompressedSize(last_block));
+  if (end < start || end - start > num_blocks * m_header.block_size)
+  {
+    PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+    return false;
+  }
+
+  m_read_ahead_buffer.resize(end - start);
+  m_file.Seek(start, SEEK_SET);
+  if (!m_file.ReadBytes(m_read_ahead_buffer.data(), m_read_ahead_buffer.size()))
+  {
+    PanicAlertT("The disc image \"%s\" is truncated, some of the data is missing.",
+                m_file_name.c_str());
+    m_file.Clear();
+    return false;
+  }
+
+  std::atomic<bool> success{true};
+  GetDecompressionPool().ParallelFor(num_blocks, [&](size_t i) {
+    const u64 block = block_num + i;
+    const u64 offset = (m_block_pointers[block] & ~(1ULL << 63)) + m_data_offset - start;
+    const u32 size = static_cast<u32>(GetBlockCompressedSize(block));
+    const bool uncompressed = (m_block_pointers[block] & (1ULL << 63)) != 0;
+    if (offset + size > m_read_ahead_buffer.size() ||
+        !DecompressBlock(block, m_read_ahead_buffer.data() + offset, size, uncompressed,
+                         out_ptr + i * m_header.block_size))
+    {
+      success = false;
+    }
+  });
+  return success;
+}
+
+bool CompressedBlobReader::DecompressBlock(u64 block_num, const u8* data, u32 size,
+                                           bool uncompressed, u8* out_ptr) const
+{
   // First, check hash.
-  u32 block_hash = Common::HashAdler32(m_zlib_buffer.data(), comp_block_size);
+  u32 block_hash = Common::HashAdler32(data, size);
   if (block_hash != m_hashes[block_num])
     PanicAlertT("The disc image \"%s\" is corrupt.\n"
                 "Hash of block %" PRIu64 " is %08x instead of %08x.",
@@ -120,13 +208,18 @@ bool CompressedBlobReader::GetBlock(u64 block_num, u8* out_ptr)
 
   if (uncompressed)
   {
-    std::copy(m_zlib_buffer.begin(), m_zlib_buffer.begin() + comp_block_size, out_ptr);
+    if (size != m_header.block_size)
+    {
+      PanicAlert("Uncompressed block with wrong size");
+      return false;
+    }
+    std::copy(data, data + size, out_ptr);
   }
   else
   {
     z_stream z = {};
-    z.next_in = m_zlib_buffer.data();
-    z.avail_in = comp_block_size;
+    z.next_in = const_cast<u8*>(data);
+    z.avail_in = size;
     if (z.avail_in > m_header.block_size)
     {
       PanicAlert("We have a problem");
@@ -153,7 +246,8 @@ bool CompressedBlobReader::GetBlock(u64 block_num, u8* out_ptr)
 }
 
 bool CompressFileToBlob(const std::string& infile_path, const std::string& outfile_path,
-                        u32 sub_type, int block_size, CompressCB callback, void* arg)
+                        u32 sub_type, int block_size, CompressCB callback, void* arg,
+                        unsigned int num_threads)
 {
   bool scrubbing = false;
 
@@ -193,11 +287,20 @@ bool CompressFileToBlob(const std::string& infile_path, const std::string& outfi
     scrubbing = true;
   }
 
-  z_stream z = {};
-  if (deflateInit(&z, 9) != Z_OK)
-    return false;
+  // Blocks are compressed independently of each other, so they are read in batches, compressed
+  // on all threads at once and then written in order. The output doesn't depend on the number
+  // of threads.
+  Common::ThreadPool pool(num_threads, "GCZ compression");
+  std::vector<z_stream> streams(pool.GetThreadCount());
+  for (z_stream& z : streams)
+  {
+    z = {};
+    if (deflateInit(&z, 9) != Z_OK)
+      return false;
+  }
 
   callback(GetStringT("Files opened, ready to compress."), 0, arg);
+  const auto start_time = std::chrono::steady_clock::now();
 
   CompressedBlobHeader header;
   header.magic_cookie = GCZ_MAGIC;
@@ -208,10 +311,13 @@ bool CompressFileToBlob(const std::string& infile_path, const std::string& outfi
   // round upwards!
   header.num_blocks = (u32)((header.data_size + (block_size - 1)) / block_size);
 
+  const u32 batch_blocks = static_cast<u32>(pool.GetThreadCount()) * GCZ_BLOCKS_PER_THREAD;
   std::vector<u64> offsets(header.num_blocks);
   std::vector<u32> hashes(header.num_blocks);
-  std::vector<u8> out_buf(block_size);
-  std::vector<u8> in_buf(block_size);
+  std::vector<u8> out_buf(static_cast<size_t>(batch_blocks) * block_size);
+  std::vector<u8> in_buf(static_cast<size_t>(batch_blocks) * block_size);
+  // 0 if the block is to be stored uncompressed
+  std::vector<u32> comp_sizes(batch_blocks);
 
   // seek past the header (we will write it at the end)
   outfile.Seek(sizeof(CompressedBlobHeader), SEEK_CUR);
@@ -224,12 +330,15 @@ bool CompressFileToBlob(const std::string& infile_path, const std::string& outfi
   u64 position = 0;
   int num_compressed = 0;
   int num_stored = 0;
-  int progress_monitor = std::max<int>(1, header.num_blocks / 1000);
+  u32 progress_monitor = std::max<u32>(1, header.num_blocks / 1000);
+  u32 next_progress = 0;
   bool success = true;
 
-  for (u32 i = 0; i < header.num_blocks; i++)
+  for (u32 first = 0; first < header.num_blocks; first += batch_blocks)
   {
-    if (i % progress_monitor == 0)
+    const u32 count = std::min(batch_blocks, header.num_blocks - first);
+
+    if (first >= next_progress)
     {
       const u64 inpos = infile.Tell();
       int ratio = 0;
@@ -237,74 +346,110 @@ bool CompressFileToBlob(const std::string& infile_path, const std::string& outfi
         ratio = (int)(100 * position / inpos);
 
       std::string temp =
-          StringFromFormat(GetStringT("%i of %i blocks. Compression ratio %i%%").c_str(), i,
+          StringFromFormat(GetStringT("%i of %i blocks. Compression ratio %i%%").c_str(), first,
                            header.num_blocks, ratio);
-      bool was_cancelled = !callback(temp, (float)i / (float)header.num_blocks, arg);
+      bool was_cancelled = !callback(temp, (float)first / (float)header.num_blocks, arg);
       if (was_cancelled)
       {
         success = false;
         break;
       }
+      next_progress = first + progress_monitor;
     }
 
-    offsets[i] = position;
-
-    size_t read_bytes;
-    if (scrubbing)
-      read_bytes = disc_scrubber.GetNextBlock(infile, in_buf.data());
-    else
-      infile.ReadArray(in_buf.data(), header.block_size, &read_bytes);
-    if (read_bytes < header.block_size)
-      std::fill(in_buf.begin() + read_bytes, in_buf.begin() + header.block_size, 0);
+    for (u32 i = 0; i < count; i++)
+    {
+      u8* const block_in = &in_buf[static_cast<size_t>(i) * block_size];
+      size_t read_bytes;
+      if (scrubbing)
+        read_bytes = disc_scrubber.GetNextBlock(infile, block_in);
+      else
+        infile.ReadArray(block_in, header.block_size, &read_bytes);
+      if (read_bytes < header.block_size)
+        std::fill(block_in + read_bytes, block_in + header.block_size, 0);
+    }
 
-    int retval = deflateReset(&z);
-    z.next_in = in_buf.data();
-    z.avail_in = header.block_size;
-    z.next_out = out_buf.data();
-    z.avail_out = block_size;
+    std::atomic<bool> deflate_failed{false};
+    const size_t num_tasks = std::min<size_t>(streams.size(), count);
+    pool.ParallelFor(num_tasks, [&](size_t task) {
+      z_stream& z = streams[task];
+      for (u32 i = static_cast<u32>(task * count / num_tasks);
+           i < static_cast<u32>((task + 1) * count / num_tasks); i++)
+      {
+        u8* const block_in = &in_buf[static_cast<size_t>(i) * block_size];
+        u8* const block_out = &out_buf[static_cast<size_t>(i) * block_size];
+
+        int retval = deflateReset(&z);
+        z.next_in = block_in;
+        z.avail_in = header.block_size;
+        z.next_out = block_out;
+        z.avail_out = block_size;
+
+        if (retval != Z_OK)
+        {
+          deflate_failed = true;
+          return;
+        }
+
+        int status = deflate(&z, Z_FINISH);
+        int comp_size = block_size - z.avail_out;
+
+        if ((status != Z_STREAM_END) || (z.avail_out < 10))
+        {
+          // let's store uncompressed
+          comp_sizes[i] = 0;
+          hashes[first + i] = Common::HashAdler32(block_in, block_size);
+        }
+        else
+        {
+          // let's store compressed
+          comp_sizes[i] = comp_size;
+          hashes[first + i] = Common::HashAdler32(block_out, comp_size);
+        }
+      }
+    });
 
-    if (retval != Z_OK)
+    if (deflate_failed)
     {
       ERROR_LOG(DISCIO, "Deflate failed");
       success = false;
       break;
     }
 
-    int status = deflate(&z, Z_FINISH);
-    int comp_size = block_size - z.avail_out;
-
-    u8* write_buf;
-    int write_size;
-    if ((status != Z_STREAM_END) || (z.avail_out < 10))
+    for (u32 i = 0; i < count; i++)
     {
-      // PanicAlert("%i %i Store %i", i*block_size, position, comp_size);
-      // let's store uncompressed
-      write_buf = in_buf.data();
-      offsets[i] |= 0x8000000000000000ULL;
-      write_size = block_size;
-      num_stored++;
-    }
-    else
-    {
-      // let's store compressed
-      // PanicAlert("Comp %i to %i", block_size, comp_size);
-      write_buf = out_buf.data();
-      write_size = comp_size;
-      num_compressed++;
-    }
+      offsets[first + i] = position;
 
-    if (!outfile.WriteBytes(write_buf, write_size))
-    {
-      PanicAlertT("Failed to write the output file \"%s\".\n"
-                  "Check that you have enough space available on the target drive.",
-                  outfile_path.c_str());
-      success = false;
-      break;
-    }
+      u8* write_buf;
+      int write_size;
+      if (comp_sizes[i] == 0)
+      {
+        write_buf = &in_buf[static_cast<size_t>(i) * block_size];
+        offsets[first + i] |= 0x8000000000000000ULL;
+        write_size = block_size;
+        num_stored++;
+      }
+      else
+      {
+        write_buf = &out_buf[static_cast<size_t>(i) * block_size];
+        write_size = comp_sizes[i];
+        num_compressed++;
+      }
+
+      if (!outfile.WriteBytes(write_buf, write_size))
+      {
+        PanicAlertT("Failed to write the output file \"%s\".\n"
+                    "Check that you have enough space available on the target drive.",
+                    outfile_path.c_str());
+        success = false;
+        break;
+      }
 
-    position += write_size;
+      position += write_size;
+    }
 
-    hashes[i] = Common::HashAdler32(write_buf, write_size);
+    if (!success)
+      break;
   }
 
   header.compressed_data_size = position;
@@ -325,10 +470,15 @@ bool CompressFileToBlob(const std::string& infile_path, const std::string& outfi
   }
 
   // Cleanup
-  deflateEnd(&z);
+  for (z_stream& z : streams)
+    deflateEnd(&z);
 
   if (success)
   {
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start_time;
+    NOTICE_LOG(DISCIO, "Compressed %" PRIu64 " bytes in %.2f s (%.1f MiB/s, %zu threads)",
+               header.data_size, time.count(), header.data_size / (1024.0 * 1024.0) / time.count(),
+               pool.GetThreadCount());
     callback(GetStringT("Done compressing disc image."), 1.0f, arg);
   }
   return success;
@@ -366,9 +516,9 @@ bool DecompressBlobToFile(const std::string& infile_path, const std::string& out
   }
 
   const CompressedBlobHeader& header = reader->GetHeader();
+  const auto start_time = std::chrono::steady_clock::now();
   static const size_t BUFFER_BLOCKS = 32;
   size_t buffer_size = header.block_size * BUFFER_BLOCKS;
-  size_t last_buffer_size = header.block_size * (header.num_blocks % BUFFER_BLOCKS);
   std::vector<u8> buffer(buffer_size);
   u32 num_buffers = (header.num_blocks + BUFFER_BLOCKS - 1) / BUFFER_BLOCKS;
   int progress_monitor = std::max<int>(1, num_buffers / 100);
@@ -385,7 +535,8 @@ bool DecompressBlobToFile(const std::string& infile_path, const std::string& out
         break;
       }
     }
-    const size_t sz = i == num_buffers - 1 ? last_buffer_size : buffer_size;
+    const size_t sz =
+        static_cast<size_t>(std::min<u64>(buffer_size, header.data_size - i * buffer_size));
     reader->Read(i * buffer_size, sz, buffer.data());
     if (!outfile.WriteBytes(buffer.data(), sz))
     {
@@ -406,6 +557,9 @@ bool DecompressBlobToFile(const std::string& infile_path, const std::string& out
   else
   {
     outfile.Resize(header.data_size);
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start_time;
+    NOTICE_LOG(DISCIO, "Decompressed %" PRIu64 " bytes in %.2f s (%.1f MiB/s)", header.data_size,
+               time.count(), header.data_size / (1024.0 * 1024.0) / time.count());
   }
 
   return success;
@@ -52,11 +52,19 @@ public:
   u64 GetDataSize() const override { return m_header.data_size; }
   u64 GetRawSize() const override { return m_file_size; }
   u64 GetBlockCompressedSize(u64 block_num) const;
+  // Reads which go past the end of the data fail, instead of returning the padding of the last
+  // block.
+  bool Read(u64 offset, u64 size, u8* out_ptr) override;
   bool GetBlock(u64 block_num, u8* out_ptr) override;
+  bool ReadMultipleAlignedBlocks(u64 block_num, u64 num_blocks, u8* out_ptr) override;
 
 private:
   CompressedBlobReader(File::IOFile file, const std::string& filename);
 
+  // Thread-safe, so that neighbouring blocks can be decompressed in parallel.
+  bool DecompressBlock(u64 block_num, const u8* data, u32 size, bool uncompressed,
+                       u8* out_ptr) const;
+
   CompressedBlobHeader m_header;
   std::vector<u64> m_block_pointers;
   std::vector<u32> m_hashes;
@@ -64,6 +72,7 @@ private:
   File::IOFile m_file;
   u64 m_file_size;
   std::vector<u8> m_zlib_buffer;
+  std::vector<u8> m_read_ahead_buffer;
   std::string m_file_name;
 };
 
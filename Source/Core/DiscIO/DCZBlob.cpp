@@ -0,0 +1,826 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "DiscIO/DCZBlob.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mbedtls/aes.h>
+#include <mbedtls/sha1.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Common/CommonTypes.h"
+#include "Common/Crypto/AES.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Common/MsgHandler.h"
+#include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
+#include "Core/IOS/ES/Formats.h"
+#include "DiscIO/Blob.h"
+#include "DiscIO/Enums.h"
+#include "DiscIO/Volume.h"
+#include "DiscIO/VolumeWii.h"
+
+namespace DiscIO
+{
+constexpr u32 BLOCK_HEADER_SIZE = VolumeWii::BLOCK_HEADER_SIZE;
+constexpr u32 BLOCK_DATA_SIZE = VolumeWii::BLOCK_DATA_SIZE;
+constexpr u32 BLOCK_TOTAL_SIZE = VolumeWii::BLOCK_TOTAL_SIZE;
+constexpr u32 BLOCKS_PER_SUBGROUP = 8;
+constexpr u32 BLOCKS_PER_GROUP = DCZ_GROUP_SIZE / BLOCK_TOTAL_SIZE;
+
+// Layout of a decrypted hash block
+constexpr u32 SHA1_SIZE = 20;
+constexpr u32 H0_HASHES = BLOCK_DATA_SIZE / 0x400;
+constexpr u32 H0_OFFSET = 0x000;
+constexpr u32 H1_OFFSET = 0x280;
+constexpr u32 H2_OFFSET = 0x340;
+// The IV of the data is taken from the encrypted hash block.
+constexpr u32 IV_OFFSET = 0x3D0;
+
+constexpr u32 UNCOMPRESSED_CHUNK = 0x80000000;
+
+bool IsDCZCompressionSupported(DCZCompression compression)
+{
+  switch (compression)
+  {
+  case DCZCompression::None:
+  case DCZCompression::Zlib:
+    return true;
+  case DCZCompression::LZMA:
+#ifdef HAVE_LZMA
+    return true;
+#else
+    return false;
+#endif
+  case DCZCompression::Zstd:
+#ifdef HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+static bool CompressChunkData(DCZCompression compression, int level, const std::vector<u8>& in,
+                              std::vector<u8>* out)
+{
+  switch (compression)
+  {
+  case DCZCompression::Zlib:
+  {
+    uLongf out_size = compressBound(static_cast<uLong>(in.size()));
+    out->resize(out_size);
+    if (compress2(out->data(), &out_size, in.data(), static_cast<uLong>(in.size()), level) != Z_OK)
+      return false;
+    out->resize(out_size);
+    return true;
+  }
+#ifdef HAVE_LZMA
+  case DCZCompression::LZMA:
+  {
+    size_t out_size = 0;
+    out->resize(lzma_stream_buffer_bound(in.size()));
+    if (lzma_easy_buffer_encode(static_cast<u32>(level), LZMA_CHECK_NONE, nullptr, in.data(),
+                                in.size(), out->data(), &out_size, out->size()) != LZMA_OK)
+    {
+      return false;
+    }
+    out->resize(out_size);
+    return true;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case DCZCompression::Zstd:
+  {
+    out->resize(ZSTD_compressBound(in.size()));
+    const size_t out_size = ZSTD_compress(out->data(), out->size(), in.data(), in.size(), level);
+    if (ZSTD_isError(out_size))
+      return false;
+    out->resize(out_size);
+    return true;
+  }
+#endif
+  default:
+    return false;
+  }
+}
+
+static bool DecompressChunkData(DCZCompression compression, const u8* in, size_t in_size, u8* out,
+                                size_t out_size)
+{
+  switch (compression)
+  {
+  case DCZCompression::Zlib:
+  {
+    uLongf size = static_cast<uLongf>(out_size);
+    return uncompress(out, &size, in, static_cast<uLong>(in_size)) == Z_OK && size == out_size;
+  }
+#ifdef HAVE_LZMA
+  case DCZCompression::LZMA:
+  {
+    u64 memory_limit = UINT64_MAX;
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    return lzma_stream_buffer_decode(&memory_limit, 0, nullptr, in, &in_pos, in_size, out,
+                                     &out_pos, out_size) == LZMA_OK &&
+           out_pos == out_size;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case DCZCompression::Zstd:
+    return ZSTD_decompress(out, out_size, in, in_size) == out_size;
+#endif
+  default:
+    return false;
+  }
+}
+
+void DCZFileReader::HashGroup(const u8* data, u32 num_blocks, u8* hash_blocks)
+{
+  std::fill(hash_blocks, hash_blocks + num_blocks * BLOCK_HEADER_SIZE, 0);
+
+  // H0: one hash for every 0x400 bytes of the block's data
+  for (u32 i = 0; i < num_blocks; i++)
+  {
+    for (u32 j = 0; j < H0_HASHES; j++)
+    {
+      mbedtls_sha1(data + i * BLOCK_DATA_SIZE + j * 0x400, 0x400,
+                   hash_blocks + i * BLOCK_HEADER_SIZE + H0_OFFSET + j * SHA1_SIZE);
+    }
+  }
+
+  // H1: the hashes of the H0 tables of the blocks in the subgroup
+  const u32 num_subgroups = (num_blocks + BLOCKS_PER_SUBGROUP - 1) / BLOCKS_PER_SUBGROUP;
+  for (u32 subgroup = 0; subgroup < num_subgroups; subgroup++)
+  {
+    const u32 first = subgroup * BLOCKS_PER_SUBGROUP;
+    const u32 end = std::min(first + BLOCKS_PER_SUBGROUP, num_blocks);
+
+    u8 h1[BLOCKS_PER_SUBGROUP * SHA1_SIZE] = {};
+    for (u32 i = first; i < end; i++)
+    {
+      mbedtls_sha1(hash_blocks + i * BLOCK_HEADER_SIZE + H0_OFFSET, H0_HASHES * SHA1_SIZE,
+                   h1 + (i - first) * SHA1_SIZE);
+    }
+    for (u32 i = first; i < end; i++)
+      std::copy_n(h1, sizeof(h1), hash_blocks + i * BLOCK_HEADER_SIZE + H1_OFFSET);
+  }
+
+  // H2: the hashes of the H1 tables of the subgroups in the group
+  u8 h2[BLOCKS_PER_GROUP / BLOCKS_PER_SUBGROUP * SHA1_SIZE] = {};
+  for (u32 subgroup = 0; subgroup < num_subgroups; subgroup++)
+  {
+    mbedtls_sha1(hash_blocks + subgroup * BLOCKS_PER_SUBGROUP * BLOCK_HEADER_SIZE + H1_OFFSET,
+                 BLOCKS_PER_SUBGROUP * SHA1_SIZE, h2 + subgroup * SHA1_SIZE);
+  }
+  for (u32 i = 0; i < num_blocks; i++)
+    std::copy_n(h2, sizeof(h2), hash_blocks + i * BLOCK_HEADER_SIZE + H2_OFFSET);
+}
+
+static void EncryptBlock(mbedtls_aes_context* aes_context, const u8* hash_block, const u8* data,
+                         u8* out)
+{
+  u8 iv[16] = {};
+  mbedtls_aes_crypt_cbc(aes_context, MBEDTLS_AES_ENCRYPT, BLOCK_HEADER_SIZE, iv, hash_block, out);
+  std::copy_n(out + IV_OFFSET, sizeof(iv), iv);
+  mbedtls_aes_crypt_cbc(aes_context, MBEDTLS_AES_ENCRYPT, BLOCK_DATA_SIZE, iv, data,
+                        out + BLOCK_HEADER_SIZE);
+}
+
+static void DecryptBlock(const Common::AES::Context& aes_context, const u8* in, u8* hash_block,
+                         u8* data)
+{
+  u8 iv[16] = {};
+  aes_context.DecryptCBC(iv, in, hash_block, BLOCK_HEADER_SIZE);
+  std::copy_n(in + IV_OFFSET, sizeof(iv), iv);
+  aes_context.DecryptCBC(iv, in + BLOCK_HEADER_SIZE, data, BLOCK_DATA_SIZE);
+}
+
+static void RecreateHashBlocks(const u8* data, u32 num_blocks, u8* hash_blocks)
+{
+  for (u32 first = 0; first < num_blocks; first += BLOCKS_PER_GROUP)
+  {
+    DCZFileReader::HashGroup(data + first * BLOCK_DATA_SIZE,
+                             std::min(BLOCKS_PER_GROUP, num_blocks - first),
+                             hash_blocks + first * BLOCK_HEADER_SIZE);
+  }
+}
+
+DCZFileReader::DCZFileReader(File::IOFile file, const std::string& path)
+    : m_file(std::move(file)), m_file_name(path)
+{
+}
+
+std::unique_ptr<DCZFileReader> DCZFileReader::Create(File::IOFile file, const std::string& path)
+{
+  std::unique_ptr<DCZFileReader> reader(new DCZFileReader(std::move(file), path));
+  if (!reader->Initialize())
+    return nullptr;
+
+  return reader;
+}
+
+bool DCZFileReader::Initialize()
+{
+  m_file_size = m_file.GetSize();
+  m_file.Seek(0, SEEK_SET);
+  if (!m_file.ReadArray(&m_header, 1) || m_header.magic_cookie != DCZ_MAGIC)
+    return false;
+
+  if (m_header.version != DCZ_VERSION)
+  {
+    ERROR_LOG(DISCIO, "DCZ file %s has unsupported version %u", m_file_name.c_str(),
+              m_header.version);
+    return false;
+  }
+
+  if (!IsDCZCompressionSupported(static_cast<DCZCompression>(m_header.compression)))
+  {
+    PanicAlertT("The disc image \"%s\" uses a compression method that is not supported by "
+                "this build of Dolphin.",
+                m_file_name.c_str());
+    return false;
+  }
+
+  const u64 tables_size = sizeof(DCZRegion) * static_cast<u64>(m_header.num_regions) +
+                          sizeof(DCZChunk) * static_cast<u64>(m_header.num_chunks);
+  if (m_header.chunk_size == 0 || m_header.chunk_size % DCZ_GROUP_SIZE != 0 ||
+      m_header.chunk_size > DCZ_MAX_CHUNK_SIZE || sizeof(DCZHeader) + tables_size > m_file_size)
+  {
+    PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+    return false;
+  }
+
+  m_regions.resize(m_header.num_regions);
+  m_chunks.resize(m_header.num_chunks);
+  if (!m_file.ReadArray(m_regions.data(), m_regions.size()) ||
+      !m_file.ReadArray(m_chunks.data(), m_chunks.size()))
+  {
+    PanicAlertT("The disc image \"%s\" is truncated, some of the data is missing.",
+                m_file_name.c_str());
+    return false;
+  }
+  m_data_offset = sizeof(DCZHeader) + tables_size;
+
+  // Check everything that the read functions rely on up front.
+  u64 next_offset = 0;
+  u32 next_chunk = 0;
+  for (const DCZRegion& region : m_regions)
+  {
+    const bool is_wii = region.type == static_cast<u32>(DCZRegionType::WiiPartitionData);
+    if (region.offset != next_offset || region.size == 0 ||
+        region.size > m_header.data_size - region.offset || region.first_chunk != next_chunk ||
+        (!is_wii && region.type != static_cast<u32>(DCZRegionType::Raw)) ||
+        (is_wii && region.size % BLOCK_TOTAL_SIZE != 0))
+    {
+      PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+      return false;
+    }
+
+    const u64 num_chunks = (region.size + m_header.chunk_size - 1) / m_header.chunk_size;
+    if (num_chunks > m_chunks.size() - next_chunk)
+    {
+      PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+      return false;
+    }
+
+    for (u32 i = 0; i < num_chunks; i++)
+    {
+      const DCZChunk& chunk = m_chunks[region.first_chunk + i];
+      const u64 disc_size =
+          std::min<u64>(m_header.chunk_size, region.size - u64(i) * m_header.chunk_size);
+      const u64 data_size = is_wii ? disc_size / BLOCK_TOTAL_SIZE * BLOCK_DATA_SIZE : disc_size;
+      const u32 stored_size = chunk.compressed_size & ~UNCOMPRESSED_CHUNK;
+      const bool valid_size =
+          is_wii ? chunk.uncompressed_size >= data_size + sizeof(u32) &&
+                       (chunk.uncompressed_size - data_size - sizeof(u32)) %
+                               sizeof(DCZHashException) ==
+                           0 :
+                   chunk.uncompressed_size == data_size;
+      if (!valid_size || chunk.offset + stored_size > m_file_size - m_data_offset ||
+          ((chunk.compressed_size & UNCOMPRESSED_CHUNK) && stored_size != chunk.uncompressed_size))
+      {
+        PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+        return false;
+      }
+    }
+
+    next_offset = region.offset + region.size;
+    next_chunk += static_cast<u32>(num_chunks);
+  }
+
+  if (next_offset != m_header.data_size || next_chunk != m_chunks.size())
+  {
+    PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+const DCZRegion* DCZFileReader::FindRegion(u64 offset) const
+{
+  auto it = std::upper_bound(m_regions.begin(), m_regions.end(), offset,
+                             [](u64 value, const DCZRegion& region) { return value < region.offset; });
+  if (it == m_regions.begin())
+    return nullptr;
+  --it;
+  return offset - it->offset < it->size ? &*it : nullptr;
+}
+
+const std::vector<u8>* DCZFileReader::GetChunk(u32 chunk_index)
+{
+  if (m_cached_chunk == chunk_index)
+    return &m_cached_chunk_data;
+
+  const DCZChunk& chunk = m_chunks[chunk_index];
+  const bool uncompressed = (chunk.compressed_size & UNCOMPRESSED_CHUNK) != 0;
+  const u32 stored_size = chunk.compressed_size & ~UNCOMPRESSED_CHUNK;
+
+  m_cached_chunk = UINT32_MAX;
+  m_cached_chunk_data.resize(chunk.uncompressed_size);
+  if (!uncompressed)
+    m_compressed_buffer.resize(stored_size);
+  u8* const read_buffer = uncompressed ? m_cached_chunk_data.data() : m_compressed_buffer.data();
+
+  m_file.Seek(m_data_offset + chunk.offset, SEEK_SET);
+  if (!m_file.ReadBytes(read_buffer, stored_size))
+  {
+    PanicAlertT("The disc image \"%s\" is truncated, some of the data is missing.",
+                m_file_name.c_str());
+    m_file.Clear();
+    return nullptr;
+  }
+
+  if (!uncompressed &&
+      !DecompressChunkData(static_cast<DCZCompression>(m_header.compression),
+                           m_compressed_buffer.data(), stored_size, m_cached_chunk_data.data(),
+                           m_cached_chunk_data.size()))
+  {
+    PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+    return nullptr;
+  }
+
+  m_cached_chunk = chunk_index;
+  return &m_cached_chunk_data;
+}
+
+const std::vector<u8>* DCZFileReader::GetEncryptedChunk(const DCZRegion& region, u32 chunk_index)
+{
+  if (m_cached_encrypted_chunk == chunk_index)
+    return &m_cached_encrypted_chunk_data;
+
+  const std::vector<u8>* chunk = GetChunk(chunk_index);
+  if (!chunk)
+    return nullptr;
+
+  const u64 chunk_offset = u64(chunk_index - region.first_chunk) * m_header.chunk_size;
+  const u32 num_blocks = static_cast<u32>(
+      std::min<u64>(m_header.chunk_size, region.size - chunk_offset) / BLOCK_TOTAL_SIZE);
+  const u8* const data = chunk->data();
+  const size_t exceptions_offset = size_t(num_blocks) * BLOCK_DATA_SIZE;
+
+  u32 num_exceptions;
+  std::memcpy(&num_exceptions, data + chunk->size() - sizeof(u32), sizeof(u32));
+  if (num_exceptions != (chunk->size() - exceptions_offset - sizeof(u32)) /
+                            sizeof(DCZHashException))
+  {
+    PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+    return nullptr;
+  }
+
+  std::vector<u8> hash_blocks(size_t(num_blocks) * BLOCK_HEADER_SIZE);
+  RecreateHashBlocks(data, num_blocks, hash_blocks.data());
+  for (u32 i = 0; i < num_exceptions; i++)
+  {
+    DCZHashException exception;
+    std::memcpy(&exception, data + exceptions_offset + i * sizeof(DCZHashException),
+                sizeof(DCZHashException));
+    if (exception.block >= num_blocks || exception.offset > BLOCK_HEADER_SIZE - SHA1_SIZE)
+    {
+      PanicAlertT("The disc image \"%s\" is corrupt.", m_file_name.c_str());
+      return nullptr;
+    }
+    std::copy(exception.data.begin(), exception.data.end(),
+              &hash_blocks[exception.block * BLOCK_HEADER_SIZE + exception.offset]);
+  }
+
+  mbedtls_aes_context aes_context;
+  mbedtls_aes_init(&aes_context);
+  mbedtls_aes_setkey_enc(&aes_context, region.title_key.data(), 128);
+
+  m_cached_encrypted_chunk_data.resize(size_t(num_blocks) * BLOCK_TOTAL_SIZE);
+  for (u32 i = 0; i < num_blocks; i++)
+  {
+    EncryptBlock(&aes_context, &hash_blocks[i * BLOCK_HEADER_SIZE], data + i * BLOCK_DATA_SIZE,
+                 &m_cached_encrypted_chunk_data[i * BLOCK_TOTAL_SIZE]);
+  }
+  mbedtls_aes_free(&aes_context);
+
+  m_cached_encrypted_chunk = chunk_index;
+  return &m_cached_encrypted_chunk_data;
+}
+
+bool DCZFileReader::Read(u64 offset, u64 size, u8* out_ptr)
+{
+  if (offset > m_header.data_size || size > m_header.data_size - offset)
+    return false;
+
+  while (size > 0)
+  {
+    const DCZRegion* region = FindRegion(offset);
+    if (!region)
+      return false;
+
+    const u64 offset_in_region = offset - region->offset;
+    const u32 chunk_index =
+        region->first_chunk + static_cast<u32>(offset_in_region / m_header.chunk_size);
+    const u64 offset_in_chunk = offset_in_region % m_header.chunk_size;
+
+    const std::vector<u8>* chunk =
+        region->type == static_cast<u32>(DCZRegionType::WiiPartitionData) ?
+            GetEncryptedChunk(*region, chunk_index) :
+            GetChunk(chunk_index);
+    if (!chunk)
+      return false;
+
+    const u64 bytes_to_copy = std::min(size, chunk->size() - offset_in_chunk);
+    std::copy_n(chunk->data() + offset_in_chunk, bytes_to_copy, out_ptr);
+
+    offset += bytes_to_copy;
+    size -= bytes_to_copy;
+    out_ptr += bytes_to_copy;
+  }
+
+  return true;
+}
+
+bool DCZFileReader::SupportsReadWiiDecrypted() const
+{
+  return (m_header.flags & DCZ_FLAG_WII_DECRYPTED) != 0;
+}
+
+bool DCZFileReader::ReadWiiDecrypted(u64 offset, u64 size, u8* out_ptr, u64 partition_offset)
+{
+  auto it = std::find_if(m_regions.begin(), m_regions.end(), [&](const DCZRegion& region) {
+    return region.type == static_cast<u32>(DCZRegionType::WiiPartitionData) &&
+           region.partition_offset == partition_offset;
+  });
+  if (it == m_regions.end())
+    return false;
+
+  const u64 data_size = it->size / BLOCK_TOTAL_SIZE * BLOCK_DATA_SIZE;
+  if (offset > data_size || size > data_size - offset)
+    return false;
+
+  const u64 data_per_chunk = m_header.chunk_size / BLOCK_TOTAL_SIZE * BLOCK_DATA_SIZE;
+  while (size > 0)
+  {
+    const u32 chunk_index = it->first_chunk + static_cast<u32>(offset / data_per_chunk);
+    const u64 offset_in_chunk = offset % data_per_chunk;
+    const u64 chunk_data_size = std::min(data_per_chunk, data_size - (offset - offset_in_chunk));
+
+    const std::vector<u8>* chunk = GetChunk(chunk_index);
+    if (!chunk)
+      return false;
+
+    const u64 bytes_to_copy = std::min(size, chunk_data_size - offset_in_chunk);
+    std::copy_n(chunk->data() + offset_in_chunk, bytes_to_copy, out_ptr);
+
+    offset += bytes_to_copy;
+    size -= bytes_to_copy;
+    out_ptr += bytes_to_copy;
+  }
+
+  return true;
+}
+
+// Finds the encrypted areas of the partitions that can be stored decrypted, sorted by offset.
+static std::vector<DCZRegion> GetWiiPartitionRegions(const Volume& volume, u64 data_size,
+                                                     bool* all_partitions)
+{
+  const std::vector<Partition> partitions = volume.GetPartitions();
+
+  std::vector<DCZRegion> regions;
+  for (const Partition& partition : partitions)
+  {
+    const IOS::ES::TicketReader& ticket = volume.GetTicket(partition);
+    const std::optional<u64> data_offset =
+        volume.ReadSwappedAndShifted(partition.offset + 0x2b8, PARTITION_NONE);
+    const std::optional<u64> size =
+        volume.ReadSwappedAndShifted(partition.offset + 0x2bc, PARTITION_NONE);
+    if (!ticket.IsValid() || !data_offset || !size || *size == 0 ||
+        *size % BLOCK_TOTAL_SIZE != 0 || partition.offset + *data_offset > data_size ||
+        *size > data_size - partition.offset - *data_offset)
+    {
+      WARN_LOG(DISCIO, "Storing the partition at %" PRIx64 " as it is", partition.offset);
+      continue;
+    }
+
+    DCZRegion region = {};
+    region.offset = partition.offset + *data_offset;
+    region.size = *size;
+    region.type = static_cast<u32>(DCZRegionType::WiiPartitionData);
+    region.partition_offset = partition.offset;
+    region.title_key = ticket.GetTitleKey();
+    regions.push_back(region);
+  }
+
+  std::sort(regions.begin(), regions.end(),
+            [](const DCZRegion& a, const DCZRegion& b) { return a.offset < b.offset; });
+  for (size_t i = 1; i < regions.size(); i++)
+  {
+    if (regions[i].offset < regions[i - 1].offset + regions[i - 1].size)
+      regions.erase(regions.begin() + i--);
+  }
+
+  *all_partitions = regions.size() == partitions.size();
+  return regions;
+}
+
+// Splits raw Wii blocks into their decrypted data and the hash exceptions that are needed to
+// recreate the hash blocks exactly.
+static std::vector<u8> DecryptChunk(const DCZRegion& region, const u8* in, u32 num_blocks)
+{
+  std::vector<u8> out(size_t(num_blocks) * BLOCK_DATA_SIZE);
+  std::vector<u8> hash_blocks(size_t(num_blocks) * BLOCK_HEADER_SIZE);
+
+  const std::unique_ptr<Common::AES::Context> aes_context =
+      Common::AES::CreateDecryptionContext(region.title_key.data());
+  for (u32 i = 0; i < num_blocks; i++)
+  {
+    DecryptBlock(*aes_context, in + i * BLOCK_TOTAL_SIZE, &hash_blocks[i * BLOCK_HEADER_SIZE],
+                 &out[i * BLOCK_DATA_SIZE]);
+  }
+
+  std::vector<u8> recreated_hash_blocks(hash_blocks.size());
+  RecreateHashBlocks(out.data(), num_blocks, recreated_hash_blocks.data());
+
+  u32 num_exceptions = 0;
+  for (u32 i = 0; i < num_blocks; i++)
+  {
+    for (u32 j = 0; j < BLOCK_HEADER_SIZE; j += SHA1_SIZE)
+    {
+      // 0x400 isn't a multiple of the hash size, so the last exception of a block overlaps
+      // the one before it.
+      const u32 offset = std::min(j, BLOCK_HEADER_SIZE - SHA1_SIZE);
+      const u8* const real = &hash_blocks[i * BLOCK_HEADER_SIZE + offset];
+      if (std::equal(real, real + SHA1_SIZE, &recreated_hash_blocks[i * BLOCK_HEADER_SIZE + offset]))
+        continue;
+
+      DCZHashException exception;
+      exception.block = static_cast<u16>(i);
+      exception.offset = static_cast<u16>(offset);
+      std::copy_n(real, SHA1_SIZE, exception.data.begin());
+
+      const u8* const exception_bytes = reinterpret_cast<const u8*>(&exception);
+      out.insert(out.end(), exception_bytes, exception_bytes + sizeof(exception));
+      num_exceptions++;
+    }
+  }
+
+  const u8* const count_bytes = reinterpret_cast<const u8*>(&num_exceptions);
+  out.insert(out.end(), count_bytes, count_bytes + sizeof(num_exceptions));
+  return out;
+}
+
+bool ConvertToDCZ(const std::string& infile_path, const std::string& outfile_path,
+                  DCZCompression compression, int compression_level, u32 chunk_size,
+                  CompressCB callback, void* arg, unsigned int num_threads)
+{
+  if (!IsDCZCompressionSupported(compression))
+  {
+    PanicAlertT("The selected compression method is not supported by this build of Dolphin.");
+    return false;
+  }
+
+  if (chunk_size == 0 || chunk_size % DCZ_GROUP_SIZE != 0 || chunk_size > DCZ_MAX_CHUNK_SIZE)
+  {
+    PanicAlert("DCZ chunk size %u is not a multiple of 2 MiB between 2 MiB and 1 GiB", chunk_size);
+    return false;
+  }
+
+  std::unique_ptr<BlobReader> reader = CreateBlobReader(infile_path);
+  if (!reader)
+  {
+    PanicAlertT("Failed to open the input file \"%s\".", infile_path.c_str());
+    return false;
+  }
+
+  if (reader->GetBlobType() == BlobType::DCZ)
+  {
+    PanicAlertT("\"%s\" is already compressed! Cannot compress it further.", infile_path.c_str());
+    return false;
+  }
+
+  File::IOFile outfile(outfile_path, "wb");
+  if (!outfile)
+  {
+    PanicAlertT("Failed to open the output file \"%s\".\n"
+                "Check that you have permissions to write the target folder and that the media can "
+                "be written.",
+                outfile_path.c_str());
+    return false;
+  }
+
+  DCZHeader header = {};
+  header.magic_cookie = DCZ_MAGIC;
+  header.version = DCZ_VERSION;
+  header.compression = static_cast<u32>(compression);
+  header.chunk_size = chunk_size;
+  header.data_size = reader->GetDataSize();
+
+  // Store the encrypted area of each Wii partition decrypted and put raw regions in between.
+  std::vector<DCZRegion> wii_regions;
+  std::unique_ptr<Volume> volume = CreateVolumeFromFilename(infile_path);
+  if (volume && volume->GetVolumeType() == Platform::WiiDisc && volume->IsEncryptedAndHashed())
+  {
+    bool all_partitions;
+    wii_regions = GetWiiPartitionRegions(*volume, header.data_size, &all_partitions);
+    if (all_partitions)
+      header.flags |= DCZ_FLAG_WII_DECRYPTED;
+  }
+  volume.reset();
+
+  std::vector<DCZRegion> regions;
+  u64 position = 0;
+  for (const DCZRegion& wii_region : wii_regions)
+  {
+    if (wii_region.offset > position)
+    {
+      DCZRegion raw_region = {};
+      raw_region.offset = position;
+      raw_region.size = wii_region.offset - position;
+      raw_region.type = static_cast<u32>(DCZRegionType::Raw);
+      regions.push_back(raw_region);
+    }
+    regions.push_back(wii_region);
+    position = wii_region.offset + wii_region.size;
+  }
+  if (header.data_size > position)
+  {
+    DCZRegion raw_region = {};
+    raw_region.offset = position;
+    raw_region.size = header.data_size - position;
+    raw_region.type = static_cast<u32>(DCZRegionType::Raw);
+    regions.push_back(raw_region);
+  }
+
+  // Every chunk is compressed on its own, so a batch of them is read in order, compressed on
+  // all threads at once and then written in order. The output doesn't depend on the number of
+  // threads.
+  struct ChunkJob
+  {
+    const DCZRegion* region;
+    u64 offset;
+    u32 size;
+  };
+  std::vector<ChunkJob> jobs;
+  for (DCZRegion& region : regions)
+  {
+    region.first_chunk = static_cast<u32>(jobs.size());
+    for (u64 offset = 0; offset < region.size; offset += chunk_size)
+    {
+      jobs.push_back({&region, region.offset + offset,
+                      static_cast<u32>(std::min<u64>(chunk_size, region.size - offset))});
+    }
+  }
+  header.num_regions = static_cast<u32>(regions.size());
+  header.num_chunks = static_cast<u32>(jobs.size());
+  std::vector<DCZChunk> chunks(jobs.size());
+
+  Common::ThreadPool pool(num_threads, "DCZ compression");
+  const size_t batch_size = pool.GetThreadCount();
+  std::vector<std::vector<u8>> in_bufs(batch_size);
+  std::vector<std::vector<u8>> data_bufs(batch_size);
+  std::vector<std::vector<u8>> out_bufs(batch_size);
+  std::vector<bool> stored(batch_size);
+
+  if (callback)
+    callback(GetStringT("Files opened, ready to compress."), 0, arg);
+
+  // seek past the header and tables (we will write them at the end)
+  outfile.Seek(sizeof(DCZHeader) + sizeof(DCZRegion) * regions.size() +
+                   sizeof(DCZChunk) * chunks.size(),
+               SEEK_SET);
+
+  u64 written = 0;
+  bool success = true;
+  for (size_t first = 0; first < jobs.size() && success; first += batch_size)
+  {
+    const size_t count = std::min(batch_size, jobs.size() - first);
+
+    if (callback)
+    {
+      const u64 read = jobs[first].offset;
+      const int ratio = read ? static_cast<int>(100 * written / read) : 0;
+      const std::string text =
+          StringFromFormat(GetStringT("%i of %i chunks. Compression ratio %i%%").c_str(),
+                           static_cast<int>(first), static_cast<int>(jobs.size()), ratio);
+      if (!callback(text, static_cast<float>(first) / jobs.size(), arg))
+      {
+        success = false;
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const ChunkJob& job = jobs[first + i];
+      in_bufs[i].resize(job.size);
+      if (!reader->Read(job.offset, job.size, in_bufs[i].data()))
+      {
+        PanicAlertT("Failed to read from the input file \"%s\".", infile_path.c_str());
+        success = false;
+        break;
+      }
+    }
+    if (!success)
+      break;
+
+    std::atomic<bool> compression_failed{false};
+    pool.ParallelFor(count, [&](size_t i) {
+      const ChunkJob& job = jobs[first + i];
+      if (job.region->type == static_cast<u32>(DCZRegionType::WiiPartitionData))
+        data_bufs[i] = DecryptChunk(*job.region, in_bufs[i].data(), job.size / BLOCK_TOTAL_SIZE);
+      else
+        data_bufs[i].swap(in_bufs[i]);
+
+      stored[i] = compression == DCZCompression::None;
+      if (!stored[i])
+      {
+        if (!CompressChunkData(compression, compression_level, data_bufs[i], &out_bufs[i]))
+          compression_failed = true;
+        // Don't bother with chunks that hardly compress.
+        stored[i] = out_bufs[i].size() >= data_bufs[i].size();
+      }
+    });
+
+    if (compression_failed)
+    {
+      ERROR_LOG(DISCIO, "DCZ compression failed");
+      success = false;
+      break;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const std::vector<u8>& buf = stored[i] ? data_bufs[i] : out_bufs[i];
+      DCZChunk& chunk = chunks[first + i];
+      chunk.offset = written;
+      chunk.compressed_size = static_cast<u32>(buf.size()) | (stored[i] ? UNCOMPRESSED_CHUNK : 0);
+      chunk.uncompressed_size = static_cast<u32>(data_bufs[i].size());
+
+      if (!outfile.WriteBytes(buf.data(), buf.size()))
+      {
+        PanicAlertT("Failed to write the output file \"%s\".\n"
+                    "Check that you have enough space available on the target drive.",
+                    outfile_path.c_str());
+        success = false;
+        break;
+      }
+      written += buf.size();
+    }
+  }
+
+  if (!success)
+  {
+    // Remove the incomplete output file.
+    outfile.Close();
+    File::Delete(outfile_path);
+    return false;
+  }
+
+  // Okay, go back and fill in headers
+  outfile.Seek(0, SEEK_SET);
+  outfile.WriteArray(&header, 1);
+  outfile.WriteArray(regions.data(), regions.size());
+  outfile.WriteArray(chunks.data(), chunks.size());
+
+  if (callback)
+    callback(GetStringT("Done compressing disc image."), 1.0f, arg);
+  return true;
+}
+
+}  // namespace
@@ -0,0 +1,149 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// WARNING Code not big-endian safe.
+
+// DCZ is a compressed disc image format that is split into large chunks, each of which can be
+// decompressed on its own. Unlike GCZ, the encrypted parts of Wii partitions are stored
+// decrypted and without their hash blocks, which makes them compress far better. The hashes
+// and the encryption are recreated when raw data is read, and VolumeWii can skip them entirely
+// by using ReadWiiDecrypted.
+
+// To create new DCZ files, use ConvertToDCZ.
+
+// File format
+// * Header
+// * [Regions]
+// * [Chunk table]
+// * [Data]
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "DiscIO/Blob.h"
+
+namespace DiscIO
+{
+static constexpr u32 DCZ_MAGIC = 0x015A4344;  // "DCZ\x01"
+static constexpr u32 DCZ_VERSION = 1;
+
+// Chunks of Wii partition data always cover whole groups of blocks, since the H1 and H2 hashes
+// of a block depend on the other blocks of its group.
+static constexpr u32 DCZ_GROUP_SIZE = 0x200000;
+// Larger chunks would overflow DCZHashException::block and the size fields of DCZChunk.
+static constexpr u32 DCZ_MAX_CHUNK_SIZE = 512 * DCZ_GROUP_SIZE;
+
+enum class DCZRegionType : u32
+{
+  Raw = 0,
+  WiiPartitionData = 1,
+};
+
+enum DCZFlags : u32
+{
+  // Every partition of the disc is stored as WiiPartitionData, so all decrypted reads can be
+  // served without touching AES.
+  DCZ_FLAG_WII_DECRYPTED = 1 << 0,
+};
+
+struct DCZHeader  // 40 bytes
+{
+  u32 magic_cookie;
+  u32 version;
+  u32 compression;  // DCZCompression
+  u32 chunk_size;   // Disc bytes covered by a chunk. A multiple of DCZ_GROUP_SIZE.
+  u64 data_size;
+  u32 num_regions;
+  u32 num_chunks;
+  u32 flags;
+  u32 reserved;
+};
+static_assert(sizeof(DCZHeader) == 40, "DCZHeader has the wrong size");
+
+// The regions cover the disc without gaps, in order. Each region is split into chunks of
+// chunk_size bytes (the last one may be shorter), numbered from first_chunk.
+//
+// A chunk of a WiiPartitionData region decompresses to the decrypted data of its blocks,
+// followed by the hash exceptions (parts of the hash blocks that don't match the recreated
+// hashes) and their count.
+struct DCZRegion  // 48 bytes
+{
+  u64 offset;
+  u64 size;
+  u32 type;  // DCZRegionType
+  u32 first_chunk;
+  u64 partition_offset;
+  std::array<u8, 16> title_key;
+};
+static_assert(sizeof(DCZRegion) == 48, "DCZRegion has the wrong size");
+
+struct DCZChunk  // 16 bytes
+{
+  u64 offset;
+  u32 compressed_size;  // Top bit specifies that the chunk is stored uncompressed.
+  u32 uncompressed_size;
+};
+static_assert(sizeof(DCZChunk) == 16, "DCZChunk has the wrong size");
+
+struct DCZHashException  // 24 bytes
+{
+  u16 block;   // Relative to the start of the chunk
+  u16 offset;  // In the decrypted hash block
+  std::array<u8, 20> data;
+};
+static_assert(sizeof(DCZHashException) == 24, "DCZHashException has the wrong size");
+
+class DCZFileReader : public BlobReader
+{
+public:
+  static std::unique_ptr<DCZFileReader> Create(File::IOFile file, const std::string& path);
+
+  BlobType GetBlobType() const override { return BlobType::DCZ; }
+  u64 GetRawSize() const override { return m_file_size; }
+  u64 GetDataSize() const override { return m_header.data_size; }
+  const DCZHeader& GetHeader() const { return m_header; }
+
+  bool Read(u64 offset, u64 size, u8* out_ptr) override;
+  bool SupportsReadWiiDecrypted() const override;
+  bool ReadWiiDecrypted(u64 offset, u64 size, u8* out_ptr, u64 partition_offset) override;
+
+  // Recreates the hash blocks of up to one group of blocks from their decrypted data.
+  // data holds num_blocks * BLOCK_DATA_SIZE bytes, hash_blocks receives
+  // num_blocks * BLOCK_HEADER_SIZE bytes.
+  static void HashGroup(const u8* data, u32 num_blocks, u8* hash_blocks);
+
+private:
+  DCZFileReader(File::IOFile file, const std::string& path);
+  bool Initialize();
+
+  const DCZRegion* FindRegion(u64 offset) const;
+  // Returns the decompressed contents of a chunk, or nullptr if it can't be read.
+  const std::vector<u8>* GetChunk(u32 chunk_index);
+  // Returns the raw contents of a chunk of a WiiPartitionData region, with recreated hashes
+  // and encryption.
+  const std::vector<u8>* GetEncryptedChunk(const DCZRegion& region, u32 chunk_index);
+
+  DCZHeader m_header;
+  std::vector<DCZRegion> m_regions;
+  std::vector<DCZChunk> m_chunks;
+  u64 m_data_offset;
+
+  File::IOFile m_file;
+  u64 m_file_size;
+  std::string m_file_name;
+
+  std::vector<u8> m_compressed_buffer;
+  u32 m_cached_chunk = UINT32_MAX;
+  std::vector<u8> m_cached_chunk_data;
+  u32 m_cached_encrypted_chunk = UINT32_MAX;
+  std::vector<u8> m_cached_encrypted_chunk_data;
+};
+
+}  // namespace
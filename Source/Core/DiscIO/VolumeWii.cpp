@@ -9,7 +9,6 @@
 #include <cstddef>
 #include <cstring>
 #include <map>
-#include <mbedtls/aes.h>
 #include <mbedtls/sha1.h>
 #include <memory>
 #include <optional>
@@ -19,6 +18,7 @@
 
 #include "Common/Assert.h"
 #include "Common/CommonTypes.h"
+#include "Common/Crypto/AES.h"
 #include "Common/Logging/Log.h"
 #include "Common/MsgHandler.h"
 #include "Common/Swap.h"
@@ -33,9 +33,11 @@
 
 namespace DiscIO
 {
+// Whole blocks are read and decrypted at most this many at a time.
+constexpr u64 MAX_BLOCKS_PER_READ = 32;
+
 VolumeWii::VolumeWii(std::unique_ptr<BlobReader> reader)
-    : m_reader(std::move(reader)), m_game_partition(PARTITION_NONE),
-      m_last_decrypted_block(UINT64_MAX)
+    : m_reader(std::move(reader)), m_game_partition(PARTITION_NONE)
 {
   ASSERT(m_reader);
 
@@ -97,14 +99,12 @@ VolumeWii::VolumeWii(std::unique_ptr<BlobReader> reader)
         return IOS::ES::TMDReader{std::move(tmd_buffer)};
       };
 
-      auto get_key = [this, partition]() -> std::unique_ptr<mbedtls_aes_context> {
+      auto get_key = [this, partition]() -> std::unique_ptr<Common::AES::Context> {
         const IOS::ES::TicketReader& ticket = *m_partitions[partition].ticket;
         if (!ticket.IsValid())
           return nullptr;
         const std::array<u8, 16> key = ticket.GetTitleKey();
-        std::unique_ptr<mbedtls_aes_context> aes_context = std::make_unique<mbedtls_aes_context>();
-        mbedtls_aes_setkey_dec(aes_context.get(), key.data(), 128);
-        return aes_context;
+        return Common::AES::CreateDecryptionContext(key.data());
       };
 
       auto get_file_system = [this, partition]() -> std::unique_ptr<FileSystem> {
@@ -117,7 +117,7 @@ VolumeWii::VolumeWii(std::unique_ptr<BlobReader> reader)
       };
 
       m_partitions.emplace(
-          partition, PartitionDetails{Common::Lazy<std::unique_ptr<mbedtls_aes_context>>(get_key),
+          partition, PartitionDetails{Common::Lazy<std::unique_ptr<Common::AES::Context>>(get_key),
                                       Common::Lazy<IOS::ES::TicketReader>(get_ticket),
                                       Common::Lazy<IOS::ES::TMDReader>(get_tmd),
                                       Common::Lazy<std::unique_ptr<FileSystem>>(get_file_system),
@@ -149,42 +149,45 @@ bool VolumeWii::Read(u64 offset, u64 length, u8* buffer, const Partition& partit
   if (m_reader->SupportsReadWiiDecrypted())
     return m_reader->ReadWiiDecrypted(offset, length, buffer, partition.offset);
 
-  mbedtls_aes_context* aes_context = partition_details.key->get();
+  const Common::AES::Context* aes_context = partition_details.key->get();
   if (!aes_context)
     return false;
 
-  std::vector<u8> read_buffer(BLOCK_TOTAL_SIZE);
+  const u64 partition_data_offset = partition.offset + *partition_details.data_offset;
   while (length > 0)
   {
     // Calculate offsets
-    u64 block_offset_on_disc = partition.offset + *partition_details.data_offset +
-                               offset / BLOCK_DATA_SIZE * BLOCK_TOTAL_SIZE;
-    u64 data_offset_in_block = offset % BLOCK_DATA_SIZE;
+    const u64 block_offset_on_disc =
+        partition_data_offset + offset / BLOCK_DATA_SIZE * BLOCK_TOTAL_SIZE;
+    const u64 data_offset_in_block = offset % BLOCK_DATA_SIZE;
 
-    if (m_last_decrypted_block != block_offset_on_disc)
+    u64 copy_size;
+    if (data_offset_in_block == 0 && length >= BLOCK_DATA_SIZE &&
+        !FindDecryptedBlock(block_offset_on_disc))
     {
-      // Read the current block
-      if (!m_reader->Read(block_offset_on_disc, BLOCK_TOTAL_SIZE, read_buffer.data()))
-        return false;
+      // Large reads are decrypted straight into the buffer, as many blocks at a time as
+      // possible, without going through the cache.
+      const u64 max_blocks = std::min(length / BLOCK_DATA_SIZE, MAX_BLOCKS_PER_READ);
+      u64 num_blocks = 1;
+      while (num_blocks < max_blocks &&
+             !FindDecryptedBlock(block_offset_on_disc + num_blocks * BLOCK_TOTAL_SIZE))
+      {
+        num_blocks++;
+      }
 
-      // Decrypt the block's data.
-      // 0x3D0 - 0x3DF in read_buffer will be overwritten,
-      // but that won't affect anything, because we won't
-      // use the content of read_buffer anymore after this
-      mbedtls_aes_crypt_cbc(aes_context, MBEDTLS_AES_DECRYPT, BLOCK_DATA_SIZE, &read_buffer[0x3D0],
-                            &read_buffer[BLOCK_HEADER_SIZE], m_last_decrypted_block_data);
-      m_last_decrypted_block = block_offset_on_disc;
-
-      // The only thing we currently use from the 0x000 - 0x3FF part
-      // of the block is the IV (at 0x3D0), but it also contains SHA-1
-      // hashes that IOS uses to check that discs aren't tampered with.
-      // http://wiibrew.org/wiki/Wii_Disc#Encrypted
+      if (!ReadAndDecryptBlocks(*aes_context, block_offset_on_disc, num_blocks, buffer))
+        return false;
+      copy_size = num_blocks * BLOCK_DATA_SIZE;
     }
+    else
+    {
+      const u8* block_data = GetDecryptedBlock(*aes_context, block_offset_on_disc);
+      if (!block_data)
+        return false;
 
-    // Copy the decrypted data
-    u64 copy_size = std::min(length, BLOCK_DATA_SIZE - data_offset_in_block);
-    memcpy(buffer, &m_last_decrypted_block_data[data_offset_in_block],
-           static_cast<size_t>(copy_size));
+      copy_size = std::min(length, BLOCK_DATA_SIZE - data_offset_in_block);
+      memcpy(buffer, &block_data[data_offset_in_block], static_cast<size_t>(copy_size));
+    }
 
     // Update offsets
     length -= copy_size;
@@ -195,6 +198,61 @@ bool VolumeWii::Read(u64 offset, u64 length, u8* buffer, const Partition& partit
   return true;
 }
 
+bool VolumeWii::ReadAndDecryptBlocks(const Common::AES::Context& aes_context, u64 offset_on_disc,
+                                     u64 num_blocks, u8* out) const
+{
+  m_read_buffer.resize(num_blocks * BLOCK_TOTAL_SIZE);
+  if (!m_reader->Read(offset_on_disc, m_read_buffer.size(), m_read_buffer.data()))
+    return false;
+
+  for (u64 i = 0; i < num_blocks; i++)
+  {
+    // The IV of the data is at 0x3D0 in the block's (still encrypted) hash area. It gets
+    // overwritten, but we don't use the rest of the read buffer anyway. The 0x000 - 0x3FF part
+    // of the block also contains SHA-1 hashes that IOS uses to check that discs aren't
+    // tampered with.
+    // http://wiibrew.org/wiki/Wii_Disc#Encrypted
+    u8* const block = &m_read_buffer[i * BLOCK_TOTAL_SIZE];
+    aes_context.DecryptCBC(&block[0x3D0], &block[BLOCK_HEADER_SIZE], out + i * BLOCK_DATA_SIZE,
+                           BLOCK_DATA_SIZE);
+  }
+
+  return true;
+}
+
+VolumeWii::DecryptedBlock* VolumeWii::FindDecryptedBlock(u64 offset_on_disc) const
+{
+  for (DecryptedBlock& block : m_decrypted_blocks)
+  {
+    if (block.offset_on_disc == offset_on_disc)
+    {
+      block.last_used = ++m_decrypted_blocks_clock;
+      return &block;
+    }
+  }
+  return nullptr;
+}
+
+const u8* VolumeWii::GetDecryptedBlock(const Common::AES::Context& aes_context,
+                                       u64 offset_on_disc) const
+{
+  if (DecryptedBlock* block = FindDecryptedBlock(offset_on_disc))
+    return block->data.data();
+
+  DecryptedBlock& block = *std::min_element(
+      m_decrypted_blocks.begin(), m_decrypted_blocks.end(),
+      [](const DecryptedBlock& a, const DecryptedBlock& b) { return a.last_used < b.last_used; });
+
+  block.offset_on_disc = UINT64_MAX;
+  block.data.resize(BLOCK_DATA_SIZE);
+  if (!ReadAndDecryptBlocks(aes_context, offset_on_disc, 1, block.data.data()))
+    return nullptr;
+
+  block.offset_on_disc = offset_on_disc;
+  block.last_used = ++m_decrypted_blocks_clock;
+  return block.data.data();
+}
+
 bool VolumeWii::IsEncryptedAndHashed() const
 {
   return m_encrypted;
@@ -389,7 +447,7 @@ bool VolumeWii::CheckIntegrity(const Partition& partition) const
   if (it == m_partitions.end())
     return false;
   const PartitionDetails& partition_details = it->second;
-  mbedtls_aes_context* aes_context = partition_details.key->get();
+  const Common::AES::Context* aes_context = partition_details.key->get();
   if (!aes_context)
     return false;
 
@@ -413,8 +471,8 @@ bool VolumeWii::CheckIntegrity(const Partition& partition) const
       WARN_LOG(DISCIO, "Integrity Check: fail at cluster %d: could not read metadata", cluster_id);
       return false;
     }
-    mbedtls_aes_crypt_cbc(aes_context, MBEDTLS_AES_DECRYPT, sizeof(cluster_metadata), iv,
-                          cluster_metadata_crypted, cluster_metadata);
+    aes_context->DecryptCBC(iv, cluster_metadata_crypted, cluster_metadata,
+                            sizeof(cluster_metadata));
 
     // Some clusters have invalid data and metadata because they aren't
     // meant to be read by the game (for example, holes between files). To
@@ -4,14 +4,15 @@
 
 #pragma once
 
+#include <array>
 #include <map>
-#include <mbedtls/aes.h>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/Crypto/AES.h"
 #include "Common/Lazy.h"
 #include "Core/IOS/ES/Formats.h"
 #include "DiscIO/Filesystem.h"
@@ -73,7 +74,7 @@ protected:
 private:
   struct PartitionDetails
   {
-    Common::Lazy<std::unique_ptr<mbedtls_aes_context>> key;
+    Common::Lazy<std::unique_ptr<Common::AES::Context>> key;
     Common::Lazy<IOS::ES::TicketReader> ticket;
     Common::Lazy<IOS::ES::TMDReader> tmd;
     Common::Lazy<std::unique_ptr<FileSystem>> file_system;
@@ -81,13 +82,29 @@ private:
     u32 type;
   };
 
+  struct DecryptedBlock
+  {
+    u64 offset_on_disc = UINT64_MAX;
+    u64 last_used = 0;
+    std::vector<u8> data;
+  };
+
+  // Reads num_blocks consecutive blocks at once and decrypts their data into out.
+  bool ReadAndDecryptBlocks(const Common::AES::Context& aes_context, u64 offset_on_disc,
+                            u64 num_blocks, u8* out) const;
+  DecryptedBlock* FindDecryptedBlock(u64 offset_on_disc) const;
+  const u8* GetDecryptedBlock(const Common::AES::Context& aes_context, u64 offset_on_disc) const;
+
   std::unique_ptr<BlobReader> m_reader;
   std::map<Partition, PartitionDetails> m_partitions;
   Partition m_game_partition;
   bool m_encrypted;
 
-  mutable u64 m_last_decrypted_block;
-  mutable u8 m_last_decrypted_block_data[BLOCK_DATA_SIZE];
+  // A small LRU cache of decrypted blocks for reads which don't cover whole blocks.
+  static constexpr size_t DECRYPTED_BLOCK_CACHE_SIZE = 16;
+  mutable std::array<DecryptedBlock, DECRYPTED_BLOCK_CACHE_SIZE> m_decrypted_blocks;
+  mutable u64 m_decrypted_blocks_clock = 0;
+  mutable std::vector<u8> m_read_buffer;
 };
 
 }  // namespace
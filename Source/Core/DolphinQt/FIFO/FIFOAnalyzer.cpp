@@ -4,6 +4,9 @@
 
 #include "DolphinQt/FIFO/FIFOAnalyzer.h"
 
+#include <optional>
+#include <vector>
+
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QHeaderView>
@@ -173,13 +176,17 @@ void FIFOAnalyzer::UpdateDetails()
   int object_nr = items[0]->data(0, OBJECT_ROLE).toInt();
 
   const auto& frame_info = FifoPlayer::GetInstance().GetAnalyzedFrameInfo(frame_nr);
-  const auto& fifo_frame = FifoPlayer::GetInstance().GetFile()->GetFrame(frame_nr);
+  const std::optional<std::vector<u8>> frame_fifo_data =
+      FifoPlayer::GetInstance().GetFile()->GetFrameFifoData(frame_nr);
+  if (!frame_fifo_data)
+    return;
+  const std::vector<u8>& fifo_data = *frame_fifo_data;
 
-  const u8* objectdata_start = &fifo_frame.fifoData[frame_info.objectStarts[object_nr]];
-  const u8* objectdata_end = &fifo_frame.fifoData[frame_info.objectEnds[object_nr]];
+  const u8* objectdata_start = &fifo_data[frame_info.objectStarts[object_nr]];
+  const u8* objectdata_end = &fifo_data[frame_info.objectEnds[object_nr]];
   const u8* objectdata = objectdata_start;
   const std::ptrdiff_t obj_offset =
-      objectdata_start - &fifo_frame.fifoData[frame_info.objectStarts[0]];
+      objectdata_start - &fifo_data[frame_info.objectStarts[0]];
 
   int cmd = *objectdata++;
   int stream_size = Common::swap16(objectdata);
@@ -200,11 +207,11 @@ void FIFOAnalyzer::UpdateDetails()
   // Between objectdata_end and next_objdata_start, there are register setting commands
   if (object_nr + 1 < static_cast<int>(frame_info.objectStarts.size()))
   {
-    const u8* next_objdata_start = &fifo_frame.fifoData[frame_info.objectStarts[object_nr + 1]];
+    const u8* next_objdata_start = &fifo_data[frame_info.objectStarts[object_nr + 1]];
     while (objectdata < next_objdata_start)
     {
       m_object_data_offsets.push_back(objectdata - objectdata_start);
-      int new_offset = objectdata - &fifo_frame.fifoData[frame_info.objectStarts[0]];
+      int new_offset = objectdata - &fifo_data[frame_info.objectStarts[0]];
       int command = *objectdata++;
       switch (command)
       {
@@ -346,13 +353,17 @@ void FIFOAnalyzer::BeginSearch()
   int object_nr = items[0]->data(0, OBJECT_ROLE).toInt();
 
   const AnalyzedFrameInfo& frame_info = FifoPlayer::GetInstance().GetAnalyzedFrameInfo(frame_nr);
-  const FifoFrameInfo& fifo_frame = FifoPlayer::GetInstance().GetFile()->GetFrame(frame_nr);
+  const std::optional<std::vector<u8>> frame_fifo_data =
+      FifoPlayer::GetInstance().GetFile()->GetFrameFifoData(frame_nr);
+  if (!frame_fifo_data)
+    return;
+  const std::vector<u8>& fifo_data = *frame_fifo_data;
 
   // TODO: Support searching through the last object...how do we know where the cmd data ends?
   // TODO: Support searching for bit patterns
 
-  const auto* start_ptr = &fifo_frame.fifoData[frame_info.objectStarts[object_nr]];
-  const auto* end_ptr = &fifo_frame.fifoData[frame_info.objectStarts[object_nr + 1]];
+  const auto* start_ptr = &fifo_data[frame_info.objectStarts[object_nr]];
+  const auto* end_ptr = &fifo_data[frame_info.objectStarts[object_nr + 1]];
 
   for (const u8* ptr = start_ptr; ptr < end_ptr - length + 1; ++ptr)
   {
@@ -458,10 +469,14 @@ void FIFOAnalyzer::UpdateDescription()
   int entry_nr = m_detail_list->currentRow();
 
   const AnalyzedFrameInfo& frame = FifoPlayer::GetInstance().GetAnalyzedFrameInfo(frame_nr);
-  const FifoFrameInfo& fifo_frame = FifoPlayer::GetInstance().GetFile()->GetFrame(frame_nr);
+  const std::optional<std::vector<u8>> frame_fifo_data =
+      FifoPlayer::GetInstance().GetFile()->GetFrameFifoData(frame_nr);
+  if (!frame_fifo_data)
+    return;
+  const std::vector<u8>& fifo_data = *frame_fifo_data;
 
   const u8* cmddata =
-      &fifo_frame.fifoData[frame.objectStarts[object_nr]] + m_object_data_offsets[entry_nr];
+      &fifo_data[frame.objectStarts[object_nr]] + m_object_data_offsets[entry_nr];
 
   // TODO: Not sure whether we should bother translating the descriptions
 
@@ -136,6 +136,7 @@ void FIFOPlayerWindow::CreateWidgets()
   // Action Buttons
   m_load = m_button_box->addButton(tr("Load..."), QDialogButtonBox::ActionRole);
   m_save = m_button_box->addButton(tr("Save..."), QDialogButtonBox::ActionRole);
+  m_convert = m_button_box->addButton(tr("Convert..."), QDialogButtonBox::ActionRole);
   m_record = m_button_box->addButton(tr("Record"), QDialogButtonBox::ActionRole);
   m_stop = m_button_box->addButton(tr("Stop"), QDialogButtonBox::ActionRole);
 
@@ -164,6 +165,7 @@ void FIFOPlayerWindow::ConnectWidgets()
 {
   connect(m_load, &QPushButton::pressed, this, &FIFOPlayerWindow::LoadRecording);
   connect(m_save, &QPushButton::pressed, this, &FIFOPlayerWindow::SaveRecording);
+  connect(m_convert, &QPushButton::pressed, this, &FIFOPlayerWindow::ConvertRecording);
   connect(m_record, &QPushButton::pressed, this, &FIFOPlayerWindow::StartRecording);
   connect(m_stop, &QPushButton::pressed, this, &FIFOPlayerWindow::StopRecording);
   connect(m_button_box, &QDialogButtonBox::rejected, this, &FIFOPlayerWindow::reject);
@@ -207,6 +209,27 @@ void FIFOPlayerWindow::SaveRecording()
     QMessageBox::critical(this, tr("Error"), tr("Failed to save FIFO log."));
 }
 
+void FIFOPlayerWindow::ConvertRecording()
+{
+  QString input_path = QFileDialog::getOpenFileName(this, tr("Convert FIFO log"), QString(),
+                                                    tr("Dolphin FIFO Log (*.dff)"));
+
+  if (input_path.isEmpty())
+    return;
+
+  QString output_path = QFileDialog::getSaveFileName(this, tr("Save converted FIFO log"), QString(),
+                                                     tr("Dolphin FIFO Log (*.dff)"));
+
+  if (output_path.isEmpty())
+    return;
+
+  // Rewrites logs from older versions in the current, compressed format
+  bool result = FifoDataFile::Convert(input_path.toStdString(), output_path.toStdString());
+
+  if (!result)
+    QMessageBox::critical(this, tr("Error"), tr("Failed to convert FIFO log."));
+}
+
 void FIFOPlayerWindow::StartRecording()
 {
   // Start recording
@@ -271,8 +294,9 @@ void FIFOPlayerWindow::UpdateInfo()
 
     for (u32 i = 0; i < file->GetFrameCount(); ++i)
     {
-      fifo_bytes += file->GetFrame(i).fifoData.size();
-      for (const auto& mem_update : file->GetFrame(i).memoryUpdates)
+      const auto frame = file->GetFrame(i);
+      fifo_bytes += frame->fifoData.size();
+      for (const auto& mem_update : frame->memoryUpdates)
         mem_bytes += mem_update.data.size();
     }
 
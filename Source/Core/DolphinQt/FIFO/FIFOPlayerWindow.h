@@ -29,6 +29,7 @@ private:
 
   void LoadRecording();
   void SaveRecording();
+  void ConvertRecording();
   void StartRecording();
   void StopRecording();
 
@@ -46,6 +47,7 @@ private:
   QLabel* m_info_label;
   QPushButton* m_load;
   QPushButton* m_save;
+  QPushButton* m_convert;
   QPushButton* m_record;
   QPushButton* m_stop;
   QSpinBox* m_frame_range_from;
@@ -36,6 +36,7 @@
 #include "Core/WiiUtils.h"
 
 #include "DiscIO/Blob.h"
+#include "DiscIO/DCZBlob.h"
 #include "DiscIO/Enums.h"
 
 #include "DolphinQt/Config/PropertiesDialog.h"
@@ -500,7 +501,7 @@ void GameList::CompressISO(bool decompress)
                 QFileInfo(QString::fromStdString(files[0]->GetFilePath())).completeBaseName())
             .append(decompress ? QStringLiteral(".gcm") : QStringLiteral(".gcz")),
         decompress ? tr("Uncompressed GC/Wii images (*.iso *.gcm)") :
-                     tr("Compressed GC/Wii images (*.gcz)"));
+                     tr("Compressed GC/Wii images (*.gcz);;DCZ GC/Wii images (*.dcz)"));
 
     if (dst_path.isEmpty())
       return;
@@ -553,9 +554,20 @@ void GameList::CompressISO(bool decompress)
       if (files.size() > 1)
         progress_dialog.setLabelText(tr("Compressing...") + QStringLiteral("\n") +
                                      QFileInfo(QString::fromStdString(original_path)).fileName());
-      good = DiscIO::CompressFileToBlob(original_path, dst_path.toStdString(),
-                                        file->GetPlatform() == DiscIO::Platform::WiiDisc ? 1 : 0,
-                                        16384, &CompressCB, &progress_dialog);
+      if (dst_path.endsWith(QStringLiteral(".dcz"), Qt::CaseInsensitive))
+      {
+        const bool zstd = DiscIO::IsDCZCompressionSupported(DiscIO::DCZCompression::Zstd);
+        good = DiscIO::ConvertToDCZ(
+            original_path, dst_path.toStdString(),
+            zstd ? DiscIO::DCZCompression::Zstd : DiscIO::DCZCompression::Zlib, zstd ? 5 : 9,
+            DiscIO::DCZ_GROUP_SIZE, &CompressCB, &progress_dialog);
+      }
+      else
+      {
+        good = DiscIO::CompressFileToBlob(original_path, dst_path.toStdString(),
+                                          file->GetPlatform() == DiscIO::Platform::WiiDisc ? 1 : 0,
+                                          16384, &CompressCB, &progress_dialog);
+      }
     }
 
     if (!good)
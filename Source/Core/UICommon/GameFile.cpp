@@ -113,6 +113,10 @@ GameFile::GameFile(const std::string& path)
     SplitPath(m_file_path, nullptr, &name, &extension);
     m_file_name = name + extension;
 
+    const File::FileInfo file_info(m_file_path);
+    m_size_on_disk = file_info.GetSize();
+    m_modification_time = file_info.GetModificationTime();
+
     std::unique_ptr<DiscIO::Volume> volume(DiscIO::CreateVolumeFromFilename(m_file_path));
     if (volume != nullptr)
     {
@@ -153,6 +157,18 @@ GameFile::GameFile(const std::string& path)
   }
 }
 
+bool GameFile::IsFileUnchanged() const
+{
+  return IsFileUnchanged(m_file_path, m_size_on_disk, m_modification_time);
+}
+
+bool GameFile::IsFileUnchanged(const std::string& path, u64 size_on_disk, s64 modification_time)
+{
+  const File::FileInfo file_info(path);
+  return file_info.Exists() && file_info.GetSize() == size_on_disk &&
+         file_info.GetModificationTime() == modification_time;
+}
+
 bool GameFile::IsValid() const
 {
   if (!m_valid)
@@ -320,6 +336,8 @@ void GameFile::DoState(PointerWrap& p)
 
   p.Do(m_file_size);
   p.Do(m_volume_size);
+  p.Do(m_size_on_disk);
+  p.Do(m_modification_time);
 
   p.Do(m_short_names);
   p.Do(m_long_names);
@@ -81,6 +81,11 @@ public:
   const std::string& GetApploaderDate() const { return m_apploader_date; }
   u64 GetFileSize() const { return m_file_size; }
   u64 GetVolumeSize() const { return m_volume_size; }
+  u64 GetSizeOnDisk() const { return m_size_on_disk; }
+  s64 GetModificationTime() const { return m_modification_time; }
+  // Returns false if the file has been modified or removed since it was scanned.
+  bool IsFileUnchanged() const;
+  static bool IsFileUnchanged(const std::string& path, u64 size_on_disk, s64 modification_time);
   const GameBanner& GetBannerImage() const;
   const GameCover& GetCoverImage() const;
   void DoState(PointerWrap& p);
@@ -113,6 +118,10 @@ private:
   u64 m_file_size{};
   u64 m_volume_size{};
 
+  // Lets GameFileCache find out whether the file must be scanned again, without opening it.
+  u64 m_size_on_disk{};
+  s64 m_modification_time{};
+
   std::map<DiscIO::Language, std::string> m_short_names{};
   std::map<DiscIO::Language, std::string> m_long_names{};
   std::map<DiscIO::Language, std::string> m_short_makers{};
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <memory>
@@ -20,6 +21,7 @@
 #include "Common/File.h"
 #include "Common/FileSearch.h"
 #include "Common/FileUtil.h"
+#include "Common/ThreadPool.h"
 
 #include "DiscIO/DirectoryBlob.h"
 
@@ -27,13 +29,47 @@
 
 namespace UICommon
 {
-static constexpr u32 CACHE_REVISION = 14;  // Last changed in PR 7441
+static constexpr u32 CACHE_MAGIC = 0x434C4744;  // "DGLC"
+static constexpr u32 CACHE_REVISION = 17;      // Last changed when adding the index
+
+// The cache file starts with a header and an index with one entry per game. The index is followed
+// by a pool with the paths of all games, and then by one PointerWrap record per game. Everything
+// is stored in native byte order, like the PointerWrap records.
+namespace
+{
+struct CacheHeader
+{
+  u32 magic;
+  u32 revision;
+  u64 file_size;
+  u64 num_games;
+  u64 paths_offset;
+  u64 paths_size;
+};
+static_assert(sizeof(CacheHeader) == 40, "CacheHeader must not have padding");
+
+struct CacheIndexEntry
+{
+  u64 path_offset;
+  u32 path_size;
+  u32 record_size;
+  u64 record_offset;
+  u64 size_on_disk;
+  s64 modification_time;
+};
+static_assert(sizeof(CacheIndexEntry) == 40, "CacheIndexEntry must not have padding");
+
+bool IsInBounds(u64 offset, u64 size, u64 bounds)
+{
+  return offset <= bounds && size <= bounds - offset;
+}
+}  // Anonymous namespace
 
 std::vector<std::string> FindAllGamePaths(const std::vector<std::string>& directories_to_scan,
                                           bool recursive_scan)
 {
   static const std::vector<std::string> search_extensions = {
-      ".gcm", ".tgc", ".iso", ".ciso", ".gcz", ".wbfs", ".wad", ".dol", ".elf"};
+      ".gcm", ".tgc", ".iso", ".ciso", ".gcz", ".dcz", ".wbfs", ".wad", ".dol", ".elf"};
 
   // TODO: We could process paths iteratively as they are found
   return Common::DoFileSearch(directories_to_scan, search_extensions, recursive_scan);
@@ -47,23 +83,39 @@ GameFileCache::GameFileCache(std::string path) : m_path(std::move(path))
 {
 }
 
-void GameFileCache::ForEach(std::function<void(const std::shared_ptr<const GameFile>&)> f) const
+void GameFileCache::ForEach(std::function<void(const std::shared_ptr<const GameFile>&)> f)
 {
   for (const std::shared_ptr<const GameFile>& item : m_cached_files)
     f(item);
+
+  // Games that are only in the cache file are read for f and kept, so that a following
+  // UpdateAdditionalMetadata or AddOrGet doesn't read them again. Corrupted records are dropped,
+  // which makes the next Update scan the game again.
+  m_cached_files.reserve(m_cached_files.size() + m_unloaded_files.size());
+  for (const UnloadedGameFile& unloaded_file : m_unloaded_files)
+  {
+    std::shared_ptr<GameFile> game = LoadRecord(unloaded_file);
+    if (!game)
+      continue;
+    f(game);
+    m_cached_files.push_back(std::move(game));
+  }
+  m_unloaded_files.clear();
 }
 
 size_t GameFileCache::GetSize() const
 {
-  return m_cached_files.size();
+  return m_cached_files.size() + m_unloaded_files.size();
 }
 
 void GameFileCache::Clear(DeleteOnDisk delete_on_disk)
 {
+  m_cached_files.clear();
+  m_unloaded_files.clear();
+  m_mapped_file.Close();
+
   if (delete_on_disk != DeleteOnDisk::No)
     File::Delete(m_path);
-
-  m_cached_files.clear();
 }
 
 std::shared_ptr<const GameFile> GameFileCache::AddOrGet(const std::string& path,
@@ -72,15 +124,31 @@ std::shared_ptr<const GameFile> GameFileCache::AddOrGet(const std::string& path,
   auto it = std::find_if(
       m_cached_files.begin(), m_cached_files.end(),
       [&path](const std::shared_ptr<GameFile>& file) { return file->GetFilePath() == path; });
-  const bool found = it != m_cached_files.cend();
+  bool found = it != m_cached_files.cend();
   if (!found)
   {
-    std::shared_ptr<UICommon::GameFile> game = std::make_shared<GameFile>(path);
-    if (!game->IsValid())
-      return nullptr;
-    m_cached_files.emplace_back(std::move(game));
+    // The game might not have been read from the cache file yet
+    auto unloaded_it = std::find_if(
+        m_unloaded_files.begin(), m_unloaded_files.end(),
+        [&path](const UnloadedGameFile& file) { return file.path == path; });
+    if (unloaded_it != m_unloaded_files.end())
+    {
+      std::shared_ptr<GameFile> game = LoadRecord(*unloaded_it);
+      m_unloaded_files.erase(unloaded_it);
+      found = game != nullptr;
+      if (found)
+        m_cached_files.emplace_back(std::move(game));
+    }
+    if (!found)
+    {
+      std::shared_ptr<UICommon::GameFile> game = std::make_shared<GameFile>(path);
+      if (!game->IsValid())
+        return nullptr;
+      m_cached_files.emplace_back(std::move(game));
+    }
+    it = m_cached_files.end() - 1;
   }
-  std::shared_ptr<GameFile>& result = found ? *it : m_cached_files.back();
+  std::shared_ptr<GameFile>& result = *it;
   if (UpdateAdditionalMetadata(&result) || !found)
     *cache_changed = true;
 
@@ -90,7 +158,7 @@ std::shared_ptr<const GameFile> GameFileCache::AddOrGet(const std::string& path,
 bool GameFileCache::Update(
     const std::vector<std::string>& all_game_paths,
     std::function<void(const std::shared_ptr<const GameFile>&)> game_added_to_cache,
-    std::function<void(const std::string&)> game_removed_from_cache)
+    std::function<void(const std::string&)> game_removed_from_cache, unsigned int num_threads)
 {
   // Copy game paths into a set, except ones that match DiscIO::ShouldHideFromGameList.
   // TODO: Prevent DoFileSearch from looking inside /files/ directories of DirectoryBlobs at all?
@@ -104,46 +172,70 @@ bool GameFileCache::Update(
   }
 
   bool cache_changed = false;
-
-  // Delete paths that aren't in game_paths from m_cached_files,
-  // while simultaneously deleting paths that are in m_cached_files from game_paths.
-  // For the sake of speed, we don't care about maintaining the order of m_cached_files.
-  {
-    auto it = m_cached_files.begin();
-    auto end = m_cached_files.end();
-    while (it != end)
+  Common::ThreadPool thread_pool(num_threads, "Game list scanner");
+
+  // Files that have been modified since they were cached have to be scanned again. Checking
+  // this doesn't require opening the files, but it can still take a while on network shares.
+  // Files that aren't kept are deleted, while simultaneously deleting paths of kept files from
+  // game_paths. For the sake of speed, we don't care about maintaining the order of the files.
+  const auto remove_files = [&](auto* files, const auto& get_path, const auto& is_unchanged) {
+    std::vector<u8> keep(files->size());
+    thread_pool.ParallelFor(files->size(), [&](size_t i) {
+      keep[i] = game_paths.count(get_path((*files)[i])) && is_unchanged((*files)[i]);
+    });
+
+    size_t i = 0;
+    size_t end = files->size();
+    while (i != end)
     {
-      if (game_paths.erase((*it)->GetFilePath()))
+      if (keep[i])
       {
-        ++it;
+        game_paths.erase(get_path((*files)[i]));
+        ++i;
       }
       else
       {
         if (game_removed_from_cache)
-          game_removed_from_cache((*it)->GetFilePath());
+          game_removed_from_cache(get_path((*files)[i]));
 
         cache_changed = true;
         --end;
-        *it = std::move(*end);
+        (*files)[i] = std::move((*files)[end]);
+        keep[i] = keep[end];
       }
     }
-    m_cached_files.erase(it, m_cached_files.end());
-  }
+    files->erase(files->begin() + end, files->end());
+  };
+
+  remove_files(&m_cached_files,
+               [](const std::shared_ptr<GameFile>& file) -> const std::string& {
+                 return file->GetFilePath();
+               },
+               [](const std::shared_ptr<GameFile>& file) { return file->IsFileUnchanged(); });
+  // Games that are only in the cache file can be checked using the index
+  remove_files(&m_unloaded_files,
+               [](const UnloadedGameFile& file) -> const std::string& { return file.path; },
+               [](const UnloadedGameFile& file) {
+                 return GameFile::IsFileUnchanged(file.path, file.size_on_disk,
+                                                  file.modification_time);
+               });
 
   // Now that the previous loop has run, game_paths only contains paths that
-  // aren't in m_cached_files, so we simply add all of them to m_cached_files.
-  for (const std::string& path : game_paths)
-  {
-    auto file = std::make_shared<GameFile>(path);
-    if (file->IsValid())
-    {
-      if (game_added_to_cache)
-        game_added_to_cache(file);
+  // aren't in m_cached_files, so we scan all of them and add them to m_cached_files.
+  const std::vector<std::string> new_paths(game_paths.begin(), game_paths.end());
+  std::mutex lock;
+  thread_pool.ParallelFor(new_paths.size(), [&](size_t i) {
+    auto file = std::make_shared<GameFile>(new_paths[i]);
+    if (!file->IsValid())
+      return;
 
-      cache_changed = true;
-      m_cached_files.push_back(std::move(file));
-    }
-  }
+    std::lock_guard<std::mutex> lk(lock);
+    if (game_added_to_cache)
+      game_added_to_cache(file);
+
+    cache_changed = true;
+    m_cached_files.push_back(std::move(file));
+  });
 
   return cache_changed;
 }
@@ -161,6 +253,31 @@ bool GameFileCache::UpdateAdditionalMetadata(
       game_updated(file);
   }
 
+  // Checking banners and covers requires reading the games that are only in the cache file,
+  // but only the ones that have changed are kept in memory.
+  size_t i = 0;
+  size_t end = m_unloaded_files.size();
+  while (i != end)
+  {
+    std::shared_ptr<GameFile> file = LoadRecord(m_unloaded_files[i]);
+    if (file && !UpdateAdditionalMetadata(&file))
+    {
+      ++i;
+      continue;
+    }
+
+    --end;
+    m_unloaded_files[i] = std::move(m_unloaded_files[end]);
+    if (!file)
+      continue;
+
+    cache_changed = true;
+    if (game_updated)
+      game_updated(file);
+    m_cached_files.push_back(std::move(file));
+  }
+  m_unloaded_files.erase(m_unloaded_files.begin() + end, m_unloaded_files.end());
+
   return cache_changed;
 }
 
@@ -198,79 +315,189 @@ bool GameFileCache::UpdateAdditionalMetadata(std::shared_ptr<GameFile>* game_fil
 
 bool GameFileCache::Load()
 {
-  return SyncCacheFile(false);
-}
+  m_cached_files.clear();
+  m_unloaded_files.clear();
+  m_mapped_file.Close();
 
-bool GameFileCache::Save()
-{
-  return SyncCacheFile(true);
+  if (!File::Exists(m_path))
+    return false;
+
+  if (!m_mapped_file.Open(m_path) || !ReadIndex())
+  {
+    // Delete the probably-corrupted cache
+    m_unloaded_files.clear();
+    m_mapped_file.Close();
+    File::Delete(m_path);
+    return false;
+  }
+
+  return true;
 }
 
-bool GameFileCache::SyncCacheFile(bool save)
+bool GameFileCache::ReadIndex()
 {
-  const char* open_mode = save ? "wb" : "rb";
-  File::IOFile f(m_path, open_mode);
-  if (!f)
+  const u8* const data = m_mapped_file.GetData();
+  const u64 size = m_mapped_file.GetSize();
+
+  CacheHeader header;
+  if (size < sizeof(header))
     return false;
-  bool success = false;
-  if (save)
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != CACHE_MAGIC || header.revision != CACHE_REVISION ||
+      header.file_size != size || header.num_games > size / sizeof(CacheIndexEntry) ||
+      !IsInBounds(sizeof(header), header.num_games * sizeof(CacheIndexEntry), size) ||
+      !IsInBounds(header.paths_offset, header.paths_size, size))
   {
-    // Measure the size of the buffer.
-    u8* ptr = nullptr;
-    PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
-    DoState(&p);
-    const size_t buffer_size = reinterpret_cast<size_t>(ptr);
-
-    // Then actually do the write.
-    std::vector<u8> buffer(buffer_size);
-    ptr = &buffer[0];
-    p.SetMode(PointerWrap::MODE_WRITE);
-    DoState(&p, buffer_size);
-    if (f.WriteBytes(buffer.data(), buffer.size()))
-      success = true;
+    return false;
   }
-  else
+
+  m_unloaded_files.reserve(header.num_games);
+  for (u64 i = 0; i < header.num_games; i++)
   {
-    std::vector<u8> buffer(f.GetSize());
-    if (buffer.size() && f.ReadBytes(buffer.data(), buffer.size()))
+    CacheIndexEntry entry;
+    std::memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+    if (!IsInBounds(entry.path_offset, entry.path_size, header.paths_size) ||
+        !IsInBounds(entry.record_offset, entry.record_size, size))
     {
-      u8* ptr = buffer.data();
-      PointerWrap p(&ptr, PointerWrap::MODE_READ);
-      DoState(&p, buffer.size());
-      if (p.GetMode() == PointerWrap::MODE_READ)
-        success = true;
+      return false;
     }
+
+    const char* path =
+        reinterpret_cast<const char*>(data + header.paths_offset + entry.path_offset);
+    m_unloaded_files.push_back({std::string(path, entry.path_size), entry.size_on_disk,
+                                entry.modification_time, data + entry.record_offset,
+                                entry.record_size});
+  }
+
+  return true;
+}
+
+std::shared_ptr<GameFile> GameFileCache::LoadRecord(const UnloadedGameFile& unloaded_file)
+{
+  // PointerWrap doesn't write to the buffer in read mode
+  u8* ptr = const_cast<u8*>(unloaded_file.record);
+  PointerWrap p(&ptr, PointerWrap::MODE_READ);
+  // Reading past the record makes PointerWrap switch modes, so the record is treated as corrupted
+  p.SetReadLimit(unloaded_file.record + unloaded_file.record_size);
+  auto game = std::make_shared<GameFile>();
+  game->DoState(p);
+
+  if (p.GetMode() != PointerWrap::MODE_READ ||
+      ptr != unloaded_file.record + unloaded_file.record_size ||
+      game->GetFilePath() != unloaded_file.path)
+  {
+    return nullptr;
   }
-  if (!success)
+  return game;
+}
+
+bool GameFileCache::Save()
+{
+  // The mapped cache file must not be overwritten, so the new one is written next to it and then
+  // renamed over it. Games that haven't been read from the old file are copied without reading.
+  const std::string temp_path = m_path + ".tmp";
+  if (!WriteCacheFile(temp_path))
+  {
+    File::Delete(temp_path);
+    return false;
+  }
+
+  m_unloaded_files.clear();
+  m_mapped_file.Close();
+  if (!File::Rename(temp_path, m_path))
   {
-    // If some file operation failed, try to delete the probably-corrupted cache
-    f.Close();
+    // The games that were only in the old cache file get scanned again by the next Update
+    File::Delete(temp_path);
     File::Delete(m_path);
+    return false;
+  }
+
+  // The new file starts with the games that are already in memory, so only the rest of its index
+  // is needed.
+  if (!m_mapped_file.Open(m_path) || !ReadIndex() ||
+      m_unloaded_files.size() < m_cached_files.size())
+  {
+    m_unloaded_files.clear();
+    m_mapped_file.Close();
+    return false;
   }
-  return success;
+  m_unloaded_files.erase(m_unloaded_files.begin(),
+                         m_unloaded_files.begin() + m_cached_files.size());
+  return true;
 }
 
-void GameFileCache::DoState(PointerWrap* p, u64 size)
+bool GameFileCache::WriteCacheFile(const std::string& path) const
 {
-  struct
+  const size_t num_games = m_cached_files.size() + m_unloaded_files.size();
+  const auto get_path = [this](size_t i) -> const std::string& {
+    return i < m_cached_files.size() ? m_cached_files[i]->GetFilePath() :
+                                       m_unloaded_files[i - m_cached_files.size()].path;
+  };
+
+  CacheHeader header{};
+  header.magic = CACHE_MAGIC;
+  header.revision = CACHE_REVISION;
+  header.num_games = num_games;
+  header.paths_offset = sizeof(header) + header.num_games * sizeof(CacheIndexEntry);
+
+  std::vector<CacheIndexEntry> index(num_games);
+  for (size_t i = 0; i < num_games; i++)
   {
-    u32 revision;
-    u64 expected_size;
-  } header = {CACHE_REVISION, size};
-  p->Do(header);
-  if (p->GetMode() == PointerWrap::MODE_READ)
+    index[i].path_offset = header.paths_size;
+    index[i].path_size = static_cast<u32>(get_path(i).size());
+    header.paths_size += index[i].path_size;
+  }
+
+  // Measure the size of each record. Records of unloaded games are copied as they are.
+  u64 offset = header.paths_offset + header.paths_size;
+  for (size_t i = 0; i < num_games; i++)
   {
-    if (header.revision != CACHE_REVISION || header.expected_size != size)
+    index[i].record_offset = offset;
+    if (i < m_cached_files.size())
     {
-      p->SetMode(PointerWrap::MODE_MEASURE);
-      return;
+      u8* ptr = nullptr;
+      PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+      m_cached_files[i]->DoState(p);
+
+      index[i].record_size = static_cast<u32>(reinterpret_cast<size_t>(ptr));
+      index[i].size_on_disk = m_cached_files[i]->GetSizeOnDisk();
+      index[i].modification_time = m_cached_files[i]->GetModificationTime();
+    }
+    else
+    {
+      const UnloadedGameFile& unloaded_file = m_unloaded_files[i - m_cached_files.size()];
+      index[i].record_size = unloaded_file.record_size;
+      index[i].size_on_disk = unloaded_file.size_on_disk;
+      index[i].modification_time = unloaded_file.modification_time;
     }
+    offset += index[i].record_size;
   }
-  p->DoEachElement(m_cached_files, [](PointerWrap& state, std::shared_ptr<GameFile>& elem) {
-    if (state.GetMode() == PointerWrap::MODE_READ)
-      elem = std::make_shared<GameFile>();
-    elem->DoState(state);
-  });
+  header.file_size = offset;
+
+  // Then actually do the write
+  std::vector<u8> buffer(header.file_size);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  std::memcpy(buffer.data() + sizeof(header), index.data(), index.size() * sizeof(index[0]));
+  for (size_t i = 0; i < num_games; i++)
+  {
+    const std::string& game_path = get_path(i);
+    std::copy(game_path.begin(), game_path.end(),
+              buffer.begin() + header.paths_offset + index[i].path_offset);
+
+    u8* ptr = buffer.data() + index[i].record_offset;
+    if (i < m_cached_files.size())
+    {
+      PointerWrap p(&ptr, PointerWrap::MODE_WRITE);
+      m_cached_files[i]->DoState(p);
+    }
+    else
+    {
+      std::memcpy(ptr, m_unloaded_files[i - m_cached_files.size()].record, index[i].record_size);
+    }
+  }
+
+  File::IOFile f(path, "wb");
+  return f && f.WriteBytes(buffer.data(), buffer.size());
 }
 
 }  // namespace DiscIO
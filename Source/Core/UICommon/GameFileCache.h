@@ -11,8 +11,7 @@
 #include <vector>
 
 #include "Common/CommonTypes.h"
-
-class PointerWrap;
+#include "Common/MappedFile.h"
 
 namespace UICommon
 {
@@ -33,7 +32,8 @@ public:
   GameFileCache();  // Uses the default path
   explicit GameFileCache(std::string path);
 
-  void ForEach(std::function<void(const std::shared_ptr<const GameFile>&)> f) const;
+  // Games that are only in the cache file are read for f and then kept in memory.
+  void ForEach(std::function<void(const std::shared_ptr<const GameFile>&)> f);
 
   size_t GetSize() const;
   void Clear(DeleteOnDisk delete_on_disk);
@@ -42,23 +42,43 @@ public:
   std::shared_ptr<const GameFile> AddOrGet(const std::string& path, bool* cache_changed);
 
   // These functions return true if the call modified the cache.
+  // Update scans new files and files that have been modified since they were cached on
+  // num_threads threads (0 means one per hardware thread). game_added_to_cache is called as soon
+  // as each file has been scanned, from any of those threads, but never concurrently.
   bool Update(const std::vector<std::string>& all_game_paths,
               std::function<void(const std::shared_ptr<const GameFile>&)> game_added_to_cache = {},
-              std::function<void(const std::string&)> game_removed_from_cache = {});
+              std::function<void(const std::string&)> game_removed_from_cache = {},
+              unsigned int num_threads = 0);
   bool UpdateAdditionalMetadata(
       std::function<void(const std::shared_ptr<const GameFile>&)> game_updated = {});
 
+  // Load maps the cache file and only reads its index. The games themselves are read when they
+  // are first needed, so Update can check and remove games without ever reading them.
   bool Load();
   bool Save();
 
 private:
+  // A game which hasn't been read from the mapped cache file yet
+  struct UnloadedGameFile
+  {
+    std::string path;
+    u64 size_on_disk;
+    s64 modification_time;
+    const u8* record;
+    u32 record_size;
+  };
+
   bool UpdateAdditionalMetadata(std::shared_ptr<GameFile>* game_file);
 
-  bool SyncCacheFile(bool save);
-  void DoState(PointerWrap* p, u64 size = 0);
+  bool ReadIndex();
+  // Returns nullptr if the record is corrupted.
+  static std::shared_ptr<GameFile> LoadRecord(const UnloadedGameFile& unloaded_file);
+  bool WriteCacheFile(const std::string& path) const;
 
   std::string m_path;
   std::vector<std::shared_ptr<GameFile>> m_cached_files;
+  File::MappedFile m_mapped_file;
+  std::vector<UnloadedGameFile> m_unloaded_files;
 };
 
 }  // namespace UICommon
@@ -37,6 +37,20 @@ static inline u32 GetDepthOffset(u16 x, u16 y)
   return (x + y * EFB_WIDTH) * 3 + depth_buffer_start;
 }
 
+// Pixels are 3 bytes, so only 3 bytes may be accessed. The fourth one belongs to the next pixel,
+// which may be drawn on another thread at the same time.
+static inline u32 ReadPixel(u32 offset)
+{
+  u32 val = 0;
+  std::memcpy(&val, &efb[offset], 3);
+  return val;
+}
+
+static inline void WritePixel(u32 offset, u32 val)
+{
+  std::memcpy(&efb[offset], &val, 3);
+}
+
 static void SetPixelAlphaOnly(u32 offset, u8 a)
 {
   switch (bpmem.zcontrol.pixel_format)
@@ -49,10 +63,9 @@ static void SetPixelAlphaOnly(u32 offset, u8 a)
   case PEControl::RGBA6_Z24:
   {
     u32 a32 = a;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xffffffc0;
+    u32 val = ReadPixel(offset) & 0xffffffc0;
     val |= (a32 >> 2) & 0x0000003f;
-    *dst = val;
+    WritePixel(offset, val);
   }
   break;
   default:
@@ -68,31 +81,24 @@ static void SetPixelColorOnly(u32 offset, u8* rgb)
   case PEControl::Z24:
   {
     u32 src = *(u32*)rgb;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    WritePixel(offset, src >> 8);
   }
   break;
   case PEControl::RGBA6_Z24:
   {
     u32 src = *(u32*)rgb;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff00003f;
+    u32 val = ReadPixel(offset) & 0xff00003f;
     val |= (src >> 4) & 0x00000fc0;  // blue
     val |= (src >> 6) & 0x0003f000;  // green
     val |= (src >> 8) & 0x00fc0000;  // red
-    *dst = val;
+    WritePixel(offset, val);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
     u32 src = *(u32*)rgb;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    WritePixel(offset, src >> 8);
   }
   break;
   default:
@@ -108,32 +114,25 @@ static void SetPixelAlphaColor(u32 offset, u8* color)
   case PEControl::Z24:
   {
     u32 src = *(u32*)color;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    WritePixel(offset, src >> 8);
   }
   break;
   case PEControl::RGBA6_Z24:
   {
     u32 src = *(u32*)color;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
+    u32 val = 0;
     val |= (src >> 2) & 0x0000003f;  // alpha
     val |= (src >> 4) & 0x00000fc0;  // blue
     val |= (src >> 6) & 0x0003f000;  // green
     val |= (src >> 8) & 0x00fc0000;  // red
-    *dst = val;
+    WritePixel(offset, val);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
     u32 src = *(u32*)color;
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    WritePixel(offset, src >> 8);
   }
   break;
   default:
@@ -143,8 +142,7 @@ static void SetPixelAlphaColor(u32 offset, u8* color)
 
 static u32 GetPixelColor(u32 offset)
 {
-  u32 src;
-  std::memcpy(&src, &efb[offset], sizeof(u32));
+  u32 src = ReadPixel(offset);
 
   switch (bpmem.zcontrol.pixel_format)
   {
@@ -176,19 +174,13 @@ static void SetPixelDepth(u32 offset, u32 depth)
   case PEControl::RGBA6_Z24:
   case PEControl::Z24:
   {
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= depth & 0x00ffffff;
-    *dst = val;
+    WritePixel(offset, depth);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-    u32* dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= depth & 0x00ffffff;
-    *dst = val;
+    WritePixel(offset, depth);
   }
   break;
   default:
@@ -206,13 +198,13 @@ static u32 GetPixelDepth(u32 offset)
   case PEControl::RGBA6_Z24:
   case PEControl::Z24:
   {
-    depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+    depth = ReadPixel(offset);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-    depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+    depth = ReadPixel(offset);
   }
   break;
   default:
@@ -696,16 +688,15 @@ void ResetPerfQuery()
   perf_values = {};
 }
 
-void IncPerfCounterQuadCount(PerfQueryType type)
+void IncPerfCounterQuadCount(PerfQueryType type, u32 num_pixels)
 {
   // NOTE: hardware doesn't process individual pixels but quads instead.
   // Current software renderer architecture works on pixels though, so
   // we have this "quad" hack here to only increment the registers on
   // every fourth rendered pixel
   static u32 quad[PQ_NUM_MEMBERS];
-  if (++quad[type] != 3)
-    return;
-  quad[type] = 0;
-  ++perf_values[type];
+  quad[type] += num_pixels;
+  perf_values[type] += quad[type] / 3;
+  quad[type] %= 3;
 }
 }
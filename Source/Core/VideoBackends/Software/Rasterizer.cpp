@@ -3,13 +3,19 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstring>
+#include <memory>
+#include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/ThreadPool.h"
 #include "VideoBackends/Software/EfbInterface.h"
 #include "VideoBackends/Software/NativeVertexFormat.h"
 #include "VideoBackends/Software/Rasterizer.h"
 #include "VideoBackends/Software/Tev.h"
+#include "VideoCommon/BoundingBox.h"
 #include "VideoCommon/PerfQueryBase.h"
 #include "VideoCommon/Statistics.h"
 #include "VideoCommon/VideoConfig.h"
@@ -19,22 +25,80 @@ namespace Rasterizer
 {
 static constexpr int BLOCK_SIZE = 2;
 
+// The EFB is split into tiles which are drawn on separate threads. Every tile has a list of the
+// triangles touching it in the order they were submitted, so every pixel is drawn in the same order
+// as when drawing everything on one thread. Tiles are made of whole blocks.
+static constexpr int TILE_SIZE = 32;
+static constexpr int TILES_X = (EFB_WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+static constexpr int TILES_Y = (EFB_HEIGHT + TILE_SIZE - 1) / TILE_SIZE;
+static_assert(TILE_SIZE % BLOCK_SIZE == 0, "Blocks must not cross tiles");
+
+// Everything needed for drawing the pixels of a triangle. Everything else the pixels depend on,
+// like BP registers and TEV constants, can't change before the queued triangles are drawn, as
+// the vertex manager flushes before any of it changes.
+struct TriangleSetup
+{
+  Slope ZSlope;
+  Slope WSlope;
+  Slope ColorSlopes[2][4];
+  Slope TexSlopes[8][3];
+
+  s32 vertex0X;
+  s32 vertex0Y;
+  float vertexOffsetX;
+  float vertexOffsetY;
+
+  // Half-edge constants
+  s32 C1;
+  s32 C2;
+  s32 C3;
+  s32 DX12;
+  s32 DX23;
+  s32 DX31;
+  s32 DY12;
+  s32 DY23;
+  s32 DY31;
+
+  // Bounding rectangle, clipped to the scissor rectangle. minx and miny start a block.
+  s32 minx;
+  s32 maxx;
+  s32 miny;
+  s32 maxy;
+};
+
+// State of a thread that draws pixels
+struct ThreadContext
+{
+  Tev tev;
+  RasterBlock rasterBlock;
+};
+
+// The z slope is kept between triangles for zfreeze
 static Slope ZSlope;
-static Slope WSlope;
-static Slope ColorSlopes[2][4];
-static Slope TexSlopes[8][3];
 
-static s32 vertex0X;
-static s32 vertex0Y;
-static float vertexOffsetX;
-static float vertexOffsetY;
+static std::unique_ptr<Common::ThreadPool> s_thread_pool;
+static std::vector<std::unique_ptr<ThreadContext>> s_contexts;
 
-static Tev tev;
-static RasterBlock rasterBlock;
+static std::vector<TriangleSetup> s_triangles;
+static std::array<std::vector<u32>, TILES_X * TILES_Y> s_tile_triangles;
+static std::vector<u32> s_used_tiles;
+static std::atomic<size_t> s_next_tile;
+
+// Whether the TEV programs of the contexts match the current state. The state can only change after
+// a flush.
+static bool s_tev_program_valid = false;
 
 void Init()
 {
-  tev.Init();
+  s_thread_pool = std::make_unique<Common::ThreadPool>(
+      std::max(g_ActiveConfig.iSWRasterizerThreads, 0), "Software rasterizer thread");
+
+  s_contexts.clear();
+  for (size_t i = 0; i < s_thread_pool->GetThreadCount(); ++i)
+  {
+    s_contexts.push_back(std::make_unique<ThreadContext>());
+    s_contexts.back()->tev.Init();
+  }
 
   // Set initial z reference plane in the unlikely case that zfreeze is enabled when drawing the
   // first primitive.
@@ -43,6 +107,14 @@ void Init()
   ZSlope.f0 = 1.f;
 }
 
+void Shutdown()
+{
+  Flush();
+  s_contexts.clear();
+  s_thread_pool.reset();
+  Tev::ClearProgramCache();
+}
+
 // Returns approximation of log2(f) in s28.4
 // results are close enough to use for LOD
 static s32 FixedLog2(float f)
@@ -67,32 +139,37 @@ static inline int iround(float x)
 
 void SetTevReg(int reg, int comp, s16 color)
 {
-  tev.SetRegColor(reg, comp, color);
+  for (auto& context : s_contexts)
+    context->tev.SetRegColor(reg, comp, color);
 }
 
-static void Draw(s32 x, s32 y, s32 xi, s32 yi)
+static void Draw(const TriangleSetup& triangle, ThreadContext& context, s32 x, s32 y, s32 xi,
+                 s32 yi)
 {
-  INCSTAT(stats.thisFrame.rasterizedPixels);
+  Tev& tev = context.tev;
+  const RasterBlock& rasterBlock = context.rasterBlock;
+
+  tev.counters.rasterizedPixels++;
 
-  float dx = vertexOffsetX + (float)(x - vertex0X);
-  float dy = vertexOffsetY + (float)(y - vertex0Y);
+  float dx = triangle.vertexOffsetX + (float)(x - triangle.vertex0X);
+  float dy = triangle.vertexOffsetY + (float)(y - triangle.vertex0Y);
 
-  s32 z = (s32)MathUtil::Clamp<float>(ZSlope.GetValue(dx, dy), 0.0f, 16777215.0f);
+  s32 z = (s32)MathUtil::Clamp<float>(triangle.ZSlope.GetValue(dx, dy), 0.0f, 16777215.0f);
 
   if (bpmem.UseEarlyDepthTest() && g_ActiveConfig.bZComploc)
   {
     // TODO: Test if perf regs are incremented even if test is disabled
-    EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_INPUT_ZCOMPLOC);
+    tev.counters.perfQueryPixels[PQ_ZCOMP_INPUT_ZCOMPLOC]++;
     if (bpmem.zmode.testenable)
     {
       // early z
       if (!EfbInterface::ZCompare(x, y, z))
         return;
     }
-    EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_OUTPUT_ZCOMPLOC);
+    tev.counters.perfQueryPixels[PQ_ZCOMP_OUTPUT_ZCOMPLOC]++;
   }
 
-  RasterBlockPixel& pixel = rasterBlock.Pixel[xi][yi];
+  const RasterBlockPixel& pixel = rasterBlock.Pixel[xi][yi];
 
   tev.Position[0] = x;
   tev.Position[1] = y;
@@ -103,7 +180,7 @@ static void Draw(s32 x, s32 y, s32 xi, s32 yi)
   {
     for (int comp = 0; comp < 4; comp++)
     {
-      u16 color = (u16)ColorSlopes[i][comp].GetValue(dx, dy);
+      u16 color = (u16)triangle.ColorSlopes[i][comp].GetValue(dx, dy);
 
       // clamp color value to 0
       u16 mask = ~(color >> 8);
@@ -135,16 +212,16 @@ static void Draw(s32 x, s32 y, s32 xi, s32 yi)
   tev.Draw();
 }
 
-static void InitTriangle(float X1, float Y1, s32 xi, s32 yi)
+static void InitTriangle(TriangleSetup* triangle, float X1, float Y1, s32 xi, s32 yi)
 {
-  vertex0X = xi;
-  vertex0Y = yi;
+  triangle->vertex0X = xi;
+  triangle->vertex0Y = yi;
 
   // adjust a little less than 0.5
   const float adjust = 0.495f;
 
-  vertexOffsetX = ((float)xi - X1) + adjust;
-  vertexOffsetY = ((float)yi - Y1) + adjust;
+  triangle->vertexOffsetX = ((float)xi - X1) + adjust;
+  triangle->vertexOffsetY = ((float)yi - Y1) + adjust;
 }
 
 static void InitSlope(Slope* slope, float f1, float f2, float f3, float DX31, float DX12,
@@ -160,7 +237,8 @@ static void InitSlope(Slope* slope, float f1, float f2, float f3, float DX31, fl
   slope->f0 = f1;
 }
 
-static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoord)
+static inline void CalculateLOD(const RasterBlock& rasterBlock, s32* lodp, bool* linear,
+                                u32 texmap, u32 texcoord)
 {
   const FourTexUnits& texUnit = bpmem.tex[(texmap >> 2) & 1];
   const u8 subTexmap = texmap & 3;
@@ -173,17 +251,17 @@ static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoor
   float sDelta, tDelta;
   if (tm0.diag_lod)
   {
-    float* uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
-    float* uv1 = rasterBlock.Pixel[1][1].Uv[texcoord];
+    const float* uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
+    const float* uv1 = rasterBlock.Pixel[1][1].Uv[texcoord];
 
     sDelta = fabsf(uv0[0] - uv1[0]);
     tDelta = fabsf(uv0[1] - uv1[1]);
   }
   else
   {
-    float* uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
-    float* uv1 = rasterBlock.Pixel[1][0].Uv[texcoord];
-    float* uv2 = rasterBlock.Pixel[0][1].Uv[texcoord];
+    const float* uv0 = rasterBlock.Pixel[0][0].Uv[texcoord];
+    const float* uv1 = rasterBlock.Pixel[1][0].Uv[texcoord];
+    const float* uv2 = rasterBlock.Pixel[0][1].Uv[texcoord];
 
     sDelta = std::max(fabsf(uv0[0] - uv1[0]), fabsf(uv0[0] - uv2[0]));
     tDelta = std::max(fabsf(uv0[1] - uv1[1]), fabsf(uv0[1] - uv2[1]));
@@ -208,7 +286,8 @@ static inline void CalculateLOD(s32* lodp, bool* linear, u32 texmap, u32 texcoor
   *lodp = lod;
 }
 
-static void BuildBlock(s32 blockX, s32 blockY)
+static void BuildBlock(const TriangleSetup& triangle, RasterBlock& rasterBlock, s32 blockX,
+                       s32 blockY)
 {
   for (s32 yi = 0; yi < BLOCK_SIZE; yi++)
   {
@@ -216,10 +295,10 @@ static void BuildBlock(s32 blockX, s32 blockY)
     {
       RasterBlockPixel& pixel = rasterBlock.Pixel[xi][yi];
 
-      float dx = vertexOffsetX + (float)(xi + blockX - vertex0X);
-      float dy = vertexOffsetY + (float)(yi + blockY - vertex0Y);
+      float dx = triangle.vertexOffsetX + (float)(xi + blockX - triangle.vertex0X);
+      float dy = triangle.vertexOffsetY + (float)(yi + blockY - triangle.vertex0Y);
 
-      float invW = 1.0f / WSlope.GetValue(dx, dy);
+      float invW = 1.0f / triangle.WSlope.GetValue(dx, dy);
       pixel.InvW = invW;
 
       // tex coords
@@ -228,13 +307,13 @@ static void BuildBlock(s32 blockX, s32 blockY)
         float projection = invW;
         if (xfmem.texMtxInfo[i].projection)
         {
-          float q = TexSlopes[i][2].GetValue(dx, dy) * invW;
+          float q = triangle.TexSlopes[i][2].GetValue(dx, dy) * invW;
           if (q != 0.0f)
             projection = invW / q;
         }
 
-        pixel.Uv[i][0] = TexSlopes[i][0].GetValue(dx, dy) * projection;
-        pixel.Uv[i][1] = TexSlopes[i][1].GetValue(dx, dy) * projection;
+        pixel.Uv[i][0] = triangle.TexSlopes[i][0].GetValue(dx, dy) * projection;
+        pixel.Uv[i][1] = triangle.TexSlopes[i][1].GetValue(dx, dy) * projection;
       }
     }
   }
@@ -247,7 +326,8 @@ static void BuildBlock(s32 blockX, s32 blockY)
     u32 texcoord = indref & 3;
     indref >>= 3;
 
-    CalculateLOD(&rasterBlock.IndirectLod[i], &rasterBlock.IndirectLinear[i], texmap, texcoord);
+    CalculateLOD(rasterBlock, &rasterBlock.IndirectLod[i], &rasterBlock.IndirectLinear[i], texmap,
+                 texcoord);
   }
 
   for (unsigned int i = 0; i <= bpmem.genMode.numtevstages; i++)
@@ -259,11 +339,207 @@ static void BuildBlock(s32 blockX, s32 blockY)
       u32 texmap = order.getTexMap(stageOdd);
       u32 texcoord = order.getTexCoord(stageOdd);
 
-      CalculateLOD(&rasterBlock.TextureLod[i], &rasterBlock.TextureLinear[i], texmap, texcoord);
+      CalculateLOD(rasterBlock, &rasterBlock.TextureLod[i], &rasterBlock.TextureLinear[i], texmap,
+                   texcoord);
     }
   }
 }
 
+// Draws the pixels of a triangle within a rectangle, which has to start at a block.
+static void DrawTriangle(const TriangleSetup& triangle, ThreadContext& context, s32 minx, s32 maxx,
+                         s32 miny, s32 maxy)
+{
+  const s32 C1 = triangle.C1;
+  const s32 C2 = triangle.C2;
+  const s32 C3 = triangle.C3;
+
+  const s32 DX12 = triangle.DX12;
+  const s32 DX23 = triangle.DX23;
+  const s32 DX31 = triangle.DX31;
+
+  const s32 DY12 = triangle.DY12;
+  const s32 DY23 = triangle.DY23;
+  const s32 DY31 = triangle.DY31;
+
+  // Fixed-pos32 deltas
+  const s32 FDX12 = DX12 * 16;
+  const s32 FDX23 = DX23 * 16;
+  const s32 FDX31 = DX31 * 16;
+
+  const s32 FDY12 = DY12 * 16;
+  const s32 FDY23 = DY23 * 16;
+  const s32 FDY31 = DY31 * 16;
+
+  // Loop through blocks
+  for (s32 y = miny; y < maxy; y += BLOCK_SIZE)
+  {
+    for (s32 x = minx; x < maxx; x += BLOCK_SIZE)
+    {
+      // Corners of block
+      s32 x0 = x << 4;
+      s32 x1 = (x + BLOCK_SIZE - 1) << 4;
+      s32 y0 = y << 4;
+      s32 y1 = (y + BLOCK_SIZE - 1) << 4;
+
+      // Evaluate half-space functions
+      bool a00 = C1 + DX12 * y0 - DY12 * x0 > 0;
+      bool a10 = C1 + DX12 * y0 - DY12 * x1 > 0;
+      bool a01 = C1 + DX12 * y1 - DY12 * x0 > 0;
+      bool a11 = C1 + DX12 * y1 - DY12 * x1 > 0;
+      int a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);
+
+      bool b00 = C2 + DX23 * y0 - DY23 * x0 > 0;
+      bool b10 = C2 + DX23 * y0 - DY23 * x1 > 0;
+      bool b01 = C2 + DX23 * y1 - DY23 * x0 > 0;
+      bool b11 = C2 + DX23 * y1 - DY23 * x1 > 0;
+      int b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);
+
+      bool c00 = C3 + DX31 * y0 - DY31 * x0 > 0;
+      bool c10 = C3 + DX31 * y0 - DY31 * x1 > 0;
+      bool c01 = C3 + DX31 * y1 - DY31 * x0 > 0;
+      bool c11 = C3 + DX31 * y1 - DY31 * x1 > 0;
+      int c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);
+
+      // Skip block when outside an edge
+      if (a == 0x0 || b == 0x0 || c == 0x0)
+        continue;
+
+      BuildBlock(triangle, context.rasterBlock, x, y);
+
+      // Accept whole block when totally covered
+      if (a == 0xF && b == 0xF && c == 0xF)
+      {
+        for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
+        {
+          for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
+          {
+            Draw(triangle, context, x + ix, y + iy, ix, iy);
+          }
+        }
+      }
+      else  // Partially covered block
+      {
+        s32 CY1 = C1 + DX12 * y0 - DY12 * x0;
+        s32 CY2 = C2 + DX23 * y0 - DY23 * x0;
+        s32 CY3 = C3 + DX31 * y0 - DY31 * x0;
+
+        for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
+        {
+          s32 CX1 = CY1;
+          s32 CX2 = CY2;
+          s32 CX3 = CY3;
+
+          for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
+          {
+            if (CX1 > 0 && CX2 > 0 && CX3 > 0)
+            {
+              Draw(triangle, context, x + ix, y + iy, ix, iy);
+            }
+
+            CX1 -= FDY12;
+            CX2 -= FDY23;
+            CX3 -= FDY31;
+          }
+
+          CY1 += FDX12;
+          CY2 += FDX23;
+          CY3 += FDX31;
+        }
+      }
+    }
+  }
+}
+
+static void DrawTile(u32 tile, ThreadContext& context)
+{
+  const s32 tileLeft = static_cast<s32>(tile % TILES_X) * TILE_SIZE;
+  const s32 tileTop = static_cast<s32>(tile / TILES_X) * TILE_SIZE;
+
+  for (u32 index : s_tile_triangles[tile])
+  {
+    const TriangleSetup& triangle = s_triangles[index];
+    DrawTriangle(triangle, context, std::max(triangle.minx, tileLeft),
+                 std::min(triangle.maxx, tileLeft + TILE_SIZE), std::max(triangle.miny, tileTop),
+                 std::min(triangle.maxy, tileTop + TILE_SIZE));
+  }
+
+  s_tile_triangles[tile].clear();
+}
+
+static void ApplyCounters(Tev::Counters* counters)
+{
+  ADDSTAT(stats.thisFrame.rasterizedPixels, counters->rasterizedPixels);
+  ADDSTAT(stats.thisFrame.tevPixelsIn, counters->tevPixelsIn);
+  ADDSTAT(stats.thisFrame.tevPixelsOut, counters->tevPixelsOut);
+
+  for (int i = 0; i < PQ_NUM_MEMBERS; i++)
+  {
+    EfbInterface::IncPerfCounterQuadCount(static_cast<PerfQueryType>(i),
+                                          counters->perfQueryPixels[i]);
+  }
+
+  if (counters->tevPixelsOut != 0)
+  {
+    BoundingBox::coords[BoundingBox::LEFT] =
+        std::min(counters->boundingBoxLeft, BoundingBox::coords[BoundingBox::LEFT]);
+    BoundingBox::coords[BoundingBox::RIGHT] =
+        std::max(counters->boundingBoxRight, BoundingBox::coords[BoundingBox::RIGHT]);
+    BoundingBox::coords[BoundingBox::TOP] =
+        std::min(counters->boundingBoxTop, BoundingBox::coords[BoundingBox::TOP]);
+    BoundingBox::coords[BoundingBox::BOTTOM] =
+        std::max(counters->boundingBoxBottom, BoundingBox::coords[BoundingBox::BOTTOM]);
+  }
+
+  *counters = {};
+}
+
+static void UpdateTevProgram()
+{
+  if (s_tev_program_valid)
+    return;
+
+  // TEV dumps are only written when interpreting the stages
+  const Tev::Program* program = nullptr;
+  if (!g_ActiveConfig.bDumpTevStages && !g_ActiveConfig.bDumpTevTextureFetches)
+    program = Tev::GetProgram();
+
+  for (auto& context : s_contexts)
+    context->tev.SetProgram(program);
+  s_tev_program_valid = true;
+}
+
+// TEV dumps are written to shared buffers, so they need everything to be drawn on one thread.
+static bool UseTiles()
+{
+  return s_contexts.size() > 1 && !g_ActiveConfig.bDumpTevStages &&
+         !g_ActiveConfig.bDumpTevTextureFetches;
+}
+
+void Flush()
+{
+  if (s_used_tiles.size() == 1)
+  {
+    DrawTile(s_used_tiles[0], *s_contexts[0]);
+  }
+  else if (!s_used_tiles.empty())
+  {
+    // Every context is used by one call, which draws tiles until all of them are taken
+    s_next_tile = 0;
+    s_thread_pool->ParallelFor(s_contexts.size(), [](size_t thread) {
+      ThreadContext& context = *s_contexts[thread];
+      for (size_t i = s_next_tile++; i < s_used_tiles.size(); i = s_next_tile++)
+        DrawTile(s_used_tiles[i], context);
+    });
+  }
+
+  s_used_tiles.clear();
+  s_triangles.clear();
+  s_tev_program_valid = false;
+
+  for (auto& context : s_contexts)
+    ApplyCounters(&context->tev.counters);
+}
+
 void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v1,
                            const OutputVertexData* v2)
 {
@@ -290,15 +566,6 @@ void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v
   const s32 DY23 = Y2 - Y3;
   const s32 DY31 = Y3 - Y1;
 
-  // Fixed-pos32 deltas
-  const s32 FDX12 = DX12 * 16;
-  const s32 FDX23 = DX23 * 16;
-  const s32 FDX31 = DX31 * 16;
-
-  const s32 FDY12 = DY12 * 16;
-  const s32 FDY23 = DY23 * 16;
-  const s32 FDY31 = DY31 * 16;
-
   // Bounding rectangle
   s32 minx = (std::min(std::min(X1, X2), X3) + 0xF) >> 4;
   s32 maxx = (std::max(std::max(X1, X2), X3) + 0xF) >> 4;
@@ -333,6 +600,8 @@ void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v
   if (minx >= maxx || miny >= maxy)
     return;
 
+  TriangleSetup triangle;
+
   // Setup slopes
   float fltx1 = v0->screenPosition.x;
   float flty1 = v0->screenPosition.y;
@@ -341,11 +610,11 @@ void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v
   float fltdy12 = flty1 - v1->screenPosition.y;
   float fltdy31 = v2->screenPosition.y - flty1;
 
-  InitTriangle(fltx1, flty1, (X1 + 0xF) >> 4, (Y1 + 0xF) >> 4);
+  InitTriangle(&triangle, fltx1, flty1, (X1 + 0xF) >> 4, (Y1 + 0xF) >> 4);
 
   float w[3] = {1.0f / v0->projectedPosition.w, 1.0f / v1->projectedPosition.w,
                 1.0f / v2->projectedPosition.w};
-  InitSlope(&WSlope, w[0], w[1], w[2], fltdx31, fltdx12, fltdy12, fltdy31);
+  InitSlope(&triangle.WSlope, w[0], w[1], w[2], fltdx31, fltdx12, fltdy12, fltdy31);
 
   // TODO: The zfreeze emulation is not quite correct, yet!
   // Many things might prevent us from reaching this line (culling, clipping, scissoring).
@@ -356,19 +625,21 @@ void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v
   if (!bpmem.genMode.zfreeze || !g_ActiveConfig.bZFreeze)
     InitSlope(&ZSlope, v0->screenPosition[2], v1->screenPosition[2], v2->screenPosition[2], fltdx31,
               fltdx12, fltdy12, fltdy31);
+  triangle.ZSlope = ZSlope;
 
   for (unsigned int i = 0; i < bpmem.genMode.numcolchans; i++)
   {
     for (int comp = 0; comp < 4; comp++)
-      InitSlope(&ColorSlopes[i][comp], v0->color[i][comp], v1->color[i][comp], v2->color[i][comp],
-                fltdx31, fltdx12, fltdy12, fltdy31);
+      InitSlope(&triangle.ColorSlopes[i][comp], v0->color[i][comp], v1->color[i][comp],
+                v2->color[i][comp], fltdx31, fltdx12, fltdy12, fltdy31);
   }
 
   for (unsigned int i = 0; i < bpmem.genMode.numtexgens; i++)
   {
     for (int comp = 0; comp < 3; comp++)
-      InitSlope(&TexSlopes[i][comp], v0->texCoords[i][comp] * w[0], v1->texCoords[i][comp] * w[1],
-                v2->texCoords[i][comp] * w[2], fltdx31, fltdx12, fltdy12, fltdy31);
+      InitSlope(&triangle.TexSlopes[i][comp], v0->texCoords[i][comp] * w[0],
+                v1->texCoords[i][comp] * w[1], v2->texCoords[i][comp] * w[2], fltdx31, fltdx12,
+                fltdy12, fltdy31);
   }
 
   // Half-edge constants
@@ -384,87 +655,44 @@ void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v
   if (DY31 < 0 || (DY31 == 0 && DX31 > 0))
     C3++;
 
-  // Start in corner of 8x8 block
-  minx &= ~(BLOCK_SIZE - 1);
-  miny &= ~(BLOCK_SIZE - 1);
-
-  // Loop through blocks
-  for (s32 y = miny; y < maxy; y += BLOCK_SIZE)
-  {
-    for (s32 x = minx; x < maxx; x += BLOCK_SIZE)
-    {
-      // Corners of block
-      s32 x0 = x << 4;
-      s32 x1 = (x + BLOCK_SIZE - 1) << 4;
-      s32 y0 = y << 4;
-      s32 y1 = (y + BLOCK_SIZE - 1) << 4;
-
-      // Evaluate half-space functions
-      bool a00 = C1 + DX12 * y0 - DY12 * x0 > 0;
-      bool a10 = C1 + DX12 * y0 - DY12 * x1 > 0;
-      bool a01 = C1 + DX12 * y1 - DY12 * x0 > 0;
-      bool a11 = C1 + DX12 * y1 - DY12 * x1 > 0;
-      int a = (a00 << 0) | (a10 << 1) | (a01 << 2) | (a11 << 3);
+  triangle.C1 = C1;
+  triangle.C2 = C2;
+  triangle.C3 = C3;
+  triangle.DX12 = DX12;
+  triangle.DX23 = DX23;
+  triangle.DX31 = DX31;
+  triangle.DY12 = DY12;
+  triangle.DY23 = DY23;
+  triangle.DY31 = DY31;
 
-      bool b00 = C2 + DX23 * y0 - DY23 * x0 > 0;
-      bool b10 = C2 + DX23 * y0 - DY23 * x1 > 0;
-      bool b01 = C2 + DX23 * y1 - DY23 * x0 > 0;
-      bool b11 = C2 + DX23 * y1 - DY23 * x1 > 0;
-      int b = (b00 << 0) | (b10 << 1) | (b01 << 2) | (b11 << 3);
-
-      bool c00 = C3 + DX31 * y0 - DY31 * x0 > 0;
-      bool c10 = C3 + DX31 * y0 - DY31 * x1 > 0;
-      bool c01 = C3 + DX31 * y1 - DY31 * x0 > 0;
-      bool c11 = C3 + DX31 * y1 - DY31 * x1 > 0;
-      int c = (c00 << 0) | (c10 << 1) | (c01 << 2) | (c11 << 3);
-
-      // Skip block when outside an edge
-      if (a == 0x0 || b == 0x0 || c == 0x0)
-        continue;
-
-      BuildBlock(x, y);
-
-      // Accept whole block when totally covered
-      if (a == 0xF && b == 0xF && c == 0xF)
-      {
-        for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
-        {
-          for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
-          {
-            Draw(x + ix, y + iy, ix, iy);
-          }
-        }
-      }
-      else  // Partially covered block
-      {
-        s32 CY1 = C1 + DX12 * y0 - DY12 * x0;
-        s32 CY2 = C2 + DX23 * y0 - DY23 * x0;
-        s32 CY3 = C3 + DX31 * y0 - DY31 * x0;
+  // Start in corner of 8x8 block
+  triangle.minx = minx & ~(BLOCK_SIZE - 1);
+  triangle.maxx = maxx;
+  triangle.miny = miny & ~(BLOCK_SIZE - 1);
+  triangle.maxy = maxy;
 
-        for (s32 iy = 0; iy < BLOCK_SIZE; iy++)
-        {
-          s32 CX1 = CY1;
-          s32 CX2 = CY2;
-          s32 CX3 = CY3;
+  UpdateTevProgram();
 
-          for (s32 ix = 0; ix < BLOCK_SIZE; ix++)
-          {
-            if (CX1 > 0 && CX2 > 0 && CX3 > 0)
-            {
-              Draw(x + ix, y + iy, ix, iy);
-            }
+  if (!UseTiles())
+  {
+    DrawTriangle(triangle, *s_contexts[0], triangle.minx, triangle.maxx, triangle.miny,
+                 triangle.maxy);
+    return;
+  }
 
-            CX1 -= FDY12;
-            CX2 -= FDY23;
-            CX3 -= FDY31;
-          }
+  // Queue the triangle for every tile containing one of its blocks
+  const u32 index = static_cast<u32>(s_triangles.size());
+  s_triangles.push_back(triangle);
 
-          CY1 += FDX12;
-          CY2 += FDX23;
-          CY3 += FDX31;
-        }
-      }
+  for (s32 tileY = triangle.miny / TILE_SIZE; tileY <= (maxy - 1) / TILE_SIZE; tileY++)
+  {
+    for (s32 tileX = triangle.minx / TILE_SIZE; tileX <= (maxx - 1) / TILE_SIZE; tileX++)
+    {
+      const u32 tile = static_cast<u32>(tileY * TILES_X + tileX);
+      if (s_tile_triangles[tile].empty())
+        s_used_tiles.push_back(tile);
+      s_tile_triangles[tile].push_back(index);
     }
   }
 }
-}
+}  // namespace Rasterizer
@@ -11,9 +11,13 @@ struct OutputVertexData;
 namespace Rasterizer
 {
 void Init();
+void Shutdown();
 
 void DrawTriangleFrontFace(const OutputVertexData* v0, const OutputVertexData* v1,
                            const OutputVertexData* v2);
+// Draws all queued triangles, which has to happen before anything reads the EFB or changes the
+// state the triangles are drawn with.
+void Flush();
 
 void SetTevReg(int reg, int comp, s16 color);
 
@@ -4,6 +4,7 @@
 
 #include "VideoBackends/Software/SWVertexLoader.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <limits>
 
@@ -87,40 +88,49 @@ void SWVertexLoader::vFlush()
     Rasterizer::SetTevReg(i, Tev::ALP_C, PixelShaderManager::constants.kcolors[i][3]);
   }
 
-  for (u32 i = 0; i < IndexGenerator::GetIndexLen(); i++)
-  {
-    const u16 index = m_local_index_buffer[i];
-    memset(&m_vertex, 0, sizeof(m_vertex));
+  const PortableVertexDeclaration& vdec =
+      VertexLoaderManager::GetCurrentVertexFormat()->GetVertexDeclaration();
+  const bool normals = (VertexLoaderManager::g_current_components & VB_HAS_NRM0) != 0;
+  const bool nbt = (VertexLoaderManager::g_current_components & VB_HAS_NRM2) != 0;
 
-    // Super Mario Sunshine requires those to be zero for those debug boxes.
-    m_vertex.color = {};
+  // Vertices are transformed in batches, but still set up one at a time in index order.
+  const u32 num_indices = IndexGenerator::GetIndexLen();
+  for (u32 first = 0; first < num_indices; first += TransformUnit::VERTEX_BATCH_SIZE)
+  {
+    const u32 count = std::min(num_indices - first, TransformUnit::VERTEX_BATCH_SIZE);
+    for (u32 i = 0; i < count; i++)
+    {
+      InputVertexData* vertex = &m_vertices[i];
+      memset(vertex, 0, sizeof(*vertex));
 
-    // parse the videocommon format to our own struct format (m_vertex)
-    SetFormat(g_main_cp_state.last_id, primitiveType);
-    ParseVertex(VertexLoaderManager::GetCurrentVertexFormat()->GetVertexDeclaration(), index);
+      // Super Mario Sunshine requires those to be zero for those debug boxes.
+      vertex->color = {};
 
-    // transform this vertex so that it can be used for rasterization (outVertex)
-    OutputVertexData* outVertex = m_setup_unit.GetVertex();
-    TransformUnit::TransformPosition(&m_vertex, outVertex);
-    outVertex->normal = {};
-    if (VertexLoaderManager::g_current_components & VB_HAS_NRM0)
-    {
-      TransformUnit::TransformNormal(
-          &m_vertex, (VertexLoaderManager::g_current_components & VB_HAS_NRM2) != 0, outVertex);
+      // parse the videocommon format to our own struct format (m_vertices)
+      SetFormat(vertex, g_main_cp_state.last_id, primitiveType);
+      ParseVertex(vertex, vdec, m_local_index_buffer[first + i]);
     }
-    TransformUnit::TransformColor(&m_vertex, outVertex);
-    TransformUnit::TransformTexCoord(&m_vertex, outVertex, m_tex_gen_special_case);
 
-    // assemble and rasterize the primitive
-    m_setup_unit.SetupVertex();
+    // transform the vertices so that they can be used for rasterization (m_out_vertices)
+    TransformUnit::TransformVertices(m_vertices.data(), m_out_vertices.data(), count, normals,
+                                     nbt, m_tex_gen_special_case);
 
-    INCSTAT(stats.thisFrame.numVerticesLoaded)
+    for (u32 i = 0; i < count; i++)
+    {
+      // assemble and rasterize the primitive
+      *m_setup_unit.GetVertex() = m_out_vertices[i];
+      m_setup_unit.SetupVertex();
+
+      INCSTAT(stats.thisFrame.numVerticesLoaded)
+    }
   }
 
+  Rasterizer::Flush();
+
   DebugUtil::OnObjectEnd();
 }
 
-void SWVertexLoader::SetFormat(u8 attributeIndex, u8 primitiveType)
+void SWVertexLoader::SetFormat(InputVertexData* vertex, u8 attributeIndex, u8 primitiveType)
 {
   // matrix index from xf regs or cp memory?
   if (xfmem.MatrixIndexA.PosNormalMtxIdx != g_main_cp_state.matrix_index_a.PosNormalMtxIdx ||
@@ -136,15 +146,15 @@ void SWVertexLoader::SetFormat(u8 attributeIndex, u8 primitiveType)
     ERROR_LOG(VIDEO, "Matrix indices don't match");
   }
 
-  m_vertex.posMtx = xfmem.MatrixIndexA.PosNormalMtxIdx;
-  m_vertex.texMtx[0] = xfmem.MatrixIndexA.Tex0MtxIdx;
-  m_vertex.texMtx[1] = xfmem.MatrixIndexA.Tex1MtxIdx;
-  m_vertex.texMtx[2] = xfmem.MatrixIndexA.Tex2MtxIdx;
-  m_vertex.texMtx[3] = xfmem.MatrixIndexA.Tex3MtxIdx;
-  m_vertex.texMtx[4] = xfmem.MatrixIndexB.Tex4MtxIdx;
-  m_vertex.texMtx[5] = xfmem.MatrixIndexB.Tex5MtxIdx;
-  m_vertex.texMtx[6] = xfmem.MatrixIndexB.Tex6MtxIdx;
-  m_vertex.texMtx[7] = xfmem.MatrixIndexB.Tex7MtxIdx;
+  vertex->posMtx = xfmem.MatrixIndexA.PosNormalMtxIdx;
+  vertex->texMtx[0] = xfmem.MatrixIndexA.Tex0MtxIdx;
+  vertex->texMtx[1] = xfmem.MatrixIndexA.Tex1MtxIdx;
+  vertex->texMtx[2] = xfmem.MatrixIndexA.Tex2MtxIdx;
+  vertex->texMtx[3] = xfmem.MatrixIndexA.Tex3MtxIdx;
+  vertex->texMtx[4] = xfmem.MatrixIndexB.Tex4MtxIdx;
+  vertex->texMtx[5] = xfmem.MatrixIndexB.Tex5MtxIdx;
+  vertex->texMtx[6] = xfmem.MatrixIndexB.Tex6MtxIdx;
+  vertex->texMtx[7] = xfmem.MatrixIndexB.Tex7MtxIdx;
 
   // special case if only pos and tex coord 0 and tex coord input is AB11
   // http://libogc.devkitpro.org/gx_8h.html#a55a426a3ff796db584302bddd829f002
@@ -207,34 +217,35 @@ static void ReadVertexAttribute(T* dst, DataReader src, const AttributeFormat& f
   }
 }
 
-void SWVertexLoader::ParseVertex(const PortableVertexDeclaration& vdec, int index)
+void SWVertexLoader::ParseVertex(InputVertexData* vertex, const PortableVertexDeclaration& vdec,
+                                 int index)
 {
   DataReader src(m_local_vertex_buffer.data(),
                  m_local_vertex_buffer.data() + m_local_vertex_buffer.size());
   src.Skip(index * vdec.stride);
 
-  ReadVertexAttribute<float>(&m_vertex.position[0], src, vdec.position, 0, 3, false);
+  ReadVertexAttribute<float>(&vertex->position[0], src, vdec.position, 0, 3, false);
 
-  for (std::size_t i = 0; i < m_vertex.normal.size(); i++)
+  for (std::size_t i = 0; i < vertex->normal.size(); i++)
   {
-    ReadVertexAttribute<float>(&m_vertex.normal[i][0], src, vdec.normals[i], 0, 3, false);
+    ReadVertexAttribute<float>(&vertex->normal[i][0], src, vdec.normals[i], 0, 3, false);
   }
 
-  for (std::size_t i = 0; i < m_vertex.color.size(); i++)
+  for (std::size_t i = 0; i < vertex->color.size(); i++)
   {
-    ReadVertexAttribute<u8>(m_vertex.color[i].data(), src, vdec.colors[i], 0, 4, true);
+    ReadVertexAttribute<u8>(vertex->color[i].data(), src, vdec.colors[i], 0, 4, true);
   }
 
-  for (std::size_t i = 0; i < m_vertex.texCoords.size(); i++)
+  for (std::size_t i = 0; i < vertex->texCoords.size(); i++)
   {
-    ReadVertexAttribute<float>(m_vertex.texCoords[i].data(), src, vdec.texcoords[i], 0, 2, false);
+    ReadVertexAttribute<float>(vertex->texCoords[i].data(), src, vdec.texcoords[i], 0, 2, false);
 
     // the texmtr is stored as third component of the texCoord
     if (vdec.texcoords[i].components >= 3)
     {
-      ReadVertexAttribute<u8>(&m_vertex.texMtx[i], src, vdec.texcoords[i], 2, 1, false);
+      ReadVertexAttribute<u8>(&vertex->texMtx[i], src, vdec.texcoords[i], 2, 1, false);
     }
   }
 
-  ReadVertexAttribute<u8>(&m_vertex.posMtx, src, vdec.posmtx, 0, 1, false);
+  ReadVertexAttribute<u8>(&vertex->posMtx, src, vdec.posmtx, 0, 1, false);
 }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -11,6 +12,7 @@
 
 #include "VideoBackends/Software/NativeVertexFormat.h"
 #include "VideoBackends/Software/SetupUnit.h"
+#include "VideoBackends/Software/TransformUnit.h"
 
 #include "VideoCommon/VertexManagerBase.h"
 
@@ -27,13 +29,14 @@ private:
   void ResetBuffer(u32 stride) override;
   void vFlush() override;
 
-  void SetFormat(u8 attributeIndex, u8 primitiveType);
-  void ParseVertex(const PortableVertexDeclaration& vdec, int index);
+  void SetFormat(InputVertexData* vertex, u8 attributeIndex, u8 primitiveType);
+  void ParseVertex(InputVertexData* vertex, const PortableVertexDeclaration& vdec, int index);
 
   std::vector<u8> m_local_vertex_buffer;
   std::vector<u16> m_local_index_buffer;
 
-  InputVertexData m_vertex;
+  std::array<InputVertexData, TransformUnit::VERTEX_BATCH_SIZE> m_vertices;
+  std::array<OutputVertexData, TransformUnit::VERTEX_BATCH_SIZE> m_out_vertices;
   SetupUnit m_setup_unit;
 
   bool m_tex_gen_special_case;
@@ -2,20 +2,24 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <array>
 #include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
+#include "Common/Hash.h"
 #include "Common/MathUtil.h"
 #include "VideoBackends/Software/DebugUtil.h"
 #include "VideoBackends/Software/EfbInterface.h"
 #include "VideoBackends/Software/Tev.h"
 #include "VideoBackends/Software/TextureSampler.h"
 
-#include "VideoCommon/BoundingBox.h"
 #include "VideoCommon/PerfQueryBase.h"
 #include "VideoCommon/PixelShaderManager.h"
-#include "VideoCommon/Statistics.h"
 #include "VideoCommon/VideoConfig.h"
 #include "VideoCommon/XFMemory.h"
 
@@ -563,49 +567,8 @@ void Tev::Indirect(unsigned int stageNum, s32 s, s32 t)
   }
 }
 
-void Tev::Draw()
+void Tev::InterpretStages()
 {
-  ASSERT(Position[0] >= 0 && Position[0] < EFB_WIDTH);
-  ASSERT(Position[1] >= 0 && Position[1] < EFB_HEIGHT);
-
-  INCSTAT(stats.thisFrame.tevPixelsIn);
-
-  // initial color values
-  for (int i = 0; i < 4; i++)
-  {
-    Reg[i][RED_C] = PixelShaderManager::constants.colors[i][0];
-    Reg[i][GRN_C] = PixelShaderManager::constants.colors[i][1];
-    Reg[i][BLU_C] = PixelShaderManager::constants.colors[i][2];
-    Reg[i][ALP_C] = PixelShaderManager::constants.colors[i][3];
-  }
-
-  for (unsigned int stageNum = 0; stageNum < bpmem.genMode.numindstages; stageNum++)
-  {
-    const int stageNum2 = stageNum >> 1;
-    const int stageOdd = stageNum & 1;
-
-    const u32 texcoordSel = bpmem.tevindref.getTexCoord(stageNum);
-    const u32 texmap = bpmem.tevindref.getTexMap(stageNum);
-
-    const TEXSCALE& texscale = bpmem.texscale[stageNum2];
-    const s32 scaleS = stageOdd ? texscale.ss1 : texscale.ss0;
-    const s32 scaleT = stageOdd ? texscale.ts1 : texscale.ts0;
-
-    TextureSampler::Sample(Uv[texcoordSel].s >> scaleS, Uv[texcoordSel].t >> scaleT,
-                           IndirectLod[stageNum], IndirectLinear[stageNum], texmap,
-                           IndirectTex[stageNum]);
-
-#if ALLOW_TEV_DUMPS
-    if (g_ActiveConfig.bDumpTevStages)
-    {
-      u8 stage[4] = {IndirectTex[stageNum][TextureSampler::ALP_SMP],
-                     IndirectTex[stageNum][TextureSampler::BLU_SMP],
-                     IndirectTex[stageNum][TextureSampler::GRN_SMP], 255};
-      DebugUtil::DrawTempBuffer(stage, INDIRECT + stageNum);
-    }
-#endif
-  }
-
   for (unsigned int stageNum = 0; stageNum <= bpmem.genMode.numtevstages; stageNum++)
   {
     const int stageNum2 = stageNum >> 1;
@@ -706,6 +669,412 @@ void Tev::Draw()
     }
 #endif
   }
+}
+
+struct Tev::Program
+{
+  // Combiners are specialized for bits 16 to 21 of the combiner registers, which hold the bias, op,
+  // clamp and shift of both color and alpha combiners.
+  using CombinerFunc = void (*)(Tev& tev, u32 dest, const InputRegType inputs[4]);
+  static constexpr size_t NUM_COMBINER_MODES = 64;
+
+  struct Stage
+  {
+    CombinerFunc color_combiner;
+    CombinerFunc alpha_combiner;
+    u8 color_dest;
+    u8 alpha_dest;
+    std::array<u8, 4> color_inputs;
+    std::array<u8, 4> alpha_inputs;
+    u8 konst_color;
+    u8 konst_alpha;
+    u8 color_chan;
+    std::array<u8, 4> ras_swap;
+    std::array<u8, 4> tex_swap;
+    u8 texcoord;
+    u8 texmap;
+    bool texture_enabled;
+    // Whether the texture coordinate is modified by indirect texturing
+    bool indirect;
+  };
+
+  u32 num_stages;
+  std::array<Stage, 16> stages;
+  // Result of the alpha test for every alpha value
+  std::array<bool, 256> alpha_test;
+
+  void Compile();
+
+  template <u32 CompareMode>
+  static bool Compare(const InputRegType inputs[4], int comp);
+  template <u32 Mode>
+  static void CombineColor(Tev& tev, u32 dest, const InputRegType inputs[4]);
+  template <u32 Mode>
+  static void CombineAlpha(Tev& tev, u32 dest, const InputRegType inputs[4]);
+
+  template <size_t... Modes>
+  static std::array<CombinerFunc, sizeof...(Modes)> ColorCombiners(std::index_sequence<Modes...>)
+  {
+    return {{&CombineColor<Modes>...}};
+  }
+  template <size_t... Modes>
+  static std::array<CombinerFunc, sizeof...(Modes)> AlphaCombiners(std::index_sequence<Modes...>)
+  {
+    return {{&CombineAlpha<Modes>...}};
+  }
+};
+
+static constexpr s32 CombinerBias(u32 bias)
+{
+  return bias == 1 ? 128 : bias == 2 ? -128 : 0;
+}
+
+static constexpr u32 CombinerLShift(u32 shift)
+{
+  return shift == 1 ? 1 : shift == 2 ? 2 : 0;
+}
+
+static constexpr u32 CombinerRShift(u32 shift)
+{
+  return shift == 3 ? 1 : 0;
+}
+
+template <u32 CompareMode>
+bool Tev::Program::Compare(const InputRegType inputs[4], int comp)
+{
+  switch (CompareMode)
+  {
+  case TEVCMP_R8_GT:
+    return inputs[RED_C].a > inputs[RED_C].b;
+  case TEVCMP_R8_EQ:
+    return inputs[RED_C].a == inputs[RED_C].b;
+  case TEVCMP_GR16_GT:
+  case TEVCMP_GR16_EQ:
+  {
+    const u32 a = (inputs[GRN_C].a << 8) | inputs[RED_C].a;
+    const u32 b = (inputs[GRN_C].b << 8) | inputs[RED_C].b;
+    return CompareMode == TEVCMP_GR16_GT ? a > b : a == b;
+  }
+  case TEVCMP_BGR24_GT:
+  case TEVCMP_BGR24_EQ:
+  {
+    const u32 a = (inputs[BLU_C].a << 16) | (inputs[GRN_C].a << 8) | inputs[RED_C].a;
+    const u32 b = (inputs[BLU_C].b << 16) | (inputs[GRN_C].b << 8) | inputs[RED_C].b;
+    return CompareMode == TEVCMP_BGR24_GT ? a > b : a == b;
+  }
+  case TEVCMP_RGB8_GT:
+    return inputs[comp].a > inputs[comp].b;
+  case TEVCMP_RGB8_EQ:
+  default:
+    return inputs[comp].a == inputs[comp].b;
+  }
+}
+
+// Same as DrawColorRegular or DrawColorCompare followed by the clamping in InterpretStages
+template <u32 Mode>
+void Tev::Program::CombineColor(Tev& tev, u32 dest, const InputRegType inputs[4])
+{
+  constexpr u32 bias = Mode & 3;
+  constexpr u32 op = (Mode >> 2) & 1;
+  constexpr bool clamp = ((Mode >> 3) & 1) != 0;
+  constexpr u32 shift = (Mode >> 4) & 3;
+
+  s16* reg = tev.Reg[dest];
+
+  if (bias != 3)
+  {
+    for (int i = BLU_C; i <= RED_C; i++)
+    {
+      const InputRegType& InputReg = inputs[i];
+
+      const u16 c = InputReg.c + (InputReg.c >> 7);
+
+      s32 temp = InputReg.a * (256 - c) + (InputReg.b * c);
+      temp <<= CombinerLShift(shift);
+      temp += (shift == 3) ? 0 : (op == 1) ? 127 : 128;
+      temp >>= 8;
+      temp = op ? -temp : temp;
+
+      s32 result = ((InputReg.d + CombinerBias(bias)) << CombinerLShift(shift)) + temp;
+      result = result >> CombinerRShift(shift);
+
+      reg[i] = result;
+    }
+  }
+  else
+  {
+    for (int i = BLU_C; i <= RED_C; i++)
+      reg[i] = inputs[i].d + (Compare<(shift << 1) | op | 8>(inputs, i) ? inputs[i].c : 0);
+  }
+
+  for (int i = BLU_C; i <= RED_C; i++)
+    reg[i] = clamp ? Clamp255(reg[i]) : Clamp1024(reg[i]);
+}
+
+// Same as DrawAlphaRegular or DrawAlphaCompare followed by the clamping in InterpretStages
+template <u32 Mode>
+void Tev::Program::CombineAlpha(Tev& tev, u32 dest, const InputRegType inputs[4])
+{
+  constexpr u32 bias = Mode & 3;
+  constexpr u32 op = (Mode >> 2) & 1;
+  constexpr bool clamp = ((Mode >> 3) & 1) != 0;
+  constexpr u32 shift = (Mode >> 4) & 3;
+
+  s16& reg = tev.Reg[dest][ALP_C];
+  const InputRegType& InputReg = inputs[ALP_C];
+
+  if (bias != 3)
+  {
+    const u16 c = InputReg.c + (InputReg.c >> 7);
+
+    s32 temp = InputReg.a * (256 - c) + (InputReg.b * c);
+    temp <<= CombinerLShift(shift);
+    temp += (shift != 3) ? 0 : (op == 1) ? 127 : 128;
+    temp = op ? (-temp >> 8) : (temp >> 8);
+
+    s32 result = ((InputReg.d + CombinerBias(bias)) << CombinerLShift(shift)) + temp;
+    result = result >> CombinerRShift(shift);
+
+    reg = result;
+  }
+  else
+  {
+    reg = InputReg.d + (Compare<(shift << 1) | op | 8>(inputs, ALP_C) ? InputReg.c : 0);
+  }
+
+  reg = clamp ? Clamp255(reg) : Clamp1024(reg);
+}
+
+void Tev::Program::Compile()
+{
+  static const auto color_combiners =
+      ColorCombiners(std::make_index_sequence<NUM_COMBINER_MODES>());
+  static const auto alpha_combiners =
+      AlphaCombiners(std::make_index_sequence<NUM_COMBINER_MODES>());
+
+  num_stages = bpmem.genMode.numtevstages + 1;
+
+  for (u32 stageNum = 0; stageNum < num_stages; stageNum++)
+  {
+    const int stageOdd = stageNum & 1;
+    const TwoTevStageOrders& order = bpmem.tevorders[stageNum >> 1];
+    const TevKSel& kSel = bpmem.tevksel[stageNum >> 1];
+    const TevStageCombiner::ColorCombiner& cc = bpmem.combiners[stageNum].colorC;
+    const TevStageCombiner::AlphaCombiner& ac = bpmem.combiners[stageNum].alphaC;
+    Stage& stage = stages[stageNum];
+
+    stage.color_combiner = color_combiners[(cc.hex >> 16) & (NUM_COMBINER_MODES - 1)];
+    stage.alpha_combiner = alpha_combiners[(ac.hex >> 16) & (NUM_COMBINER_MODES - 1)];
+    stage.color_dest = cc.dest;
+    stage.alpha_dest = ac.dest;
+    stage.color_inputs = {{static_cast<u8>(cc.a), static_cast<u8>(cc.b), static_cast<u8>(cc.c),
+                           static_cast<u8>(cc.d)}};
+    stage.alpha_inputs = {{static_cast<u8>(ac.a), static_cast<u8>(ac.b), static_cast<u8>(ac.c),
+                           static_cast<u8>(ac.d)}};
+
+    stage.konst_color = kSel.getKC(stageOdd);
+    stage.konst_alpha = kSel.getKA(stageOdd);
+
+    // Swap tables in the order red, green, blue, alpha
+    const TevKSel& rasSwap0 = bpmem.tevksel[ac.rswap * 2];
+    const TevKSel& rasSwap1 = bpmem.tevksel[ac.rswap * 2 + 1];
+    stage.color_chan = order.getColorChan(stageOdd);
+    stage.ras_swap = {{static_cast<u8>(rasSwap0.swap1), static_cast<u8>(rasSwap0.swap2),
+                       static_cast<u8>(rasSwap1.swap1), static_cast<u8>(rasSwap1.swap2)}};
+
+    const TevKSel& texSwap0 = bpmem.tevksel[ac.tswap * 2];
+    const TevKSel& texSwap1 = bpmem.tevksel[ac.tswap * 2 + 1];
+    stage.texcoord = order.getTexCoord(stageOdd);
+    stage.texmap = order.getTexMap(stageOdd);
+    stage.texture_enabled = order.getEnable(stageOdd) != 0;
+    stage.tex_swap = {{static_cast<u8>(texSwap0.swap1), static_cast<u8>(texSwap0.swap2),
+                       static_cast<u8>(texSwap1.swap1), static_cast<u8>(texSwap1.swap2)}};
+
+    stage.indirect = bpmem.tevind[stageNum].hex != 0;
+  }
+
+  for (u32 alpha = 0; alpha < alpha_test.size(); alpha++)
+    alpha_test[alpha] = TevAlphaTest(alpha);
+}
+
+namespace
+{
+// All BP registers a program depends on
+struct ProgramUid
+{
+  u32 num_stages;
+  u32 alpha_test;
+  std::array<u32, 16> color_combiners;
+  std::array<u32, 16> alpha_combiners;
+  std::array<u32, 16> indirect;
+  std::array<u32, 8> orders;
+  std::array<u32, 8> ksel;
+
+  bool operator==(const ProgramUid& other) const
+  {
+    return std::memcmp(this, &other, sizeof(ProgramUid)) == 0;
+  }
+};
+
+struct ProgramUidHash
+{
+  size_t operator()(const ProgramUid& uid) const
+  {
+    return Common::HashFletcher(reinterpret_cast<const u8*>(&uid), sizeof(ProgramUid));
+  }
+};
+}  // namespace
+
+static std::unordered_map<ProgramUid, std::unique_ptr<Tev::Program>, ProgramUidHash> s_programs;
+
+const Tev::Program* Tev::GetProgram()
+{
+  // Registers of unused stages are left zero, so that they don't cause a new program
+  ProgramUid uid = {};
+  uid.num_stages = bpmem.genMode.numtevstages + 1;
+  uid.alpha_test = bpmem.alpha_test.hex;
+  for (u32 i = 0; i < uid.num_stages; i++)
+  {
+    uid.color_combiners[i] = bpmem.combiners[i].colorC.hex;
+    uid.alpha_combiners[i] = bpmem.combiners[i].alphaC.hex;
+    uid.indirect[i] = bpmem.tevind[i].hex;
+  }
+  for (u32 i = 0; i < uid.orders.size(); i++)
+  {
+    uid.orders[i] = bpmem.tevorders[i].hex;
+    uid.ksel[i] = bpmem.tevksel[i].hex;
+  }
+
+  std::unique_ptr<Program>& program = s_programs[uid];
+  if (!program)
+  {
+    program = std::make_unique<Program>();
+    program->Compile();
+  }
+  return program.get();
+}
+
+void Tev::ClearProgramCache()
+{
+  s_programs.clear();
+}
+
+void Tev::RunProgram(const Program& program)
+{
+  for (u32 stageNum = 0; stageNum < program.num_stages; stageNum++)
+  {
+    const Program::Stage& stage = program.stages[stageNum];
+    const TextureCoordinateType& uv = Uv[stage.texcoord];
+
+    if (stage.indirect)
+    {
+      Indirect(stageNum, uv.s, uv.t);
+    }
+    else
+    {
+      TexCoord.s = uv.s;
+      TexCoord.t = uv.t;
+      AlphaBump = 0;
+    }
+
+    if (stage.texture_enabled)
+    {
+      // RGBA
+      u8 texel[4];
+
+      TextureSampler::Sample(TexCoord.s, TexCoord.t, TextureLod[stageNum], TextureLinear[stageNum],
+                             stage.texmap, texel);
+
+      TexColor[RED_C] = texel[stage.tex_swap[0]];
+      TexColor[GRN_C] = texel[stage.tex_swap[1]];
+      TexColor[BLU_C] = texel[stage.tex_swap[2]];
+      TexColor[ALP_C] = texel[stage.tex_swap[3]];
+    }
+
+    StageKonst[RED_C] = *(m_KonstLUT[stage.konst_color][RED_C]);
+    StageKonst[GRN_C] = *(m_KonstLUT[stage.konst_color][GRN_C]);
+    StageKonst[BLU_C] = *(m_KonstLUT[stage.konst_color][BLU_C]);
+    StageKonst[ALP_C] = *(m_KonstLUT[stage.konst_alpha][ALP_C]);
+
+    if (stage.color_chan <= 1)
+    {
+      const u8* color = Color[stage.color_chan];
+      RasColor[RED_C] = color[stage.ras_swap[0]];
+      RasColor[GRN_C] = color[stage.ras_swap[1]];
+      RasColor[BLU_C] = color[stage.ras_swap[2]];
+      RasColor[ALP_C] = color[stage.ras_swap[3]];
+    }
+    else
+    {
+      // The remaining channels don't use the swap table
+      SetRasColor(stage.color_chan, 0);
+    }
+
+    InputRegType inputs[4];
+    for (int i = 0; i < 3; i++)
+    {
+      inputs[BLU_C + i].a = *m_ColorInputLUT[stage.color_inputs[0]][i];
+      inputs[BLU_C + i].b = *m_ColorInputLUT[stage.color_inputs[1]][i];
+      inputs[BLU_C + i].c = *m_ColorInputLUT[stage.color_inputs[2]][i];
+      inputs[BLU_C + i].d = *m_ColorInputLUT[stage.color_inputs[3]][i];
+    }
+    inputs[ALP_C].a = *m_AlphaInputLUT[stage.alpha_inputs[0]];
+    inputs[ALP_C].b = *m_AlphaInputLUT[stage.alpha_inputs[1]];
+    inputs[ALP_C].c = *m_AlphaInputLUT[stage.alpha_inputs[2]];
+    inputs[ALP_C].d = *m_AlphaInputLUT[stage.alpha_inputs[3]];
+
+    stage.color_combiner(*this, stage.color_dest, inputs);
+    stage.alpha_combiner(*this, stage.alpha_dest, inputs);
+  }
+}
+
+void Tev::Draw()
+{
+  ASSERT(Position[0] >= 0 && Position[0] < EFB_WIDTH);
+  ASSERT(Position[1] >= 0 && Position[1] < EFB_HEIGHT);
+
+  counters.tevPixelsIn++;
+
+  // initial color values
+  for (int i = 0; i < 4; i++)
+  {
+    Reg[i][RED_C] = PixelShaderManager::constants.colors[i][0];
+    Reg[i][GRN_C] = PixelShaderManager::constants.colors[i][1];
+    Reg[i][BLU_C] = PixelShaderManager::constants.colors[i][2];
+    Reg[i][ALP_C] = PixelShaderManager::constants.colors[i][3];
+  }
+
+  for (unsigned int stageNum = 0; stageNum < bpmem.genMode.numindstages; stageNum++)
+  {
+    const int stageNum2 = stageNum >> 1;
+    const int stageOdd = stageNum & 1;
+
+    const u32 texcoordSel = bpmem.tevindref.getTexCoord(stageNum);
+    const u32 texmap = bpmem.tevindref.getTexMap(stageNum);
+
+    const TEXSCALE& texscale = bpmem.texscale[stageNum2];
+    const s32 scaleS = stageOdd ? texscale.ss1 : texscale.ss0;
+    const s32 scaleT = stageOdd ? texscale.ts1 : texscale.ts0;
+
+    TextureSampler::Sample(Uv[texcoordSel].s >> scaleS, Uv[texcoordSel].t >> scaleT,
+                           IndirectLod[stageNum], IndirectLinear[stageNum], texmap,
+                           IndirectTex[stageNum]);
+
+#if ALLOW_TEV_DUMPS
+    if (g_ActiveConfig.bDumpTevStages)
+    {
+      u8 stage[4] = {IndirectTex[stageNum][TextureSampler::ALP_SMP],
+                     IndirectTex[stageNum][TextureSampler::BLU_SMP],
+                     IndirectTex[stageNum][TextureSampler::GRN_SMP], 255};
+      DebugUtil::DrawTempBuffer(stage, INDIRECT + stageNum);
+    }
+#endif
+  }
+
+  if (m_program)
+    RunProgram(*m_program);
+  else
+    InterpretStages();
 
   // convert to 8 bits per component
   // the results of the last tev stage are put onto the screen,
@@ -715,7 +1084,7 @@ void Tev::Draw()
   u8 output[4] = {(u8)Reg[alpha_index][ALP_C], (u8)Reg[color_index][BLU_C],
                   (u8)Reg[color_index][GRN_C], (u8)Reg[color_index][RED_C]};
 
-  if (!TevAlphaTest(output[ALP_C]))
+  if (m_program ? !m_program->alpha_test[output[ALP_C]] : !TevAlphaTest(output[ALP_C]))
     return;
 
   // z texture
@@ -831,23 +1200,19 @@ void Tev::Draw()
   if (late_ztest && bpmem.zmode.testenable)
   {
     // TODO: Check against hw if these values get incremented even if depth testing is disabled
-    EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_INPUT);
+    counters.perfQueryPixels[PQ_ZCOMP_INPUT]++;
 
     if (!EfbInterface::ZCompare(Position[0], Position[1], Position[2]))
       return;
 
-    EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_OUTPUT);
+    counters.perfQueryPixels[PQ_ZCOMP_OUTPUT]++;
   }
 
   // branchless bounding box update
-  BoundingBox::coords[BoundingBox::LEFT] =
-      std::min((u16)Position[0], BoundingBox::coords[BoundingBox::LEFT]);
-  BoundingBox::coords[BoundingBox::RIGHT] =
-      std::max((u16)Position[0], BoundingBox::coords[BoundingBox::RIGHT]);
-  BoundingBox::coords[BoundingBox::TOP] =
-      std::min((u16)Position[1], BoundingBox::coords[BoundingBox::TOP]);
-  BoundingBox::coords[BoundingBox::BOTTOM] =
-      std::max((u16)Position[1], BoundingBox::coords[BoundingBox::BOTTOM]);
+  counters.boundingBoxLeft = std::min((u16)Position[0], counters.boundingBoxLeft);
+  counters.boundingBoxRight = std::max((u16)Position[0], counters.boundingBoxRight);
+  counters.boundingBoxTop = std::min((u16)Position[1], counters.boundingBoxTop);
+  counters.boundingBoxBottom = std::max((u16)Position[1], counters.boundingBoxBottom);
 
 #if ALLOW_TEV_DUMPS
   if (g_ActiveConfig.bDumpTevStages)
@@ -869,8 +1234,8 @@ void Tev::Draw()
   }
 #endif
 
-  INCSTAT(stats.thisFrame.tevPixelsOut);
-  EfbInterface::IncPerfCounterQuadCount(PQ_BLEND_INPUT);
+  counters.tevPixelsOut++;
+  counters.perfQueryPixels[PQ_BLEND_INPUT]++;
 
   EfbInterface::BlendTev(Position[0], Position[1], output);
 }
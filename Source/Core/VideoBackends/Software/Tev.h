@@ -4,10 +4,20 @@
 
 #pragma once
 
+#include <array>
+
+#include "Common/CommonTypes.h"
 #include "VideoCommon/BPMemory.h"
+#include "VideoCommon/PerfQueryBase.h"
 
 class Tev
 {
+public:
+  // The TEV stage configuration decoded into functions which are specialized for the modes of the
+  // combiners, so that the BP registers don't have to be decoded for every pixel.
+  struct Program;
+
+private:
   struct InputRegType
   {
     unsigned a : 8;
@@ -23,7 +33,6 @@ class Tev
   };
 
   // color order: ABGR
-  s16 Reg[4][4];
   s16 KonstantColors[4][4];
   s16 TexColor[4];
   s16 RasColor[4];
@@ -66,7 +75,32 @@ class Tev
 
   void Indirect(unsigned int stageNum, s32 s, s32 t);
 
+  void InterpretStages();
+  void RunProgram(const Program& program);
+
+  const Program* m_program = nullptr;
+
 public:
+  // Per-pixel statistics, perf query counts and the bounding box are gathered by every instance
+  // separately, so that several threads can draw at the same time. Rasterizer adds them to the
+  // global values after every batch of triangles.
+  struct Counters
+  {
+    u32 rasterizedPixels = 0;
+    u32 tevPixelsIn = 0;
+    u32 tevPixelsOut = 0;
+    std::array<u32, PQ_NUM_MEMBERS> perfQueryPixels{};
+    u16 boundingBoxLeft = 0xFFFF;
+    u16 boundingBoxRight = 0;
+    u16 boundingBoxTop = 0xFFFF;
+    u16 boundingBoxBottom = 0;
+  };
+
+  Counters counters;
+
+  // color order: ABGR
+  s16 Reg[4][4];
+
   s32 Position[3];
   u8 Color[2][4];  // must be RGBA for correct swap table ordering
   TextureCoordinateType Uv[8];
@@ -87,5 +121,14 @@ public:
 
   void Draw();
 
+  // Returns the program for the current BP state, which is only compiled the first time the state
+  // is used.
+  static const Program* GetProgram();
+  static void ClearProgramCache();
+
+  // Draw runs the given program instead of interpreting the BP registers, unless it is null. The
+  // program has to match the current BP state.
+  void SetProgram(const Program* program) { m_program = program; }
+
   void SetRegColor(int reg, int comp, s16 color);
 };
@@ -22,6 +22,16 @@
 #include "VideoCommon/BPMemory.h"
 #include "VideoCommon/XFMemory.h"
 
+#if defined(_M_X86)
+#include <emmintrin.h>
+#elif defined(_M_ARM_64)
+#include <arm_neon.h>
+#endif
+
+#if defined(_M_X86) || defined(_M_ARM_64)
+#define TRANSFORM_UNIT_SIMD
+#endif
+
 namespace TransformUnit
 {
 static void MultiplyVec2Mat24(const Vec3& vec, const float* mat, Vec3& result)
@@ -319,7 +329,12 @@ static void LightAlpha(const Vec3& pos, const Vec3& normal, u8 lightNum, const L
   }
 }
 
-void TransformColor(const InputVertexData* src, OutputVertexData* dst)
+// Combines the material colors with the summed up light colors, which are only used for channels
+// with lighting enabled.
+static void ApplyLighting(const InputVertexData* src,
+                          const std::array<Vec3, NUM_XF_COLOR_CHANNELS>& lightCols,
+                          const std::array<float, NUM_XF_COLOR_CHANNELS>& lightAlphas,
+                          OutputVertexData* dst)
 {
   for (u32 chan = 0; chan < NUM_XF_COLOR_CHANNELS; chan++)
   {
@@ -336,7 +351,53 @@ void TransformColor(const InputVertexData* src, OutputVertexData* dst)
 
     if (colorchan.enablelighting)
     {
-      Vec3 lightCol;
+      const Vec3& lightCol = lightCols[chan];
+      int light_x = MathUtil::Clamp(static_cast<int>(lightCol.x), 0, 255);
+      int light_y = MathUtil::Clamp(static_cast<int>(lightCol.y), 0, 255);
+      int light_z = MathUtil::Clamp(static_cast<int>(lightCol.z), 0, 255);
+      chancolor[1] = (matcolor[1] * (light_x + (light_x >> 7))) >> 8;
+      chancolor[2] = (matcolor[2] * (light_y + (light_y >> 7))) >> 8;
+      chancolor[3] = (matcolor[3] * (light_z + (light_z >> 7))) >> 8;
+    }
+    else
+    {
+      chancolor = matcolor;
+    }
+
+    // alpha
+    const LitChannel& alphachan = xfmem.alpha[chan];
+    if (alphachan.matsource)
+      matcolor[0] = src->color[chan][0];  // vertex
+    else
+      matcolor[0] = xfmem.matColor[chan] & 0xff;
+
+    if (xfmem.alpha[chan].enablelighting)
+    {
+      int light_a = MathUtil::Clamp(static_cast<int>(lightAlphas[chan]), 0, 255);
+      chancolor[0] = (matcolor[0] * (light_a + (light_a >> 7))) >> 8;
+    }
+    else
+    {
+      chancolor[0] = matcolor[0];
+    }
+
+    // abgr -> rgba
+    const u32 rgba_color = Common::swap32(chancolor.data());
+    std::memcpy(dst->color[chan].data(), &rgba_color, sizeof(u32));
+  }
+}
+
+void TransformColor(const InputVertexData* src, OutputVertexData* dst)
+{
+  std::array<Vec3, NUM_XF_COLOR_CHANNELS> lightCols;
+  std::array<float, NUM_XF_COLOR_CHANNELS> lightAlphas;
+
+  for (u32 chan = 0; chan < NUM_XF_COLOR_CHANNELS; chan++)
+  {
+    const LitChannel& colorchan = xfmem.color[chan];
+    if (colorchan.enablelighting)
+    {
+      Vec3& lightCol = lightCols[chan];
       if (colorchan.ambsource)
       {
         // vertex
@@ -358,29 +419,12 @@ void TransformColor(const InputVertexData* src, OutputVertexData* dst)
         if (mask & (1 << i))
           LightColor(dst->mvPosition, dst->normal[0], i, colorchan, lightCol);
       }
-
-      int light_x = MathUtil::Clamp(static_cast<int>(lightCol.x), 0, 255);
-      int light_y = MathUtil::Clamp(static_cast<int>(lightCol.y), 0, 255);
-      int light_z = MathUtil::Clamp(static_cast<int>(lightCol.z), 0, 255);
-      chancolor[1] = (matcolor[1] * (light_x + (light_x >> 7))) >> 8;
-      chancolor[2] = (matcolor[2] * (light_y + (light_y >> 7))) >> 8;
-      chancolor[3] = (matcolor[3] * (light_z + (light_z >> 7))) >> 8;
-    }
-    else
-    {
-      chancolor = matcolor;
     }
 
-    // alpha
     const LitChannel& alphachan = xfmem.alpha[chan];
-    if (alphachan.matsource)
-      matcolor[0] = src->color[chan][0];  // vertex
-    else
-      matcolor[0] = xfmem.matColor[chan] & 0xff;
-
-    if (xfmem.alpha[chan].enablelighting)
+    if (alphachan.enablelighting)
     {
-      float lightCol;
+      float& lightCol = lightAlphas[chan];
       if (alphachan.ambsource)
         lightCol = src->color[chan][0];  // vertex
       else
@@ -392,68 +436,754 @@ void TransformColor(const InputVertexData* src, OutputVertexData* dst)
         if (mask & (1 << i))
           LightAlpha(dst->mvPosition, dst->normal[0], i, alphachan, lightCol);
       }
-
-      int light_a = MathUtil::Clamp(static_cast<int>(lightCol), 0, 255);
-      chancolor[0] = (matcolor[0] * (light_a + (light_a >> 7))) >> 8;
-    }
-    else
-    {
-      chancolor[0] = matcolor[0];
     }
+  }
 
-    // abgr -> rgba
-    const u32 rgba_color = Common::swap32(chancolor.data());
-    std::memcpy(dst->color[chan].data(), &rgba_color, sizeof(u32));
+  ApplyLighting(src, lightCols, lightAlphas, dst);
+}
+
+static void TransformTexGen(u32 coordNum, const InputVertexData* src, OutputVertexData* dst,
+                            bool specialCase)
+{
+  const TexMtxInfo& texinfo = xfmem.texMtxInfo[coordNum];
+
+  switch (texinfo.texgentype)
+  {
+  case XF_TEXGEN_REGULAR:
+    TransformTexCoordRegular(texinfo, coordNum, specialCase, src, dst);
+    break;
+  case XF_TEXGEN_EMBOSS_MAP:
+  {
+    const LightPointer* light = (const LightPointer*)&xfmem.lights[texinfo.embosslightshift];
+
+    Vec3 ldir = (light->pos - dst->mvPosition).Normalized();
+    float d1 = ldir * dst->normal[1];
+    float d2 = ldir * dst->normal[2];
+
+    dst->texCoords[coordNum].x = dst->texCoords[texinfo.embosssourceshift].x + d1;
+    dst->texCoords[coordNum].y = dst->texCoords[texinfo.embosssourceshift].y + d2;
+    dst->texCoords[coordNum].z = dst->texCoords[texinfo.embosssourceshift].z;
+  }
+  break;
+  case XF_TEXGEN_COLOR_STRGBC0:
+    ASSERT(texinfo.sourcerow == XF_SRCCOLORS_INROW);
+    ASSERT(texinfo.inputform == XF_TEXINPUT_AB11);
+    dst->texCoords[coordNum].x = (float)dst->color[0][0] / 255.0f;
+    dst->texCoords[coordNum].y = (float)dst->color[0][1] / 255.0f;
+    dst->texCoords[coordNum].z = 1.0f;
+    break;
+  case XF_TEXGEN_COLOR_STRGBC1:
+    ASSERT(texinfo.sourcerow == XF_SRCCOLORS_INROW);
+    ASSERT(texinfo.inputform == XF_TEXINPUT_AB11);
+    dst->texCoords[coordNum].x = (float)dst->color[1][0] / 255.0f;
+    dst->texCoords[coordNum].y = (float)dst->color[1][1] / 255.0f;
+    dst->texCoords[coordNum].z = 1.0f;
+    break;
+  default:
+    ERROR_LOG(VIDEO, "Bad tex gen type %i", texinfo.texgentype.Value());
+  }
+}
+
+static void ScaleTexCoords(OutputVertexData* dst)
+{
+  for (u32 coordNum = 0; coordNum < xfmem.numTexGen.numTexGens; coordNum++)
+  {
+    dst->texCoords[coordNum][0] *= (bpmem.texcoords[coordNum].s.scale_minus_1 + 1);
+    dst->texCoords[coordNum][1] *= (bpmem.texcoords[coordNum].t.scale_minus_1 + 1);
   }
 }
 
 void TransformTexCoord(const InputVertexData* src, OutputVertexData* dst, bool specialCase)
 {
   for (u32 coordNum = 0; coordNum < xfmem.numTexGen.numTexGens; coordNum++)
+    TransformTexGen(coordNum, src, dst, specialCase);
+
+  ScaleTexCoords(dst);
+}
+
+#ifdef TRANSFORM_UNIT_SIMD
+
+// The batched functions below work on VERTEX_BATCH_SIZE vertices at once, with one vector holding
+// the same component of every vertex. They perform exactly the same floating point operations in
+// the same order as the functions for single vertices, so the results are identical.
+
+#if defined(_M_X86)
+
+using Float4 = __m128;
+using Mask4 = __m128;
+
+static Float4 Load(const float* values)
+{
+  return _mm_loadu_ps(values);
+}
+
+static void Store(float* values, Float4 vector)
+{
+  _mm_storeu_ps(values, vector);
+}
+
+static Float4 Splat(float value)
+{
+  return _mm_set1_ps(value);
+}
+
+static Float4 Add(Float4 a, Float4 b)
+{
+  return _mm_add_ps(a, b);
+}
+
+static Float4 Sub(Float4 a, Float4 b)
+{
+  return _mm_sub_ps(a, b);
+}
+
+static Float4 Mul(Float4 a, Float4 b)
+{
+  return _mm_mul_ps(a, b);
+}
+
+static Float4 Div(Float4 a, Float4 b)
+{
+  return _mm_div_ps(a, b);
+}
+
+static Float4 Sqrt(Float4 a)
+{
+  return _mm_sqrt_ps(a);
+}
+
+static Float4 Negate(Float4 a)
+{
+  return _mm_xor_ps(a, _mm_set1_ps(-0.0f));
+}
+
+static Mask4 Equal(Float4 a, Float4 b)
+{
+  return _mm_cmpeq_ps(a, b);
+}
+
+static Mask4 Less(Float4 a, Float4 b)
+{
+  return _mm_cmplt_ps(a, b);
+}
+
+static Mask4 GreaterEqual(Float4 a, Float4 b)
+{
+  return _mm_cmpge_ps(a, b);
+}
+
+static Mask4 And(Mask4 a, Mask4 b)
+{
+  return _mm_and_ps(a, b);
+}
+
+// Takes a where the mask is set and b everywhere else
+static Float4 Select(Mask4 mask, Float4 a, Float4 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+#elif defined(_M_ARM_64)
+
+using Float4 = float32x4_t;
+using Mask4 = uint32x4_t;
+
+static Float4 Load(const float* values)
+{
+  return vld1q_f32(values);
+}
+
+static void Store(float* values, Float4 vector)
+{
+  vst1q_f32(values, vector);
+}
+
+static Float4 Splat(float value)
+{
+  return vdupq_n_f32(value);
+}
+
+static Float4 Add(Float4 a, Float4 b)
+{
+  return vaddq_f32(a, b);
+}
+
+static Float4 Sub(Float4 a, Float4 b)
+{
+  return vsubq_f32(a, b);
+}
+
+static Float4 Mul(Float4 a, Float4 b)
+{
+  return vmulq_f32(a, b);
+}
+
+static Float4 Div(Float4 a, Float4 b)
+{
+  return vdivq_f32(a, b);
+}
+
+static Float4 Sqrt(Float4 a)
+{
+  return vsqrtq_f32(a);
+}
+
+static Float4 Negate(Float4 a)
+{
+  return vnegq_f32(a);
+}
+
+static Mask4 Equal(Float4 a, Float4 b)
+{
+  return vceqq_f32(a, b);
+}
+
+static Mask4 Less(Float4 a, Float4 b)
+{
+  return vcltq_f32(a, b);
+}
+
+static Mask4 GreaterEqual(Float4 a, Float4 b)
+{
+  return vcgeq_f32(a, b);
+}
+
+static Mask4 And(Mask4 a, Mask4 b)
+{
+  return vandq_u32(a, b);
+}
+
+// Takes a where the mask is set and b everywhere else
+static Float4 Select(Mask4 mask, Float4 a, Float4 b)
+{
+  return vbslq_f32(mask, a, b);
+}
+
+#endif
+
+// std::max(0.0f, a), which gives 0 for NaN
+static Float4 MaxZero(Float4 a)
+{
+  const Float4 zero = Splat(0.0f);
+  return Select(Less(zero, a), a, zero);
+}
+
+// MathUtil::Clamp(a, min, max)
+static Float4 Clamp(Float4 a, float min, float max)
+{
+  const Float4 lower = Select(Less(a, Splat(max)), a, Splat(max));
+  return Select(Less(Splat(min), lower), lower, Splat(min));
+}
+
+// SafeDivide for every component
+static Float4 SafeDivide(Float4 n, Float4 d)
+{
+  const Float4 zero = Splat(0.0f);
+  const Float4 sign = Select(Less(zero, n), Splat(1.0f), zero);
+  return Select(Equal(d, zero), sign, Div(n, d));
+}
+
+struct Vec3x4
+{
+  Float4 x;
+  Float4 y;
+  Float4 z;
+};
+
+static Vec3x4 Splat(const Vec3& vec)
+{
+  return {Splat(vec.x), Splat(vec.y), Splat(vec.z)};
+}
+
+static Vec3x4 Sub(const Vec3x4& a, const Vec3x4& b)
+{
+  return {Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z)};
+}
+
+static Vec3x4 Mul(const Vec3x4& vec, Float4 f)
+{
+  return {Mul(vec.x, f), Mul(vec.y, f), Mul(vec.z, f)};
+}
+
+static Vec3x4 Select(Mask4 mask, const Vec3x4& a, const Vec3x4& b)
+{
+  return {Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z)};
+}
+
+// Vec3::operator*(const Vec3&), which is also Vec3::Length2 for the same vector
+static Float4 Dot(const Vec3x4& a, const Vec3x4& b)
+{
+  return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z));
+}
+
+// Vec3::Normalized, which multiplies with the reciprocal of the length
+static Vec3x4 Normalized(const Vec3x4& vec)
+{
+  return Mul(vec, Div(Splat(1.0f), Sqrt(Dot(vec, vec))));
+}
+
+struct VertexBatch
+{
+  // Batches with less than VERTEX_BATCH_SIZE vertices repeat the last vertex in the remaining
+  // lanes, which then write the same results to the same output vertex.
+  std::array<const InputVertexData*, VERTEX_BATCH_SIZE> src;
+  std::array<OutputVertexData*, VERTEX_BATCH_SIZE> dst;
+  u32 count;
+};
+
+template <typename Function>
+static Float4 Gather(Function get)
+{
+  std::array<float, VERTEX_BATCH_SIZE> values;
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    values[i] = get(i);
+  return Load(values.data());
+}
+
+// get returns the vector of the vertex in the given lane
+template <typename Function>
+static Vec3x4 GatherVec3(Function get)
+{
+  return {Gather([&](u32 i) { return get(i).x; }), Gather([&](u32 i) { return get(i).y; }),
+          Gather([&](u32 i) { return get(i).z; })};
+}
+
+template <typename Function>
+static void ScatterVec3(const Vec3x4& vec, Function get)
+{
+  std::array<float, VERTEX_BATCH_SIZE> x, y, z;
+  Store(x.data(), vec.x);
+  Store(y.data(), vec.y);
+  Store(z.data(), vec.z);
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    get(i) = Vec3(x[i], y[i], z[i]);
+}
+
+// Loads the first size elements of the matrix of every lane. Usually all vertices of a batch use
+// the same matrix.
+static void LoadMatrix(const std::array<const float*, VERTEX_BATCH_SIZE>& matrices, u32 size,
+                       Float4* result)
+{
+  if (std::all_of(matrices.begin(), matrices.end(),
+                  [&](const float* matrix) { return matrix == matrices[0]; }))
   {
-    const TexMtxInfo& texinfo = xfmem.texMtxInfo[coordNum];
+    for (u32 i = 0; i < size; i++)
+      result[i] = Splat(matrices[0][i]);
+  }
+  else
+  {
+    for (u32 i = 0; i < size; i++)
+      result[i] = Gather([&](u32 lane) { return matrices[lane][i]; });
+  }
+}
+
+static void LoadMatrix(const float* matrix, u32 size, Float4* result)
+{
+  for (u32 i = 0; i < size; i++)
+    result[i] = Splat(matrix[i]);
+}
 
-    switch (texinfo.texgentype)
+static Vec3x4 MultiplyVec2Mat24(const Vec3x4& vec, const Float4* mat)
+{
+  return {Add(Add(Add(Mul(mat[0], vec.x), Mul(mat[1], vec.y)), mat[2]), mat[3]),
+          Add(Add(Add(Mul(mat[4], vec.x), Mul(mat[5], vec.y)), mat[6]), mat[7]), Splat(1.0f)};
+}
+
+static Vec3x4 MultiplyVec2Mat34(const Vec3x4& vec, const Float4* mat)
+{
+  return {Add(Add(Add(Mul(mat[0], vec.x), Mul(mat[1], vec.y)), mat[2]), mat[3]),
+          Add(Add(Add(Mul(mat[4], vec.x), Mul(mat[5], vec.y)), mat[6]), mat[7]),
+          Add(Add(Add(Mul(mat[8], vec.x), Mul(mat[9], vec.y)), mat[10]), mat[11])};
+}
+
+static Vec3x4 MultiplyVec3Mat33(const Vec3x4& vec, const Float4* mat)
+{
+  return {Add(Add(Mul(mat[0], vec.x), Mul(mat[1], vec.y)), Mul(mat[2], vec.z)),
+          Add(Add(Mul(mat[3], vec.x), Mul(mat[4], vec.y)), Mul(mat[5], vec.z)),
+          Add(Add(Mul(mat[6], vec.x), Mul(mat[7], vec.y)), Mul(mat[8], vec.z))};
+}
+
+static Vec3x4 MultiplyVec3Mat24(const Vec3x4& vec, const Float4* mat)
+{
+  return {Add(Add(Add(Mul(mat[0], vec.x), Mul(mat[1], vec.y)), Mul(mat[2], vec.z)), mat[3]),
+          Add(Add(Add(Mul(mat[4], vec.x), Mul(mat[5], vec.y)), Mul(mat[6], vec.z)), mat[7]),
+          Splat(1.0f)};
+}
+
+static Vec3x4 MultiplyVec3Mat34(const Vec3x4& vec, const Float4* mat)
+{
+  return {Add(Add(Add(Mul(mat[0], vec.x), Mul(mat[1], vec.y)), Mul(mat[2], vec.z)), mat[3]),
+          Add(Add(Add(Mul(mat[4], vec.x), Mul(mat[5], vec.y)), Mul(mat[6], vec.z)), mat[7]),
+          Add(Add(Add(Mul(mat[8], vec.x), Mul(mat[9], vec.y)), Mul(mat[10], vec.z)), mat[11])};
+}
+
+static void TransformPositions(const VertexBatch& batch)
+{
+  std::array<const float*, VERTEX_BATCH_SIZE> matrices;
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    matrices[i] = &xfmem.posMatrices[batch.src[i]->posMtx * 4];
+  Float4 mat[12];
+  LoadMatrix(matrices, 12, mat);
+
+  const Vec3x4 position = GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->position; });
+  const Vec3x4 mvPosition = MultiplyVec3Mat34(position, mat);
+  ScatterVec3(mvPosition, [&](u32 i) -> Vec3& { return batch.dst[i]->mvPosition; });
+
+  const float* proj = xfmem.projection.rawProjection;
+  Float4 projected[4];
+  if (xfmem.projection.type == GX_PERSPECTIVE)
+  {
+    projected[0] = Add(Mul(Splat(proj[0]), mvPosition.x), Mul(Splat(proj[1]), mvPosition.z));
+    projected[1] = Add(Mul(Splat(proj[2]), mvPosition.y), Mul(Splat(proj[3]), mvPosition.z));
+    projected[2] = Mul(Add(Mul(Splat(proj[4]), mvPosition.z), Splat(proj[5])),
+                       Splat(1.0f - (float)1e-7));
+    projected[3] = Negate(mvPosition.z);
+  }
+  else
+  {
+    projected[0] = Add(Mul(Splat(proj[0]), mvPosition.x), Splat(proj[1]));
+    projected[1] = Add(Mul(Splat(proj[2]), mvPosition.y), Splat(proj[3]));
+    projected[2] = Add(Mul(Splat(proj[4]), mvPosition.z), Splat(proj[5]));
+    projected[3] = Splat(1.0f);
+  }
+
+  std::array<std::array<float, VERTEX_BATCH_SIZE>, 4> values;
+  for (u32 i = 0; i < values.size(); i++)
+    Store(values[i].data(), projected[i]);
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    batch.dst[i]->projectedPosition = {values[0][i], values[1][i], values[2][i], values[3][i]};
+}
+
+static void TransformNormals(const VertexBatch& batch, bool nbt)
+{
+  std::array<const float*, VERTEX_BATCH_SIZE> matrices;
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    matrices[i] = &xfmem.normalMatrices[(batch.src[i]->posMtx & 31) * 3];
+  Float4 mat[9];
+  LoadMatrix(matrices, 9, mat);
+
+  for (u32 n = 0; n < (nbt ? 3 : 1); n++)
+  {
+    Vec3x4 normal = MultiplyVec3Mat33(
+        GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->normal[n]; }), mat);
+    if (n == 0)
+      normal = Normalized(normal);
+    ScatterVec3(normal, [&](u32 i) -> Vec3& { return batch.dst[i]->normal[n]; });
+  }
+}
+
+// CalculateLightAttn for every lane
+static Float4 CalculateLightAttn(const LightPointer* light, Vec3x4* ldir, const Vec3x4& normal,
+                                 const LitChannel& chan)
+{
+  const Float4 zero = Splat(0.0f);
+  Float4 attn = Splat(1.0f);
+
+  switch (chan.attnfunc)
+  {
+  case LIGHTATTN_NONE:
+  case LIGHTATTN_DIR:
+  {
+    *ldir = Normalized(*ldir);
+    const Mask4 is_zero = And(And(Equal(ldir->x, zero), Equal(ldir->y, zero)), Equal(ldir->z, zero));
+    *ldir = Select(is_zero, normal, *ldir);
+    break;
+  }
+  case LIGHTATTN_SPEC:
+  {
+    *ldir = Normalized(*ldir);
+    attn = Select(GreaterEqual(Dot(*ldir, normal), zero), MaxZero(Dot(Splat(light->dir), normal)),
+                  zero);
+    Vec3 distAttn = light->distatt;
+    if (chan.diffusefunc != LIGHTDIF_NONE)
+      distAttn = distAttn.Normalized();
+
+    // attLen is (1, attn, attn * attn)
+    const Float4 attn2 = Mul(attn, attn);
+    const Float4 cosAttn = Add(Add(Mul(Splat(1.0f), Splat(light->cosatt.x)),
+                                   Mul(attn, Splat(light->cosatt.y))),
+                               Mul(attn2, Splat(light->cosatt.z)));
+    const Float4 distAttnLen = Add(
+        Add(Mul(Splat(1.0f), Splat(distAttn.x)), Mul(attn, Splat(distAttn.y))),
+        Mul(attn2, Splat(distAttn.z)));
+    attn = SafeDivide(MaxZero(cosAttn), distAttnLen);
+    break;
+  }
+  case LIGHTATTN_SPOT:
+  {
+    const Float4 dist2 = Dot(*ldir, *ldir);
+    const Float4 dist = Sqrt(dist2);
+    *ldir = Mul(*ldir, Div(Splat(1.0f), dist));
+    attn = MaxZero(Dot(*ldir, Splat(light->dir)));
+
+    const Float4 cosAtt =
+        Add(Add(Splat(light->cosatt.x), Mul(Splat(light->cosatt.y), attn)),
+            Mul(Mul(Splat(light->cosatt.z), attn), attn));
+    const Float4 distAtt =
+        Add(Add(Splat(light->distatt.x), Mul(Splat(light->distatt.y), dist)),
+            Mul(Splat(light->distatt.z), dist2));
+    attn = SafeDivide(MaxZero(cosAtt), distAtt);
+    break;
+  }
+  }
+
+  return attn;
+}
+
+// LightColor for every lane
+static void LightColor(const Vec3x4& pos, const Vec3x4& normal, u8 lightNum,
+                       const LitChannel& chan, Vec3x4* lightCol)
+{
+  const LightPointer* light = (const LightPointer*)&xfmem.lights[lightNum];
+
+  Vec3x4 ldir = Sub(Splat(light->pos), pos);
+  const Float4 attn = CalculateLightAttn(light, &ldir, normal, chan);
+
+  Float4 scale;
+  switch (chan.diffusefunc)
+  {
+  case LIGHTDIF_NONE:
+    scale = attn;
+    break;
+  case LIGHTDIF_SIGN:
+    scale = Mul(attn, Dot(ldir, normal));
+    break;
+  case LIGHTDIF_CLAMP:
+    scale = Mul(attn, MaxZero(Dot(ldir, normal)));
+    break;
+  default:
+    return;
+  }
+
+  lightCol->x = Add(lightCol->x, Mul(Splat(light->color[1]), scale));
+  lightCol->y = Add(lightCol->y, Mul(Splat(light->color[2]), scale));
+  lightCol->z = Add(lightCol->z, Mul(Splat(light->color[3]), scale));
+}
+
+// LightAlpha for every lane
+static void LightAlpha(const Vec3x4& pos, const Vec3x4& normal, u8 lightNum,
+                       const LitChannel& chan, Float4* lightCol)
+{
+  const LightPointer* light = (const LightPointer*)&xfmem.lights[lightNum];
+
+  Vec3x4 ldir = Sub(Splat(light->pos), pos);
+  const Float4 attn = CalculateLightAttn(light, &ldir, normal, chan);
+
+  const Float4 color = Splat(light->color[0]);
+  switch (chan.diffusefunc)
+  {
+  case LIGHTDIF_NONE:
+    *lightCol = Add(*lightCol, Mul(color, attn));
+    break;
+  case LIGHTDIF_SIGN:
+    *lightCol = Add(*lightCol, Mul(Mul(color, attn), Dot(ldir, normal)));
+    break;
+  case LIGHTDIF_CLAMP:
+    *lightCol = Add(*lightCol, Mul(Mul(color, attn), MaxZero(Dot(ldir, normal))));
+    break;
+  }
+}
+
+static void TransformColors(const VertexBatch& batch)
+{
+  const Vec3x4 pos = GatherVec3([&](u32 i) -> const Vec3& { return batch.dst[i]->mvPosition; });
+  const Vec3x4 normal = GatherVec3([&](u32 i) -> const Vec3& { return batch.dst[i]->normal[0]; });
+
+  std::array<std::array<Vec3, NUM_XF_COLOR_CHANNELS>, VERTEX_BATCH_SIZE> lightCols;
+  std::array<std::array<float, NUM_XF_COLOR_CHANNELS>, VERTEX_BATCH_SIZE> lightAlphas;
+
+  for (u32 chan = 0; chan < NUM_XF_COLOR_CHANNELS; chan++)
+  {
+    const LitChannel& colorchan = xfmem.color[chan];
+    if (colorchan.enablelighting)
     {
-    case XF_TEXGEN_REGULAR:
-      TransformTexCoordRegular(texinfo, coordNum, specialCase, src, dst);
-      break;
-    case XF_TEXGEN_EMBOSS_MAP:
+      Vec3x4 lightCol;
+      if (colorchan.ambsource)
+      {
+        // vertex
+        lightCol.x = Gather([&](u32 i) { return batch.src[i]->color[chan][1]; });
+        lightCol.y = Gather([&](u32 i) { return batch.src[i]->color[chan][2]; });
+        lightCol.z = Gather([&](u32 i) { return batch.src[i]->color[chan][3]; });
+      }
+      else
+      {
+        const u8* ambColor = reinterpret_cast<u8*>(&xfmem.ambColor[chan]);
+        lightCol = {Splat(ambColor[1]), Splat(ambColor[2]), Splat(ambColor[3])};
+      }
+
+      u8 mask = colorchan.GetFullLightMask();
+      for (int i = 0; i < 8; ++i)
+      {
+        if (mask & (1 << i))
+          LightColor(pos, normal, i, colorchan, &lightCol);
+      }
+
+      ScatterVec3(lightCol, [&](u32 i) -> Vec3& { return lightCols[i][chan]; });
+    }
+
+    const LitChannel& alphachan = xfmem.alpha[chan];
+    if (alphachan.enablelighting)
     {
-      const LightPointer* light = (const LightPointer*)&xfmem.lights[texinfo.embosslightshift];
+      Float4 lightCol;
+      if (alphachan.ambsource)
+        lightCol = Gather([&](u32 i) { return batch.src[i]->color[chan][0]; });  // vertex
+      else
+        lightCol = Splat(static_cast<float>(xfmem.ambColor[chan] & 0xff));
 
-      Vec3 ldir = (light->pos - dst->mvPosition).Normalized();
-      float d1 = ldir * dst->normal[1];
-      float d2 = ldir * dst->normal[2];
+      u8 mask = alphachan.GetFullLightMask();
+      for (int i = 0; i < 8; ++i)
+      {
+        if (mask & (1 << i))
+          LightAlpha(pos, normal, i, alphachan, &lightCol);
+      }
 
-      dst->texCoords[coordNum].x = dst->texCoords[texinfo.embosssourceshift].x + d1;
-      dst->texCoords[coordNum].y = dst->texCoords[texinfo.embosssourceshift].y + d2;
-      dst->texCoords[coordNum].z = dst->texCoords[texinfo.embosssourceshift].z;
+      std::array<float, VERTEX_BATCH_SIZE> values;
+      Store(values.data(), lightCol);
+      for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+        lightAlphas[i][chan] = values[i];
     }
+  }
+
+  for (u32 i = 0; i < batch.count; i++)
+    ApplyLighting(batch.src[i], lightCols[i], lightAlphas[i], batch.dst[i]);
+}
+
+// TransformTexCoordRegular for every lane
+static void TransformTexCoordsRegular(const TexMtxInfo& texinfo, int coordNum, bool specialCase,
+                                      const VertexBatch& batch)
+{
+  Vec3x4 src;
+  switch (texinfo.sourcerow)
+  {
+  case XF_SRCGEOM_INROW:
+    src = GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->position; });
+    break;
+  case XF_SRCNORMAL_INROW:
+    src = GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->normal[0]; });
+    break;
+  case XF_SRCBINORMAL_T_INROW:
+    src = GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->normal[1]; });
+    break;
+  case XF_SRCBINORMAL_B_INROW:
+    src = GatherVec3([&](u32 i) -> const Vec3& { return batch.src[i]->normal[2]; });
+    break;
+  default:
+  {
+    ASSERT(texinfo.sourcerow >= XF_SRCTEX0_INROW && texinfo.sourcerow <= XF_SRCTEX7_INROW);
+    const u32 row = texinfo.sourcerow - XF_SRCTEX0_INROW;
+    src.x = Gather([&](u32 i) { return batch.src[i]->texCoords[row][0]; });
+    src.y = Gather([&](u32 i) { return batch.src[i]->texCoords[row][1]; });
+    src.z = Splat(1.0f);
     break;
-    case XF_TEXGEN_COLOR_STRGBC0:
-      ASSERT(texinfo.sourcerow == XF_SRCCOLORS_INROW);
-      ASSERT(texinfo.inputform == XF_TEXINPUT_AB11);
-      dst->texCoords[coordNum].x = (float)dst->color[0][0] / 255.0f;
-      dst->texCoords[coordNum].y = (float)dst->color[0][1] / 255.0f;
-      dst->texCoords[coordNum].z = 1.0f;
-      break;
-    case XF_TEXGEN_COLOR_STRGBC1:
-      ASSERT(texinfo.sourcerow == XF_SRCCOLORS_INROW);
-      ASSERT(texinfo.inputform == XF_TEXINPUT_AB11);
-      dst->texCoords[coordNum].x = (float)dst->color[1][0] / 255.0f;
-      dst->texCoords[coordNum].y = (float)dst->color[1][1] / 255.0f;
-      dst->texCoords[coordNum].z = 1.0f;
-      break;
-    default:
-      ERROR_LOG(VIDEO, "Bad tex gen type %i", texinfo.texgentype.Value());
+  }
+  }
+
+  std::array<const float*, VERTEX_BATCH_SIZE> matrices;
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    matrices[i] = &xfmem.posMatrices[batch.src[i]->texMtx[coordNum] * 4];
+  Float4 mat[12];
+
+  Vec3x4 dst;
+  if (texinfo.projection == XF_TEXPROJ_ST)
+  {
+    LoadMatrix(matrices, 8, mat);
+    if (texinfo.inputform == XF_TEXINPUT_AB11 || specialCase)
+      dst = MultiplyVec2Mat24(src, mat);
+    else
+      dst = MultiplyVec3Mat24(src, mat);
+  }
+  else  // texinfo.projection == XF_TEXPROJ_STQ
+  {
+    ASSERT(!specialCase);
+
+    LoadMatrix(matrices, 12, mat);
+    if (texinfo.inputform == XF_TEXINPUT_AB11)
+      dst = MultiplyVec2Mat34(src, mat);
+    else
+      dst = MultiplyVec3Mat34(src, mat);
+  }
+
+  if (xfmem.dualTexTrans.enabled)
+  {
+    const PostMtxInfo& postInfo = xfmem.postMtxInfo[coordNum];
+    const float* postMat = &xfmem.postMatrices[postInfo.index * 4];
+
+    if (specialCase)
+    {
+      LoadMatrix(postMat, 8, mat);
+      dst = MultiplyVec2Mat24(dst, mat);
+    }
+    else
+    {
+      LoadMatrix(postMat, 12, mat);
+      dst = MultiplyVec3Mat34(postInfo.normalize ? Normalized(dst) : dst, mat);
     }
   }
 
+  // Special case for q being 0
+  const Mask4 q_zero = Equal(dst.z, Splat(0.0f));
+  dst.x = Select(q_zero, Clamp(Div(dst.x, Splat(2.0f)), -1.0f, 1.0f), dst.x);
+  dst.y = Select(q_zero, Clamp(Div(dst.y, Splat(2.0f)), -1.0f, 1.0f), dst.y);
+
+  ScatterVec3(dst, [&](u32 i) -> Vec3& { return batch.dst[i]->texCoords[coordNum]; });
+}
+
+static void TransformTexCoords(const VertexBatch& batch, bool specialCase)
+{
   for (u32 coordNum = 0; coordNum < xfmem.numTexGen.numTexGens; coordNum++)
   {
-    dst->texCoords[coordNum][0] *= (bpmem.texcoords[coordNum].s.scale_minus_1 + 1);
-    dst->texCoords[coordNum][1] *= (bpmem.texcoords[coordNum].t.scale_minus_1 + 1);
+    const TexMtxInfo& texinfo = xfmem.texMtxInfo[coordNum];
+    if (texinfo.texgentype == XF_TEXGEN_REGULAR)
+    {
+      TransformTexCoordsRegular(texinfo, coordNum, specialCase, batch);
+    }
+    else
+    {
+      for (u32 i = 0; i < batch.count; i++)
+        TransformTexGen(coordNum, batch.src[i], batch.dst[i], specialCase);
+    }
   }
+
+  for (u32 i = 0; i < batch.count; i++)
+    ScaleTexCoords(batch.dst[i]);
 }
+
+#endif
+
+void TransformVertices(const InputVertexData* src, OutputVertexData* dst, u32 count, bool normals,
+                       bool nbt, bool specialCase)
+{
+  ASSERT(count > 0 && count <= VERTEX_BATCH_SIZE);
+
+  if (!normals)
+  {
+    for (u32 i = 0; i < count; i++)
+      dst[i].normal.fill(Vec3(0.0f, 0.0f, 0.0f));
+  }
+
+#ifdef TRANSFORM_UNIT_SIMD
+  VertexBatch batch;
+  for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+  {
+    batch.src[i] = &src[std::min(i, count - 1)];
+    batch.dst[i] = &dst[std::min(i, count - 1)];
+  }
+  batch.count = count;
+
+  TransformPositions(batch);
+  if (normals)
+    TransformNormals(batch, nbt);
+  TransformColors(batch);
+  TransformTexCoords(batch, specialCase);
+#else
+  for (u32 i = 0; i < count; i++)
+  {
+    TransformPosition(&src[i], &dst[i]);
+    if (normals)
+      TransformNormal(&src[i], nbt, &dst[i]);
+    TransformColor(&src[i], &dst[i]);
+    TransformTexCoord(&src[i], &dst[i], specialCase);
+  }
+#endif
 }
+}  // namespace TransformUnit
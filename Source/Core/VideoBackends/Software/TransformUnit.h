@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "Common/CommonTypes.h"
+
 struct InputVertexData;
 struct OutputVertexData;
 
@@ -13,4 +15,11 @@ void TransformPosition(const InputVertexData* src, OutputVertexData* dst);
 void TransformNormal(const InputVertexData* src, bool nbt, OutputVertexData* dst);
 void TransformColor(const InputVertexData* src, OutputVertexData* dst);
 void TransformTexCoord(const InputVertexData* src, OutputVertexData* dst, bool specialCase);
+
+constexpr u32 VERTEX_BATCH_SIZE = 4;
+
+// Does the same as the functions above for up to VERTEX_BATCH_SIZE vertices at once, using SIMD
+// instructions where they are available. The normals are set to zero when the vertices have none.
+void TransformVertices(const InputVertexData* src, OutputVertexData* dst, u32 count, bool normals,
+                       bool nbt, bool specialCase);
 }
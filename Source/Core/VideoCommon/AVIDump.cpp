@@ -6,6 +6,8 @@
 #define __STDC_CONSTANT_MACROS 1
 #endif
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -20,6 +22,7 @@ extern "C" {
 #include "Common/Logging/Log.h"
 #include "Common/MsgHandler.h"
 #include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/HW/SystemTimers.h"
@@ -27,6 +30,7 @@ extern "C" {
 #include "Core/Movie.h"
 
 #include "VideoCommon/AVIDump.h"
+#include "VideoCommon/FrameDumpConversion.h"
 #include "VideoCommon/OnScreenDisplay.h"
 #include "VideoCommon/VideoConfig.h"
 
@@ -43,6 +47,7 @@ static AVFrame* s_src_frame = nullptr;
 static AVFrame* s_scaled_frame = nullptr;
 static AVPixelFormat s_pix_fmt = AV_PIX_FMT_BGR24;
 static SwsContext* s_sws_context = nullptr;
+static std::unique_ptr<Common::ThreadPool> s_conversion_pool;
 static int s_width;
 static int s_height;
 static u64 s_last_frame;
@@ -196,12 +201,21 @@ bool AVIDump::CreateVideoFile()
   if (output_format->flags & AVFMT_GLOBALHEADER)
     s_codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
+  // Let encoders that support it work on slices or on several frames at once. 0 lets libavcodec
+  // pick the number of threads.
+  const int num_threads = std::max(g_Config.iDumpEncoderThreads, 0);
+  s_codec_context->thread_count = num_threads;
+  s_codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
   if (avcodec_open2(s_codec_context, codec, nullptr) < 0)
   {
     ERROR_LOG(VIDEO, "Could not open codec");
     return false;
   }
 
+  s_conversion_pool =
+      std::make_unique<Common::ThreadPool>(num_threads, "Frame dump conversion thread");
+
   s_src_frame = av_frame_alloc();
   s_scaled_frame = av_frame_alloc();
 
@@ -295,6 +309,28 @@ static void WritePacket(AVPacket& pkt)
   av_interleaved_write_frame(s_format_context, &pkt);
 }
 
+// Converts the frame to YUV 4:2:0 for the encoder, splitting it into horizontal strips for the
+// conversion threads.
+static void ConvertFrameToYUV420(const u8* data, int stride)
+{
+  const FrameDumpConversion::YUV420Planes planes = {
+      s_scaled_frame->data[0],     s_scaled_frame->data[1],     s_scaled_frame->data[2],
+      s_scaled_frame->linesize[0], s_scaled_frame->linesize[1], s_scaled_frame->linesize[2]};
+  const int chroma_rows = (s_height + 1) / 2;
+  const int num_strips = static_cast<int>(s_conversion_pool->GetThreadCount());
+  const int rows_per_strip = (chroma_rows + num_strips - 1) / num_strips;
+
+  s_conversion_pool->ParallelFor(static_cast<size_t>(num_strips), [&](size_t strip) {
+    const int first_row = static_cast<int>(strip) * rows_per_strip;
+    const int end_row = std::min(first_row + rows_per_strip, chroma_rows);
+    if (first_row < end_row)
+    {
+      FrameDumpConversion::ConvertRGBAToYUV420(data, stride, s_width, s_height, planes, first_row,
+                                               end_row);
+    }
+  });
+}
+
 void AVIDump::AddFrame(const u8* data, int width, int height, int stride, const Frame& state)
 {
   // Assume that the timing is valid, if the savestate id of the new frame
@@ -312,14 +348,23 @@ void AVIDump::AddFrame(const u8* data, int width, int height, int stride, const
   s_src_frame->width = s_width;
   s_src_frame->height = s_height;
 
-  // Convert image from {BGR24, RGBA} to desired pixel format
-  s_sws_context =
-      sws_getCachedContext(s_sws_context, width, height, s_pix_fmt, s_width, s_height,
-                           s_codec_context->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
-  if (s_sws_context)
+  // Convert image from {BGR24, RGBA} to desired pixel format. The common case of RGBA to YUV 4:2:0
+  // without scaling uses our own conversion, which runs on several threads.
+  if (s_pix_fmt == AV_PIX_FMT_RGBA && s_codec_context->pix_fmt == AV_PIX_FMT_YUV420P &&
+      width == s_width && height == s_height)
+  {
+    ConvertFrameToYUV420(data, stride);
+  }
+  else
   {
-    sws_scale(s_sws_context, s_src_frame->data, s_src_frame->linesize, 0, height,
-              s_scaled_frame->data, s_scaled_frame->linesize);
+    s_sws_context =
+        sws_getCachedContext(s_sws_context, width, height, s_pix_fmt, s_width, s_height,
+                             s_codec_context->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (s_sws_context)
+    {
+      sws_scale(s_sws_context, s_src_frame->data, s_src_frame->linesize, 0, height,
+                s_scaled_frame->data, s_scaled_frame->linesize);
+    }
   }
 
   // Encode and write the image.
@@ -366,6 +411,17 @@ void AVIDump::AddFrame(const u8* data, int width, int height, int stride, const
 
 static void HandleDelayedPackets()
 {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+  // The encoder holds on to frames (one per thread with frame threading) until it is told that no
+  // more frames are coming, and only then hands out the rest of the packets.
+  const int flush_error = avcodec_send_frame(s_codec_context, nullptr);
+  if (flush_error)
+  {
+    ERROR_LOG(VIDEO, "Error while stopping video: %d", flush_error);
+    return;
+  }
+#endif
+
   AVPacket pkt;
 
   while (true)
@@ -373,6 +429,10 @@ static void HandleDelayedPackets()
     PreparePacket(&pkt);
     int got_packet;
     int error = ReceivePacket(s_codec_context, &pkt, &got_packet);
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+    if (error == AVERROR_EOF)
+      break;
+#endif
     if (error)
     {
       ERROR_LOG(VIDEO, "Error while stopping video: %d", error);
@@ -415,6 +475,8 @@ void AVIDump::CloseVideoFile()
     sws_freeContext(s_sws_context);
     s_sws_context = nullptr;
   }
+
+  s_conversion_pool.reset();
 }
 
 void AVIDump::DoState()
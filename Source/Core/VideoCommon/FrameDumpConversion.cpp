@@ -0,0 +1,171 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "VideoCommon/FrameDumpConversion.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Common/CommonTypes.h"
+
+#if defined(_M_X86)
+#include <emmintrin.h>
+#endif
+
+namespace FrameDumpConversion
+{
+// Fixed point BT.601 coefficients for 8-bit limited range, scaled by 256
+constexpr int Y_R = 66, Y_G = 129, Y_B = 25;
+constexpr int U_R = -38, U_G = -74, U_B = 112;
+constexpr int V_R = 112, V_G = -94, V_B = -18;
+
+static u8 ApplyCoefficients(int r, int g, int b, int coef_r, int coef_g, int coef_b, int offset)
+{
+  return static_cast<u8>(((coef_r * r + coef_g * g + coef_b * b + 128) >> 8) + offset);
+}
+
+static u8 Luma(const u8* pixel)
+{
+  return ApplyCoefficients(pixel[0], pixel[1], pixel[2], Y_R, Y_G, Y_B, 16);
+}
+
+// Writes the chroma of the average of four pixels.
+static void Chroma(u8* u, u8* v, const u8* pixel0, const u8* pixel1, const u8* pixel2,
+                   const u8* pixel3)
+{
+  int average[3];
+  for (int i = 0; i < 3; ++i)
+    average[i] = (pixel0[i] + pixel1[i] + pixel2[i] + pixel3[i] + 2) >> 2;
+
+  *u = ApplyCoefficients(average[0], average[1], average[2], U_R, U_G, U_B, 128);
+  *v = ApplyCoefficients(average[0], average[1], average[2], V_R, V_G, V_B, 128);
+}
+
+#if defined(_M_X86)
+
+// {a0 + a1, a2 + a3, b0 + b1, b2 + b3} for 32-bit values
+static __m128i AddPairs(__m128i a, __m128i b)
+{
+  const __m128 float_a = _mm_castsi128_ps(a);
+  const __m128 float_b = _mm_castsi128_ps(b);
+  const __m128i even = _mm_castps_si128(_mm_shuffle_ps(float_a, float_b, _MM_SHUFFLE(2, 0, 2, 0)));
+  const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(float_a, float_b, _MM_SHUFFLE(3, 1, 3, 1)));
+  return _mm_add_epi32(even, odd);
+}
+
+// Applies the coefficients to 4 pixels with 16-bit components, 2 pixels per vector, like
+// ApplyCoefficients does.
+static __m128i ApplyCoefficients(__m128i pixels01, __m128i pixels23, __m128i coefficients,
+                                 int offset)
+{
+  const __m128i sums = AddPairs(_mm_madd_epi16(pixels01, coefficients),
+                                _mm_madd_epi16(pixels23, coefficients));
+  return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(128)), 8),
+                       _mm_set1_epi32(offset));
+}
+
+static void ConvertLuma(u8* luma, const u8* rgba)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i coefficients = _mm_setr_epi16(Y_R, Y_G, Y_B, 0, Y_R, Y_G, Y_B, 0);
+  const __m128i pixels0123 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba));
+  const __m128i pixels4567 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 16));
+
+  const __m128i low = ApplyCoefficients(_mm_unpacklo_epi8(pixels0123, zero),
+                                        _mm_unpackhi_epi8(pixels0123, zero), coefficients, 16);
+  const __m128i high = ApplyCoefficients(_mm_unpacklo_epi8(pixels4567, zero),
+                                         _mm_unpackhi_epi8(pixels4567, zero), coefficients, 16);
+  const __m128i packed = _mm_packs_epi32(low, high);
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(luma), _mm_packus_epi16(packed, packed));
+}
+
+// Averages 2x2 blocks of 8 pixels from two rows, and writes the chroma of the 4 averages.
+static void ConvertChroma(u8* u, u8* v, const u8* row0, const u8* row1)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i row0_0123 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+  const __m128i row0_4567 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 16));
+  const __m128i row1_0123 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+  const __m128i row1_4567 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 16));
+
+  // Vertical sums of pixels 0-1, 2-3, 4-5 and 6-7
+  const __m128i sums01 =
+      _mm_add_epi16(_mm_unpacklo_epi8(row0_0123, zero), _mm_unpacklo_epi8(row1_0123, zero));
+  const __m128i sums23 =
+      _mm_add_epi16(_mm_unpackhi_epi8(row0_0123, zero), _mm_unpackhi_epi8(row1_0123, zero));
+  const __m128i sums45 =
+      _mm_add_epi16(_mm_unpacklo_epi8(row0_4567, zero), _mm_unpacklo_epi8(row1_4567, zero));
+  const __m128i sums67 =
+      _mm_add_epi16(_mm_unpackhi_epi8(row0_4567, zero), _mm_unpackhi_epi8(row1_4567, zero));
+
+  // Add horizontally adjacent pixels, giving two 2x2 blocks per vector
+  const __m128i rounding = _mm_set1_epi16(2);
+  const __m128i blocks01 = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums01, sums23),
+                                  _mm_unpackhi_epi64(sums01, sums23)),
+                    rounding),
+      2);
+  const __m128i blocks23 = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums45, sums67),
+                                  _mm_unpackhi_epi64(sums45, sums67)),
+                    rounding),
+      2);
+
+  const __m128i u_coefficients = _mm_setr_epi16(U_R, U_G, U_B, 0, U_R, U_G, U_B, 0);
+  const __m128i v_coefficients = _mm_setr_epi16(V_R, V_G, V_B, 0, V_R, V_G, V_B, 0);
+  const __m128i u_values = ApplyCoefficients(blocks01, blocks23, u_coefficients, 128);
+  const __m128i v_values = ApplyCoefficients(blocks01, blocks23, v_coefficients, 128);
+  const __m128i packed = _mm_packs_epi32(u_values, v_values);
+  const __m128i bytes = _mm_packus_epi16(packed, packed);
+
+  const u32 u_bytes = static_cast<u32>(_mm_cvtsi128_si32(bytes));
+  const u32 v_bytes = static_cast<u32>(_mm_cvtsi128_si32(_mm_srli_si128(bytes, 4)));
+  std::memcpy(u, &u_bytes, sizeof(u32));
+  std::memcpy(v, &v_bytes, sizeof(u32));
+}
+
+#endif
+
+void ConvertRGBAToYUV420(const u8* rgba, int stride, int width, int height,
+                         const YUV420Planes& planes, int first_chroma_row, int end_chroma_row)
+{
+  for (int chroma_row = first_chroma_row; chroma_row < end_chroma_row; ++chroma_row)
+  {
+    // For odd heights, the last chroma row only covers one row of the image.
+    const int y = chroma_row * 2;
+    const bool has_second_row = y + 1 < height;
+    const u8* const row0 = rgba + y * stride;
+    const u8* const row1 = has_second_row ? row0 + stride : row0;
+    u8* const luma0 = planes.y + y * planes.y_stride;
+    u8* const luma1 = luma0 + planes.y_stride;
+    u8* const u = planes.u + chroma_row * planes.u_stride;
+    u8* const v = planes.v + chroma_row * planes.v_stride;
+
+    int x = 0;
+#if defined(_M_X86)
+    for (; x + 8 <= width; x += 8)
+    {
+      ConvertLuma(luma0 + x, row0 + x * 4);
+      if (has_second_row)
+        ConvertLuma(luma1 + x, row1 + x * 4);
+      ConvertChroma(u + x / 2, v + x / 2, row0 + x * 4, row1 + x * 4);
+    }
+#endif
+
+    for (; x < width; x += 2)
+    {
+      // For odd widths, the last chroma column only covers one column of the image.
+      const int x1 = std::min(x + 1, width - 1);
+      luma0[x] = Luma(row0 + x * 4);
+      luma0[x1] = Luma(row0 + x1 * 4);
+      if (has_second_row)
+      {
+        luma1[x] = Luma(row1 + x * 4);
+        luma1[x1] = Luma(row1 + x1 * 4);
+      }
+      Chroma(u + x / 2, v + x / 2, row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4);
+    }
+  }
+}
+}  // namespace FrameDumpConversion
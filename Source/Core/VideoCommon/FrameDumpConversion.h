@@ -0,0 +1,29 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+namespace FrameDumpConversion
+{
+// Destination of a conversion to planar YUV 4:2:0, with the chroma planes at half the width and
+// height of the image (rounded up).
+struct YUV420Planes
+{
+  u8* y;
+  u8* u;
+  u8* v;
+  int y_stride;
+  int u_stride;
+  int v_stride;
+};
+
+// Converts an RGBA8 image to YUV 4:2:0 with limited range BT.601 coefficients, which is what
+// encoders expect by default. Only the chroma rows [first_chroma_row, end_chroma_row) and the
+// luma rows belonging to them are written, so that parts of an image can be converted on different
+// threads. Uses SSE2 on x86-64, and gives the same results as the plain C++ code.
+void ConvertRGBAToYUV420(const u8* rgba, int stride, int width, int height,
+                         const YUV420Planes& planes, int first_chroma_row, int end_chroma_row);
+}  // namespace FrameDumpConversion
@@ -16,6 +16,7 @@
 
 #include <cinttypes>
 #include <cmath>
+#include <cstring>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -655,9 +656,9 @@ void Renderer::Swap(u32 xfbAddr, u32 fbWidth, u32 fbStride, u32 fbHeight, const
       m_aspect_wide = flush_count_anamorphic > 0.75 * flush_total;
   }
 
-  // Ensure the last frame was written to the dump.
-  // This is required even if frame dumping has stopped, since the frame dump is one frame
-  // behind the renderer.
+  // Ensure the previous frames were written to the dump.
+  // This is required even if frame dumping has stopped, since the frame dump is behind the
+  // renderer.
   FlushFrameDump();
 
   if (xfbAddr && fbWidth && fbStride && fbHeight)
@@ -798,42 +799,56 @@ void Renderer::RenderFrameDump()
 
 void Renderer::QueueFrameDumpReadback()
 {
-  // Index 0 was just sent to AVI dump. Swap with the second texture.
-  if (m_frame_dump_readback_textures[0])
-    std::swap(m_frame_dump_readback_textures[0], m_frame_dump_readback_textures[1]);
+  // Make room for this frame if the caller hasn't.
+  if (m_frame_dump_readback_count == FRAME_DUMP_READBACK_RING_SIZE)
+    EncodeFrameDumpReadbacks(FRAME_DUMP_READBACK_RING_SIZE - 1);
 
-  std::unique_ptr<AbstractStagingTexture>& rbtex = m_frame_dump_readback_textures[0];
+  const size_t index = (m_frame_dump_first_readback + m_frame_dump_readback_count) %
+                       FRAME_DUMP_READBACK_RING_SIZE;
+  std::unique_ptr<AbstractStagingTexture>& rbtex = m_frame_dump_readback_textures[index];
   if (!rbtex || rbtex->GetConfig() != m_frame_dump_render_texture->GetConfig())
   {
     rbtex = CreateStagingTexture(StagingTextureType::Readback,
                                  m_frame_dump_render_texture->GetConfig());
   }
 
-  m_last_frame_state = AVIDump::FetchState(m_last_xfb_ticks);
-  m_last_frame_exported = true;
+  m_frame_dump_readback_states[index] = AVIDump::FetchState(m_last_xfb_ticks);
+  m_frame_dump_readback_count++;
   rbtex->CopyFromTexture(m_frame_dump_render_texture.get(), 0, 0);
 }
 
-void Renderer::FlushFrameDump()
+void Renderer::EncodeFrameDumpReadbacks(size_t frames_to_keep)
 {
-  if (!m_last_frame_exported)
-    return;
-
-  // Ensure the previously-queued frame was encoded.
-  FinishFrameData();
-
-  // Queue encoding of the last frame dumped.
-  std::unique_ptr<AbstractStagingTexture>& rbtex = m_frame_dump_readback_textures[0];
-  rbtex->Flush();
-  if (rbtex->Map())
+  while (m_frame_dump_readback_count > frames_to_keep)
   {
-    DumpFrameData(reinterpret_cast<u8*>(rbtex->GetMappedPointer()), rbtex->GetConfig().width,
-                  rbtex->GetConfig().height, static_cast<int>(rbtex->GetMappedStride()),
-                  m_last_frame_state);
-    rbtex->Unmap();
+    std::unique_ptr<AbstractStagingTexture>& rbtex =
+        m_frame_dump_readback_textures[m_frame_dump_first_readback];
+    rbtex->Flush();
+    if (rbtex->Map())
+    {
+      DumpFrameData(reinterpret_cast<u8*>(rbtex->GetMappedPointer()), rbtex->GetConfig().width,
+                    rbtex->GetConfig().height, static_cast<int>(rbtex->GetMappedStride()),
+                    m_frame_dump_readback_states[m_frame_dump_first_readback]);
+      rbtex->Unmap();
+    }
+
+    m_frame_dump_first_readback = (m_frame_dump_first_readback + 1) % FRAME_DUMP_READBACK_RING_SIZE;
+    m_frame_dump_readback_count--;
   }
+}
 
-  m_last_frame_exported = false;
+void Renderer::FlushFrameDump()
+{
+  // Video dumps keep readbacks in flight, but screenshots are written as soon as possible.
+  const size_t frames_to_keep =
+      SConfig::GetInstance().m_DumpFrames && !m_screenshot_request.IsSet() ?
+          FRAME_DUMP_READBACK_RING_SIZE - 1 :
+          0;
+  if (m_frame_dump_readback_count <= frames_to_keep)
+    return;
+
+  // Queue encoding of the frames that are old enough.
+  EncodeFrameDumpReadbacks(frames_to_keep);
 
   // Shutdown frame dumping if it is no longer active.
   if (!IsFrameDumping())
@@ -842,29 +857,31 @@ void Renderer::FlushFrameDump()
 
 void Renderer::ShutdownFrameDumping()
 {
-  // Ensure the last queued readback has been sent to the encoder.
-  FlushFrameDump();
+  // Ensure the queued readbacks have been sent to the encoder.
+  EncodeFrameDumpReadbacks(0);
 
   if (!m_frame_dump_thread_running.IsSet())
     return;
 
-  // Ensure previous frame has been encoded.
+  // Ensure the queued frames have been encoded.
   FinishFrameData();
 
   // Wake thread up, and wait for it to exit.
-  m_frame_dump_thread_running.Clear();
-  m_frame_dump_start.Set();
+  {
+    std::lock_guard<std::mutex> lk(m_frame_dump_lock);
+    m_frame_dump_thread_running.Clear();
+  }
+  m_frame_dump_queue_changed.notify_all();
   if (m_frame_dump_thread.joinable())
     m_frame_dump_thread.join();
   m_frame_dump_render_texture.reset();
   for (auto& tex : m_frame_dump_readback_textures)
     tex.reset();
+  m_frame_dump_free_buffers.clear();
 }
 
 void Renderer::DumpFrameData(const u8* data, int w, int h, int stride, const AVIDump::Frame& state)
 {
-  m_frame_dump_config = FrameDumpConfig{data, w, h, stride, state};
-
   if (!m_frame_dump_thread_running.IsSet())
   {
     if (m_frame_dump_thread.joinable())
@@ -873,18 +890,38 @@ void Renderer::DumpFrameData(const u8* data, int w, int h, int stride, const AVI
     m_frame_dump_thread = std::thread(&Renderer::RunFrameDumps, this);
   }
 
-  // Wake worker thread up.
-  m_frame_dump_start.Set();
-  m_frame_dump_frame_running = true;
+  // Only stall the emulation if the encoder has fallen too far behind.
+  QueuedFrameDump frame;
+  {
+    std::unique_lock<std::mutex> lk(m_frame_dump_lock);
+    m_frame_dump_queue_changed.wait(
+        lk, [this] { return m_frame_dump_pending_frames < FRAME_DUMP_QUEUE_SIZE; });
+    if (!m_frame_dump_free_buffers.empty())
+    {
+      frame.data = std::move(m_frame_dump_free_buffers.back());
+      m_frame_dump_free_buffers.pop_back();
+    }
+    m_frame_dump_pending_frames++;
+  }
+
+  // Copy the frame without padding, so that the readback texture can be reused.
+  const int row_size = w * 4;
+  frame.data.resize(static_cast<size_t>(row_size) * h);
+  for (int y = 0; y < h; y++)
+    std::memcpy(&frame.data[static_cast<size_t>(y) * row_size], data + y * stride, row_size);
+  frame.config = FrameDumpConfig{frame.data.data(), w, h, row_size, state};
+
+  {
+    std::lock_guard<std::mutex> lk(m_frame_dump_lock);
+    m_frame_dump_queue.push_back(std::move(frame));
+  }
+  m_frame_dump_queue_changed.notify_all();
 }
 
 void Renderer::FinishFrameData()
 {
-  if (!m_frame_dump_frame_running)
-    return;
-
-  m_frame_dump_done.Wait();
-  m_frame_dump_frame_running = false;
+  std::unique_lock<std::mutex> lk(m_frame_dump_lock);
+  m_frame_dump_queue_changed.wait(lk, [this] { return m_frame_dump_pending_frames == 0; });
 }
 
 void Renderer::RunFrameDumps()
@@ -905,11 +942,19 @@ void Renderer::RunFrameDumps()
 
   while (true)
   {
-    m_frame_dump_start.Wait();
-    if (!m_frame_dump_thread_running.IsSet())
-      break;
-
-    auto config = m_frame_dump_config;
+    QueuedFrameDump frame;
+    {
+      std::unique_lock<std::mutex> lk(m_frame_dump_lock);
+      m_frame_dump_queue_changed.wait(lk, [this] {
+        return !m_frame_dump_queue.empty() || !m_frame_dump_thread_running.IsSet();
+      });
+      if (m_frame_dump_queue.empty())
+        break;
+
+      frame = std::move(m_frame_dump_queue.front());
+      m_frame_dump_queue.pop_front();
+    }
+    const FrameDumpConfig& config = frame.config;
 
     // Save screenshot
     if (m_screenshot_request.TestAndClear())
@@ -949,7 +994,13 @@ void Renderer::RunFrameDumps()
       }
     }
 
-    m_frame_dump_done.Set();
+    // Keep the buffer around for the next frame.
+    {
+      std::lock_guard<std::mutex> lk(m_frame_dump_lock);
+      m_frame_dump_free_buffers.push_back(std::move(frame.data));
+      m_frame_dump_pending_frames--;
+    }
+    m_frame_dump_queue_changed.notify_all();
   }
 
   if (frame_dump_started)
@@ -16,6 +16,7 @@
 
 #include <array>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -256,11 +257,8 @@ private:
 
   // frame dumping
   std::thread m_frame_dump_thread;
-  Common::Event m_frame_dump_start;
-  Common::Event m_frame_dump_done;
   Common::Flag m_frame_dump_thread_running;
   u32 m_frame_dump_image_counter = 0;
-  bool m_frame_dump_frame_running = false;
   struct FrameDumpConfig
   {
     const u8* data;
@@ -268,13 +266,35 @@ private:
     int height;
     int stride;
     AVIDump::Frame state;
-  } m_frame_dump_config;
+  };
+
+  // Frames that were read back, but haven't been encoded yet. Each one owns the memory that its
+  // config points to, so the readback texture can be reused while the frame is being encoded.
+  struct QueuedFrameDump
+  {
+    FrameDumpConfig config;
+    std::vector<u8> data;
+  };
+  static constexpr size_t FRAME_DUMP_QUEUE_SIZE = 4;
+  std::mutex m_frame_dump_lock;
+  std::condition_variable m_frame_dump_queue_changed;
+  std::deque<QueuedFrameDump> m_frame_dump_queue;
+  std::vector<std::vector<u8>> m_frame_dump_free_buffers;
+  // Frames in the queue plus the frame that is being encoded
+  size_t m_frame_dump_pending_frames = 0;
 
   // Texture used for screenshot/frame dumping
   std::unique_ptr<AbstractTexture> m_frame_dump_render_texture;
-  std::array<std::unique_ptr<AbstractStagingTexture>, 2> m_frame_dump_readback_textures;
-  AVIDump::Frame m_last_frame_state;
-  bool m_last_frame_exported = false;
+
+  // Ring of readbacks of the frame dump texture. When dumping video, a frame is only mapped
+  // FRAME_DUMP_READBACK_RING_SIZE - 1 frames after it was rendered, so that the GPU has had time to
+  // finish copying it and mapping it doesn't stall.
+  static constexpr size_t FRAME_DUMP_READBACK_RING_SIZE = 3;
+  std::array<std::unique_ptr<AbstractStagingTexture>, FRAME_DUMP_READBACK_RING_SIZE>
+      m_frame_dump_readback_textures;
+  std::array<AVIDump::Frame, FRAME_DUMP_READBACK_RING_SIZE> m_frame_dump_readback_states;
+  size_t m_frame_dump_first_readback = 0;
+  size_t m_frame_dump_readback_count = 0;
 
   // Tracking of XFB textures so we don't render duplicate frames.
   AbstractTexture* m_last_xfb_texture = nullptr;
@@ -306,13 +326,18 @@ private:
   // Fills the frame dump render texture with the current XFB texture.
   void RenderFrameDump();
 
-  // Queues the current frame for readback, which will be written to AVI next frame.
+  // Queues the current frame for readback, which will be written to AVI in a later frame.
   void QueueFrameDumpReadback();
 
-  // Asynchronously encodes the specified pointer of frame data to the frame dump.
+  // Asynchronously encodes a copy of the specified frame data to the frame dump. Waits for the
+  // frame dumping thread if FRAME_DUMP_QUEUE_SIZE frames are already waiting to be encoded.
   void DumpFrameData(const u8* data, int w, int h, int stride, const AVIDump::Frame& state);
 
-  // Ensures all rendered frames are queued for encoding.
+  // Queues the oldest readbacks for encoding until frames_to_keep are left.
+  void EncodeFrameDumpReadbacks(size_t frames_to_keep);
+
+  // Ensures all rendered frames that are old enough are queued for encoding, or all of them if
+  // frame dumping has stopped.
   void FlushFrameDump();
 
   // Ensures all encoded frames have been written to the output file.
@@ -41,6 +41,14 @@ bool ShaderCache::Initialize()
     LoadPipelineUIDCache();
   }
 
+  // Vertex loaders are used by every backend, including the software renderer.
+  if (g_ActiveConfig.bShaderCache)
+  {
+    VertexLoaderManager::LoadVertexLoaderUIDCache(File::GetUserPath(D_CACHE_IDX) +
+                                                  SConfig::GetInstance().GetGameID() +
+                                                  ".vluidcache");
+  }
+
   // Queue ubershader precompiling if required.
   if (g_ActiveConfig.UsingUberShaders())
     QueueUberShaderPipelines();
@@ -48,7 +56,10 @@ bool ShaderCache::Initialize()
   // Compile all known UIDs.
   CompileMissingPipelines();
   if (g_ActiveConfig.bWaitForShadersBeforeStarting)
+  {
     WaitForAsyncCompiler();
+    VertexLoaderManager::WaitForPrecompiledVertexLoaders();
+  }
 
   // Switch to the runtime shader compiler thread configuration.
   m_async_shader_compiler->ResizeWorkerThreads(g_ActiveConfig.GetShaderCompilerThreads());
@@ -98,6 +109,7 @@ void ShaderCache::Shutdown()
   // until everything has finished compiling.
   m_async_shader_compiler->StopWorkerThreads();
   ClosePipelineUIDCache();
+  VertexLoaderManager::CloseVertexLoaderUIDCache();
   ClearShaderCaches();
   ClearPipelineCaches();
 }
@@ -67,6 +67,10 @@ std::string Statistics::ToString()
   str += StringFromFormat("Index streamed: %i kB\n", stats.thisFrame.bytesIndexStreamed / 1024);
   str += StringFromFormat("Uniform streamed: %i kB\n", stats.thisFrame.bytesUniformStreamed / 1024);
   str += StringFromFormat("Vertex Loaders: %i\n", stats.numVertexLoaders);
+  str += StringFromFormat("Vertex Loader cache hits: %i\n",
+                          stats.thisFrame.numVertexLoaderCacheHits);
+  str += StringFromFormat("Vertex Loader cache misses: %i\n",
+                          stats.thisFrame.numVertexLoaderCacheMisses);
 
   std::string vertex_list = VertexLoaderManager::VertexLoadersToString();
 
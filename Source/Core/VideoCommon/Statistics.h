@@ -59,6 +59,8 @@ struct Statistics
     int rasterizedPixels;
     int numTrianglesDrawn;
     int numVerticesLoaded;
+    int numVertexLoaderCacheHits;
+    int numVertexLoaderCacheMisses;
     int tevPixelsIn;
     int tevPixelsOut;
   };
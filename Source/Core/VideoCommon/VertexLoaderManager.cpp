@@ -3,16 +3,24 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "Common/Assert.h"
 #include "Common/CommonFuncs.h"
 #include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/Flag.h"
+#include "Common/Logging/Log.h"
+#include "Common/Thread.h"
 #include "Core/HW/Memmap.h"
 
 #include "VideoCommon/BPMemory.h"
@@ -40,7 +48,46 @@ u32 g_current_components;
 typedef std::unordered_map<VertexLoaderUID, std::unique_ptr<VertexLoaderBase>> VertexLoaderMap;
 static std::mutex s_vertex_loader_map_lock;
 static VertexLoaderMap s_vertex_loader_map;
-// TODO - change into array of pointers. Keep a map of all seen so far.
+
+// Games can change the vertex descriptor hundreds of times per frame, which makes all vertex
+// attribute groups dirty. The loaders used recently are kept in a small direct-mapped cache for
+// each CP state, which is only accessed by the thread that owns the state, so that the map above
+// and its lock are only needed the first time a thread sees a vertex format.
+struct VertexLoaderCacheEntry
+{
+  VertexLoaderUID uid;
+  VertexLoaderBase* loader = nullptr;
+};
+constexpr size_t VERTEX_LOADER_CACHE_SIZE = 64;
+using VertexLoaderCache = std::array<VertexLoaderCacheEntry, VERTEX_LOADER_CACHE_SIZE>;
+static VertexLoaderCache s_main_loader_cache;
+static VertexLoaderCache s_preprocess_loader_cache;
+
+// The loaders used in previous sessions of a game are listed in a file, so that they can be
+// compiled on a background thread at boot instead of on the GPU thread when they are first used.
+// The file and the set of UIDs it contains are protected by s_vertex_loader_map_lock.
+constexpr u32 VERTEX_LOADER_UID_CACHE_MAGIC = 0x44554C56;  // VLUD
+constexpr u32 VERTEX_LOADER_UID_CACHE_VERSION = 1;
+
+struct SerializedVertexLoaderUid
+{
+  u64 vtx_desc;
+  u32 vat[3];
+  PortableVertexDeclaration vertex_decl;
+};
+
+struct PrecompiledVertexLoader
+{
+  TVtxDesc vtx_desc;
+  VAT vtx_attr;
+  PortableVertexDeclaration vertex_decl;
+  NativeVertexFormat* native_format;
+};
+
+static File::IOFile s_loader_uid_cache_file;
+static std::unordered_set<VertexLoaderUID> s_loader_uids_in_cache_file;
+static std::thread s_loader_precompile_thread;
+static Common::Flag s_loader_precompile_cancel;
 
 u8* cached_arraybases[12];
 
@@ -56,7 +103,11 @@ void Init()
 
 void Clear()
 {
+  CloseVertexLoaderUIDCache();
+
   std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+  s_main_loader_cache.fill({});
+  s_preprocess_loader_cache.fill({});
   s_vertex_loader_map.clear();
   s_native_vertex_map.clear();
 }
@@ -195,6 +246,177 @@ NativeVertexFormat* GetUberVertexFormat(const PortableVertexDeclaration& decl)
   return GetOrCreateMatchingFormat(new_decl);
 }
 
+// Must be called with s_vertex_loader_map_lock held.
+static void AppendVertexLoaderUID(const VertexLoaderUID& uid, const TVtxDesc& vtx_desc,
+                                  const VAT& vtx_attr, const PortableVertexDeclaration& decl)
+{
+  if (!s_loader_uid_cache_file.IsOpen() || !s_loader_uids_in_cache_file.insert(uid).second)
+    return;
+
+  // Convert to disk format. Ensure all padding bytes are zero.
+  SerializedVertexLoaderUid disk_uid;
+  std::memset(&disk_uid, 0, sizeof(disk_uid));
+  disk_uid.vtx_desc = vtx_desc.Hex;
+  disk_uid.vat[0] = vtx_attr.g0.Hex;
+  disk_uid.vat[1] = vtx_attr.g1.Hex;
+  disk_uid.vat[2] = vtx_attr.g2.Hex;
+  disk_uid.vertex_decl = decl;
+  if (!s_loader_uid_cache_file.WriteBytes(&disk_uid, sizeof(disk_uid)))
+  {
+    WARN_LOG(VIDEO, "Writing vertex loader UID to cache failed, closing file.");
+    s_loader_uid_cache_file.Close();
+  }
+}
+
+static void PrecompileVertexLoaders(const std::vector<PrecompiledVertexLoader>& loaders)
+{
+  Common::SetCurrentThreadName("Vertex loader precompiler");
+
+  for (const PrecompiledVertexLoader& entry : loaders)
+  {
+    if (s_loader_precompile_cancel.IsSet())
+      break;
+
+    // The GPU thread may have needed the loader before we got to it.
+    const VertexLoaderUID uid(entry.vtx_desc, entry.vtx_attr);
+    {
+      std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+      if (s_vertex_loader_map.count(uid))
+        continue;
+    }
+
+    std::unique_ptr<VertexLoaderBase> loader =
+        VertexLoaderBase::CreateVertexLoader(entry.vtx_desc, entry.vtx_attr);
+    if (!loader)
+      continue;
+
+    // Native vertex formats can only be created on the video thread, which did so when the cache
+    // was loaded. The declaration only differs if the loaders changed without a version bump.
+    if (loader->m_native_vtx_decl == entry.vertex_decl)
+      loader->m_native_vertex_format = entry.native_format;
+
+    std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+    std::unique_ptr<VertexLoaderBase>& map_entry = s_vertex_loader_map[uid];
+    if (!map_entry)
+    {
+      map_entry = std::move(loader);
+      INCSTAT(stats.numVertexLoaders);
+    }
+  }
+}
+
+void LoadVertexLoaderUIDCache(const std::string& filename)
+{
+  constexpr size_t CACHE_HEADER_SIZE = sizeof(u32) + sizeof(u32);
+  std::vector<SerializedVertexLoaderUid> uids;
+
+  {
+    std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+    if (s_loader_uid_cache_file.Open(filename, "rb+"))
+    {
+      // If an existing cache exists, validate the version before reading entries.
+      u32 existing_magic;
+      u32 existing_version;
+      bool uid_file_valid = false;
+      if (s_loader_uid_cache_file.ReadBytes(&existing_magic, sizeof(existing_magic)) &&
+          s_loader_uid_cache_file.ReadBytes(&existing_version, sizeof(existing_version)) &&
+          existing_magic == VERTEX_LOADER_UID_CACHE_MAGIC &&
+          existing_version == VERTEX_LOADER_UID_CACHE_VERSION)
+      {
+        // A size which isn't a multiple of the entry size means the file is corrupted.
+        const u64 file_size = s_loader_uid_cache_file.GetSize();
+        const size_t uid_count =
+            static_cast<size_t>(file_size - CACHE_HEADER_SIZE) / sizeof(SerializedVertexLoaderUid);
+        const size_t expected_size =
+            uid_count * sizeof(SerializedVertexLoaderUid) + CACHE_HEADER_SIZE;
+        uid_file_valid = file_size == expected_size;
+        if (uid_file_valid)
+        {
+          uids.resize(uid_count);
+          uid_file_valid = s_loader_uid_cache_file.ReadArray(uids.data(), uids.size()) &&
+                           s_loader_uid_cache_file.Seek(expected_size, SEEK_SET);
+        }
+      }
+
+      // If the file is invalid, close it. We re-open and truncate it below.
+      if (!uid_file_valid)
+      {
+        uids.clear();
+        s_loader_uid_cache_file.Close();
+      }
+    }
+
+    // If the file is not open, it means it was either corrupted or didn't exist.
+    if (!s_loader_uid_cache_file.IsOpen() && s_loader_uid_cache_file.Open(filename, "wb"))
+    {
+      s_loader_uid_cache_file.WriteBytes(&VERTEX_LOADER_UID_CACHE_MAGIC,
+                                         sizeof(VERTEX_LOADER_UID_CACHE_MAGIC));
+      s_loader_uid_cache_file.WriteBytes(&VERTEX_LOADER_UID_CACHE_VERSION,
+                                         sizeof(VERTEX_LOADER_UID_CACHE_VERSION));
+    }
+  }
+
+  std::vector<PrecompiledVertexLoader> loaders;
+  loaders.reserve(uids.size());
+  for (const SerializedVertexLoaderUid& uid : uids)
+  {
+    PrecompiledVertexLoader entry;
+    entry.vtx_desc.Hex = uid.vtx_desc;
+    entry.vtx_attr.g0.Hex = uid.vat[0];
+    entry.vtx_attr.g1.Hex = uid.vat[1];
+    entry.vtx_attr.g2.Hex = uid.vat[2];
+    entry.vertex_decl = uid.vertex_decl;
+    entry.native_format = GetOrCreateMatchingFormat(uid.vertex_decl);
+
+    std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+    if (s_loader_uids_in_cache_file.emplace(entry.vtx_desc, entry.vtx_attr).second)
+      loaders.push_back(entry);
+  }
+
+  INFO_LOG(VIDEO, "Read %u vertex loader UIDs from %s", static_cast<unsigned>(loaders.size()),
+           filename.c_str());
+
+  if (!loaders.empty())
+  {
+    s_loader_precompile_thread =
+        std::thread([loaders = std::move(loaders)] { PrecompileVertexLoaders(loaders); });
+  }
+}
+
+void WaitForPrecompiledVertexLoaders()
+{
+  if (s_loader_precompile_thread.joinable())
+    s_loader_precompile_thread.join();
+}
+
+void CloseVertexLoaderUIDCache()
+{
+  if (s_loader_precompile_thread.joinable())
+  {
+    s_loader_precompile_cancel.Set();
+    s_loader_precompile_thread.join();
+    s_loader_precompile_cancel.Clear();
+  }
+
+  std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+  s_loader_uid_cache_file.Close();
+  s_loader_uids_in_cache_file.clear();
+}
+
+static VertexLoaderBase* GetOrCreateLoader(const VertexLoaderUID& uid, const TVtxDesc& vtx_desc,
+                                           const VAT& vtx_attr)
+{
+  std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
+  std::unique_ptr<VertexLoaderBase>& loader = s_vertex_loader_map[uid];
+  if (!loader)
+  {
+    loader = VertexLoaderBase::CreateVertexLoader(vtx_desc, vtx_attr);
+    INCSTAT(stats.numVertexLoaders);
+    AppendVertexLoaderUID(uid, vtx_desc, vtx_attr, loader->m_native_vtx_decl);
+  }
+  return loader.get();
+}
+
 static VertexLoaderBase* RefreshLoader(int vtx_attr_group, bool preprocess = false)
 {
   CPState* state = preprocess ? &g_preprocess_cp_state : &g_main_cp_state;
@@ -208,31 +430,27 @@ static VertexLoaderBase* RefreshLoader(int vtx_attr_group, bool preprocess = fal
     bool check_for_native_format = !preprocess;
 
     VertexLoaderUID uid(state->vtx_desc, state->vtx_attr[vtx_attr_group]);
-    std::lock_guard<std::mutex> lk(s_vertex_loader_map_lock);
-    VertexLoaderMap::iterator iter = s_vertex_loader_map.find(uid);
-    if (iter != s_vertex_loader_map.end())
+    VertexLoaderCache& cache = preprocess ? s_preprocess_loader_cache : s_main_loader_cache;
+    VertexLoaderCacheEntry& cached = cache[uid.GetHash() % VERTEX_LOADER_CACHE_SIZE];
+    if (cached.loader && cached.uid == uid)
     {
-      loader = iter->second.get();
-      check_for_native_format &= !loader->m_native_vertex_format;
+      loader = cached.loader;
+      if (!preprocess)
+        INCSTAT(stats.thisFrame.numVertexLoaderCacheHits);
     }
     else
     {
-      s_vertex_loader_map[uid] =
-          VertexLoaderBase::CreateVertexLoader(state->vtx_desc, state->vtx_attr[vtx_attr_group]);
-      loader = s_vertex_loader_map[uid].get();
-      INCSTAT(stats.numVertexLoaders);
-    }
-    if (check_for_native_format)
-    {
-      // search for a cached native vertex format
-      const PortableVertexDeclaration& format = loader->m_native_vtx_decl;
-      std::unique_ptr<NativeVertexFormat>& native = s_native_vertex_map[format];
-      if (!native)
-      {
-        native = g_vertex_manager->CreateNativeVertexFormat(format);
-      }
-      loader->m_native_vertex_format = native.get();
+      loader = GetOrCreateLoader(uid, state->vtx_desc, state->vtx_attr[vtx_attr_group]);
+      cached.uid = uid;
+      cached.loader = loader;
+      if (!preprocess)
+        INCSTAT(stats.thisFrame.numVertexLoaderCacheMisses);
     }
+
+    // search for a cached native vertex format
+    if (check_for_native_format && !loader->m_native_vertex_format)
+      loader->m_native_vertex_format = GetOrCreateMatchingFormat(loader->m_native_vtx_decl);
+
     state->vertex_loaders[vtx_attr_group] = loader;
     state->attr_dirty[vtx_attr_group] = false;
   }
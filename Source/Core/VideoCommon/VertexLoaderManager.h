@@ -24,6 +24,12 @@ void Clear();
 
 void MarkAllDirty();
 
+// Reads the vertex loaders of previous sessions from filename and compiles them on a background
+// thread, and records every loader created from now on in the same file.
+void LoadVertexLoaderUIDCache(const std::string& filename);
+void WaitForPrecompiledVertexLoaders();
+void CloseVertexLoaderUIDCache();
+
 // Creates or obtains a pointer to a VertexFormat representing decl.
 // If this results in a VertexFormat being created, if the game later uses a matching vertex
 // declaration, the one that was previously created will be used.
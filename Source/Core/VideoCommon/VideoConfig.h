@@ -108,6 +108,8 @@ struct VideoConfig final
   bool bBorderlessFullscreen;
   bool bEnableGPUTextureDecoding;
   int iBitrateKbps;
+  // Threads used for converting and encoding dumped frames, 0 to use all hardware threads
+  int iDumpEncoderThreads;
 
   // Hacks
   bool bEFBAccessEnable;
@@ -150,6 +152,8 @@ struct VideoConfig final
   bool bDumpObjects;
   bool bDumpTevStages;
   bool bDumpTevTextureFetches;
+  // Threads used for rasterizing, 0 to use all hardware threads
+  int iSWRasterizerThreads;
 
   // Enable API validation layers, currently only supported with Vulkan.
   bool bEnableValidationLayer;
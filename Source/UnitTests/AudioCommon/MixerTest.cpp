@@ -0,0 +1,292 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AudioCommon/Mixer.h"
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/FileUtil.h"
+#include "Common/MathUtil.h"
+#include "Common/Swap.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "UICommon/UICommon.h"
+
+namespace
+{
+constexpr u32 MAX_SAMPLES = 1024 * 4;
+constexpr u32 INDEX_MASK = MAX_SAMPLES * 2 - 1;
+
+// The scalar linear interpolation that the mixer used before it was vectorized, which the
+// results have to match exactly.
+class ReferenceFifo
+{
+public:
+  explicit ReferenceFifo(u32 sample_rate) : m_sample_rate(sample_rate) {}
+
+  void SetVolume(u32 lvolume, u32 rvolume)
+  {
+    m_lvolume = lvolume + (lvolume >> 7);
+    m_rvolume = rvolume + (rvolume >> 7);
+  }
+
+  void Push(const std::vector<s16>& samples)
+  {
+    if (samples.size() + ((m_index_w - m_index_r) & INDEX_MASK) >= MAX_SAMPLES * 2)
+      return;
+    for (s16 sample : samples)
+      m_buffer[m_index_w++ & INDEX_MASK] = sample;
+  }
+
+  void Mix(s16* samples, u32 num_samples, u32 output_rate)
+  {
+    const u32 ratio = (u32)(65536.0f * static_cast<float>(m_sample_rate) / (float)output_rate);
+    u32 current = 0;
+    for (; current < num_samples * 2 && ((m_index_w - m_index_r) & INDEX_MASK) > 2; current += 2)
+    {
+      const u32 next = m_index_r + 2;
+      const s16 l1 = Common::swap16(m_buffer[m_index_r & INDEX_MASK]);
+      const s16 l2 = Common::swap16(m_buffer[next & INDEX_MASK]);
+      int sample_l = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
+      sample_l = (sample_l * m_lvolume) >> 8;
+      samples[current + 1] = MathUtil::Clamp(sample_l + samples[current + 1], -32767, 32767);
+
+      const s16 r1 = Common::swap16(m_buffer[(m_index_r + 1) & INDEX_MASK]);
+      const s16 r2 = Common::swap16(m_buffer[(next + 1) & INDEX_MASK]);
+      int sample_r = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
+      sample_r = (sample_r * m_rvolume) >> 8;
+      samples[current] = MathUtil::Clamp(sample_r + samples[current], -32767, 32767);
+
+      m_frac += ratio;
+      m_index_r += 2 * (u16)(m_frac >> 16);
+      m_frac &= 0xffff;
+    }
+
+    const s16 last_r = Common::swap16(m_buffer[(m_index_r - 1) & INDEX_MASK]);
+    const s16 last_l = Common::swap16(m_buffer[(m_index_r - 2) & INDEX_MASK]);
+    const s16 pad_r = (last_r * m_rvolume) >> 8;
+    const s16 pad_l = (last_l * m_lvolume) >> 8;
+    for (; current < num_samples * 2; current += 2)
+    {
+      samples[current] = MathUtil::Clamp(pad_r + samples[current], -32767, 32767);
+      samples[current + 1] = MathUtil::Clamp(pad_l + samples[current + 1], -32767, 32767);
+    }
+  }
+
+private:
+  u32 m_sample_rate;
+  std::array<s16, MAX_SAMPLES * 2> m_buffer{};
+  u32 m_index_w = 0;
+  u32 m_index_r = 0;
+  u32 m_frac = 0;
+  s32 m_lvolume = 256;
+  s32 m_rvolume = 256;
+};
+
+class MixerTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+    // Don't adjust the sample rate to the amount of buffered samples
+    SConfig::GetInstance().m_EmulationSpeed = 0.0f;
+  }
+
+  void TearDown() override
+  {
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  std::string m_temp_dir;
+};
+
+std::vector<s16> RandomSamples(std::mt19937& rng, size_t count)
+{
+  std::vector<s16> samples(count);
+  for (s16& sample : samples)
+    sample = rng() % 8 == 0 ? (rng() % 2 ? 0x7FFF : 0x0080) : static_cast<s16>(rng());
+  return samples;
+}
+
+// Pushes a big-endian sine wave at 32000 Hz and returns how far the mixed output is from an
+// ideal sine wave, as RMS relative to the amplitude.
+double MeasureSineError(double frequency)
+{
+  constexpr u32 OUTPUT_RATE = 48000;
+  constexpr u32 INPUT_FRAMES = 2048;
+  constexpr double AMPLITUDE = 16000.0;
+  Mixer mixer(OUTPUT_RATE);
+
+  std::vector<s16> input(INPUT_FRAMES * 2);
+  for (u32 i = 0; i < INPUT_FRAMES; ++i)
+  {
+    const s16 sample = static_cast<s16>(AMPLITUDE * std::sin(2 * M_PI * frequency * i / 32000));
+    input[i * 2] = input[i * 2 + 1] = Common::swap16(sample);
+  }
+  mixer.PushSamples(input.data(), INPUT_FRAMES);
+
+  std::vector<s16> output(INPUT_FRAMES * 2);
+  mixer.Mix(output.data(), INPUT_FRAMES);
+
+  // Output sample i is at input position i * ratio, with the ratio in 16.16 fixed point.
+  const double step = static_cast<u32>(65536.0f * 32000 / OUTPUT_RATE) / 65536.0;
+  double error = 0.0;
+  u32 count = 0;
+  for (u32 i = 100; i < 1000; ++i, ++count)
+  {
+    const double expected = AMPLITUDE * std::sin(2 * M_PI * frequency * i * step / 32000);
+    const double difference = output[i * 2] - expected;
+    error += difference * difference;
+  }
+  return std::sqrt(error / count) / AMPLITUDE;
+}
+}  // namespace
+
+TEST_F(MixerTest, LinearMatchesReference)
+{
+  std::mt19937 rng(1);
+  for (u32 output_rate : {32000u, 44100u, 48000u})
+  {
+    for (u32 dma_rate : {32000u, 48000u})
+    {
+      SCOPED_TRACE(std::to_string(dma_rate) + " Hz to " + std::to_string(output_rate) + " Hz");
+      Mixer mixer(output_rate);
+      mixer.SetDMAInputSampleRate(dma_rate);
+      ReferenceFifo reference_dma(dma_rate);
+      ReferenceFifo reference_streaming(48000);
+
+      for (int iteration = 0; iteration < 300; ++iteration)
+      {
+        if (iteration % 50 == 0)
+        {
+          const u32 lvolume = rng() % 256;
+          const u32 rvolume = rng() % 256;
+          mixer.SetStreamingVolume(lvolume, rvolume);
+          reference_streaming.SetVolume(lvolume, rvolume);
+        }
+
+        const std::vector<s16> dma = RandomSamples(rng, (rng() % 200) * 2);
+        mixer.PushSamples(dma.data(), static_cast<u32>(dma.size() / 2));
+        reference_dma.Push(dma);
+        const std::vector<s16> streaming = RandomSamples(rng, (rng() % 200) * 2);
+        mixer.PushStreamingSamples(streaming.data(), static_cast<u32>(streaming.size() / 2));
+        reference_streaming.Push(streaming);
+
+        const u32 num_samples = 1 + rng() % 250;
+        std::vector<s16> expected(num_samples * 2);
+        reference_dma.Mix(expected.data(), num_samples, output_rate);
+        reference_streaming.Mix(expected.data(), num_samples, output_rate);
+        std::vector<s16> actual(num_samples * 2);
+        mixer.Mix(actual.data(), num_samples);
+
+        ASSERT_EQ(expected, actual) << "iteration " << iteration;
+      }
+    }
+  }
+}
+
+TEST_F(MixerTest, HighQualityResamplingIsMoreAccurate)
+{
+  for (double frequency : {1000.0, 6000.0})
+  {
+    SCOPED_TRACE(frequency);
+    SConfig::GetInstance().m_audio_hq_resampling = false;
+    const double linear_error = MeasureSineError(frequency);
+    SConfig::GetInstance().m_audio_hq_resampling = true;
+    const double hq_error = MeasureSineError(frequency);
+
+    EXPECT_LT(hq_error, 0.02);
+    EXPECT_LT(hq_error, linear_error);
+  }
+}
+
+// The resampler must not read samples that were already consumed from the ring buffer, since
+// PushSamples is allowed to overwrite them.
+TEST_F(MixerTest, HighQualityResamplingIgnoresOverwrittenSamples)
+{
+  constexpr u32 RATE = 32000;
+  constexpr u32 FIRST_FRAMES = 1000;
+  constexpr u32 MIXED_FRAMES = 500;
+  // As much as fits into the ring buffer, which wraps around onto the consumed samples.
+  constexpr u32 SECOND_FRAMES = (MAX_SAMPLES * 2 - (FIRST_FRAMES - MIXED_FRAMES) * 2 - 1) / 2;
+  SConfig::GetInstance().m_audio_hq_resampling = true;
+
+  std::mt19937 rng(3);
+  const std::vector<s16> input = RandomSamples(rng, (FIRST_FRAMES + SECOND_FRAMES) * 2);
+  std::vector<s16> output(MIXED_FRAMES * 2);
+
+  // Only pushes what is needed for the next mix, so nothing gets overwritten.
+  Mixer reference(RATE);
+  reference.SetDMAInputSampleRate(RATE);
+  reference.PushSamples(input.data(), FIRST_FRAMES);
+  reference.Mix(output.data(), MIXED_FRAMES);
+  reference.PushSamples(&input[FIRST_FRAMES * 2], MIXED_FRAMES + 100);
+  std::vector<s16> expected(MIXED_FRAMES * 2);
+  reference.Mix(expected.data(), MIXED_FRAMES);
+
+  Mixer mixer(RATE);
+  mixer.SetDMAInputSampleRate(RATE);
+  mixer.PushSamples(input.data(), FIRST_FRAMES);
+  mixer.Mix(output.data(), MIXED_FRAMES);
+  mixer.PushSamples(&input[FIRST_FRAMES * 2], SECOND_FRAMES);
+  std::vector<s16> actual(MIXED_FRAMES * 2);
+  mixer.Mix(actual.data(), MIXED_FRAMES);
+
+  EXPECT_EQ(expected, actual);
+}
+
+// Measures how many output samples per second the mixer produces from one FIFO, for different
+// ratios between the input and output sample rates.
+TEST_F(MixerTest, DISABLED_Benchmark)
+{
+  constexpr u32 OUTPUT_RATE = 48000;
+  constexpr u32 CHUNK = 512;
+  constexpr int ITERATIONS = 20000;
+
+  std::mt19937 rng(2);
+  const std::vector<s16> input = RandomSamples(rng, CHUNK * 2 * 4);
+  std::vector<s16> output(CHUNK * 2 * 4);
+
+  for (bool hq : {false, true})
+  {
+    SConfig::GetInstance().m_audio_hq_resampling = hq;
+    for (u32 input_rate : {16000u, 32000u, 48000u, 96000u})
+    {
+      Mixer mixer(OUTPUT_RATE);
+      mixer.SetDMAInputSampleRate(input_rate);
+      const u32 input_frames = CHUNK * input_rate / OUTPUT_RATE;
+
+      u64 output_frames = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < ITERATIONS; ++i)
+      {
+        mixer.PushSamples(input.data(), input_frames);
+        mixer.Mix(output.data(), CHUNK);
+        output_frames += CHUNK;
+      }
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      std::printf("%s, %u Hz -> %u Hz: %.1f million sample pairs per second (%.0fx real time)\n",
+                  hq ? "High quality" : "Linear", input_rate, OUTPUT_RATE,
+                  output_frames / seconds / 1e6, output_frames / seconds / OUTPUT_RATE);
+    }
+  }
+}
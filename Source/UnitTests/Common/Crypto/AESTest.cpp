@@ -0,0 +1,78 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Crypto/AES.h"
+
+namespace
+{
+std::vector<u8> RandomBytes(std::mt19937* rng, size_t size)
+{
+  std::vector<u8> data(size);
+  std::generate(data.begin(), data.end(), [rng] { return static_cast<u8>((*rng)()); });
+  return data;
+}
+}  // namespace
+
+TEST(AES, ContextMatchesMbedtls)
+{
+  std::mt19937 rng(1234);
+  const std::vector<u8> key = RandomBytes(&rng, 16);
+  const std::unique_ptr<Common::AES::Context> context =
+      Common::AES::CreateDecryptionContext(key.data());
+  ASSERT_NE(nullptr, context);
+
+  // Sizes around the number of blocks that the hardware paths decrypt in parallel.
+  for (size_t size : {16, 16 * 7, 16 * 8, 16 * 9, 16 * 17, 0x400, 0x7C00})
+  {
+    SCOPED_TRACE(size);
+    const std::vector<u8> src = RandomBytes(&rng, size);
+    const std::vector<u8> iv = RandomBytes(&rng, 16);
+
+    std::array<u8, 16> expected_iv;
+    std::copy(iv.begin(), iv.end(), expected_iv.begin());
+    const std::vector<u8> expected =
+        Common::AES::Decrypt(key.data(), expected_iv.data(), src.data(), size);
+
+    std::array<u8, 16> actual_iv;
+    std::copy(iv.begin(), iv.end(), actual_iv.begin());
+    std::vector<u8> actual(size);
+    context->DecryptCBC(actual_iv.data(), src.data(), actual.data(), size);
+    EXPECT_EQ(expected, actual);
+    EXPECT_EQ(expected_iv, actual_iv);
+
+    // In place
+    std::copy(iv.begin(), iv.end(), actual_iv.begin());
+    actual = src;
+    context->DecryptCBC(actual_iv.data(), actual.data(), actual.data(), size);
+    EXPECT_EQ(expected, actual);
+  }
+}
+
+TEST(AES, ContextChainsIV)
+{
+  std::mt19937 rng(42);
+  const std::vector<u8> key = RandomBytes(&rng, 16);
+  const std::unique_ptr<Common::AES::Context> context =
+      Common::AES::CreateDecryptionContext(key.data());
+  const std::vector<u8> src = RandomBytes(&rng, 0x400);
+
+  std::array<u8, 16> iv{};
+  std::vector<u8> whole(src.size());
+  context->DecryptCBC(iv.data(), src.data(), whole.data(), src.size());
+
+  iv = {};
+  std::vector<u8> split(src.size());
+  context->DecryptCBC(iv.data(), src.data(), split.data(), 0x90);
+  context->DecryptCBC(iv.data(), src.data() + 0x90, split.data() + 0x90, src.size() - 0x90);
+  EXPECT_EQ(whole, split);
+}
@@ -0,0 +1,56 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "Common/ThreadPool.h"
+
+TEST(ThreadPool, CoversEveryItemOnce)
+{
+  Common::ThreadPool pool(4);
+  EXPECT_EQ(4u, pool.GetThreadCount());
+
+  for (size_t count : {0, 1, 3, 4, 1000})
+  {
+    std::vector<std::atomic<int>> calls(count);
+    pool.ParallelFor(count, [&](size_t i) { calls[i]++; });
+    for (size_t i = 0; i < count; i++)
+      EXPECT_EQ(1, calls[i]) << "count " << count << ", item " << i;
+  }
+}
+
+TEST(ThreadPool, SingleThreaded)
+{
+  Common::ThreadPool pool(1);
+  const std::thread::id caller = std::this_thread::get_id();
+
+  int sum = 0;
+  pool.ParallelFor(10, [&](size_t i) {
+    EXPECT_EQ(caller, std::this_thread::get_id());
+    sum += static_cast<int>(i);
+  });
+  EXPECT_EQ(45, sum);
+}
+
+TEST(ThreadPool, ConcurrentCallers)
+{
+  Common::ThreadPool pool(3);
+  std::atomic<int> total{0};
+
+  std::vector<std::thread> callers;
+  for (int t = 0; t < 4; t++)
+  {
+    callers.emplace_back([&] {
+      for (int j = 0; j < 100; j++)
+        pool.ParallelFor(10, [&](size_t) { total++; });
+    });
+  }
+  for (std::thread& thread : callers)
+    thread.join();
+
+  EXPECT_EQ(4 * 100 * 10, total);
+}
@@ -0,0 +1,392 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Core/FifoPlayer/FifoDataFile.h"
+#include "Core/FifoPlayer/FifoPlaybackAnalyzer.h"
+
+namespace
+{
+// The layout of version 4 files, which can't be written by FifoDataFile anymore
+#pragma pack(push, 1)
+struct Version4Header
+{
+  u32 fileId;
+  u32 file_version;
+  u32 min_loader_version;
+  u64 bpMemOffset;
+  u32 bpMemSize;
+  u64 cpMemOffset;
+  u32 cpMemSize;
+  u64 xfMemOffset;
+  u32 xfMemSize;
+  u64 xfRegsOffset;
+  u32 xfRegsSize;
+  u64 frameListOffset;
+  u32 frameCount;
+  u32 flags;
+  u64 texMemOffset;
+  u32 texMemSize;
+  u8 reserved[40];
+};
+
+struct Version4FrameInfo
+{
+  u64 fifoDataOffset;
+  u32 fifoDataSize;
+  u32 fifoStart;
+  u32 fifoEnd;
+  u64 memoryUpdatesOffset;
+  u32 numMemoryUpdates;
+  u8 reserved[32];
+};
+
+struct Version5FrameInfo
+{
+  u64 fifoDataOffset;
+  u32 fifoDataStoredSize;
+  u32 fifoDataSize;
+  u32 fifoStart;
+  u32 fifoEnd;
+  u64 memoryUpdatesOffset;
+  u32 memoryUpdatesStoredSize;
+  u32 memoryUpdatesSize;
+  u32 numMemoryUpdates;
+  u8 reserved[20];
+};
+
+struct Version4MemoryUpdate
+{
+  u32 fifoPosition;
+  u32 address;
+  u64 dataOffset;
+  u32 dataSize;
+  u8 type;
+  u8 reserved[3];
+};
+#pragma pack(pop)
+
+std::vector<FifoFrameInfo> GenerateFrames(u32 count)
+{
+  std::mt19937 rng(count);
+  std::vector<FifoFrameInfo> frames(count);
+  for (FifoFrameInfo& frame : frames)
+  {
+    // BP writes of compressible and incompressible values, and draws without any vertices, so
+    // that the playback analysis finds objects
+    const u32 num_commands = rng() % 1000;
+    for (u32 i = 0; i < num_commands; ++i)
+    {
+      if (rng() % 4 == 0)
+      {
+        frame.fifoData.insert(frame.fifoData.end(), {0x80, 0x00, 0x00});
+        continue;
+      }
+
+      const bool random = rng() % 3 == 0;
+      frame.fifoData.push_back(0x61);
+      for (int j = 0; j < 4; ++j)
+        frame.fifoData.push_back(random ? static_cast<u8>(rng()) : 0x61);
+    }
+    frame.fifoStart = rng();
+    frame.fifoEnd = rng();
+
+    frame.memoryUpdates.resize(rng() % 4);
+    u32 fifo_position = 0;
+    for (MemoryUpdate& update : frame.memoryUpdates)
+    {
+      fifo_position += rng() % 100;
+      update.fifoPosition = fifo_position;
+      update.address = rng();
+      update.type = MemoryUpdate::TEXTURE_MAP;
+      update.data.resize(rng() % 20000);
+      const bool random = rng() % 2 == 0;
+      for (u8& value : update.data)
+        value = random ? static_cast<u8>(rng()) : 0x42;
+    }
+  }
+  return frames;
+}
+
+void ExpectFrameEq(const FifoFrameInfo& expected, const FifoFrameInfo& actual)
+{
+  EXPECT_EQ(expected.fifoData, actual.fifoData);
+  EXPECT_EQ(expected.fifoStart, actual.fifoStart);
+  EXPECT_EQ(expected.fifoEnd, actual.fifoEnd);
+  ASSERT_EQ(expected.memoryUpdates.size(), actual.memoryUpdates.size());
+  for (size_t i = 0; i < expected.memoryUpdates.size(); ++i)
+  {
+    EXPECT_EQ(expected.memoryUpdates[i].fifoPosition, actual.memoryUpdates[i].fifoPosition);
+    EXPECT_EQ(expected.memoryUpdates[i].address, actual.memoryUpdates[i].address);
+    EXPECT_EQ(expected.memoryUpdates[i].type, actual.memoryUpdates[i].type);
+    EXPECT_EQ(expected.memoryUpdates[i].data, actual.memoryUpdates[i].data);
+  }
+}
+
+void WriteVersion4File(const std::string& path, const std::vector<FifoFrameInfo>& frames)
+{
+  File::IOFile file(path, "wb");
+
+  Version4Header header = {};
+  header.fileId = 0x0d01f1f0;
+  header.file_version = 4;
+  header.min_loader_version = 1;
+  header.frameListOffset = sizeof(Version4Header);
+  header.frameCount = static_cast<u32>(frames.size());
+  header.flags = 1;
+  file.WriteBytes(&header, sizeof(header));
+
+  std::vector<Version4FrameInfo> frame_list(frames.size());
+  file.WriteArray(frame_list.data(), frame_list.size());
+
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    const FifoFrameInfo& frame = frames[i];
+    Version4FrameInfo& info = frame_list[i];
+    info.fifoDataOffset = file.Tell();
+    info.fifoDataSize = static_cast<u32>(frame.fifoData.size());
+    info.fifoStart = frame.fifoStart;
+    info.fifoEnd = frame.fifoEnd;
+    file.WriteBytes(frame.fifoData.data(), frame.fifoData.size());
+
+    std::vector<Version4MemoryUpdate> updates(frame.memoryUpdates.size());
+    for (size_t j = 0; j < updates.size(); ++j)
+    {
+      const MemoryUpdate& update = frame.memoryUpdates[j];
+      updates[j].fifoPosition = update.fifoPosition;
+      updates[j].address = update.address;
+      updates[j].dataOffset = file.Tell();
+      updates[j].dataSize = static_cast<u32>(update.data.size());
+      updates[j].type = update.type;
+      file.WriteBytes(update.data.data(), update.data.size());
+    }
+    info.memoryUpdatesOffset = file.Tell();
+    info.numMemoryUpdates = static_cast<u32>(updates.size());
+    file.WriteArray(updates.data(), updates.size());
+  }
+
+  file.Seek(header.frameListOffset, SEEK_SET);
+  file.WriteArray(frame_list.data(), frame_list.size());
+}
+}  // namespace
+
+class FifoDataFileTest : public testing::Test
+{
+protected:
+  void SetUp() override { m_temp_dir = File::CreateTempDir(); }
+  void TearDown() override { File::DeleteDirRecursively(m_temp_dir); }
+
+  std::string m_temp_dir;
+};
+
+TEST_F(FifoDataFileTest, SaveAndLoad)
+{
+  const std::vector<FifoFrameInfo> frames = GenerateFrames(50);
+  const std::string path = m_temp_dir + "/test.dff";
+
+  {
+    FifoDataFile file;
+    file.SetIsWii(true);
+    for (int i = 0; i < FifoDataFile::BP_MEM_SIZE; ++i)
+      file.GetBPMem()[i] = i * 3;
+    file.GetTexMem()[1234] = 0x56;
+    for (const FifoFrameInfo& frame : frames)
+      file.AddFrame(frame);
+    ASSERT_TRUE(file.Save(path));
+  }
+
+  // Frames are read on demand, so check both playback order and random access
+  const std::unique_ptr<FifoDataFile> file = FifoDataFile::Load(path, false);
+  ASSERT_NE(nullptr, file);
+  EXPECT_TRUE(file->GetIsWii());
+  EXPECT_EQ(30u, file->GetBPMem()[10]);
+  EXPECT_EQ(0x56, file->GetTexMem()[1234]);
+  ASSERT_EQ(frames.size(), file->GetFrameCount());
+  for (u32 i = 0; i < file->GetFrameCount(); ++i)
+    ExpectFrameEq(frames[i], *file->GetFrame(i));
+
+  std::mt19937 rng(1);
+  for (int i = 0; i < 100; ++i)
+  {
+    const u32 frame = rng() % file->GetFrameCount();
+    ExpectFrameEq(frames[frame], *file->GetFrame(frame));
+    const std::optional<std::vector<u8>> fifo_data = file->GetFrameFifoData(frame);
+    ASSERT_TRUE(fifo_data);
+    EXPECT_EQ(frames[frame].fifoData, *fifo_data);
+  }
+
+  // Saving a loaded file must give the same result
+  const std::string resaved_path = m_temp_dir + "/resaved.dff";
+  ASSERT_TRUE(file->Save(resaved_path));
+  const std::unique_ptr<FifoDataFile> resaved = FifoDataFile::Load(resaved_path, false);
+  ASSERT_NE(nullptr, resaved);
+  ASSERT_EQ(frames.size(), resaved->GetFrameCount());
+  for (u32 i = 0; i < resaved->GetFrameCount(); ++i)
+    ExpectFrameEq(frames[i], *resaved->GetFrame(i));
+}
+
+TEST_F(FifoDataFileTest, LoadVersion4)
+{
+  const std::vector<FifoFrameInfo> frames = GenerateFrames(20);
+  const std::string path = m_temp_dir + "/old.dff";
+  WriteVersion4File(path, frames);
+
+  const std::unique_ptr<FifoDataFile> file = FifoDataFile::Load(path, false);
+  ASSERT_NE(nullptr, file);
+  EXPECT_TRUE(file->GetIsWii());
+  ASSERT_EQ(frames.size(), file->GetFrameCount());
+  for (u32 i = file->GetFrameCount(); i-- > 0;)
+    ExpectFrameEq(frames[i], *file->GetFrame(i));
+}
+
+TEST_F(FifoDataFileTest, ConvertVersion4)
+{
+  const std::vector<FifoFrameInfo> frames = GenerateFrames(20);
+  const std::string old_path = m_temp_dir + "/old.dff";
+  const std::string new_path = m_temp_dir + "/new.dff";
+  WriteVersion4File(old_path, frames);
+
+  EXPECT_FALSE(FifoDataFile::Convert(old_path, old_path));
+  ASSERT_TRUE(FifoDataFile::Convert(old_path, new_path));
+
+  const std::unique_ptr<FifoDataFile> file = FifoDataFile::Load(new_path, false);
+  ASSERT_NE(nullptr, file);
+  EXPECT_TRUE(file->GetIsWii());
+  EXPECT_FALSE(file->HasBrokenEFBCopies());
+  ASSERT_EQ(frames.size(), file->GetFrameCount());
+  for (u32 i = 0; i < file->GetFrameCount(); ++i)
+    ExpectFrameEq(frames[i], *file->GetFrame(i));
+}
+
+TEST_F(FifoDataFileTest, RejectTruncatedFile)
+{
+  const std::string path = m_temp_dir + "/test.dff";
+  {
+    FifoDataFile file;
+    for (const FifoFrameInfo& frame : GenerateFrames(10))
+      file.AddFrame(frame);
+    ASSERT_TRUE(file.Save(path));
+  }
+
+  // Cut the file off in the middle of the frame list
+  {
+    File::IOFile file(path, "r+b");
+    ASSERT_TRUE(file.Resize(128 + 64 * 5));
+  }
+  EXPECT_EQ(nullptr, FifoDataFile::Load(path, false));
+}
+
+TEST_F(FifoDataFileTest, StoresPlaybackAnalysis)
+{
+  const std::vector<FifoFrameInfo> frames = GenerateFrames(20);
+  const std::string path = m_temp_dir + "/test.dff";
+
+  FifoDataFile recorded;
+  for (const FifoFrameInfo& frame : frames)
+    recorded.AddFrame(frame);
+  EXPECT_TRUE(recorded.GetStoredAnalysis().empty());
+  ASSERT_TRUE(recorded.Save(path));
+  std::vector<AnalyzedFrameInfo> expected;
+  ASSERT_TRUE(FifoPlaybackAnalyzer::AnalyzeFrames(&recorded, expected));
+  ASSERT_FALSE(expected.back().objectStarts.empty());
+
+  const std::unique_ptr<FifoDataFile> file = FifoDataFile::Load(path, false);
+  ASSERT_NE(nullptr, file);
+  const std::vector<AnalyzedFrameInfo>& analysis = file->GetStoredAnalysis();
+  ASSERT_EQ(expected.size(), analysis.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    EXPECT_EQ(expected[i].objectStarts, analysis[i].objectStarts);
+    EXPECT_EQ(expected[i].objectEnds, analysis[i].objectEnds);
+  }
+
+  // Files that don't have an analysis yet get one when they are converted
+  const std::string old_path = m_temp_dir + "/old.dff";
+  const std::string new_path = m_temp_dir + "/new.dff";
+  WriteVersion4File(old_path, frames);
+  const std::unique_ptr<FifoDataFile> old_file = FifoDataFile::Load(old_path, false);
+  ASSERT_NE(nullptr, old_file);
+  EXPECT_TRUE(old_file->GetStoredAnalysis().empty());
+  ASSERT_TRUE(FifoDataFile::Convert(old_path, new_path));
+  const std::unique_ptr<FifoDataFile> new_file = FifoDataFile::Load(new_path, false);
+  ASSERT_NE(nullptr, new_file);
+  EXPECT_EQ(expected.size(), new_file->GetStoredAnalysis().size());
+}
+
+TEST_F(FifoDataFileTest, RejectInvalidChunkSizes)
+{
+  const std::string path = m_temp_dir + "/test.dff";
+  {
+    FifoDataFile file;
+    for (const FifoFrameInfo& frame : GenerateFrames(10))
+      file.AddFrame(frame);
+    ASSERT_TRUE(file.Save(path));
+  }
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(path, contents));
+
+  // Sizes past the end of the file, and sizes no frame could have
+  for (u32 size : {static_cast<u32>(contents.size()), 0x7FFFFFFFu})
+  {
+    SCOPED_TRACE(size);
+    std::string corrupted = contents;
+    Version5FrameInfo info;
+    std::memcpy(&info, &corrupted[128 + 3 * sizeof(info)], sizeof(info));
+    info.fifoDataStoredSize = size;
+    info.fifoDataSize = size;
+    std::memcpy(&corrupted[128 + 3 * sizeof(info)], &info, sizeof(info));
+    ASSERT_TRUE(File::WriteStringToFile(corrupted, path));
+    EXPECT_EQ(nullptr, FifoDataFile::Load(path, false));
+  }
+}
+
+TEST_F(FifoDataFileTest, CorruptedFrameCantBeRead)
+{
+  const std::string path = m_temp_dir + "/test.dff";
+  {
+    FifoDataFile file;
+    for (const FifoFrameInfo& frame : GenerateFrames(10))
+      file.AddFrame(frame);
+    ASSERT_TRUE(file.Save(path));
+  }
+
+  // Overwrite the compressed FIFO data of a frame, so that it can't be decompressed
+  u32 corrupted_frame = 0;
+  {
+    File::IOFile file(path, "r+b");
+    Version5FrameInfo info;
+    for (; corrupted_frame < 10; ++corrupted_frame)
+    {
+      ASSERT_TRUE(file.Seek(128 + corrupted_frame * sizeof(info), SEEK_SET));
+      ASSERT_TRUE(file.ReadBytes(&info, sizeof(info)));
+      if (info.fifoDataStoredSize != info.fifoDataSize)
+        break;
+    }
+    ASSERT_LT(corrupted_frame, 10u);
+    const std::vector<u8> garbage(info.fifoDataStoredSize, 0xFF);
+    ASSERT_TRUE(file.Seek(info.fifoDataOffset, SEEK_SET));
+    ASSERT_TRUE(file.WriteBytes(garbage.data(), garbage.size()));
+  }
+
+  const std::unique_ptr<FifoDataFile> file = FifoDataFile::Load(path, false);
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(nullptr, file->GetFrame(corrupted_frame));
+  EXPECT_FALSE(file->GetFrameFifoData(corrupted_frame));
+  EXPECT_NE(nullptr, file->GetFrame((corrupted_frame + 1) % 10));
+
+  std::vector<AnalyzedFrameInfo> analysis;
+  EXPECT_FALSE(FifoPlaybackAnalyzer::AnalyzeFrames(file.get(), analysis));
+  EXPECT_FALSE(file->Save(m_temp_dir + "/resaved.dff"));
+}
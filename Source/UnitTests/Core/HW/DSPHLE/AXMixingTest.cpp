@@ -0,0 +1,190 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/MathUtil.h"
+#include "Core/HW/DSPHLE/UCodes/AXMixing.h"
+
+namespace
+{
+// The scalar loops that AX used before they were vectorized, which the results have to match
+// exactly.
+void ReferenceApplyVolume(s16* samples, u32 count, u16* volume, s16 volume_delta)
+{
+  for (u32 i = 0; i < count; ++i)
+  {
+    samples[i] = MathUtil::Clamp(((s32)samples[i] * *volume) >> 15, -32767, 32767);
+    *volume += volume_delta;
+  }
+}
+
+void ReferenceMixAdd(int* out, const s16* input, u32 count, u16* pvol, s16* dpop, bool ramp)
+{
+  u16& volume = pvol[0];
+  u16 volume_delta = pvol[1];
+  if (!ramp)
+    volume_delta = 0;
+
+  for (u32 i = 0; i < count; ++i)
+  {
+    s64 sample = input[i];
+    sample *= volume;
+    sample >>= 15;
+    sample = MathUtil::Clamp((s32)sample, -32767, 32767);
+
+    out[i] += (s16)sample;
+    volume += volume_delta;
+
+    *dpop = (s16)sample;
+  }
+}
+
+// Sample counts used by AX GC, AX Wii and Wii Remote mixing, plus odd ones
+constexpr std::array<u32, 9> COUNTS = {{0, 1, 5, 6, 8, 18, 31, 32, 96}};
+
+std::vector<s16> RandomSamples(std::mt19937& rng, u32 count)
+{
+  std::vector<s16> samples(count);
+  for (s16& sample : samples)
+  {
+    // Make the extremes common, since that is where clamping happens
+    switch (rng() % 4)
+    {
+    case 0:
+      sample = rng() % 2 ? 32767 : -32768;
+      break;
+    default:
+      sample = static_cast<s16>(rng());
+      break;
+    }
+  }
+  return samples;
+}
+
+u16 RandomVolume(std::mt19937& rng)
+{
+  switch (rng() % 4)
+  {
+  case 0:
+    return 0x8000;
+  case 1:
+    return 0xFFFF;
+  default:
+    return static_cast<u16>(rng());
+  }
+}
+}  // namespace
+
+TEST(AXMixing, ApplyVolumeMatchesReference)
+{
+  std::mt19937 rng(1);
+  for (int iteration = 0; iteration < 2000; ++iteration)
+  {
+    for (u32 count : COUNTS)
+    {
+      const std::vector<s16> input = RandomSamples(rng, count);
+      const u16 volume = RandomVolume(rng);
+      const s16 volume_delta = rng() % 2 ? static_cast<s16>(rng()) : 0;
+
+      std::vector<s16> expected = input;
+      u16 expected_volume = volume;
+      ReferenceApplyVolume(expected.data(), count, &expected_volume, volume_delta);
+
+      std::vector<s16> actual = input;
+      u16 actual_volume = volume;
+      DSP::HLE::ApplyVolume(actual.data(), count, &actual_volume, volume_delta);
+
+      ASSERT_EQ(expected, actual) << "count " << count << ", volume " << volume << ", delta "
+                                  << volume_delta;
+      ASSERT_EQ(expected_volume, actual_volume);
+    }
+  }
+}
+
+TEST(AXMixing, MixAddMatchesReference)
+{
+  std::mt19937 rng(2);
+  for (int iteration = 0; iteration < 2000; ++iteration)
+  {
+    for (u32 count : COUNTS)
+    {
+      const std::vector<s16> input = RandomSamples(rng, count);
+      std::vector<int> out(count);
+      for (int& value : out)
+        value = static_cast<int>(rng() % 0x40000) - 0x20000;
+      const bool ramp = rng() % 2 != 0;
+      const std::array<u16, 2> vol = {{RandomVolume(rng), static_cast<u16>(rng())}};
+      const s16 dpop = 0x1234;
+
+      std::vector<int> expected = out;
+      std::array<u16, 2> expected_vol = vol;
+      s16 expected_dpop = dpop;
+      ReferenceMixAdd(expected.data(), input.data(), count, expected_vol.data(), &expected_dpop,
+                      ramp);
+
+      std::vector<int> actual = out;
+      std::array<u16, 2> actual_vol = vol;
+      s16 actual_dpop = dpop;
+      DSP::HLE::MixAdd(actual.data(), input.data(), count, actual_vol.data(), &actual_dpop, ramp);
+
+      ASSERT_EQ(expected, actual) << "count " << count << ", volume " << vol[0] << ", delta "
+                                  << vol[1] << ", ramp " << ramp;
+      ASSERT_EQ(expected_vol, actual_vol);
+      ASSERT_EQ(expected_dpop, actual_dpop);
+    }
+  }
+}
+
+// Measures the per-voice work of an AX Wii frame with 64 voices that each mix to main and aux A,
+// with the scalar loops and with the vectorized ones.
+TEST(AXMixing, DISABLED_Benchmark)
+{
+  constexpr u32 NUM_VOICES = 64;
+  constexpr u32 NUM_BUSES = 6;
+  constexpr u32 COUNT = 96;
+  constexpr int NUM_FRAMES = 20000;
+
+  std::mt19937 rng(3);
+  std::vector<std::vector<s16>> voices;
+  for (u32 i = 0; i < NUM_VOICES; ++i)
+    voices.push_back(RandomSamples(rng, COUNT));
+  std::vector<std::vector<int>> buses(NUM_BUSES, std::vector<int>(COUNT));
+
+  const auto run = [&](auto apply_volume, auto mix_add) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < NUM_FRAMES; ++frame)
+    {
+      for (std::vector<int>& bus : buses)
+        std::fill(bus.begin(), bus.end(), 0);
+      for (std::vector<s16>& voice : voices)
+      {
+        std::vector<s16> samples = voice;
+        u16 volume = 0x7000;
+        apply_volume(samples.data(), COUNT, &volume, 3);
+        for (std::vector<int>& bus : buses)
+        {
+          u16 vol[2] = {0x6000, 0xFFFE};
+          s16 dpop;
+          mix_add(bus.data(), samples.data(), COUNT, vol, &dpop, true);
+        }
+      }
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+               .count();
+  };
+
+  const long long reference_time = run(ReferenceApplyVolume, ReferenceMixAdd);
+  const long long time = run(DSP::HLE::ApplyVolume, DSP::HLE::MixAdd);
+  std::printf("Scalar: %lld us per frame, vectorized: %lld us per frame\n",
+              reference_time / NUM_FRAMES, time / NUM_FRAMES);
+}
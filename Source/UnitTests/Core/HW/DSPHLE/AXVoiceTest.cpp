@@ -0,0 +1,167 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <array>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/FileUtil.h"
+#include "Common/ThreadPool.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "Core/HW/DSP.h"
+#include "Core/HW/Memmap.h"
+#include "UICommon/UICommon.h"
+
+#define AX_WII
+#include "Core/HW/DSPHLE/UCodes/AXVoice.h"
+
+using namespace DSP::HLE;
+
+namespace
+{
+constexpr u32 CRC = 0;
+constexpr u32 PB_ADDRESS = 0x10000;
+// Accelerator addresses are in nibbles for ADPCM and in samples for PCM8 and PCM16. In all three
+// cases, the audio data in this range is far away from the PBs.
+constexpr u32 AUDIO_START = 0x400000;
+constexpr u32 AUDIO_SIZE = 0x100000;
+constexpr u32 NUM_VOICES = 40;
+constexpr u32 NUM_BUFFERS = sizeof(AXBuffers) / sizeof(int*);
+
+class AXVoiceTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+    // On the Wii, the accelerator reads audio from main memory.
+    SConfig::GetInstance().bWii = true;
+    Memory::Init();
+    DSP::Reinit(true);
+  }
+
+  void TearDown() override
+  {
+    DSP::Shutdown();
+    Memory::Shutdown();
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  // Random voices in all formats and with all sample rate converters, most of them running.
+  static void WriteVoices(std::mt19937& rng)
+  {
+    std::vector<u8> audio((AUDIO_START + AUDIO_SIZE) * 2 - AUDIO_START / 2);
+    for (u8& byte : audio)
+      byte = static_cast<u8>(rng());
+    Memory::CopyToEmu(AUDIO_START / 2, audio.data(), audio.size());
+
+    for (u32 i = 0; i < NUM_VOICES; ++i)
+    {
+      AXPBWii pb;
+      u16* const words = reinterpret_cast<u16*>(&pb);
+      for (size_t j = 0; j < sizeof(pb) / sizeof(u16); ++j)
+        words[j] = static_cast<u16>(rng());
+
+      const u32 address = PB_ADDRESS + i * sizeof(pb);
+      const u32 next = i + 1 < NUM_VOICES ? address + sizeof(pb) : 0;
+      pb.next_pb_hi = static_cast<u16>(next >> 16);
+      pb.next_pb_lo = static_cast<u16>(next);
+      pb.running = rng() % 8 != 0;
+      pb.is_stream = rng() % 2;
+      pb.remote = rng() % 2;
+      pb.src_type = rng() % 3;
+      pb.coef_select = 0;
+
+      static constexpr std::array<u16, 3> formats = {
+          {AUDIOFORMAT_ADPCM, AUDIOFORMAT_PCM8, AUDIOFORMAT_PCM16}};
+      pb.audio_addr.sample_format = formats[rng() % formats.size()];
+      pb.audio_addr.looping = rng() % 2;
+      const u32 loop_addr = AUDIO_START + rng() % (AUDIO_SIZE / 2);
+      const u32 end_addr = loop_addr + 1 + rng() % 0x400;
+      const u32 cur_addr = loop_addr + rng() % (end_addr - loop_addr);
+      pb.audio_addr.loop_addr_hi = static_cast<u16>(loop_addr >> 16);
+      pb.audio_addr.loop_addr_lo = static_cast<u16>(loop_addr);
+      pb.audio_addr.end_addr_hi = static_cast<u16>(end_addr >> 16);
+      pb.audio_addr.end_addr_lo = static_cast<u16>(end_addr);
+      pb.audio_addr.cur_addr_hi = static_cast<u16>(cur_addr >> 16);
+      pb.audio_addr.cur_addr_lo = static_cast<u16>(cur_addr);
+      pb.src.ratio_hi = rng() % 4;
+
+      WritePB(address, pb, CRC);
+    }
+  }
+
+  struct MixResult
+  {
+    std::vector<int> samples;
+    std::vector<u8> pbs;
+    u32 walked_voices = 0;
+  };
+
+  // Mixes all voices like AXWiiUCode::ProcessPBList does for PBs without updates.
+  static MixResult Mix(unsigned int num_threads)
+  {
+    MixResult result;
+    result.samples.assign(NUM_BUFFERS * GetBufferSize(0), 0);
+    AXBuffers buffers;
+    for (u32 i = 0; i < NUM_BUFFERS; ++i)
+      buffers.ptrs[i] = &result.samples[i * GetBufferSize(0)];
+
+    Common::ThreadPool thread_pool(num_threads);
+    ProcessVoices(PB_ADDRESS, CRC, buffers, &thread_pool,
+                  [&result](AXPBWii& pb, const AXBuffers* output) {
+                    if (!output)
+                    {
+                      result.walked_voices++;
+                      return;
+                    }
+                    const auto mixer_control =
+                        static_cast<AXMixControl>(HILO_TO_32(pb.mixer_control) & 0xFFFFFF);
+                    ProcessVoice(pb, *output, 96, mixer_control, nullptr);
+                  });
+
+    result.pbs.resize(NUM_VOICES * sizeof(AXPBWii));
+    Memory::CopyFromEmu(result.pbs.data(), PB_ADDRESS, result.pbs.size());
+    return result;
+  }
+
+  std::string m_temp_dir;
+};
+}  // namespace
+
+TEST_F(AXVoiceTest, ParallelMixingMatchesSerialMixing)
+{
+  std::mt19937 rng(1234);
+  for (int frame = 0; frame < 8; ++frame)
+  {
+    SCOPED_TRACE(frame);
+    WriteVoices(rng);
+    std::vector<u8> pbs(NUM_VOICES * sizeof(AXPBWii));
+    Memory::CopyFromEmu(pbs.data(), PB_ADDRESS, pbs.size());
+
+    const MixResult serial = Mix(1);
+    EXPECT_EQ(0u, serial.walked_voices);
+
+    Memory::CopyToEmu(PB_ADDRESS, pbs.data(), pbs.size());
+    const MixResult parallel = Mix(4);
+    // Otherwise the voices weren't processed on the thread pool.
+    ASSERT_EQ(NUM_VOICES, parallel.walked_voices);
+
+    EXPECT_NE(std::vector<int>(serial.samples.size()), serial.samples);
+    EXPECT_EQ(serial.samples, parallel.samples);
+    EXPECT_EQ(serial.pbs, parallel.pbs);
+    EXPECT_NE(pbs, parallel.pbs);
+  }
+}
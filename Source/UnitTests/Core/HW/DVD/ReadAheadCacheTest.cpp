@@ -0,0 +1,290 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/HW/DVD/ReadAheadCache.h"
+#include "DiscIO/Volume.h"
+
+using DVDThread::ReadAheadCache;
+
+namespace
+{
+constexpr u64 PARTITION_SIZE = 0x10000000;
+const DiscIO::Partition PARTITION(0x50000);
+
+u8 ExpectedByte(const DiscIO::Partition& partition, u64 offset)
+{
+  return static_cast<u8>((offset >> 3) ^ (offset * 7) ^ partition.offset);
+}
+
+// A fake disc that counts how much it has been read.
+class FakeDisc
+{
+public:
+  ReadAheadCache::ReadFunction GetReadFunction()
+  {
+    return [this](u64 offset, u32 length, u8* buffer, const DiscIO::Partition& partition) {
+      if (offset + length > size)
+      {
+        failed_reads++;
+        return false;
+      }
+      reads++;
+      bytes_read += length;
+      for (u32 i = 0; i < length; i++)
+        buffer[i] = ExpectedByte(partition, offset + i);
+      return true;
+    };
+  }
+
+  u64 size = PARTITION_SIZE;
+  u64 reads = 0;
+  u64 failed_reads = 0;
+  u64 bytes_read = 0;
+};
+
+void CheckRead(ReadAheadCache* cache, FakeDisc* disc, u64 offset, u32 length,
+               const DiscIO::Partition& partition = PARTITION)
+{
+  std::vector<u8> buffer(length);
+  ASSERT_TRUE(cache->Read(offset, length, buffer.data(), partition, disc->size,
+                          disc->GetReadFunction()));
+  for (u32 i = 0; i < length; i++)
+    ASSERT_EQ(ExpectedByte(partition, offset + i), buffer[i]) << "at " << offset + i;
+}
+
+void PrefetchAll(ReadAheadCache* cache, FakeDisc* disc)
+{
+  while (cache->Prefetch(disc->GetReadFunction()))
+  {
+  }
+}
+}  // namespace
+
+TEST(DVDReadAhead, SequentialStreamIsPrefetched)
+{
+  ReadAheadCache cache;
+  FakeDisc disc;
+
+  for (u64 offset = 0; offset < 0x800000; offset += 0x8000)
+  {
+    CheckRead(&cache, &disc, offset, 0x8000);
+    PrefetchAll(&cache, &disc);
+  }
+
+  const ReadAheadCache::Stats& stats = cache.GetStats();
+  EXPECT_EQ(0x100u, stats.reads);
+  EXPECT_GT(stats.hits, 0xF0u);
+  EXPECT_GT(stats.bytes_hit, stats.bytes_read * 9 / 10);
+}
+
+TEST(DVDReadAhead, InterleavedStreamsArePrefetched)
+{
+  ReadAheadCache cache;
+  FakeDisc disc;
+  const DiscIO::Partition other_partition(0x1000000);
+
+  for (u64 i = 0; i < 0x80; i++)
+  {
+    CheckRead(&cache, &disc, i * 0x8000, 0x8000);
+    CheckRead(&cache, &disc, 0x4000000 + i * 0x4000, 0x4000);
+    CheckRead(&cache, &disc, i * 0x10000, 0x10000, other_partition);
+    PrefetchAll(&cache, &disc);
+  }
+
+  const ReadAheadCache::Stats& stats = cache.GetStats();
+  EXPECT_GT(stats.hits, stats.reads * 9 / 10);
+  EXPECT_EQ(0u, stats.bytes_wasted);
+}
+
+TEST(DVDReadAhead, RandomReadsArentPrefetched)
+{
+  ReadAheadCache cache;
+  FakeDisc disc;
+
+  for (u64 i = 0; i < 0x40; i++)
+  {
+    CheckRead(&cache, &disc, (i * 0x2345679) % (PARTITION_SIZE - 0x1000), 0x1000);
+    PrefetchAll(&cache, &disc);
+  }
+
+  EXPECT_EQ(0u, cache.GetStats().bytes_prefetched);
+  EXPECT_EQ(0x40u, disc.reads);
+}
+
+TEST(DVDReadAhead, StopsAtEndOfPartition)
+{
+  ReadAheadCache cache;
+  FakeDisc disc;
+
+  for (u64 offset = PARTITION_SIZE - 0x40000; offset < PARTITION_SIZE; offset += 0x8000)
+  {
+    CheckRead(&cache, &disc, offset, 0x8000);
+    PrefetchAll(&cache, &disc);
+  }
+  EXPECT_FALSE(cache.Prefetch(disc.GetReadFunction()));
+  EXPECT_LE(cache.GetStats().bytes_prefetched, 0x40000u);
+  EXPECT_EQ(0u, disc.failed_reads);
+}
+
+TEST(DVDReadAhead, PrefetchesPartialLastChunk)
+{
+  ReadAheadCache cache;
+  FakeDisc disc;
+  disc.size = PARTITION_SIZE - 0x12345;
+
+  u64 offset = disc.size - 0x80000;
+  for (; offset + 0x8000 <= disc.size; offset += 0x8000)
+  {
+    CheckRead(&cache, &disc, offset, 0x8000);
+    PrefetchAll(&cache, &disc);
+  }
+  const u64 reads = disc.reads;
+  CheckRead(&cache, &disc, offset, static_cast<u32>(disc.size - offset));
+
+  EXPECT_EQ(reads, disc.reads);
+  EXPECT_FALSE(cache.Prefetch(disc.GetReadFunction()));
+  EXPECT_EQ(0u, disc.failed_reads);
+}
+
+TEST(DVDReadAhead, RandomAccessReturnsCorrectData)
+{
+  ReadAheadCache cache(8);
+  FakeDisc disc;
+  std::mt19937 rng(1234);
+
+  u64 offset = 0;
+  for (int i = 0; i < 2000; i++)
+  {
+    // Mostly sequential reads with occasional seeks, so that prefetched and evicted chunks mix
+    if (rng() % 8 == 0)
+      offset = rng() % (PARTITION_SIZE / 2);
+    const u32 length = 1 + rng() % 0x30000;
+    CheckRead(&cache, &disc, offset, length);
+    offset += length + rng() % 0x100;
+
+    if (rng() % 2)
+      cache.Prefetch(disc.GetReadFunction());
+  }
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Prefetch(disc.GetReadFunction()));
+}
+
+// Replays an access trace against a disc with simulated latency and bandwidth, and compares the
+// time that reads spend waiting with and without read-ahead. Set DOLPHIN_DVD_TRACE to a log file
+// with the "DVD read:" lines that DVDThread logs at the info level to replay a recorded trace.
+// Otherwise, a synthetic trace with streamed audio, level loading and seeks is used.
+TEST(DVDReadAhead, DISABLED_ReplayTrace)
+{
+  struct TraceEntry
+  {
+    u64 time_us;
+    DiscIO::Partition partition;
+    u64 offset;
+    u32 length;
+  };
+  std::vector<TraceEntry> trace;
+  u64 data_size = PARTITION_SIZE;
+
+  if (const char* path = std::getenv("DOLPHIN_DVD_TRACE"))
+  {
+    // The trace doesn't contain the partition sizes, so assume a dual-layer disc
+    data_size = 0x200000000;
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      const size_t pos = line.find("DVD read:");
+      if (pos == std::string::npos)
+        continue;
+      TraceEntry entry;
+      if (std::sscanf(line.c_str() + pos,
+                      "DVD read: time %" SCNu64 " us, partition %" SCNx64 ", offset %" SCNx64
+                      ", length %x",
+                      &entry.time_us, &entry.partition.offset, &entry.offset, &entry.length) == 4)
+      {
+        trace.push_back(entry);
+      }
+    }
+  }
+  else
+  {
+    std::mt19937 rng(42);
+    u64 level_offset = 0x1000000;
+    for (u64 time_us = 0; time_us < 60000000; time_us += 50000)
+    {
+      // 32 KiB of streamed audio every 50 ms
+      trace.push_back({time_us, PARTITION, 0x8000000 + time_us / 50000 * 0x8000, 0x8000});
+
+      // Every few seconds, a level gets loaded with 128 KiB reads and a few seeks
+      if (time_us % 5000000 < 1000000)
+      {
+        for (u64 i = 0; i < 4; i++)
+        {
+          trace.push_back({time_us + i * 10000 + 5000, PARTITION, level_offset, 0x20000});
+          level_offset += 0x20000;
+        }
+        if (rng() % 16 == 0)
+          level_offset = 0x1000000 + (rng() % 0x4000) * 0x800;
+      }
+    }
+  }
+  ASSERT_FALSE(trace.empty());
+
+  constexpr u64 LATENCY_US = 2000;
+  constexpr u64 BYTES_PER_US = 20;  // About 20 MB/s
+
+  const auto replay = [&](bool read_ahead) {
+    ReadAheadCache cache;
+    u64 cost_us = 0;
+    const ReadAheadCache::ReadFunction read = [&](u64 offset, u32 length, u8* buffer,
+                                                  const DiscIO::Partition& partition) {
+      cost_us += LATENCY_US + length / BYTES_PER_US;
+      return true;
+    };
+
+    std::vector<u8> buffer;
+    u64 thread_free_us = 0;
+    u64 total_wait_us = 0;
+    for (const TraceEntry& entry : trace)
+    {
+      // The DVD thread prefetches while it has nothing else to do
+      while (read_ahead && thread_free_us < entry.time_us && cache.Prefetch(read))
+      {
+        thread_free_us += cost_us;
+        cost_us = 0;
+      }
+
+      buffer.resize(entry.length);
+      cache.Read(entry.offset, entry.length, buffer.data(), entry.partition, data_size, read);
+      thread_free_us = std::max(thread_free_us, entry.time_us) + cost_us;
+      cost_us = 0;
+      total_wait_us += thread_free_us - entry.time_us;
+    }
+
+    const ReadAheadCache::Stats& stats = cache.GetStats();
+    std::printf("%s: %zu reads, %" PRIu64 " hits (%.1f%% of bytes), %" PRIu64
+                " KiB prefetched (%" PRIu64 " KiB unused), average wait %" PRIu64 " us\n",
+                read_ahead ? "Read-ahead" : "No read-ahead", trace.size(), stats.hits,
+                100.0 * stats.bytes_hit / stats.bytes_read, stats.bytes_prefetched / 1024,
+                stats.bytes_wasted / 1024, total_wait_us / trace.size());
+    return total_wait_us;
+  };
+
+  const u64 without = replay(false);
+  const u64 with = replay(true);
+  EXPECT_LE(with, without);
+}
@@ -0,0 +1,126 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "Common/ChunkFile.h"
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/FileUtil.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "Core/HW/Memmap.h"
+#include "UICommon/UICommon.h"
+
+namespace
+{
+class MemmapTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+    SConfig::GetInstance().bWii = true;
+    Memory::Init();
+  }
+
+  void TearDown() override
+  {
+    Memory::Shutdown();
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  static std::vector<u8> Save(Memory::StateType type)
+  {
+    Memory::SetStateTypeToSave(type);
+    u8* ptr = nullptr;
+    PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+    Memory::DoState(p);
+    std::vector<u8> state(reinterpret_cast<size_t>(ptr));
+
+    ptr = state.data();
+    p.SetMode(PointerWrap::MODE_WRITE);
+    Memory::DoState(p);
+    Memory::SetStateTypeToSave(Memory::StateType::Full);
+    return state;
+  }
+
+  static bool Load(std::vector<u8>& state)
+  {
+    u8* ptr = state.data();
+    PointerWrap p(&ptr, PointerWrap::MODE_READ);
+    Memory::DoState(p);
+    return p.GetMode() == PointerWrap::MODE_READ;
+  }
+
+  static std::vector<u8> GetMemory()
+  {
+    std::vector<u8> memory(Memory::m_pRAM, Memory::m_pRAM + Memory::RAM_SIZE);
+    memory.insert(memory.end(), Memory::m_pEXRAM, Memory::m_pEXRAM + Memory::EXRAM_SIZE);
+    return memory;
+  }
+
+  std::string m_temp_dir;
+};
+}  // namespace
+
+TEST_F(MemmapTest, DeltaStateOnlyContainsChangedPages)
+{
+  std::fill_n(Memory::m_pRAM, 0x10000, 0x12);
+  std::vector<u8> base = Save(Memory::StateType::DeltaBase);
+  EXPECT_NE(0u, Memory::GetDeltaBaseID());
+
+  Memory::m_pRAM[0x1234] = 0x56;
+  Memory::m_pRAM[0x1FFF] = 0x56;
+  Memory::m_pEXRAM[0x3FFFFFF] = 0x78;
+  std::vector<u8> delta = Save(Memory::StateType::Delta);
+  const std::vector<u8> memory = GetMemory();
+  EXPECT_LT(delta.size(), 3 * Memory::DELTA_PAGE_SIZE + 0x100);
+
+  // Loading the delta restores the pages that only changed after it was saved from the base
+  Memory::m_pRAM[0x1234] = 0;
+  Memory::m_pRAM[0x5000] = 0x9A;
+  Memory::m_pEXRAM[0] = 0xBC;
+  ASSERT_TRUE(Load(delta));
+  EXPECT_TRUE(GetMemory() == memory);
+
+  // Full states don't replace the base
+  std::vector<u8> full = Save(Memory::StateType::Full);
+  ASSERT_TRUE(Load(full));
+  ASSERT_TRUE(Load(delta));
+  EXPECT_TRUE(GetMemory() == memory);
+}
+
+TEST_F(MemmapTest, DeltaStateNeedsItsBase)
+{
+  std::vector<u8> base = Save(Memory::StateType::DeltaBase);
+  Memory::m_pRAM[0] = 1;
+  std::vector<u8> delta = Save(Memory::StateType::Delta);
+  const std::vector<u8> memory = GetMemory();
+
+  Save(Memory::StateType::DeltaBase);
+  Memory::m_pRAM[0] = 2;
+  EXPECT_FALSE(Load(delta));
+
+  // Loading the base makes it the current base again
+  ASSERT_TRUE(Load(base));
+  EXPECT_EQ(0, Memory::m_pRAM[0]);
+  ASSERT_TRUE(Load(delta));
+  EXPECT_TRUE(GetMemory() == memory);
+
+  Memory::Shutdown();
+  Memory::Init();
+  EXPECT_EQ(0u, Memory::GetDeltaBaseID());
+  EXPECT_FALSE(Load(delta));
+}
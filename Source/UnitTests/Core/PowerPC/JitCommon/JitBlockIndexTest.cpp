@@ -0,0 +1,343 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/PowerPC/JitCommon/JitBase.h"
+#include "Core/PowerPC/JitCommon/JitCache.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+std::vector<JitBlock> MakeBlocks(size_t count, u32 stride)
+{
+  std::vector<JitBlock> blocks(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    blocks[i].physicalAddress = 0x80000000 + static_cast<u32>(i) * stride;
+    blocks[i].effectiveAddress = blocks[i].physicalAddress;
+  }
+  return blocks;
+}
+
+std::set<JitBlock*> FindAll(const JitBlockIndex& index, u32 physical_address)
+{
+  std::set<JitBlock*> result;
+  for (JitBlock* block = index.Find(physical_address); block; block = block->next_in_bucket)
+    result.insert(block);
+  return result;
+}
+
+class TestBlockCache final : public JitBaseBlockCache
+{
+public:
+  using JitBaseBlockCache::JitBaseBlockCache;
+
+private:
+  void WriteLinkBlock(const JitBlock::LinkData& source, const JitBlock* dest) override {}
+};
+
+// Only provides the block cache, nothing is ever compiled.
+class TestJit final : public JitBase
+{
+public:
+  void Init() override {}
+  void Shutdown() override {}
+  void ClearCache() override {}
+  void Run() override {}
+  void SingleStep() override {}
+  const char* GetName() const override { return "TestJit"; }
+  JitBaseBlockCache* GetBlockCache() override { return &m_block_cache; }
+  void Jit(u32 em_address) override {}
+  const CommonAsmRoutinesBase* GetAsmRoutines() override { return nullptr; }
+  bool HandleFault(uintptr_t access_address, SContext* ctx) override { return false; }
+
+private:
+  TestBlockCache m_block_cache{*this};
+};
+}  // namespace
+
+TEST(JitBlockIndex, InsertFind)
+{
+  JitBlockIndex index;
+  std::vector<JitBlock> blocks = MakeBlocks(0x4000, 4);
+  for (JitBlock& block : blocks)
+    index.Insert(&block);
+
+  EXPECT_EQ(blocks.size(), index.Size());
+  for (JitBlock& block : blocks)
+    EXPECT_EQ(&block, index.Find(block.physicalAddress));
+  EXPECT_EQ(nullptr, index.Find(0x7ffffffc));
+}
+
+TEST(JitBlockIndex, SharedStartAddress)
+{
+  JitBlockIndex index;
+  std::vector<JitBlock> blocks = MakeBlocks(3, 0);
+  for (JitBlock& block : blocks)
+    index.Insert(&block);
+
+  EXPECT_EQ((std::set<JitBlock*>{&blocks[0], &blocks[1], &blocks[2]}),
+            FindAll(index, 0x80000000));
+
+  index.Erase(&blocks[1]);
+  EXPECT_EQ((std::set<JitBlock*>{&blocks[0], &blocks[2]}), FindAll(index, 0x80000000));
+  index.Erase(&blocks[0]);
+  index.Erase(&blocks[2]);
+  EXPECT_EQ(nullptr, index.Find(0x80000000));
+  EXPECT_EQ(0u, index.Size());
+}
+
+TEST(JitBlockIndex, EraseKeepsProbeSequences)
+{
+  JitBlockIndex index;
+  // Addresses which are a multiple of a large power of two tend to collide.
+  std::vector<JitBlock> blocks = MakeBlocks(0x1000, 0x10000);
+  for (JitBlock& block : blocks)
+    index.Insert(&block);
+
+  for (size_t i = 0; i < blocks.size(); i += 2)
+    index.Erase(&blocks[i]);
+
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    JitBlock* expected = i % 2 ? &blocks[i] : nullptr;
+    EXPECT_EQ(expected, index.Find(blocks[i].physicalAddress));
+  }
+  EXPECT_EQ(blocks.size() / 2, index.Size());
+
+  index.Clear();
+  EXPECT_EQ(0u, index.Size());
+  EXPECT_EQ(nullptr, index.Find(blocks[1].physicalAddress));
+}
+
+TEST(JitBlockIndex, ForEachAllowsFreeing)
+{
+  JitBlockIndex index;
+  std::vector<JitBlock> blocks = MakeBlocks(3, 0);
+  for (JitBlock& block : blocks)
+    index.Insert(&block);
+
+  // Freeing a block resets it, including its link to the next block with the same address.
+  std::set<JitBlock*> visited;
+  index.ForEach([&](JitBlock& block) {
+    visited.insert(&block);
+    block = JitBlock{};
+  });
+  EXPECT_EQ((std::set<JitBlock*>{&blocks[0], &blocks[1], &blocks[2]}), visited);
+}
+
+// The MSR is clear, so effective addresses are used as physical addresses.
+TEST(JitBlockCache, InvalidateICachePageRegistry)
+{
+  TestJit jit;
+  JitBaseBlockCache& cache = *jit.GetBlockCache();
+  cache.Clear();
+
+  JitBlock* block = cache.AllocateBlock(0x3000);
+  cache.FinalizeBlock(*block, false, {0x3000, 0x3004, 0x3008});
+  jit.js.fifoWriteAddresses = {0x3004, 0x5004, 0x6004};
+  jit.js.pairedQuantizeAddresses = {0x5008};
+  jit.js.hotBlockAddresses = {0x500c};
+
+  // A page without any code must still drop the addresses found in code which was there before.
+  cache.InvalidateICache(0x5000, 0x1000, false);
+  EXPECT_EQ(1u, cache.GetInvalidationStats().page_hits);
+  EXPECT_EQ(0u, cache.GetInvalidationStats().misses);
+  EXPECT_EQ((std::unordered_set<u32>{0x3004, 0x6004}), jit.js.fifoWriteAddresses);
+  EXPECT_TRUE(jit.js.pairedQuantizeAddresses.empty());
+  EXPECT_TRUE(jit.js.hotBlockAddresses.empty());
+
+  // Forced invalidations don't mean that the code changed.
+  cache.InvalidateICache(0x6000, 32, true);
+  EXPECT_EQ(2u, cache.GetInvalidationStats().page_hits);
+  EXPECT_EQ(1u, jit.js.fifoWriteAddresses.count(0x6004));
+
+  EXPECT_EQ(block, cache.GetBlockFromStartAddress(0x3000, 0));
+  cache.InvalidateICache(0x3000, 32, false);
+  EXPECT_EQ(1u, cache.GetInvalidationStats().misses);
+  EXPECT_EQ(1u, cache.GetInvalidationStats().blocks_destroyed);
+  EXPECT_EQ((std::unordered_set<u32>{0x6004}), jit.js.fifoWriteAddresses);
+  EXPECT_EQ(nullptr, cache.GetBlockFromStartAddress(0x3000, 0));
+
+  // The page has no code left.
+  cache.InvalidateICache(0x3000, 32, false);
+  EXPECT_EQ(3u, cache.GetInvalidationStats().page_hits);
+}
+
+TEST(JitBlockCache, RunCountersAreFreedWithTheirBlocks)
+{
+  TestJit jit;
+  JitBaseBlockCache& cache = *jit.GetBlockCache();
+  cache.Clear();
+
+  JitBlock* block = cache.AllocateBlock(0x3000);
+  block->run_counter = cache.AllocateRunCounter(1000);
+  cache.FinalizeBlock(*block, false, {0x3000});
+  u32* const counter = block->run_counter;
+  EXPECT_EQ(1000u, *counter);
+
+  // Recompiling the block many times must not keep allocating counters.
+  cache.InvalidateICache(0x3000, 32, false);
+  EXPECT_EQ(nullptr, block->run_counter);
+  EXPECT_EQ(counter, cache.AllocateRunCounter(1000));
+
+  u32* const other_counter = cache.AllocateRunCounter(5);
+  EXPECT_NE(counter, other_counter);
+  EXPECT_EQ(5u, *other_counter);
+  cache.FreeRunCounter(other_counter);
+  EXPECT_EQ(other_counter, cache.AllocateRunCounter(7));
+  EXPECT_EQ(7u, *other_counter);
+}
+
+// Replays an allocate/link/invalidate trace against the block cache and reports how long the
+// cache took. Set DOLPHIN_JIT_TRACE to a log file with the "JIT block:", "JIT link:" and "JIT
+// invalidate:" lines that JitBaseBlockCache logs at the info level to replay a recorded trace.
+// Otherwise, a synthetic trace of a game which streams code overlays is used.
+TEST(JitBlockCache, DISABLED_ReplayTrace)
+{
+  struct TraceEntry
+  {
+    enum Type
+    {
+      BLOCK,
+      LINK,
+      INVALIDATE,
+    } type;
+    u32 address;
+    // The number of instructions of a block, or the length of an invalidation
+    u32 length;
+  };
+  std::vector<TraceEntry> trace;
+
+  if (const char* path = std::getenv("DOLPHIN_JIT_TRACE"))
+  {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      TraceEntry entry{};
+      size_t pos;
+      if ((pos = line.find("JIT block:")) != std::string::npos &&
+          std::sscanf(line.c_str() + pos, "JIT block: %x, %u instructions", &entry.address,
+                      &entry.length) == 2)
+      {
+        entry.type = TraceEntry::BLOCK;
+        trace.push_back(entry);
+      }
+      else if ((pos = line.find("JIT link:")) != std::string::npos &&
+               std::sscanf(line.c_str() + pos, "JIT link: %x", &entry.address) == 1)
+      {
+        entry.type = TraceEntry::LINK;
+        trace.push_back(entry);
+      }
+      else if ((pos = line.find("JIT invalidate:")) != std::string::npos &&
+               std::sscanf(line.c_str() + pos, "JIT invalidate: %x, length %u", &entry.address,
+                           &entry.length) == 2)
+      {
+        entry.type = TraceEntry::INVALIDATE;
+        trace.push_back(entry);
+      }
+    }
+  }
+  else
+  {
+    std::mt19937 rng(42);
+    const auto add_blocks = [&](u32 start, u32 size, u32 count) {
+      u32 address = start;
+      for (u32 i = 0; i < count && address < start + size; i++)
+      {
+        const u32 instructions = 4 + rng() % 24;
+        trace.push_back({TraceEntry::BLOCK, address, instructions});
+        for (u32 exit = 0; exit < 2; exit++)
+          trace.push_back({TraceEntry::LINK, start + (rng() % (size / 4)) * 4, 0});
+        address += instructions * 4 + (rng() % 4) * 4;
+      }
+    };
+
+    // The main executable, which stays loaded
+    add_blocks(0x00003000, 0x400000, 20000);
+    for (u32 overlay = 0; overlay < 50; overlay++)
+    {
+      // An overlay gets loaded by DMA, after which the game invalidates the instruction cache
+      // line by line, and then runs some of the new code.
+      const u32 overlay_start = 0x00800000 + (overlay % 4) * 0x40000;
+      trace.push_back({TraceEntry::INVALIDATE, overlay_start, 0x40000});
+      for (u32 line = 0; line < 0x40000; line += 32)
+        trace.push_back({TraceEntry::INVALIDATE, overlay_start + line, 32});
+      add_blocks(overlay_start, 0x40000, 2000);
+
+      // Data next to the code gets written and flushed.
+      for (u32 i = 0; i < 2000; i++)
+        trace.push_back({TraceEntry::INVALIDATE, 0x00003000 + (rng() % 0x20000) * 32, 32});
+    }
+  }
+  ASSERT_FALSE(trace.empty());
+
+  TestJit jit;
+  JitBaseBlockCache& cache = *jit.GetBlockCache();
+  cache.Clear();
+
+  // The physical addresses are set up front, so that only the cache itself is measured. Recorded
+  // blocks are assumed to be contiguous.
+  std::vector<std::set<u32>> block_addresses;
+  for (const TraceEntry& entry : trace)
+  {
+    if (entry.type != TraceEntry::BLOCK)
+      continue;
+    block_addresses.emplace_back();
+    for (u32 i = 0; i < entry.length; i++)
+      block_addresses.back().insert(entry.address + i * 4);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t num_blocks = 0;
+  size_t num_invalidations = 0;
+  JitBlock* block = nullptr;
+  const auto finalize = [&] {
+    if (block)
+      cache.FinalizeBlock(*block, true, block_addresses[num_blocks++]);
+    block = nullptr;
+  };
+  for (const TraceEntry& entry : trace)
+  {
+    switch (entry.type)
+    {
+    case TraceEntry::BLOCK:
+      finalize();
+      block = cache.AllocateBlock(entry.address);
+      break;
+    case TraceEntry::LINK:
+      if (block)
+        block->linkData.push_back({nullptr, entry.address, false, false});
+      break;
+    case TraceEntry::INVALIDATE:
+      finalize();
+      cache.InvalidateICache(entry.address, entry.length, false);
+      num_invalidations++;
+      break;
+    }
+  }
+  finalize();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const JitInvalidationStats& stats = cache.GetInvalidationStats();
+  std::printf("%zu blocks, %zu invalidations (page hits: %" PRIu64 ", cacheline hits: %" PRIu64
+              ", misses: %" PRIu64 ", blocks destroyed: %" PRIu64 ") in %.1f ms\n",
+              num_blocks, num_invalidations, stats.page_hits, stats.cacheline_hits, stats.misses,
+              stats.blocks_destroyed, seconds * 1000);
+  EXPECT_EQ(num_invalidations, stats.invalidations);
+}
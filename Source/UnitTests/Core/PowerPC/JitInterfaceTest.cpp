@@ -0,0 +1,93 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <unordered_set>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/PowerPC/JitCommon/JitBase.h"
+#include "Core/PowerPC/JitCommon/JitCache.h"
+#include "Core/PowerPC/JitInterface.h"
+#include "Core/PowerPC/PowerPC.h"
+
+// include order is important
+#include <gtest/gtest.h>  // NOLINT
+
+namespace
+{
+class FakeBlockCache final : public JitBaseBlockCache
+{
+public:
+  using JitBaseBlockCache::JitBaseBlockCache;
+
+private:
+  void WriteLinkBlock(const JitBlock::LinkData& source, const JitBlock* dest) override {}
+};
+
+// Pretends to have a block compiling in the background, which reads the exception address
+// sets until it is waited for.
+class FakeJit final : public JitBase
+{
+public:
+  void Init() override {}
+  void Shutdown() override {}
+  void ClearCache() override {}
+  void Run() override {}
+  void SingleStep() override {}
+  const char* GetName() const override { return "FakeJit"; }
+  JitBaseBlockCache* GetBlockCache() override { return &m_block_cache; }
+  void Jit(u32 em_address) override {}
+  const CommonAsmRoutinesBase* GetAsmRoutines() override { return nullptr; }
+  bool HandleFault(uintptr_t access_address, SContext* ctx) override { return false; }
+
+  void InvalidatePendingCompile(u32 address, u32 length) override
+  {
+    if (!m_compile_pending)
+      return;
+    m_compile_pending = false;
+
+    // Nothing may have touched what the compile was reading before it was waited for.
+    m_sets_changed_while_pending = js.pairedQuantizeAddresses != m_sets_at_compile_start ||
+                                   m_block_cache.GetInvalidationStats().invalidations != 0;
+    m_waited_for.push_back(address);
+  }
+
+  void StartCompile()
+  {
+    m_compile_pending = true;
+    m_sets_at_compile_start = js.pairedQuantizeAddresses;
+  }
+
+  FakeBlockCache m_block_cache{*this};
+  bool m_compile_pending = false;
+  bool m_sets_changed_while_pending = false;
+  std::unordered_set<u32> m_sets_at_compile_start;
+  std::vector<u32> m_waited_for;
+};
+}  // namespace
+
+TEST(JitInterface, ExceptionCheckWaitsForPendingCompile)
+{
+  FakeJit jit;
+  jit.m_block_cache.Clear();
+  g_jit = &jit;
+
+  // The MSR is clear, so no address translation is needed.
+  PC = 0x3000;
+  jit.StartCompile();
+  JitInterface::CompileExceptionCheck(JitInterface::ExceptionType::PairedQuantize);
+
+  EXPECT_EQ(std::vector<u32>{0x3000}, jit.m_waited_for);
+  EXPECT_FALSE(jit.m_sets_changed_while_pending);
+  EXPECT_EQ(1u, jit.js.pairedQuantizeAddresses.count(0x3000));
+  EXPECT_EQ(1u, jit.m_block_cache.GetInvalidationStats().invalidations);
+
+  // Once the address is known, later checks neither wait nor change anything.
+  jit.StartCompile();
+  JitInterface::CompileExceptionCheck(JitInterface::ExceptionType::PairedQuantize);
+  EXPECT_EQ(std::vector<u32>{0x3000}, jit.m_waited_for);
+  EXPECT_EQ(1u, jit.m_block_cache.GetInvalidationStats().invalidations);
+
+  g_jit = nullptr;
+}
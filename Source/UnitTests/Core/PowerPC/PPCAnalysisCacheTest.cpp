@@ -0,0 +1,306 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/FileUtil.h"
+#include "Common/LinearDiskCache.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "Core/HW/Memmap.h"
+#include "Core/PowerPC/Interpreter/Interpreter.h"
+#include "Core/PowerPC/PPCAnalysisCache.h"
+#include "Core/PowerPC/PPCAnalyst.h"
+#include "UICommon/UICommon.h"
+
+namespace
+{
+constexpr u32 BLOCK_ADDRESS = 0x3000;
+constexpr std::size_t BLOCK_SIZE = 32;
+
+struct AnalyzedBlock
+{
+  AnalyzedBlock() : buffer(BLOCK_SIZE)
+  {
+    block.m_stats = &stats;
+    block.m_gpa = &gpa;
+    block.m_fpa = &fpa;
+  }
+
+  PPCAnalyst::BlockStats stats{};
+  PPCAnalyst::BlockRegStats gpa{};
+  PPCAnalyst::BlockRegStats fpa{};
+  PPCAnalyst::CodeBlock block;
+  PPCAnalyst::CodeBuffer buffer;
+  u32 next_pc = 0;
+};
+
+void ExpectRegStatsEq(const PPCAnalyst::BlockRegStats& expected,
+                      const PPCAnalyst::BlockRegStats& actual)
+{
+  EXPECT_EQ(0, std::memcmp(expected.firstRead, actual.firstRead, sizeof(expected.firstRead)));
+  EXPECT_EQ(0, std::memcmp(expected.firstWrite, actual.firstWrite, sizeof(expected.firstWrite)));
+  EXPECT_EQ(0, std::memcmp(expected.lastRead, actual.lastRead, sizeof(expected.lastRead)));
+  EXPECT_EQ(0, std::memcmp(expected.lastWrite, actual.lastWrite, sizeof(expected.lastWrite)));
+  EXPECT_EQ(0, std::memcmp(expected.numReads, actual.numReads, sizeof(expected.numReads)));
+  EXPECT_EQ(0, std::memcmp(expected.numWrites, actual.numWrites, sizeof(expected.numWrites)));
+  EXPECT_EQ(expected.any, actual.any);
+  EXPECT_EQ(expected.anyTimer, actual.anyTimer);
+}
+
+void ExpectCodeOpEq(const PPCAnalyst::CodeOp& expected, const PPCAnalyst::CodeOp& actual)
+{
+  EXPECT_EQ(expected.inst.hex, actual.inst.hex);
+  EXPECT_EQ(expected.opinfo, actual.opinfo);
+  EXPECT_EQ(expected.address, actual.address);
+  EXPECT_EQ(expected.branchTo, actual.branchTo);
+  EXPECT_EQ(expected.branchToIndex, actual.branchToIndex);
+  EXPECT_EQ(expected.regsOut, actual.regsOut);
+  EXPECT_EQ(expected.regsIn, actual.regsIn);
+  EXPECT_EQ(expected.fregsIn, actual.fregsIn);
+  EXPECT_EQ(expected.fregOut, actual.fregOut);
+  EXPECT_EQ(expected.isBranchTarget, actual.isBranchTarget);
+  EXPECT_EQ(expected.wantsCR0, actual.wantsCR0);
+  EXPECT_EQ(expected.wantsCR1, actual.wantsCR1);
+  EXPECT_EQ(expected.wantsFPRF, actual.wantsFPRF);
+  EXPECT_EQ(expected.wantsCA, actual.wantsCA);
+  EXPECT_EQ(expected.wantsCAInFlags, actual.wantsCAInFlags);
+  EXPECT_EQ(expected.outputCR0, actual.outputCR0);
+  EXPECT_EQ(expected.outputCR1, actual.outputCR1);
+  EXPECT_EQ(expected.outputFPRF, actual.outputFPRF);
+  EXPECT_EQ(expected.outputCA, actual.outputCA);
+  EXPECT_EQ(expected.canEndBlock, actual.canEndBlock);
+  EXPECT_EQ(expected.skipLRStack, actual.skipLRStack);
+  EXPECT_EQ(expected.skip, actual.skip);
+  EXPECT_EQ(expected.fprInUse, actual.fprInUse);
+  EXPECT_EQ(expected.gprInUse, actual.gprInUse);
+  EXPECT_EQ(expected.gprInReg, actual.gprInReg);
+  EXPECT_EQ(expected.fprInXmm, actual.fprInXmm);
+  EXPECT_EQ(expected.fprIsSingle, actual.fprIsSingle);
+  EXPECT_EQ(expected.fprIsDuplicated, actual.fprIsDuplicated);
+  EXPECT_EQ(expected.fprIsStoreSafe, actual.fprIsStoreSafe);
+}
+
+void ExpectBlockEq(const AnalyzedBlock& expected, const AnalyzedBlock& actual)
+{
+  EXPECT_EQ(expected.next_pc, actual.next_pc);
+  EXPECT_EQ(expected.block.m_address, actual.block.m_address);
+  EXPECT_EQ(expected.block.m_num_instructions, actual.block.m_num_instructions);
+  EXPECT_EQ(expected.block.m_broken, actual.block.m_broken);
+  EXPECT_EQ(expected.block.m_memory_exception, actual.block.m_memory_exception);
+  EXPECT_EQ(expected.block.m_gqr_used, actual.block.m_gqr_used);
+  EXPECT_EQ(expected.block.m_gqr_modified, actual.block.m_gqr_modified);
+  EXPECT_EQ(expected.block.m_gpr_inputs, actual.block.m_gpr_inputs);
+  EXPECT_EQ(expected.block.m_physical_addresses, actual.block.m_physical_addresses);
+  EXPECT_EQ(expected.stats.isFirstBlockOfFunction, actual.stats.isFirstBlockOfFunction);
+  EXPECT_EQ(expected.stats.isLastBlockOfFunction, actual.stats.isLastBlockOfFunction);
+  EXPECT_EQ(expected.stats.numCycles, actual.stats.numCycles);
+  ExpectRegStatsEq(expected.gpa, actual.gpa);
+  ExpectRegStatsEq(expected.fpa, actual.fpa);
+
+  ASSERT_EQ(expected.block.m_num_instructions, actual.block.m_num_instructions);
+  for (u32 i = 0; i < expected.block.m_num_instructions; i++)
+  {
+    SCOPED_TRACE(testing::Message() << "instruction " << i);
+    ExpectCodeOpEq(expected.buffer[i], actual.buffer[i]);
+  }
+}
+
+class PPCAnalysisCacheTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    m_cache_path = m_temp_dir + "/test.ppcanalysis";
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+    Memory::Init();
+    Interpreter::getInstance()->Init();
+
+    // The MSR is clear, so these are physical addresses.
+    static constexpr u32 code[] = {
+        0x38630001,  // addi r3, r3, 1
+        0x2C03000A,  // cmpwi r3, 10
+        0xC0240000,  // lfs f1, 0(r4)
+        0xEC41082A,  // fadds f2, f1, f1
+        0x4082FFF0,  // bne 0x3000
+        0x4E800020,  // blr
+    };
+    for (u32 i = 0; i < sizeof(code) / sizeof(code[0]); i++)
+      Memory::Write_U32(code[i], BLOCK_ADDRESS + i * 4);
+
+    m_analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CONDITIONAL_CONTINUE);
+    m_analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_MERGE);
+    m_analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CARRY_MERGE);
+  }
+
+  void TearDown() override
+  {
+    Memory::Shutdown();
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  void Analyze(AnalyzedBlock* result)
+  {
+    result->next_pc =
+        m_analyzer.Analyze(BLOCK_ADDRESS, &result->block, &result->buffer, BLOCK_SIZE);
+  }
+
+  bool Lookup(PPCAnalyst::AnalysisCache* cache, AnalyzedBlock* result, u32 options)
+  {
+    return cache->Lookup(BLOCK_ADDRESS, options, BLOCK_SIZE, &result->block, &result->buffer,
+                         &result->next_pc);
+  }
+
+  std::string m_temp_dir;
+  std::string m_cache_path;
+  PPCAnalyst::PPCAnalyzer m_analyzer;
+};
+}  // namespace
+
+TEST_F(PPCAnalysisCacheTest, RoundTrip)
+{
+  AnalyzedBlock expected;
+  Analyze(&expected);
+  ASSERT_EQ(6u, expected.block.m_num_instructions);
+
+  {
+    PPCAnalyst::AnalysisCache cache;
+    cache.Open(m_cache_path);
+    AnalyzedBlock actual;
+    EXPECT_FALSE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+    cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, expected.block,
+                expected.buffer, expected.next_pc);
+    cache.Close();
+  }
+
+  // The entry has to survive being written to disk and read back.
+  PPCAnalyst::AnalysisCache cache;
+  cache.Open(m_cache_path);
+  AnalyzedBlock actual;
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  ExpectBlockEq(expected, actual);
+  EXPECT_EQ(1u, cache.GetHits());
+
+  // Entries are specific to the analyzer options.
+  EXPECT_FALSE(Lookup(&cache, &actual,
+                      m_analyzer.GetOptions() | PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_FOLLOW));
+}
+
+TEST_F(PPCAnalysisCacheTest, ModifiedCodeInvalidatesEntry)
+{
+  AnalyzedBlock original;
+  Analyze(&original);
+
+  PPCAnalyst::AnalysisCache cache;
+  cache.Open(m_cache_path);
+  cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, original.block, original.buffer,
+              original.next_pc);
+
+  // fadds f2, f1, f1 -> fmuls f2, f1, f1
+  Memory::Write_U32(0xEC410072, BLOCK_ADDRESS + 12);
+  AnalyzedBlock actual;
+  EXPECT_FALSE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  EXPECT_EQ(0u, cache.GetHits());
+
+  // The new analysis is stored next to the stale entry.
+  AnalyzedBlock modified;
+  Analyze(&modified);
+  cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, modified.block, modified.buffer,
+              modified.next_pc);
+  cache.Close();
+
+  cache.Open(m_cache_path);
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  ExpectBlockEq(modified, actual);
+}
+
+TEST_F(PPCAnalysisCacheTest, OverlaysKeepSeparateEntries)
+{
+  AnalyzedBlock original;
+  Analyze(&original);
+  PPCAnalyst::AnalysisCache cache;
+  cache.Open(m_cache_path);
+  cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, original.block, original.buffer,
+              original.next_pc);
+
+  // fadds f2, f1, f1 -> fmuls f2, f1, f1
+  Memory::Write_U32(0xEC410072, BLOCK_ADDRESS + 12);
+  AnalyzedBlock modified;
+  Analyze(&modified);
+  cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, modified.block, modified.buffer,
+              modified.next_pc);
+  cache.Close();
+
+  // Switching back and forth between the two versions of the code hits every time.
+  cache.Open(m_cache_path);
+  EXPECT_EQ(2u, cache.GetFileEntries());
+  AnalyzedBlock actual;
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  ExpectBlockEq(modified, actual);
+
+  Memory::Write_U32(0xEC41082A, BLOCK_ADDRESS + 12);
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  ExpectBlockEq(original, actual);
+  EXPECT_EQ(2u, cache.GetHits());
+
+  // Storing an entry which is already there doesn't write it again.
+  cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, original.block, original.buffer,
+              original.next_pc);
+  EXPECT_EQ(2u, cache.GetFileEntries());
+}
+
+TEST_F(PPCAnalysisCacheTest, UnusedEntriesAreCompacted)
+{
+  AnalyzedBlock expected;
+  Analyze(&expected);
+  {
+    PPCAnalyst::AnalysisCache cache;
+    cache.Open(m_cache_path);
+    cache.Store(BLOCK_ADDRESS, m_analyzer.GetOptions(), BLOCK_SIZE, expected.block,
+                expected.buffer, expected.next_pc);
+    cache.Close();
+  }
+
+  // Entries from an older version of the analysis are never loaded.
+  {
+    class NullReader final : public LinearDiskCacheReader<PPCAnalyst::AnalysisCacheKey, u8>
+    {
+    public:
+      void Read(const PPCAnalyst::AnalysisCacheKey& key, const u8* value, u32 value_size) override
+      {
+      }
+    } reader;
+    LinearDiskCache<PPCAnalyst::AnalysisCacheKey, u8> disk_cache;
+    ASSERT_EQ(1u, disk_cache.OpenAndRead(m_cache_path, reader));
+    const u8 old_entry[8] = {};
+    for (u32 i = 0; i < 0x2000; i++)
+      disk_cache.Append({0x80000000 + i * 4, 0, BLOCK_SIZE, 0, i}, old_entry, sizeof(old_entry));
+    disk_cache.Close();
+  }
+  const u64 file_size = File::GetSize(m_cache_path);
+
+  PPCAnalyst::AnalysisCache cache;
+  cache.Open(m_cache_path);
+  EXPECT_EQ(1u, cache.GetFileEntries());
+  EXPECT_LT(File::GetSize(m_cache_path), file_size / 100);
+  AnalyzedBlock actual;
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+  ExpectBlockEq(expected, actual);
+  cache.Close();
+
+  // The rewritten file is still usable.
+  cache.Open(m_cache_path);
+  EXPECT_EQ(1u, cache.GetFileEntries());
+  ASSERT_TRUE(Lookup(&cache, &actual, m_analyzer.GetOptions()));
+}
@@ -0,0 +1,117 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/FileUtil.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "Core/HW/Memmap.h"
+#include "Core/PowerPC/Interpreter/Interpreter.h"
+#include "Core/PowerPC/PPCAnalyst.h"
+#include "UICommon/UICommon.h"
+
+namespace
+{
+constexpr u32 CODE_ADDRESS = 0x3000;
+constexpr std::size_t BLOCK_SIZE = 64;
+
+class PPCAnalystTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+    Memory::Init();
+    Interpreter::getInstance()->Init();
+
+    m_code_block.m_stats = &m_stats;
+    m_code_block.m_gpa = &m_gpa;
+    m_code_block.m_fpa = &m_fpa;
+  }
+
+  void TearDown() override
+  {
+    Memory::Shutdown();
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  // The MSR is clear, so these are physical addresses.
+  static void WriteCode(const std::vector<u32>& code)
+  {
+    for (u32 i = 0; i < code.size(); i++)
+      Memory::Write_U32(code[i], CODE_ADDRESS + i * 4);
+  }
+
+  // The options Jit64 uses for both tiers of tiered compilation.
+  static PPCAnalyst::PPCAnalyzer MakeAnalyzer(bool hot)
+  {
+    PPCAnalyst::PPCAnalyzer analyzer;
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CONDITIONAL_CONTINUE);
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_MERGE);
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CROR_MERGE);
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_CARRY_MERGE);
+    analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_BRANCH_FOLLOW);
+    if (hot)
+      analyzer.SetOption(PPCAnalyst::PPCAnalyzer::OPTION_AGGRESSIVE_BRANCH_FOLLOW);
+    return analyzer;
+  }
+
+  u32 Analyze(bool hot)
+  {
+    MakeAnalyzer(hot).Analyze(CODE_ADDRESS, &m_code_block, &m_code_buffer, BLOCK_SIZE);
+    return m_code_block.m_num_instructions;
+  }
+
+  std::string m_temp_dir;
+  PPCAnalyst::BlockStats m_stats{};
+  PPCAnalyst::BlockRegStats m_gpa{};
+  PPCAnalyst::BlockRegStats m_fpa{};
+  PPCAnalyst::CodeBlock m_code_block;
+  PPCAnalyst::CodeBuffer m_code_buffer{BLOCK_SIZE};
+};
+}  // namespace
+
+TEST_F(PPCAnalystTest, HotBlocksFollowMoreBranches)
+{
+  // Every branch skips one instruction.
+  WriteCode({
+      0x48000008,  // b +8
+      0x00000000,  //
+      0x48000008,  // b +8
+      0x00000000,  //
+      0x48000008,  // b +8
+      0x00000000,  //
+      0x48000008,  // b +8
+      0x00000000,  //
+      0x4E800020,  // blr
+  });
+
+  EXPECT_EQ(3u, Analyze(false));
+  EXPECT_EQ(5u, Analyze(true));
+}
+
+TEST_F(PPCAnalystTest, BothTiersContinuePastConditionalBranches)
+{
+  WriteCode({
+      0x38630001,  // addi r3, r3, 1
+      0x2C03000A,  // cmpwi r3, 10
+      0x40820008,  // bne +8
+      0x38630001,  // addi r3, r3, 1
+      0x4E800020,  // blr
+  });
+
+  EXPECT_EQ(5u, Analyze(false));
+  EXPECT_EQ(5u, Analyze(true));
+}
@@ -0,0 +1,121 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/ThreadPool.h"
+#include "Core/Rewind.h"
+#include "Core/State.h"
+
+namespace
+{
+// Every state changes a few bytes of the previous one, and sometimes its size.
+std::vector<std::vector<u8>> MakeStates(size_t count)
+{
+  std::mt19937 rng(1234);
+  std::vector<std::vector<u8>> states;
+  std::vector<u8> state(0x234567);
+  for (u8& byte : state)
+    byte = static_cast<u8>(rng() % 4);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    for (int j = 0; j < 100; j++)
+      state[rng() % state.size()] = static_cast<u8>(rng());
+    if (i % 3 == 1)
+      state.resize(state.size() + rng() % 0x1000 - 0x800, 0x55);
+    states.push_back(state);
+  }
+  return states;
+}
+
+class RewindTest : public testing::Test
+{
+protected:
+  void SetUp() override { State::Init(); }
+  void TearDown() override { State::Shutdown(); }
+};
+}  // namespace
+
+TEST_F(RewindTest, PopReturnsStatesInReverse)
+{
+  Common::ThreadPool thread_pool(2);
+  Rewind::RewindBuffer buffer(0x10000000, &thread_pool);
+  const std::vector<std::vector<u8>> states = MakeStates(10);
+  for (const std::vector<u8>& state : states)
+  {
+    EXPECT_TRUE(buffer.Push(state));
+    buffer.Flush();
+  }
+
+  EXPECT_EQ(states.size(), buffer.GetNumStates());
+  // Only the newest state is kept uncompressed
+  EXPECT_LT(buffer.GetMemoryUsage(), states.back().size() * 2);
+
+  for (auto it = states.rbegin(); it != states.rend(); ++it)
+  {
+    std::vector<u8> state = buffer.TakeSpareBuffer();
+    ASSERT_TRUE(buffer.Pop(&state));
+    EXPECT_TRUE(state == *it);
+    buffer.RecycleBuffer(std::move(state));
+  }
+
+  std::vector<u8> state;
+  EXPECT_FALSE(buffer.Pop(&state));
+  EXPECT_EQ(0u, buffer.GetNumStates());
+}
+
+TEST_F(RewindTest, PushingAfterPopping)
+{
+  Common::ThreadPool thread_pool(2);
+  Rewind::RewindBuffer buffer(0x10000000, &thread_pool);
+  const std::vector<std::vector<u8>> states = MakeStates(6);
+  for (size_t i = 0; i < 4; i++)
+  {
+    buffer.Push(states[i]);
+    buffer.Flush();
+  }
+
+  std::vector<u8> state;
+  ASSERT_TRUE(buffer.Pop(&state));
+  ASSERT_TRUE(buffer.Pop(&state));
+  EXPECT_TRUE(state == states[2]);
+
+  EXPECT_TRUE(buffer.Push(states[4]));
+  buffer.Flush();
+  EXPECT_TRUE(buffer.Push(states[5]));
+  buffer.Flush();
+
+  for (size_t i : {5, 4, 1, 0})
+  {
+    ASSERT_TRUE(buffer.Pop(&state));
+    EXPECT_TRUE(state == states[i]);
+  }
+}
+
+TEST_F(RewindTest, OldestStatesAreDroppedToStayWithinBudget)
+{
+  Common::ThreadPool thread_pool(2);
+  const std::vector<std::vector<u8>> states = MakeStates(20);
+  Rewind::RewindBuffer buffer(states.back().size() + 0x8000, &thread_pool);
+  for (const std::vector<u8>& state : states)
+  {
+    buffer.Push(state);
+    buffer.Flush();
+    EXPECT_LE(buffer.GetMemoryUsage(), states.back().size() + 0x8000);
+  }
+
+  const size_t num_states = buffer.GetNumStates();
+  EXPECT_GT(num_states, 1u);
+  EXPECT_LT(num_states, states.size());
+  for (size_t i = 0; i < num_states; i++)
+  {
+    std::vector<u8> state;
+    ASSERT_TRUE(buffer.Pop(&state));
+    EXPECT_TRUE(state == states[states.size() - 1 - i]);
+  }
+}
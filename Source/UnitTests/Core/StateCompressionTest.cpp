@@ -0,0 +1,214 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/ThreadPool.h"
+#include "Core/State.h"
+#include "Core/StateCompression.h"
+
+namespace
+{
+// Roughly what a Wii state looks like: MEM1 and MEM2 with code, data, mostly empty heaps and some
+// uncompressible textures, followed by a few megabytes of video and hardware state.
+std::vector<u8> MakeWiiLikeState(size_t size = 0x5A00000)
+{
+  std::vector<u8> state(size);
+  std::mt19937 rng(1234);
+  for (size_t offset = 0; offset < size; offset += 0x1000)
+  {
+    const size_t page_size = std::min<size_t>(0x1000, size - offset);
+    u8* const page = &state[offset];
+    switch (rng() % 8)
+    {
+    case 0:
+    case 1:
+    case 2:
+      // Empty
+      break;
+    case 3:
+      // Random, like compressed textures or audio
+      std::generate(page, page + page_size, [&rng] { return static_cast<u8>(rng()); });
+      break;
+    default:
+      // Instructions and data structures, which repeat a lot but not exactly
+      for (size_t i = 0; i < page_size; i += 4)
+      {
+        const u32 word = 0x38600000 | (rng() % 16 << 16) | (rng() % 4 == 0 ? rng() % 0x100 : 0);
+        std::memcpy(page + i, &word, std::min<size_t>(4, page_size - i));
+      }
+      break;
+    }
+  }
+  return state;
+}
+
+class StateCompressionTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    State::Init();
+    m_temp_dir = File::CreateTempDir();
+    m_path = m_temp_dir + "/test.sav";
+  }
+
+  void TearDown() override
+  {
+    File::DeleteDirRecursively(m_temp_dir);
+    State::Shutdown();
+  }
+
+  // Writes the state in pieces while it is being compressed, like State::SaveAs does.
+  bool Save(const std::vector<u8>& state, State::StateCompression compression,
+            Common::ThreadPool* thread_pool)
+  {
+    std::vector<u8> buffer(state.size());
+    State::StateCompressor compressor(buffer.data(), buffer.size(), compression, thread_pool);
+    bool compressed = false;
+    std::thread compress_thread([&] { compressed = compressor.Compress(); });
+
+    for (size_t offset = 0; offset < state.size(); offset += 0x345678)
+    {
+      const size_t size = std::min<size_t>(0x345678, state.size() - offset);
+      std::copy_n(state.begin() + offset, size, buffer.begin() + offset);
+      compressor.SetWrittenSize(offset + size);
+    }
+    compress_thread.join();
+    if (!compressed)
+      return false;
+
+    File::IOFile file(m_path, "wb");
+    return compressor.WriteToFile(&file);
+  }
+
+  bool Load(std::vector<u8>* state, Common::ThreadPool* thread_pool)
+  {
+    File::IOFile file(m_path, "rb");
+    return State::ReadCompressedState(&file, state, thread_pool);
+  }
+
+  std::string m_temp_dir;
+  std::string m_path;
+};
+}  // namespace
+
+TEST_F(StateCompressionTest, RoundTrip)
+{
+  const std::vector<u8> state = MakeWiiLikeState(0x1234567);
+  Common::ThreadPool thread_pool(4);
+
+  for (State::StateCompression compression :
+       {State::StateCompression::None, State::StateCompression::LZO,
+        State::StateCompression::Zstd})
+  {
+    if (!State::IsStateCompressionSupported(compression))
+      continue;
+
+    SCOPED_TRACE(static_cast<int>(compression));
+    ASSERT_TRUE(Save(state, compression, &thread_pool));
+    if (compression != State::StateCompression::None)
+      EXPECT_LT(File::GetSize(m_path), state.size() / 2);
+
+    std::vector<u8> loaded;
+    ASSERT_TRUE(Load(&loaded, &thread_pool));
+    EXPECT_TRUE(loaded == state);
+  }
+}
+
+TEST_F(StateCompressionTest, EmptyState)
+{
+  Common::ThreadPool thread_pool(2);
+  ASSERT_TRUE(Save({}, State::GetDefaultStateCompression(), &thread_pool));
+  std::vector<u8> loaded(1);
+  ASSERT_TRUE(Load(&loaded, &thread_pool));
+  EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(StateCompressionTest, Abort)
+{
+  std::vector<u8> buffer(0x300000);
+  Common::ThreadPool thread_pool(2);
+  State::StateCompressor compressor(buffer.data(), buffer.size(), State::StateCompression::LZO,
+                                    &thread_pool);
+  bool compressed = true;
+  std::thread compress_thread([&] { compressed = compressor.Compress(); });
+  compressor.SetWrittenSize(0x100000);
+  compressor.Abort();
+  compress_thread.join();
+  EXPECT_FALSE(compressed);
+}
+
+TEST_F(StateCompressionTest, CorruptedStateIsRejected)
+{
+  const std::vector<u8> state = MakeWiiLikeState(0x345678);
+  Common::ThreadPool thread_pool(2);
+  ASSERT_TRUE(Save(state, State::StateCompression::LZO, &thread_pool));
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(m_path, contents));
+  const size_t chunks_start = sizeof(State::CompressedStateHeader) + 4 * sizeof(u32);
+  for (size_t offset : {size_t(0), size_t(8), sizeof(State::CompressedStateHeader),
+                        chunks_start + 0x1000, contents.size() - 1})
+  {
+    SCOPED_TRACE(offset);
+    std::string corrupted = contents;
+    corrupted[offset] ^= 0x55;
+    ASSERT_TRUE(File::WriteStringToFile(corrupted, m_path));
+    std::vector<u8> loaded;
+    EXPECT_FALSE(Load(&loaded, &thread_pool) && loaded == state);
+  }
+
+  ASSERT_TRUE(File::WriteStringToFile(contents.substr(0, contents.size() - 1), m_path));
+  std::vector<u8> loaded;
+  EXPECT_FALSE(Load(&loaded, &thread_pool));
+}
+
+// Measures saving and loading a state of the size of a typical Wii state, with the chunks being
+// processed on one thread and on all hardware threads.
+TEST_F(StateCompressionTest, DISABLED_Benchmark)
+{
+  const std::vector<u8> state = MakeWiiLikeState();
+  const auto ms = [](auto duration) {
+    return static_cast<long long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+  };
+
+  for (unsigned int num_threads : {1u, 0u})
+  {
+    Common::ThreadPool thread_pool(num_threads);
+    for (State::StateCompression compression :
+         {State::StateCompression::None, State::StateCompression::LZO,
+          State::StateCompression::Zstd})
+    {
+      if (!State::IsStateCompressionSupported(compression))
+        continue;
+
+      const auto start = std::chrono::steady_clock::now();
+      ASSERT_TRUE(Save(state, compression, &thread_pool));
+      const auto saved = std::chrono::steady_clock::now();
+      std::vector<u8> loaded;
+      ASSERT_TRUE(Load(&loaded, &thread_pool));
+      const auto done = std::chrono::steady_clock::now();
+
+      static const char* const NAMES[] = {"None", "LZO", "zstd"};
+      std::printf("%s, %zu threads: %zu KiB -> %llu KiB, saved in %lld ms, loaded in %lld ms\n",
+                  NAMES[static_cast<int>(compression)], thread_pool.GetThreadCount(),
+                  state.size() / 1024,
+                  static_cast<unsigned long long>(File::GetSize(m_path) / 1024),
+                  ms(saved - start), ms(done - saved));
+    }
+  }
+}
@@ -0,0 +1,168 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "DiscIO/Blob.h"
+
+namespace
+{
+constexpr int BLOCK_SIZE = 0x4000;
+
+bool IgnoreProgress(const std::string&, float, void*)
+{
+  return true;
+}
+
+class CompressedBlobTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    m_iso_path = m_temp_dir + "/test.iso";
+    m_gcz_path = m_temp_dir + "/test.gcz";
+  }
+
+  void TearDown() override { File::DeleteDirRecursively(m_temp_dir); }
+
+  // Mixes compressible and incompressible blocks, and ends with a partial block.
+  void WriteTestImage(size_t size)
+  {
+    m_data.resize(size);
+    std::mt19937 rng(1234);
+    for (size_t i = 0; i < size; i++)
+      m_data[i] = (i / BLOCK_SIZE) % 3 == 0 ? static_cast<u8>(rng()) : static_cast<u8>(i >> 6);
+
+    File::IOFile file(m_iso_path, "wb");
+    ASSERT_TRUE(file.WriteBytes(m_data.data(), m_data.size()));
+  }
+
+  std::vector<u8> ReadFile(const std::string& path)
+  {
+    File::IOFile file(path, "rb");
+    std::vector<u8> data(file.GetSize());
+    file.ReadBytes(data.data(), data.size());
+    return data;
+  }
+
+  std::string m_temp_dir;
+  std::string m_iso_path;
+  std::string m_gcz_path;
+  std::vector<u8> m_data;
+};
+}  // namespace
+
+TEST_F(CompressedBlobTest, RoundTrip)
+{
+  WriteTestImage(40 * BLOCK_SIZE + 123);
+  ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                         nullptr, 4));
+
+  const std::string decompressed_path = m_temp_dir + "/decompressed.iso";
+  ASSERT_TRUE(DiscIO::DecompressBlobToFile(m_gcz_path, decompressed_path, IgnoreProgress));
+  EXPECT_EQ(m_data, ReadFile(decompressed_path));
+
+  // Unaligned reads which span several blocks.
+  std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_gcz_path);
+  ASSERT_NE(nullptr, reader);
+  std::vector<u8> buffer(5 * BLOCK_SIZE);
+  for (u64 offset : {u64{0}, u64{BLOCK_SIZE - 7}, u64{17 * BLOCK_SIZE + 5}, u64{35 * BLOCK_SIZE}})
+  {
+    ASSERT_TRUE(reader->Read(offset, buffer.size(), buffer.data()));
+    EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(), m_data.begin() + offset));
+  }
+}
+
+TEST_F(CompressedBlobTest, ReadsPastTheEndFail)
+{
+  WriteTestImage(40 * BLOCK_SIZE + 123);
+  ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                         nullptr, 4));
+  std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_gcz_path);
+  ASSERT_NE(nullptr, reader);
+  const u64 size = reader->GetDataSize();
+  ASSERT_EQ(m_data.size(), size);
+
+  std::vector<u8> buffer(2 * BLOCK_SIZE);
+  ASSERT_TRUE(reader->Read(size - 100, 100, buffer.data()));
+  EXPECT_TRUE(std::equal(buffer.begin(), buffer.begin() + 100, m_data.end() - 100));
+
+  EXPECT_FALSE(reader->Read(size - 100, 101, buffer.data()));
+  EXPECT_FALSE(reader->Read(size + 1, 1, buffer.data()));
+  EXPECT_FALSE(reader->Read(42 * BLOCK_SIZE, buffer.size(), buffer.data()));
+  EXPECT_FALSE(reader->Read(0, ~u64{0}, buffer.data()));
+}
+
+TEST_F(CompressedBlobTest, OutputDoesNotDependOnThreadCount)
+{
+  WriteTestImage(100 * BLOCK_SIZE);
+  ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                         nullptr, 1));
+  const std::vector<u8> single_threaded = ReadFile(m_gcz_path);
+
+  ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                         nullptr, 3));
+  EXPECT_EQ(single_threaded, ReadFile(m_gcz_path));
+}
+
+// Compares the single threaded compressor (which is what the old code did) with using all
+// threads. Run with --gtest_also_run_disabled_tests.
+TEST_F(CompressedBlobTest, DISABLED_Throughput)
+{
+  WriteTestImage(256 * 1024 * 1024);
+
+  const double megabytes = m_data.size() / (1024.0 * 1024.0);
+  for (unsigned int threads : {1u, 0u})
+  {
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                           nullptr, threads));
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    std::printf("Compression (%s): %.1f MiB/s\n", threads == 1 ? "1 thread" : "all threads",
+                megabytes / time.count());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(DiscIO::DecompressBlobToFile(m_gcz_path, m_temp_dir + "/out.iso", IgnoreProgress));
+  const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+  std::printf("Decompression: %.1f MiB/s\n", megabytes / time.count());
+}
+
+// Reads a compressed image through BlobReader::Read in DVD-sized and in large requests, which
+// is what the read-ahead and the parallel decompression are for. Run with
+// --gtest_also_run_disabled_tests.
+TEST_F(CompressedBlobTest, DISABLED_ReadThroughput)
+{
+  WriteTestImage(256 * 1024 * 1024);
+  ASSERT_TRUE(DiscIO::CompressFileToBlob(m_iso_path, m_gcz_path, 0, BLOCK_SIZE, IgnoreProgress,
+                                         nullptr, 0));
+
+  const double megabytes = m_data.size() / (1024.0 * 1024.0);
+  for (size_t request_size : {size_t{0x8000}, size_t{0x200000}})
+  {
+    std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_gcz_path);
+    ASSERT_NE(nullptr, reader);
+    std::vector<u8> buffer(request_size);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (u64 offset = 0; offset < m_data.size(); offset += request_size)
+    {
+      const u64 size = std::min<u64>(request_size, m_data.size() - offset);
+      ASSERT_TRUE(reader->Read(offset, size, buffer.data()));
+    }
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    std::printf("Reads of 0x%zx bytes: %.1f MiB/s\n", request_size, megabytes / time.count());
+  }
+}
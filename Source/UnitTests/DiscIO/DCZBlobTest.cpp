@@ -0,0 +1,250 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <gtest/gtest.h>
+#include <mbedtls/aes.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/Swap.h"
+#include "Core/IOS/ES/Formats.h"
+#include "DiscIO/Blob.h"
+#include "DiscIO/DCZBlob.h"
+#include "DiscIO/VolumeWii.h"
+
+namespace
+{
+constexpr u32 HEADER_SIZE = DiscIO::VolumeWii::BLOCK_HEADER_SIZE;
+constexpr u32 DATA_SIZE = DiscIO::VolumeWii::BLOCK_DATA_SIZE;
+constexpr u32 TOTAL_SIZE = DiscIO::VolumeWii::BLOCK_TOTAL_SIZE;
+constexpr u32 BLOCKS_PER_GROUP = 64;
+
+constexpr u64 PARTITION_OFFSET = 0x50000;
+constexpr u64 PARTITION_DATA_OFFSET = 0x20000;
+// A full group followed by a partial one
+constexpr u32 NUM_BLOCKS = BLOCKS_PER_GROUP + 10;
+constexpr u64 TRAILER_SIZE = 0x12345;
+
+bool IgnoreProgress(const std::string&, float, void*)
+{
+  return true;
+}
+
+void WriteU32(std::vector<u8>* data, u64 offset, u32 value)
+{
+  value = Common::swap32(value);
+  std::copy_n(reinterpret_cast<const u8*>(&value), sizeof(value), data->begin() + offset);
+}
+
+class DCZBlobTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    m_iso_path = m_temp_dir + "/test.iso";
+    m_dcz_path = m_temp_dir + "/test.dcz";
+  }
+
+  void TearDown() override { File::DeleteDirRecursively(m_temp_dir); }
+
+  // Builds an encrypted Wii disc with one partition. modify_hashes can tamper with the
+  // decrypted hash blocks before they are encrypted.
+  void WriteWiiImage(const std::function<void(u32 block, u8* hash_block)>& modify_hashes = {})
+  {
+    const u64 data_start = PARTITION_OFFSET + PARTITION_DATA_OFFSET;
+    m_data.assign(data_start + NUM_BLOCKS * TOTAL_SIZE + TRAILER_SIZE, 0);
+    std::mt19937 rng(1234);
+
+    WriteU32(&m_data, 0x18, 0x5D1C9EA3);
+    WriteU32(&m_data, 0x40000, 1);
+    WriteU32(&m_data, 0x40004, 0x40020 >> 2);
+    WriteU32(&m_data, 0x40020, PARTITION_OFFSET >> 2);
+    WriteU32(&m_data, 0x40024, 0);
+
+    std::vector<u8> ticket(sizeof(IOS::ES::Ticket));
+    WriteU32(&ticket, 0, 0x00010001);
+    for (size_t i = 0; i < 16; i++)
+      ticket[offsetof(IOS::ES::Ticket, title_key) + i] = static_cast<u8>(rng());
+    std::copy(ticket.begin(), ticket.end(), m_data.begin() + PARTITION_OFFSET);
+    WriteU32(&m_data, PARTITION_OFFSET + 0x2b8, PARTITION_DATA_OFFSET >> 2);
+    WriteU32(&m_data, PARTITION_OFFSET + 0x2bc, (NUM_BLOCKS * TOTAL_SIZE) >> 2);
+
+    // Partly compressible, partly random data
+    m_decrypted.resize(NUM_BLOCKS * DATA_SIZE);
+    for (size_t i = 0; i < m_decrypted.size(); i++)
+      m_decrypted[i] = (i / 0x1000) % 4 == 0 ? static_cast<u8>(rng()) : static_cast<u8>(i >> 8);
+
+    std::vector<u8> hash_blocks(NUM_BLOCKS * HEADER_SIZE);
+    for (u32 first = 0; first < NUM_BLOCKS; first += BLOCKS_PER_GROUP)
+    {
+      DiscIO::DCZFileReader::HashGroup(&m_decrypted[first * DATA_SIZE],
+                                       std::min(BLOCKS_PER_GROUP, NUM_BLOCKS - first),
+                                       &hash_blocks[first * HEADER_SIZE]);
+    }
+
+    const std::array<u8, 16> key = IOS::ES::TicketReader(std::move(ticket)).GetTitleKey();
+    mbedtls_aes_context aes_context;
+    mbedtls_aes_init(&aes_context);
+    mbedtls_aes_setkey_enc(&aes_context, key.data(), 128);
+    for (u32 i = 0; i < NUM_BLOCKS; i++)
+    {
+      u8* const hash_block = &hash_blocks[i * HEADER_SIZE];
+      if (modify_hashes)
+        modify_hashes(i, hash_block);
+
+      u8* const out = &m_data[data_start + i * TOTAL_SIZE];
+      u8 iv[16] = {};
+      mbedtls_aes_crypt_cbc(&aes_context, MBEDTLS_AES_ENCRYPT, HEADER_SIZE, iv, hash_block, out);
+      std::copy_n(out + 0x3D0, sizeof(iv), iv);
+      mbedtls_aes_crypt_cbc(&aes_context, MBEDTLS_AES_ENCRYPT, DATA_SIZE, iv,
+                            &m_decrypted[i * DATA_SIZE], out + HEADER_SIZE);
+    }
+    mbedtls_aes_free(&aes_context);
+
+    for (u64 i = m_data.size() - TRAILER_SIZE; i < m_data.size(); i++)
+      m_data[i] = static_cast<u8>(i / 0x100);
+
+    File::IOFile file(m_iso_path, "wb");
+    ASSERT_TRUE(file.WriteBytes(m_data.data(), m_data.size()));
+  }
+
+  void CheckDCZMatchesImage()
+  {
+    std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_dcz_path);
+    ASSERT_NE(nullptr, reader);
+    EXPECT_EQ(DiscIO::BlobType::DCZ, reader->GetBlobType());
+    ASSERT_EQ(m_data.size(), reader->GetDataSize());
+
+    std::vector<u8> buffer(m_data.size());
+    ASSERT_TRUE(reader->Read(0, buffer.size(), buffer.data()));
+    EXPECT_EQ(m_data, buffer);
+
+    // Unaligned reads which cross block, chunk and region boundaries.
+    const u64 data_start = PARTITION_OFFSET + PARTITION_DATA_OFFSET;
+    for (u64 offset : {u64(0x3ff), data_start - 5, data_start + 0x7fff,
+                       data_start + BLOCKS_PER_GROUP * TOTAL_SIZE - 0x123,
+                       data_start + NUM_BLOCKS * TOTAL_SIZE - 0x100})
+    {
+      ASSERT_TRUE(reader->Read(offset, 0x9000, buffer.data()));
+      EXPECT_TRUE(std::equal(buffer.begin(), buffer.begin() + 0x9000, m_data.begin() + offset));
+    }
+    EXPECT_FALSE(reader->Read(m_data.size() - 1, 2, buffer.data()));
+  }
+
+  std::string m_temp_dir;
+  std::string m_iso_path;
+  std::string m_dcz_path;
+  std::vector<u8> m_data;
+  std::vector<u8> m_decrypted;
+};
+}  // namespace
+
+TEST_F(DCZBlobTest, RoundTrip)
+{
+  WriteWiiImage();
+
+  for (DiscIO::DCZCompression compression :
+       {DiscIO::DCZCompression::None, DiscIO::DCZCompression::Zlib, DiscIO::DCZCompression::LZMA,
+        DiscIO::DCZCompression::Zstd})
+  {
+    if (!DiscIO::IsDCZCompressionSupported(compression))
+      continue;
+
+    SCOPED_TRACE(static_cast<int>(compression));
+    ASSERT_TRUE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, compression, 6, 0x200000,
+                                     IgnoreProgress, nullptr, 2));
+    CheckDCZMatchesImage();
+  }
+}
+
+TEST_F(DCZBlobTest, ReadWiiDecrypted)
+{
+  WriteWiiImage();
+  ASSERT_TRUE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, DiscIO::DCZCompression::Zlib, 6));
+
+  std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_dcz_path);
+  ASSERT_NE(nullptr, reader);
+  ASSERT_TRUE(reader->SupportsReadWiiDecrypted());
+
+  std::vector<u8> buffer(m_decrypted.size());
+  ASSERT_TRUE(reader->ReadWiiDecrypted(0, buffer.size(), buffer.data(), PARTITION_OFFSET));
+  EXPECT_EQ(m_decrypted, buffer);
+
+  const u64 offset = BLOCKS_PER_GROUP * DATA_SIZE - 0x10;
+  ASSERT_TRUE(reader->ReadWiiDecrypted(offset, 0x20, buffer.data(), PARTITION_OFFSET));
+  EXPECT_TRUE(std::equal(buffer.begin(), buffer.begin() + 0x20, m_decrypted.begin() + offset));
+
+  EXPECT_FALSE(reader->ReadWiiDecrypted(m_decrypted.size() - 1, 2, buffer.data(),
+                                        PARTITION_OFFSET));
+  EXPECT_FALSE(reader->ReadWiiDecrypted(0, 1, buffer.data(), PARTITION_OFFSET + 0x8000));
+}
+
+TEST_F(DCZBlobTest, HashExceptions)
+{
+  // Real discs have hashes which don't match their data, and non-zero padding.
+  WriteWiiImage([](u32 block, u8* hash_block) {
+    if (block == 3)
+      hash_block[0x10] ^= 0xff;
+    if (block % 9 == 0)
+      std::fill(hash_block + 0x3e0, hash_block + HEADER_SIZE, static_cast<u8>(block));
+    if (block == NUM_BLOCKS - 1)
+      hash_block[0x26C] = 1;
+  });
+
+  ASSERT_TRUE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, DiscIO::DCZCompression::Zlib, 6));
+  CheckDCZMatchesImage();
+}
+
+TEST_F(DCZBlobTest, NonWiiImage)
+{
+  m_data.resize(0x345678);
+  std::mt19937 rng(42);
+  for (size_t i = 0; i < m_data.size(); i++)
+    m_data[i] = i % 3 ? static_cast<u8>(i >> 4) : static_cast<u8>(rng());
+  {
+    File::IOFile file(m_iso_path, "wb");
+    ASSERT_TRUE(file.WriteBytes(m_data.data(), m_data.size()));
+  }
+
+  ASSERT_TRUE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, DiscIO::DCZCompression::Zlib, 6));
+  std::unique_ptr<DiscIO::BlobReader> reader = DiscIO::CreateBlobReader(m_dcz_path);
+  ASSERT_NE(nullptr, reader);
+  EXPECT_FALSE(reader->SupportsReadWiiDecrypted());
+
+  std::vector<u8> buffer(m_data.size());
+  ASSERT_TRUE(reader->Read(0, buffer.size(), buffer.data()));
+  EXPECT_EQ(m_data, buffer);
+}
+
+TEST_F(DCZBlobTest, ChunkSizeIsLimited)
+{
+  m_data.resize(0x345678);
+  {
+    File::IOFile file(m_iso_path, "wb");
+    ASSERT_TRUE(file.WriteBytes(m_data.data(), m_data.size()));
+  }
+
+  EXPECT_FALSE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, DiscIO::DCZCompression::Zlib, 6,
+                                    DiscIO::DCZ_MAX_CHUNK_SIZE + DiscIO::DCZ_GROUP_SIZE));
+
+  // A chunk size of 2 GiB would make the hash exception block numbers overflow
+  ASSERT_TRUE(DiscIO::ConvertToDCZ(m_iso_path, m_dcz_path, DiscIO::DCZCompression::Zlib, 6));
+  {
+    File::IOFile file(m_dcz_path, "r+b");
+    const u32 chunk_size = 0x80000000;
+    ASSERT_TRUE(file.Seek(offsetof(DiscIO::DCZHeader, chunk_size), SEEK_SET));
+    ASSERT_TRUE(file.WriteBytes(&chunk_size, sizeof(chunk_size)));
+  }
+  EXPECT_EQ(nullptr, DiscIO::CreateBlobReader(m_dcz_path));
+}
@@ -0,0 +1,322 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
+#include "Common/Swap.h"
+#include "Core/ConfigLoaders/BaseConfigLoader.h"
+#include "Core/ConfigManager.h"
+#include "UICommon/GameFile.h"
+#include "UICommon/GameFileCache.h"
+#include "UICommon/UICommon.h"
+
+namespace
+{
+// Writes a GameCube disc image that only has a disc header.
+void WriteFakeImage(const std::string& path, u32 index, u64 size = 0x10000)
+{
+  std::vector<u8> data(size);
+  const std::string game_id = StringFromFormat("G%03X01", index % 0x1000);
+  std::copy(game_id.begin(), game_id.end(), data.begin());
+  const std::string name = StringFromFormat("Fake game %u", index);
+  std::copy(name.begin(), name.end(), data.begin() + 0x20);
+  const u32 magic = Common::swap32(0xC2339F3D);
+  std::copy_n(reinterpret_cast<const u8*>(&magic), sizeof(magic), data.begin() + 0x1C);
+
+  File::IOFile file(path, "wb");
+  file.WriteBytes(data.data(), data.size());
+}
+
+class GameFileCacheTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_temp_dir = File::CreateTempDir();
+    // AddOrGet and UpdateAdditionalMetadata look at the cover settings
+    UICommon::SetUserDirectory(m_temp_dir + "/User");
+    Config::Init();
+    Config::AddLayer(ConfigLoaders::GenerateBaseConfigLoader());
+    SConfig::Init();
+  }
+
+  void TearDown() override
+  {
+    SConfig::Shutdown();
+    Config::Shutdown();
+    File::DeleteDirRecursively(m_temp_dir);
+  }
+
+  std::vector<std::string> WriteFakeImages(u32 count)
+  {
+    std::vector<std::string> paths;
+    for (u32 i = 0; i < count; i++)
+    {
+      paths.push_back(StringFromFormat("%s/game%u.iso", m_temp_dir.c_str(), i));
+      WriteFakeImage(paths.back(), i);
+    }
+    return paths;
+  }
+
+  struct UpdateResult
+  {
+    bool changed;
+    std::multiset<std::string> added;
+    std::multiset<std::string> removed;
+  };
+
+  UpdateResult Update(UICommon::GameFileCache* cache, const std::vector<std::string>& paths,
+                      unsigned int num_threads = 0)
+  {
+    UpdateResult result;
+    std::mutex lock;
+    result.changed = cache->Update(
+        paths,
+        [&](const std::shared_ptr<const UICommon::GameFile>& game) {
+          // Callbacks must never run concurrently, so this lock should never be contended
+          EXPECT_TRUE(lock.try_lock());
+          result.added.insert(game->GetFilePath());
+          lock.unlock();
+        },
+        [&](const std::string& path) { result.removed.insert(path); }, num_threads);
+    return result;
+  }
+
+  std::string m_temp_dir;
+};
+}  // namespace
+
+TEST_F(GameFileCacheTest, AddsValidFiles)
+{
+  std::vector<std::string> paths = WriteFakeImages(50);
+  const std::string invalid_path = m_temp_dir + "/invalid.iso";
+  File::WriteStringToFile("This is not a disc image", invalid_path);
+  paths.push_back(invalid_path);
+
+  UICommon::GameFileCache cache(m_temp_dir + "/gamelist.cache");
+  const UpdateResult result = Update(&cache, paths, 4);
+  EXPECT_TRUE(result.changed);
+  EXPECT_EQ(std::multiset<std::string>(paths.begin(), paths.end() - 1), result.added);
+  EXPECT_TRUE(result.removed.empty());
+  EXPECT_EQ(50u, cache.GetSize());
+
+  std::set<std::string> game_ids;
+  cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& game) {
+    game_ids.insert(game->GetGameID());
+  });
+  EXPECT_EQ(50u, game_ids.size());
+}
+
+TEST_F(GameFileCacheTest, OnlyRescansChangedFiles)
+{
+  std::vector<std::string> paths = WriteFakeImages(20);
+  UICommon::GameFileCache cache(m_temp_dir + "/gamelist.cache");
+  Update(&cache, paths);
+
+  // Nothing has changed
+  UpdateResult result = Update(&cache, paths);
+  EXPECT_FALSE(result.changed);
+  EXPECT_TRUE(result.added.empty());
+  EXPECT_TRUE(result.removed.empty());
+
+  // The fingerprints survive saving and loading the cache
+  ASSERT_TRUE(cache.Save());
+  UICommon::GameFileCache loaded_cache(m_temp_dir + "/gamelist.cache");
+  ASSERT_TRUE(loaded_cache.Load());
+  EXPECT_FALSE(Update(&loaded_cache, paths).changed);
+
+  // A modified file is scanned again, a removed one is removed
+  WriteFakeImage(paths[3], 1000, 0x20000);
+  const std::string removed_path = paths.back();
+  paths.pop_back();
+  result = Update(&loaded_cache, paths);
+  EXPECT_TRUE(result.changed);
+  EXPECT_EQ(std::multiset<std::string>{paths[3]}, result.added);
+  EXPECT_EQ((std::multiset<std::string>{paths[3], removed_path}), result.removed);
+  EXPECT_EQ(19u, loaded_cache.GetSize());
+
+  bool found = false;
+  loaded_cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& game) {
+    if (game->GetFilePath() == paths[3])
+    {
+      found = true;
+      EXPECT_EQ("G3E801", game->GetGameID());
+    }
+  });
+  EXPECT_TRUE(found);
+}
+
+TEST_F(GameFileCacheTest, LoadedGamesAreReadOnDemand)
+{
+  const std::vector<std::string> paths = WriteFakeImages(10);
+  const std::string cache_path = m_temp_dir + "/gamelist.cache";
+  {
+    UICommon::GameFileCache cache(cache_path);
+    Update(&cache, paths);
+    ASSERT_TRUE(cache.Save());
+  }
+
+  // Saving over the mapped cache file copies the games that are still only in the old file, and
+  // they can still be read from the new one afterwards
+  {
+    UICommon::GameFileCache cache(cache_path);
+    ASSERT_TRUE(cache.Load());
+    EXPECT_EQ(10u, cache.GetSize());
+    bool cache_changed = false;
+    ASSERT_NE(nullptr, cache.AddOrGet(paths[2], &cache_changed));
+    EXPECT_FALSE(cache.UpdateAdditionalMetadata());
+    ASSERT_TRUE(cache.Save());
+    EXPECT_FALSE(File::Exists(cache_path + ".tmp"));
+    EXPECT_EQ(10u, cache.GetSize());
+
+    std::set<std::string> game_ids;
+    cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& loaded_game) {
+      game_ids.insert(loaded_game->GetGameID());
+    });
+    EXPECT_EQ(10u, game_ids.size());
+    ASSERT_TRUE(cache.Save());
+  }
+
+  UICommon::GameFileCache cache(cache_path);
+  ASSERT_TRUE(cache.Load());
+  bool cache_changed = false;
+  const std::shared_ptr<const UICommon::GameFile> game = cache.AddOrGet(paths[5], &cache_changed);
+  ASSERT_NE(nullptr, game);
+  EXPECT_FALSE(cache_changed);
+  EXPECT_EQ("G00501", game->GetGameID());
+  EXPECT_EQ(10u, cache.GetSize());
+
+  std::set<std::string> game_ids;
+  cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& loaded_game) {
+    game_ids.insert(loaded_game->GetGameID());
+  });
+  EXPECT_EQ(10u, game_ids.size());
+  EXPECT_FALSE(Update(&cache, paths).changed);
+}
+
+TEST_F(GameFileCacheTest, CorruptedCacheIsDeleted)
+{
+  const std::vector<std::string> paths = WriteFakeImages(3);
+  const std::string cache_path = m_temp_dir + "/gamelist.cache";
+  UICommon::GameFileCache cache(cache_path);
+  Update(&cache, paths);
+  ASSERT_TRUE(cache.Save());
+
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(cache_path, contents));
+  for (size_t size : {size_t(0), size_t(20), contents.size() / 2, contents.size() - 1})
+  {
+    SCOPED_TRACE(size);
+    File::WriteStringToFile(contents.substr(0, size), cache_path);
+    UICommon::GameFileCache loaded_cache(cache_path);
+    EXPECT_FALSE(loaded_cache.Load());
+    EXPECT_FALSE(File::Exists(cache_path));
+    EXPECT_EQ(0u, loaded_cache.GetSize());
+  }
+
+  // A corrupted record only makes that game get scanned again
+  std::string corrupted = contents;
+  const size_t name_offset = corrupted.rfind(paths[1]);
+  ASSERT_NE(std::string::npos, name_offset);
+  corrupted[name_offset + paths[1].size() - 1] = 'x';
+  File::WriteStringToFile(corrupted, cache_path);
+  UICommon::GameFileCache loaded_cache(cache_path);
+  ASSERT_TRUE(loaded_cache.Load());
+  const UpdateResult result = Update(&loaded_cache, paths);
+  EXPECT_FALSE(result.changed);
+  std::set<std::string> loaded_paths;
+  loaded_cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& game) {
+    loaded_paths.insert(game->GetFilePath());
+  });
+  EXPECT_EQ(2u, loaded_paths.size());
+  EXPECT_TRUE(Update(&loaded_cache, paths).changed);
+  EXPECT_EQ(3u, loaded_cache.GetSize());
+}
+
+TEST_F(GameFileCacheTest, RecordsAreBoundsChecked)
+{
+  const std::vector<std::string> paths = WriteFakeImages(3);
+  const std::string cache_path = m_temp_dir + "/gamelist.cache";
+  UICommon::GameFileCache cache(cache_path);
+  Update(&cache, paths);
+  ASSERT_TRUE(cache.Save());
+
+  // The length of the path in the record of the second game is made to reach past its record
+  std::string contents;
+  ASSERT_TRUE(File::ReadFileToString(cache_path, contents));
+  const size_t name_offset = contents.rfind(paths[1]);
+  ASSERT_NE(std::string::npos, name_offset);
+  for (u32 length : {u32(0x7FFFFFFF), static_cast<u32>(paths[1].size() + 0x100)})
+  {
+    SCOPED_TRACE(length);
+    std::string corrupted = contents;
+    std::memcpy(&corrupted[name_offset - sizeof(length)], &length, sizeof(length));
+    File::WriteStringToFile(corrupted, cache_path);
+
+    UICommon::GameFileCache loaded_cache(cache_path);
+    ASSERT_TRUE(loaded_cache.Load());
+    bool cache_changed = false;
+    EXPECT_NE(nullptr, loaded_cache.AddOrGet(paths[1], &cache_changed));
+    EXPECT_TRUE(cache_changed);
+
+    std::set<std::string> loaded_paths;
+    loaded_cache.ForEach([&](const std::shared_ptr<const UICommon::GameFile>& game) {
+      loaded_paths.insert(game->GetFilePath());
+    });
+    EXPECT_EQ(std::set<std::string>(paths.begin(), paths.end()), loaded_paths);
+  }
+}
+
+// Compares scanning a directory of fake images on one thread and on all hardware threads, and
+// measures loading the cache of the scanned images. Real images take far longer to scan than
+// these, since banners have to be read and decoded.
+TEST_F(GameFileCacheTest, DISABLED_Benchmark)
+{
+  const std::vector<std::string> paths = WriteFakeImages(2000);
+  const auto ms = [](auto duration) {
+    return static_cast<long long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+  };
+
+  for (unsigned int num_threads : {1u, 0u})
+  {
+    UICommon::GameFileCache cache(m_temp_dir + "/gamelist.cache");
+    const auto start = std::chrono::steady_clock::now();
+    Update(&cache, paths, num_threads);
+    const auto scanned = std::chrono::steady_clock::now();
+    Update(&cache, paths, num_threads);
+    const auto rescanned = std::chrono::steady_clock::now();
+
+    std::printf("%s: scanned %zu files in %lld ms, checked them again in %lld ms\n",
+                num_threads == 1 ? "1 thread" : "All threads", cache.GetSize(),
+                ms(scanned - start), ms(rescanned - scanned));
+    ASSERT_TRUE(cache.Save());
+  }
+
+  UICommon::GameFileCache cache(m_temp_dir + "/gamelist.cache");
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(cache.Load());
+  const auto loaded = std::chrono::steady_clock::now();
+  Update(&cache, paths);
+  const auto checked = std::chrono::steady_clock::now();
+  cache.ForEach([](const std::shared_ptr<const UICommon::GameFile>&) {});
+  const auto read = std::chrono::steady_clock::now();
+  std::printf("Loaded the index of %zu files in %lld ms, checked them in %lld ms, "
+              "read all of them in %lld ms\n",
+              cache.GetSize(), ms(loaded - start), ms(checked - loaded), ms(read - checked));
+}
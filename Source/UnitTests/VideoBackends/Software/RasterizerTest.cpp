@@ -0,0 +1,144 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CommonTypes.h"
+#include "VideoBackends/Software/EfbInterface.h"
+#include "VideoBackends/Software/NativeVertexFormat.h"
+#include "VideoBackends/Software/Rasterizer.h"
+#include "VideoCommon/BPMemory.h"
+#include "VideoCommon/PixelShaderManager.h"
+#include "VideoCommon/VideoCommon.h"
+#include "VideoCommon/VideoConfig.h"
+
+namespace
+{
+constexpr size_t EFB_SIZE = EFB_WIDTH * EFB_HEIGHT * 6;
+
+class RasterizerTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    std::memset(&bpmem, 0, sizeof(bpmem));
+    std::memset(&PixelShaderManager::constants, 0, sizeof(PixelShaderManager::constants));
+
+    // The scissor rectangle covers the whole EFB
+    bpmem.scissorOffset.x = 171;
+    bpmem.scissorOffset.y = 171;
+    bpmem.scissorTL.x = 342;
+    bpmem.scissorTL.y = 342;
+    bpmem.scissorBR.x = 341 + EFB_WIDTH;
+    bpmem.scissorBR.y = 341 + EFB_HEIGHT;
+
+    // One TEV stage which outputs the rasterized color
+    bpmem.genMode.numcolchans = 1;
+    bpmem.tevorders[0].colorchan0 = 0;
+    bpmem.tevksel[0].swap1 = 0;
+    bpmem.tevksel[0].swap2 = 1;
+    bpmem.tevksel[1].swap1 = 2;
+    bpmem.tevksel[1].swap2 = 3;
+    bpmem.combiners[0].colorC.a = TEVCOLORARG_ZERO;
+    bpmem.combiners[0].colorC.b = TEVCOLORARG_ZERO;
+    bpmem.combiners[0].colorC.c = TEVCOLORARG_ZERO;
+    bpmem.combiners[0].colorC.d = TEVCOLORARG_RASC;
+    bpmem.combiners[0].alphaC.a = TEVALPHAARG_ZERO;
+    bpmem.combiners[0].alphaC.b = TEVALPHAARG_ZERO;
+    bpmem.combiners[0].alphaC.c = TEVALPHAARG_ZERO;
+    bpmem.combiners[0].alphaC.d = TEVALPHAARG_RASA;
+    bpmem.alpha_test.comp0 = AlphaTest::ALWAYS;
+    bpmem.alpha_test.comp1 = AlphaTest::ALWAYS;
+
+    // Blending and depth testing read the EFB, so every pixel is read, modified and written
+    bpmem.zmode.testenable = 1;
+    bpmem.zmode.func = ZMode::LEQUAL;
+    bpmem.zmode.updateenable = 1;
+    bpmem.blendmode.blendenable = 1;
+    bpmem.blendmode.colorupdate = 1;
+    bpmem.blendmode.alphaupdate = 1;
+    bpmem.blendmode.srcfactor = BlendMode::SRCALPHA;
+    bpmem.blendmode.dstfactor = BlendMode::INVSRCALPHA;
+  }
+
+  // Triangles with random colors and depths, many of which cross tile borders
+  static std::vector<OutputVertexData> RandomTriangles(std::mt19937& rng, size_t count)
+  {
+    std::vector<OutputVertexData> vertices(count * 3);
+    for (size_t i = 0; i < vertices.size(); i += 3)
+    {
+      const float x = static_cast<float>(rng() % EFB_WIDTH);
+      const float y = static_cast<float>(rng() % EFB_HEIGHT);
+      for (size_t j = i; j < i + 3; j++)
+      {
+        OutputVertexData& vertex = vertices[j];
+        vertex.screenPosition.x = x + static_cast<float>(rng() % 161) - 80.0f;
+        vertex.screenPosition.y = y + static_cast<float>(rng() % 161) - 80.0f;
+        vertex.screenPosition.z = static_cast<float>(rng() & 0xFFFFFF);
+        vertex.projectedPosition.w = 1.0f;
+        for (u8& comp : vertex.color[0])
+          comp = static_cast<u8>(rng());
+      }
+
+      // Only front faces are drawn, so all triangles need the same winding
+      const Vec3& a = vertices[i].screenPosition;
+      const Vec3& b = vertices[i + 1].screenPosition;
+      const Vec3& c = vertices[i + 2].screenPosition;
+      if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0)
+        std::swap(vertices[i + 1], vertices[i + 2]);
+    }
+    return vertices;
+  }
+
+  // Draws the triangles on an EFB that is cleared to black and the furthest depth, and returns the
+  // resulting EFB contents.
+  static std::vector<u8> Draw(const std::vector<OutputVertexData>& vertices, int num_threads)
+  {
+    u8* const efb = EfbInterface::GetPixelPointer(0, 0, false);
+    std::memset(efb, 0, EFB_SIZE / 2);
+    std::memset(EfbInterface::GetPixelPointer(0, 0, true), 0xFF, EFB_SIZE / 2);
+
+    g_ActiveConfig.iSWRasterizerThreads = num_threads;
+    Rasterizer::Init();
+    for (size_t i = 0; i < vertices.size(); i += 3)
+      Rasterizer::DrawTriangleFrontFace(&vertices[i], &vertices[i + 1], &vertices[i + 2]);
+    Rasterizer::Flush();
+    Rasterizer::Shutdown();
+
+    return std::vector<u8>(efb, efb + EFB_SIZE);
+  }
+};
+}  // namespace
+
+TEST_F(RasterizerTest, ThreadsMatchSingleThread)
+{
+  std::mt19937 rng(1234);
+  for (PEControl::PixelFormat format : {PEControl::RGB8_Z24, PEControl::RGBA6_Z24})
+  {
+    SCOPED_TRACE(static_cast<int>(format));
+    bpmem.zcontrol.pixel_format = format;
+
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+      const std::vector<OutputVertexData> vertices = RandomTriangles(rng, 2000);
+      const std::vector<u8> expected = Draw(vertices, 1);
+      // Otherwise nothing was drawn
+      ASSERT_TRUE(std::any_of(expected.begin(), expected.begin() + EFB_SIZE / 2,
+                              [](u8 byte) { return byte != 0; }));
+
+      const std::vector<u8> actual = Draw(vertices, 4);
+      // Report the first difference instead of dumping the whole EFB
+      const auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin());
+      EXPECT_TRUE(mismatch.first == expected.end())
+          << "iteration " << iteration << ", first difference at byte "
+          << (mismatch.first - expected.begin());
+    }
+  }
+}
@@ -0,0 +1,166 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CommonTypes.h"
+#include "VideoBackends/Software/Tev.h"
+#include "VideoCommon/BPMemory.h"
+#include "VideoCommon/PixelShaderManager.h"
+#include "VideoCommon/VideoCommon.h"
+
+class TevTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    std::memset(&bpmem, 0, sizeof(bpmem));
+    std::memset(&PixelShaderManager::constants, 0, sizeof(PixelShaderManager::constants));
+
+    for (std::unique_ptr<Tev>& tev : m_tevs)
+    {
+      tev = std::make_unique<Tev>();
+      tev->Init();
+    }
+  }
+
+  void TearDown() override { Tev::ClearProgramCache(); }
+
+  // Random TEV state, except for the parts which need textures or the EFB
+  void RandomizeState()
+  {
+    bpmem.genMode.numtevstages = m_rng() % 16;
+    bpmem.alpha_test.hex = m_rng() & 0xFFFFFF;
+
+    for (TevStageCombiner& combiner : bpmem.combiners)
+    {
+      combiner.colorC.hex = m_rng() & 0xFFFFFF;
+      combiner.alphaC.hex = m_rng() & 0xFFFFFF;
+    }
+
+    // Indirect texturing is only enabled for some stages, as stages without it take a shortcut
+    for (TevStageIndirect& indirect : bpmem.tevind)
+      indirect.hex = m_rng() % 2 ? m_rng() : 0;
+    for (IND_MTX& matrix : bpmem.indmtx)
+    {
+      matrix.col0.hex = m_rng() & 0xFFFFFF;
+      matrix.col1.hex = m_rng() & 0xFFFFFF;
+      matrix.col2.hex = m_rng() & 0xFFFFFF;
+    }
+
+    for (TwoTevStageOrders& order : bpmem.tevorders)
+    {
+      order.hex = m_rng() & 0xFFFFFF;
+      order.enable0 = 0;
+      order.enable1 = 0;
+    }
+
+    // Konst alpha selections 12 to 15 don't exist
+    for (TevKSel& ksel : bpmem.tevksel)
+    {
+      ksel.hex = m_rng() & 0xFFFFFF;
+      if (ksel.kasel0 >= 12 && ksel.kasel0 < 16)
+        ksel.kasel0 = 0;
+      if (ksel.kasel1 >= 12 && ksel.kasel1 < 16)
+        ksel.kasel1 = 0;
+    }
+
+    for (int reg = 0; reg < 4; reg++)
+    {
+      for (int comp = 0; comp < 4; comp++)
+      {
+        PixelShaderManager::constants.colors[reg][comp] = static_cast<s32>(m_rng() % 2048) - 1024;
+
+        const s16 konst = static_cast<s16>(m_rng() % 2048) - 1024;
+        for (std::unique_ptr<Tev>& tev : m_tevs)
+          tev->SetRegColor(reg, comp, konst);
+      }
+    }
+  }
+
+  void RandomizePixel()
+  {
+    const s32 x = m_rng() % EFB_WIDTH;
+    const s32 y = m_rng() % EFB_HEIGHT;
+    const s32 z = m_rng() & 0xFFFFFF;
+    u8 color[2][4];
+    for (auto& channel : color)
+    {
+      for (u8& comp : channel)
+        comp = static_cast<u8>(m_rng());
+    }
+    s32 uv[8][2];
+    for (auto& coord : uv)
+    {
+      coord[0] = m_rng();
+      coord[1] = m_rng();
+    }
+
+    for (std::unique_ptr<Tev>& tev : m_tevs)
+    {
+      tev->Position[0] = x;
+      tev->Position[1] = y;
+      tev->Position[2] = z;
+      std::memcpy(tev->Color, color, sizeof(color));
+      for (int i = 0; i < 8; i++)
+      {
+        tev->Uv[i].s = uv[i][0];
+        tev->Uv[i].t = uv[i][1];
+      }
+    }
+  }
+
+  std::mt19937 m_rng{1234};
+  // The first instance interprets the BP registers and the second one uses programs
+  std::unique_ptr<Tev> m_tevs[2];
+};
+
+TEST_F(TevTest, ProgramMatchesInterpreter)
+{
+  Tev& interpreter = *m_tevs[0];
+  Tev& specialized = *m_tevs[1];
+
+  for (int state = 0; state < 2000; state++)
+  {
+    RandomizeState();
+    specialized.SetProgram(Tev::GetProgram());
+
+    for (int pixel = 0; pixel < 20; pixel++)
+    {
+      RandomizePixel();
+      interpreter.Draw();
+      specialized.Draw();
+
+      for (int reg = 0; reg < 4; reg++)
+      {
+        for (int comp = 0; comp < 4; comp++)
+          ASSERT_EQ(interpreter.Reg[reg][comp], specialized.Reg[reg][comp]) << "state " << state;
+      }
+      // Pixels which pass the alpha test are counted
+      ASSERT_EQ(interpreter.counters.tevPixelsOut, specialized.counters.tevPixelsOut)
+          << "state " << state;
+    }
+  }
+}
+
+TEST_F(TevTest, ProgramCache)
+{
+  RandomizeState();
+  const Tev::Program* program = Tev::GetProgram();
+  EXPECT_EQ(program, Tev::GetProgram());
+
+  // Registers of unused stages don't matter
+  bpmem.genMode.numtevstages = 0;
+  const Tev::Program* single_stage_program = Tev::GetProgram();
+  EXPECT_NE(program, single_stage_program);
+  bpmem.combiners[1].colorC.hex ^= 1;
+  EXPECT_EQ(single_stage_program, Tev::GetProgram());
+
+  bpmem.combiners[0].colorC.hex ^= 1;
+  EXPECT_NE(single_stage_program, Tev::GetProgram());
+}
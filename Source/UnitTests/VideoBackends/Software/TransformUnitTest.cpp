@@ -0,0 +1,216 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CommonTypes.h"
+#include "VideoBackends/Software/NativeVertexFormat.h"
+#include "VideoBackends/Software/TransformUnit.h"
+#include "VideoBackends/Software/Vec3.h"
+#include "VideoCommon/BPMemory.h"
+#include "VideoCommon/XFMemory.h"
+
+using TransformUnit::VERTEX_BATCH_SIZE;
+
+class TransformUnitTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    std::memset(&bpmem, 0, sizeof(bpmem));
+    std::memset(&xfmem, 0, sizeof(xfmem));
+  }
+
+  // Mostly small values, with some zeroes to hit the special cases for zero vectors
+  float RandomFloat()
+  {
+    if (m_rng() % 16 == 0)
+      return 0.0f;
+    return std::uniform_real_distribution<float>(-2.0f, 2.0f)(m_rng);
+  }
+
+  Vec3 RandomVec3() { return Vec3(RandomFloat(), RandomFloat(), RandomFloat()); }
+
+  void RandomizeState(bool special_case)
+  {
+    for (float& value : xfmem.posMatrices)
+      value = RandomFloat();
+    for (float& value : xfmem.normalMatrices)
+      value = RandomFloat();
+    for (float& value : xfmem.postMatrices)
+      value = RandomFloat();
+    for (float& value : xfmem.projection.rawProjection)
+      value = RandomFloat();
+    xfmem.projection.type = m_rng() % 2 ? GX_PERSPECTIVE : GX_ORTHOGRAPHIC;
+
+    for (Light& light : xfmem.lights)
+    {
+      for (u8& component : light.color)
+        component = static_cast<u8>(m_rng());
+      for (int i = 0; i < 3; i++)
+      {
+        light.cosatt[i] = RandomFloat();
+        light.distatt[i] = RandomFloat();
+        light.dpos[i] = RandomFloat();
+        light.ddir[i] = RandomFloat();
+      }
+    }
+
+    for (u32 chan = 0; chan < NUM_XF_COLOR_CHANNELS; chan++)
+    {
+      xfmem.ambColor[chan] = m_rng();
+      xfmem.matColor[chan] = m_rng();
+
+      // Diffuse function 3 doesn't exist
+      xfmem.color[chan].hex = m_rng();
+      xfmem.color[chan].diffusefunc = m_rng() % 3;
+      xfmem.alpha[chan].hex = m_rng();
+      xfmem.alpha[chan].diffusefunc = m_rng() % 3;
+    }
+
+    xfmem.numTexGen.numTexGens = m_rng() % 9;
+    xfmem.dualTexTrans.enabled = m_rng() % 2;
+    for (u32 i = 0; i < 8; i++)
+    {
+      TexMtxInfo& texinfo = xfmem.texMtxInfo[i];
+      texinfo.hex = m_rng();
+      texinfo.texgentype = m_rng() % 4;
+      if (texinfo.texgentype == XF_TEXGEN_REGULAR)
+      {
+        // Every row except for the colors
+        static constexpr std::array<u32, 12> rows = {
+            {XF_SRCGEOM_INROW, XF_SRCNORMAL_INROW, XF_SRCBINORMAL_T_INROW, XF_SRCBINORMAL_B_INROW,
+             XF_SRCTEX0_INROW, XF_SRCTEX1_INROW, XF_SRCTEX2_INROW, XF_SRCTEX3_INROW,
+             XF_SRCTEX4_INROW, XF_SRCTEX5_INROW, XF_SRCTEX6_INROW, XF_SRCTEX7_INROW}};
+        texinfo.sourcerow = rows[m_rng() % rows.size()];
+      }
+      else if (texinfo.texgentype != XF_TEXGEN_EMBOSS_MAP)
+      {
+        texinfo.sourcerow = XF_SRCCOLORS_INROW;
+        texinfo.inputform = XF_TEXINPUT_AB11;
+      }
+
+      if (special_case)
+        texinfo.projection = XF_TEXPROJ_ST;
+
+      xfmem.postMtxInfo[i].hex = m_rng();
+      bpmem.texcoords[i].s.scale_minus_1 = m_rng() % 1024;
+      bpmem.texcoords[i].t.scale_minus_1 = m_rng() % 1024;
+    }
+  }
+
+  InputVertexData RandomVertex(bool same_matrices)
+  {
+    InputVertexData vertex;
+    vertex.posMtx = same_matrices ? 0 : m_rng() % 64;
+    for (u8& matrix : vertex.texMtx)
+      matrix = same_matrices ? 3 : m_rng() % 64;
+    vertex.position = RandomVec3();
+    for (Vec3& normal : vertex.normal)
+      normal = RandomVec3();
+    for (auto& color : vertex.color)
+    {
+      for (u8& component : color)
+        component = static_cast<u8>(m_rng());
+    }
+    for (auto& coords : vertex.texCoords)
+    {
+      coords[0] = RandomFloat();
+      coords[1] = RandomFloat();
+    }
+    return vertex;
+  }
+
+  std::mt19937 m_rng{1234};
+};
+
+namespace
+{
+// Vec3 doesn't initialize its components, which the emboss texgen can read
+OutputVertexData ClearedVertex()
+{
+  OutputVertexData vertex;
+  vertex.mvPosition = Vec3(0.0f, 0.0f, 0.0f);
+  vertex.screenPosition = Vec3(0.0f, 0.0f, 0.0f);
+  vertex.normal.fill(Vec3(0.0f, 0.0f, 0.0f));
+  vertex.texCoords.fill(Vec3(0.0f, 0.0f, 0.0f));
+  return vertex;
+}
+
+void ExpectFloatEq(float expected, float actual)
+{
+  if (std::isnan(expected))
+    EXPECT_TRUE(std::isnan(actual));
+  else
+    EXPECT_EQ(expected, actual);
+}
+
+void ExpectVec3Eq(const Vec3& expected, const Vec3& actual)
+{
+  ExpectFloatEq(expected.x, actual.x);
+  ExpectFloatEq(expected.y, actual.y);
+  ExpectFloatEq(expected.z, actual.z);
+}
+
+void ExpectVertexEq(const OutputVertexData& expected, const OutputVertexData& actual)
+{
+  ExpectVec3Eq(expected.mvPosition, actual.mvPosition);
+  ExpectFloatEq(expected.projectedPosition.x, actual.projectedPosition.x);
+  ExpectFloatEq(expected.projectedPosition.y, actual.projectedPosition.y);
+  ExpectFloatEq(expected.projectedPosition.z, actual.projectedPosition.z);
+  ExpectFloatEq(expected.projectedPosition.w, actual.projectedPosition.w);
+  for (size_t i = 0; i < expected.normal.size(); i++)
+    ExpectVec3Eq(expected.normal[i], actual.normal[i]);
+  EXPECT_EQ(expected.color, actual.color);
+  for (size_t i = 0; i < expected.texCoords.size(); i++)
+    ExpectVec3Eq(expected.texCoords[i], actual.texCoords[i]);
+}
+}  // namespace
+
+// The batched transformation has to give exactly the same results as transforming every vertex
+// on its own, for any batch size.
+TEST_F(TransformUnitTest, BatchMatchesSingleVertices)
+{
+  for (int iteration = 0; iteration < 2000; iteration++)
+  {
+    const bool special_case = m_rng() % 4 == 0;
+    const bool normals = m_rng() % 4 != 0;
+    const bool nbt = normals && m_rng() % 2;
+    const bool same_matrices = m_rng() % 2;
+    const u32 count = m_rng() % VERTEX_BATCH_SIZE + 1;
+    RandomizeState(special_case);
+
+    std::array<InputVertexData, VERTEX_BATCH_SIZE> src;
+    for (InputVertexData& vertex : src)
+      vertex = RandomVertex(same_matrices);
+
+    std::array<OutputVertexData, VERTEX_BATCH_SIZE> expected;
+    std::array<OutputVertexData, VERTEX_BATCH_SIZE> actual;
+    expected.fill(ClearedVertex());
+    actual.fill(ClearedVertex());
+
+    for (u32 i = 0; i < count; i++)
+    {
+      TransformUnit::TransformPosition(&src[i], &expected[i]);
+      if (normals)
+        TransformUnit::TransformNormal(&src[i], nbt, &expected[i]);
+      TransformUnit::TransformColor(&src[i], &expected[i]);
+      TransformUnit::TransformTexCoord(&src[i], &expected[i], special_case);
+    }
+    TransformUnit::TransformVertices(src.data(), actual.data(), count, normals, nbt, special_case);
+
+    for (u32 i = 0; i < VERTEX_BATCH_SIZE; i++)
+    {
+      SCOPED_TRACE(testing::Message() << "iteration " << iteration << ", vertex " << i);
+      ExpectVertexEq(expected[i], actual[i]);
+    }
+    if (HasFailure())
+      return;
+  }
+}
@@ -0,0 +1,200 @@
+// Copyright 2018 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "VideoCommon/FrameDumpConversion.h"
+
+namespace
+{
+struct YUV420Image
+{
+  YUV420Image(int width, int height)
+      : y_stride(width + 3), chroma_stride((width + 1) / 2 + 5),
+        y(y_stride * height, 0xCD), u(chroma_stride * ((height + 1) / 2), 0xCD),
+        v(chroma_stride * ((height + 1) / 2), 0xCD)
+  {
+  }
+
+  FrameDumpConversion::YUV420Planes GetPlanes()
+  {
+    return {y.data(), u.data(), v.data(), y_stride, chroma_stride, chroma_stride};
+  }
+
+  int y_stride;
+  int chroma_stride;
+  std::vector<u8> y;
+  std::vector<u8> u;
+  std::vector<u8> v;
+};
+
+int Apply(int r, int g, int b, int coef_r, int coef_g, int coef_b, int offset)
+{
+  return ((coef_r * r + coef_g * g + coef_b * b + 128) >> 8) + offset;
+}
+
+// Straightforward per-pixel conversion that the results have to match exactly.
+void ReferenceConvert(const u8* rgba, int stride, int width, int height, YUV420Image* image)
+{
+  const auto pixel = [&](int x, int y) { return rgba + y * stride + x * 4; };
+
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      const u8* p = pixel(x, y);
+      image->y[y * image->y_stride + x] = Apply(p[0], p[1], p[2], 66, 129, 25, 16);
+    }
+  }
+
+  for (int cy = 0; cy < (height + 1) / 2; ++cy)
+  {
+    for (int cx = 0; cx < (width + 1) / 2; ++cx)
+    {
+      int average[3];
+      for (int c = 0; c < 3; ++c)
+      {
+        const int x0 = cx * 2, x1 = std::min(cx * 2 + 1, width - 1);
+        const int y0 = cy * 2, y1 = std::min(cy * 2 + 1, height - 1);
+        average[c] = (pixel(x0, y0)[c] + pixel(x1, y0)[c] + pixel(x0, y1)[c] +
+                      pixel(x1, y1)[c] + 2) >>
+                     2;
+      }
+      image->u[cy * image->chroma_stride + cx] =
+          Apply(average[0], average[1], average[2], -38, -74, 112, 128);
+      image->v[cy * image->chroma_stride + cx] =
+          Apply(average[0], average[1], average[2], 112, -94, -18, 128);
+    }
+  }
+}
+
+std::vector<u8> RandomImage(std::mt19937& rng, int stride, int height)
+{
+  std::vector<u8> rgba(stride * height);
+  for (u8& value : rgba)
+  {
+    // Make the extremes common
+    switch (rng() % 4)
+    {
+    case 0:
+      value = rng() % 2 ? 255 : 0;
+      break;
+    default:
+      value = static_cast<u8>(rng());
+      break;
+    }
+  }
+  return rgba;
+}
+}  // namespace
+
+TEST(FrameDumpConversion, SolidColors)
+{
+  struct Color
+  {
+    u8 r, g, b;
+    u8 y, u, v;
+  };
+  static const Color colors[] = {
+      {0, 0, 0, 16, 128, 128},   {255, 255, 255, 235, 128, 128}, {255, 0, 0, 82, 90, 240},
+      {0, 255, 0, 144, 54, 34},  {0, 0, 255, 41, 240, 110},
+  };
+
+  for (const Color& color : colors)
+  {
+    constexpr int SIZE = 16;
+    std::vector<u8> rgba(SIZE * SIZE * 4);
+    for (int i = 0; i < SIZE * SIZE; ++i)
+    {
+      rgba[i * 4] = color.r;
+      rgba[i * 4 + 1] = color.g;
+      rgba[i * 4 + 2] = color.b;
+      rgba[i * 4 + 3] = 0xFF;
+    }
+
+    YUV420Image image(SIZE, SIZE);
+    FrameDumpConversion::ConvertRGBAToYUV420(rgba.data(), SIZE * 4, SIZE, SIZE, image.GetPlanes(),
+                                             0, SIZE / 2);
+    EXPECT_EQ(color.y, image.y[0]);
+    EXPECT_EQ(color.y, image.y[(SIZE - 1) * image.y_stride + SIZE - 1]);
+    EXPECT_EQ(color.u, image.u[0]);
+    EXPECT_EQ(color.v, image.v[(SIZE / 2 - 1) * image.chroma_stride + SIZE / 2 - 1]);
+  }
+}
+
+TEST(FrameDumpConversion, MatchesReference)
+{
+  std::mt19937 rng(1);
+  for (int width : {1, 2, 7, 8, 9, 16, 31, 640})
+  {
+    for (int height : {1, 2, 3, 8, 15})
+    {
+      const int stride = width * 4 + 12;
+      const std::vector<u8> rgba = RandomImage(rng, stride, height);
+
+      YUV420Image expected(width, height);
+      ReferenceConvert(rgba.data(), stride, width, height, &expected);
+
+      YUV420Image actual(width, height);
+      FrameDumpConversion::ConvertRGBAToYUV420(rgba.data(), stride, width, height,
+                                               actual.GetPlanes(), 0, (height + 1) / 2);
+
+      ASSERT_EQ(expected.y, actual.y) << width << "x" << height;
+      ASSERT_EQ(expected.u, actual.u) << width << "x" << height;
+      ASSERT_EQ(expected.v, actual.v) << width << "x" << height;
+    }
+  }
+}
+
+TEST(FrameDumpConversion, StripsMatchWholeImage)
+{
+  constexpr int WIDTH = 100;
+  constexpr int HEIGHT = 37;
+  constexpr int CHROMA_ROWS = (HEIGHT + 1) / 2;
+  std::mt19937 rng(2);
+  const std::vector<u8> rgba = RandomImage(rng, WIDTH * 4, HEIGHT);
+
+  YUV420Image whole(WIDTH, HEIGHT);
+  FrameDumpConversion::ConvertRGBAToYUV420(rgba.data(), WIDTH * 4, WIDTH, HEIGHT,
+                                           whole.GetPlanes(), 0, CHROMA_ROWS);
+
+  YUV420Image strips(WIDTH, HEIGHT);
+  for (int row = CHROMA_ROWS; row > 0; row -= 5)
+  {
+    FrameDumpConversion::ConvertRGBAToYUV420(rgba.data(), WIDTH * 4, WIDTH, HEIGHT,
+                                             strips.GetPlanes(), std::max(row - 5, 0), row);
+  }
+
+  EXPECT_EQ(whole.y, strips.y);
+  EXPECT_EQ(whole.u, strips.u);
+  EXPECT_EQ(whole.v, strips.v);
+}
+
+// Measures how long converting a 1080p frame takes on one thread.
+TEST(FrameDumpConversion, DISABLED_Benchmark)
+{
+  constexpr int WIDTH = 1920;
+  constexpr int HEIGHT = 1080;
+  constexpr int NUM_FRAMES = 500;
+  std::mt19937 rng(3);
+  const std::vector<u8> rgba = RandomImage(rng, WIDTH * 4, HEIGHT);
+  YUV420Image image(WIDTH, HEIGHT);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < NUM_FRAMES; ++frame)
+  {
+    FrameDumpConversion::ConvertRGBAToYUV420(rgba.data(), WIDTH * 4, WIDTH, HEIGHT,
+                                             image.GetPlanes(), 0, HEIGHT / 2);
+  }
+  const long long time = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  std::printf("%lld us per frame\n", time / NUM_FRAMES);
+}
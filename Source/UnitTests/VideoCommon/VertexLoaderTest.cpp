@@ -4,6 +4,7 @@
 
 #include <limits>
 #include <memory>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <unordered_set>
@@ -12,11 +13,15 @@
 
 #include "Common/BitUtils.h"
 #include "Common/Common.h"
+#include "Common/FileUtil.h"
 #include "VideoCommon/CPMemory.h"
 #include "VideoCommon/DataReader.h"
+#include "VideoCommon/NativeVertexFormat.h"
 #include "VideoCommon/OpcodeDecoding.h"
+#include "VideoCommon/Statistics.h"
 #include "VideoCommon/VertexLoaderBase.h"
 #include "VideoCommon/VertexLoaderManager.h"
+#include "VideoCommon/VertexManagerBase.h"
 
 TEST(VertexLoaderUID, UniqueEnough)
 {
@@ -354,3 +359,109 @@ TEST_F(VertexLoaderTest, LargeFloatVertexSpeed)
   for (int i = 0; i < 100; ++i)
     RunVertices(100000);
 }
+
+TEST_F(VertexLoaderTest, ManagerReusesLoaders)
+{
+  // Only the preprocessing path is used, as it doesn't need a vertex manager
+  VertexLoaderManager::Init();
+  m_vtx_desc.Position = DIRECT;
+  m_vtx_attr.g0.PosFormat = FORMAT_FLOAT;
+  m_vtx_attr.g0.PosElements = 1;
+  g_preprocess_cp_state.vtx_desc = m_vtx_desc;
+  g_preprocess_cp_state.vtx_attr[0] = m_vtx_attr;
+  m_vtx_attr.g0.PosFormat = FORMAT_SHORT;
+  g_preprocess_cp_state.vtx_attr[1] = m_vtx_attr;
+
+  EXPECT_EQ(36, VertexLoaderManager::RunVertices(0, 0, 3, m_src, true));
+  EXPECT_EQ(18, VertexLoaderManager::RunVertices(1, 0, 3, m_src, true));
+  VertexLoaderBase* const float_loader = g_preprocess_cp_state.vertex_loaders[0];
+  VertexLoaderBase* const short_loader = g_preprocess_cp_state.vertex_loaders[1];
+  EXPECT_NE(float_loader, short_loader);
+  EXPECT_EQ(2, stats.numVertexLoaders);
+
+  // Changing the vertex descriptor back and forth must find the same loaders again
+  for (int i = 0; i < 10; i++)
+  {
+    VertexLoaderManager::MarkAllDirty();
+    EXPECT_EQ(36, VertexLoaderManager::RunVertices(0, 0, 3, m_src, true));
+    EXPECT_EQ(18, VertexLoaderManager::RunVertices(1, 0, 3, m_src, true));
+    EXPECT_EQ(float_loader, g_preprocess_cp_state.vertex_loaders[0]);
+    EXPECT_EQ(short_loader, g_preprocess_cp_state.vertex_loaders[1]);
+  }
+  EXPECT_EQ(2, stats.numVertexLoaders);
+
+  VertexLoaderManager::Clear();
+}
+
+namespace
+{
+class TestNativeVertexFormat final : public NativeVertexFormat
+{
+public:
+  explicit TestNativeVertexFormat(const PortableVertexDeclaration& decl) { vtx_decl = decl; }
+};
+
+// Only creates native vertex formats, which the UID cache does on load
+class TestVertexManager final : public VertexManagerBase
+{
+public:
+  std::unique_ptr<NativeVertexFormat>
+  CreateNativeVertexFormat(const PortableVertexDeclaration& decl) override
+  {
+    return std::make_unique<TestNativeVertexFormat>(decl);
+  }
+
+private:
+  void ResetBuffer(u32 stride) override {}
+  void vFlush() override {}
+};
+}  // namespace
+
+TEST_F(VertexLoaderTest, ManagerPrecompilesCachedLoaders)
+{
+  g_vertex_manager = std::make_unique<TestVertexManager>();
+  const std::string temp_dir = File::CreateTempDir();
+  const std::string path = temp_dir + "/test.vluidcache";
+
+  VertexLoaderManager::Init();
+  m_vtx_desc.Position = DIRECT;
+  m_vtx_attr.g0.PosFormat = FORMAT_FLOAT;
+  m_vtx_attr.g0.PosElements = 1;
+  g_preprocess_cp_state.vtx_desc = m_vtx_desc;
+  g_preprocess_cp_state.vtx_attr[0] = m_vtx_attr;
+  m_vtx_attr.g0.PosFormat = FORMAT_SHORT;
+  g_preprocess_cp_state.vtx_attr[1] = m_vtx_attr;
+
+  // The first session records the loaders it creates
+  VertexLoaderManager::LoadVertexLoaderUIDCache(path);
+  EXPECT_EQ(36, VertexLoaderManager::RunVertices(0, 0, 3, m_src, true));
+  EXPECT_EQ(18, VertexLoaderManager::RunVertices(1, 0, 3, m_src, true));
+  EXPECT_EQ(2, stats.numVertexLoaders);
+  VertexLoaderManager::Clear();
+  EXPECT_EQ(4u + 4u + 2 * (8 + 12 + sizeof(PortableVertexDeclaration)), File::GetSize(path));
+
+  // The next one compiles them before they are used
+  VertexLoaderManager::Init();
+  VertexLoaderManager::LoadVertexLoaderUIDCache(path);
+  VertexLoaderManager::WaitForPrecompiledVertexLoaders();
+  EXPECT_EQ(2, stats.numVertexLoaders);
+  EXPECT_EQ(36, VertexLoaderManager::RunVertices(0, 0, 3, m_src, true));
+  EXPECT_EQ(18, VertexLoaderManager::RunVertices(1, 0, 3, m_src, true));
+  EXPECT_EQ(2, stats.numVertexLoaders);
+
+  // Preprocessing never creates native vertex formats, so these come from the cache
+  for (int i = 0; i < 2; i++)
+  {
+    const VertexLoaderBase* loader = g_preprocess_cp_state.vertex_loaders[i];
+    ASSERT_NE(nullptr, loader->m_native_vertex_format);
+    EXPECT_EQ(loader->m_native_vtx_decl,
+              loader->m_native_vertex_format->GetVertexDeclaration());
+  }
+  VertexLoaderManager::Clear();
+
+  // Loaders which were already in the file aren't added again
+  EXPECT_EQ(4u + 4u + 2 * (8 + 12 + sizeof(PortableVertexDeclaration)), File::GetSize(path));
+
+  File::DeleteDirRecursively(temp_dir);
+  g_vertex_manager.reset();
+}